@@ -0,0 +1,717 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Distributed tests (--agent and --agents).
+ *
+ * An agent (httperf --agent=PORT) waits for controllers on a TCP port.  A
+ * controller (httperf --agents=HOST:PORT,... plus the usual options)
+ * connects to every agent it was given and sends each its command line,
+ * the agent's number and the wall-clock instant at which all of them are
+ * to start.  The agent runs that command line as a child process, which
+ * takes a 1/N share of the load just like a worker does, so --workers and
+ * everything else work the same as they do locally.
+ *
+ * While the test runs, every process of an agent sends the number of
+ * replies and errors of each rate sampling interval.  At the end, the
+ * agent sends the state of its statistic collectors (as --workers does,
+ * see worker.c) followed by the report it printed.  The controller prints
+ * the report of every agent and then merges all collector states into its
+ * own, so the global results, percentiles included, are exact.
+ *
+ * Agents run with whatever options a controller sends them, so only make
+ * them listen where trusted controllers can reach them.  Files named on
+ * the command line must exist on the agent hosts, and all hosts must run
+ * the same httperf build.  Starting together relies on the hosts' clocks
+ * being synchronized (with NTP, for example).
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <generic_types.h>
+#include <sys/resource.h>	/* after sys/types.h for BSD (in generic_types.h) */
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <localevent.h>
+#include <worker.h>
+#include <agent.h>
+
+#define	AGENT_MAGIC		0x68747066	/* "htpf" */
+#define	AGENT_ENV		"HTTPERF_AGENT"
+#define	AGENT_START_DELAY	2.0	/* seconds to get all agents going */
+#define	AGENT_MAX_ARGS		(1024*1024)	/* bytes of command line */
+
+/*
+ * Sent by the controller, followed by ARGS_LEN bytes of NUL-terminated
+ * arguments.
+ */
+struct agent_hello {
+	u_int           magic;
+	u_int           argc;
+	u_int           args_len;
+	char            version[16];
+	u_int           agent_id;	/* which of the NUM_AGENTS this is */
+	u_int           num_agents;
+	double          start;	/* time of day to start at */
+};
+
+enum agent_msg_type {
+	AGENT_INTERVAL = 1,	/* struct agent_interval follows */
+	AGENT_RESULTS,		/* see worker_send_results() */
+	AGENT_OUTPUT		/* LEN bytes of the agent's report */
+};
+
+/*
+ * Header of everything an agent sends.
+ */
+struct agent_msg {
+	u_int           type;
+	u_int           len;
+};
+
+struct agent_interval {
+	int             worker;
+	Time            time;	/* since the start of the test */
+	double          reply_rate;
+	u_long          num_replies;
+	u_long          num_errors;
+};
+
+int             agent_mode;
+
+static char   **saved_argv;
+static int      saved_argc;
+
+/*
+ * In a process started by an agent: where the messages go, and when to
+ * start.
+ */
+static int      msg_fd = -1;
+static double   start_at;
+static Time     test_start;
+static u_long   num_replies, num_errors;
+static u_long   prev_replies, prev_errors;
+
+static double
+wall_now(void)
+{
+	struct timeval  tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+/*
+ * Some options are parsed in place, so remember the command line as it
+ * was given.
+ */
+void
+agent_save_args(int argc, char **argv)
+{
+	int             i;
+
+	saved_argv = calloc(argc + 1, sizeof(saved_argv[0]));
+	if (!saved_argv) {
+		fprintf(stderr, "%s.agent_save_args: out of memory\n",
+		    prog_name);
+		exit(1);
+	}
+	for (i = 0; i < argc; ++i)
+		if (!(saved_argv[i] = strdup(argv[i]))) {
+			fprintf(stderr, "%s.agent_save_args: out of memory\n",
+			    prog_name);
+			exit(1);
+		}
+	saved_argc = argc;
+}
+
+/*
+ * Run the test described by the controller's hello on connection CD.
+ */
+static void
+run_test(const char *argv0, int cd)
+{
+	struct agent_hello hello;
+	struct agent_msg msg;
+	struct pollfd   pfd[2];
+	char           *args = NULL, *cp, *output = NULL, **argv = NULL;
+	char            env[64], buf[4096];
+	size_t          output_len = 0, output_size = 0;
+	int             msg_pipe[2], out_pipe[2], nopen, status, i;
+	int             controller_gone = 0;
+	ssize_t         n;
+	pid_t           pid;
+
+	if (read_all(cd, &hello, sizeof(hello)) < 0
+	    || hello.magic != AGENT_MAGIC) {
+		fprintf(stderr, "%s: not a controller\n", prog_name);
+		return;
+	}
+	hello.version[sizeof(hello.version) - 1] = '\0';
+	if (strcmp(hello.version, VERSION) != 0) {
+		fprintf(stderr, "%s: controller runs httperf-%s, this is "
+		    "httperf-" VERSION "\n", prog_name, hello.version);
+		return;
+	}
+	if (hello.args_len > AGENT_MAX_ARGS || hello.argc > hello.args_len
+	    || hello.agent_id >= hello.num_agents)
+		return;
+
+	args = malloc(hello.args_len + 1);
+	argv = calloc(hello.argc + 2, sizeof(argv[0]));
+	if (!args || !argv) {
+		fprintf(stderr, "%s.agent: out of memory\n", prog_name);
+		goto done;
+	}
+	if (read_all(cd, args, hello.args_len) < 0)
+		goto done;
+	args[hello.args_len] = '\0';
+	argv[0] = (char *) argv0;
+	for (i = 1, cp = args; i <= (int) hello.argc; ++i) {
+		if (cp >= args + hello.args_len)
+			goto done;
+		argv[i] = cp;
+		cp += strlen(cp) + 1;
+	}
+
+	if (pipe(msg_pipe) < 0 || pipe(out_pipe) < 0) {
+		fprintf(stderr, "%s.agent: pipe: %s\n", prog_name,
+		    strerror(errno));
+		goto done;
+	}
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "%s.agent: fork: %s\n", prog_name,
+		    strerror(errno));
+		close(msg_pipe[0]);
+		close(msg_pipe[1]);
+		close(out_pipe[0]);
+		close(out_pipe[1]);
+		goto done;
+	}
+	if (pid == 0) {
+		close(cd);
+		close(msg_pipe[0]);
+		close(out_pipe[0]);
+		dup2(out_pipe[1], 1);
+		dup2(out_pipe[1], 2);
+		close(out_pipe[1]);
+		snprintf(env, sizeof(env), "%d,%.6f,%u,%u", msg_pipe[1],
+		    hello.start, hello.agent_id, hello.num_agents);
+		setenv(AGENT_ENV, env, 1);
+		execvp(argv0, argv);
+		fprintf(stderr, "%s: can't run %s: %s\n", prog_name, argv0,
+		    strerror(errno));
+		_exit(127);
+	}
+	close(msg_pipe[1]);
+	close(out_pipe[1]);
+
+	if (verbose)
+		printf("%s: running test as agent %u of %u\n", prog_name,
+		    hello.agent_id, hello.num_agents);
+
+	/*
+	 * Pass the messages on as they come and keep the report for the
+	 * end.
+	 */
+	pfd[0].fd = msg_pipe[0];
+	pfd[1].fd = out_pipe[0];
+	pfd[0].events = pfd[1].events = POLLIN;
+	for (nopen = 2; nopen > 0;) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (i = 0; i < 2; ++i) {
+			if (pfd[i].fd < 0 || !pfd[i].revents)
+				continue;
+			n = read(pfd[i].fd, buf, sizeof(buf));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				close(pfd[i].fd);
+				pfd[i].fd = -1;
+				--nopen;
+				continue;
+			}
+			if (i == 0) {
+				if (!controller_gone
+				    && write_all(cd, buf, n) < 0) {
+					/*
+					 * Nobody wants the results anymore.
+					 */
+					kill(pid, SIGINT);
+					controller_gone = 1;
+				}
+				continue;
+			}
+			if (output_len + n > output_size) {
+				output_size = 2 * (output_len + n);
+				cp = realloc(output, output_size);
+				if (!cp) {
+					fprintf(stderr, "%s.agent: out of "
+					    "memory\n", prog_name);
+					continue;
+				}
+				output = cp;
+			}
+			memcpy(output + output_len, buf, n);
+			output_len += n;
+		}
+	}
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+	msg.type = AGENT_OUTPUT;
+	msg.len = output_len;
+	if (!controller_gone && write_all(cd, &msg, sizeof(msg)) == 0)
+		write_all(cd, output, output_len);
+
+      done:
+	free(output);
+	free(argv);
+	free(args);
+}
+
+/*
+ * Serve controllers, one at a time, on [ADDR:]PORT.  Never returns.
+ */
+void
+agent_serve(const char *argv0, const char *spec)
+{
+	struct sockaddr_in sin;
+	socklen_t       len;
+	const char     *port;
+	char           *end, addr[64];
+	int             sd, cd, on = 1;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	port = strrchr(spec, ':');
+	if (port) {
+		if ((size_t) (port - spec) >= sizeof(addr))
+			goto bad_spec;
+		memcpy(addr, spec, port - spec);
+		addr[port - spec] = '\0';
+		if (!inet_aton(addr, &sin.sin_addr))
+			goto bad_spec;
+		++port;
+	} else
+		port = spec;
+	errno = 0;
+	sin.sin_port = htons(strtoul(port, &end, 10));
+	if (errno || end == port || *end || sin.sin_port == 0)
+		goto bad_spec;
+
+	sd = socket(AF_INET, SOCK_STREAM, 0);
+	if (sd < 0
+	    || setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0
+	    || bind(sd, (struct sockaddr *) &sin, sizeof(sin)) < 0
+	    || listen(sd, 4) < 0
+	    || fcntl(sd, F_SETFD, FD_CLOEXEC) < 0) {
+		fprintf(stderr, "%s: can't listen on %s: %s\n", prog_name,
+		    spec, strerror(errno));
+		exit(1);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	printf("%s: agent waiting for controllers on %s\n", prog_name, spec);
+	fflush(stdout);
+
+	for (;;) {
+		len = sizeof(sin);
+		cd = accept(sd, (struct sockaddr *) &sin, &len);
+		if (cd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "%s: accept: %s\n", prog_name,
+			    strerror(errno));
+			exit(1);
+		}
+		if (verbose)
+			printf("%s: controller %s connected\n", prog_name,
+			    inet_ntoa(sin.sin_addr));
+		run_test(argv0, cd);
+		close(cd);
+	}
+
+      bad_spec:
+	fprintf(stderr, "%s: --agent expects [ADDR:]PORT, not %s\n",
+	    prog_name, spec);
+	exit(1);
+}
+
+/*
+ * In a process started by an agent: pick up where to send messages to,
+ * when to start and which share of the load to take.
+ */
+void
+agent_init(void)
+{
+	const char     *env = getenv(AGENT_ENV);
+	u_int           id, n;
+
+	if (!env || sscanf(env, "%d,%lf,%u,%u", &msg_fd, &start_at, &id,
+	    &n) != 4)
+		return;
+	unsetenv(AGENT_ENV);
+	agent_mode = 1;
+	worker_slice(id, n);
+}
+
+static void
+perf_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	struct {
+		struct agent_msg msg;
+		struct agent_interval iv;
+	}               m;
+
+	m.msg.type = AGENT_INTERVAL;
+	m.msg.len = sizeof(m.iv);
+	m.iv.worker = worker_id;
+	m.iv.time = timer_now() - test_start;
+	m.iv.num_replies = num_replies - prev_replies;
+	m.iv.num_errors = num_errors - prev_errors;
+	m.iv.reply_rate = call_arg.d * m.iv.num_replies;
+	prev_replies = num_replies;
+	prev_errors = num_errors;
+
+	/*
+	 * The message is smaller than PIPE_BUF, so the messages of several
+	 * workers don't get mixed up.
+	 */
+	write_all(msg_fd, &m, sizeof(m));
+}
+
+/*
+ * Wait for the instant the controller asked for and start reporting on
+ * every rate sampling interval.
+ */
+void
+agent_start(void)
+{
+	struct timespec ts;
+	Any_Type        arg;
+	double          delay;
+
+	if (!agent_mode)
+		return;
+
+	delay = start_at - wall_now();
+	if (delay < 0)
+		fprintf(stderr, "%s: starting %.3f seconds late\n", prog_name,
+		    -delay);
+	else {
+		ts.tv_sec = (time_t) delay;
+		ts.tv_nsec = (long) ((delay - ts.tv_sec) * 1e9);
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+	}
+
+	arg.l = 0;
+	event_register_handler(EV_PERF_SAMPLE, perf_sample, arg);
+	event_register_counter(EV_CALL_RECV_STOP, &num_replies);
+	event_register_counter(EV_CONN_FAILED, &num_errors);
+	event_register_counter(EV_CONN_TIMEOUT, &num_errors);
+	/*
+	 * The timers were armed for a test starting now; shift them past the
+	 * wait so it isn't counted as timer lag.
+	 */
+	timer_rebase();
+	test_start = timer_now();
+}
+
+/*
+ * Send the controller the merged results of this agent.  Called after
+ * worker_collect(), so only by the first worker.
+ */
+void
+agent_report(Stat_Collector **stat, int num_stats)
+{
+	struct agent_msg msg;
+
+	if (!agent_mode)
+		return;
+
+	msg.type = AGENT_RESULTS;
+	msg.len = 0;
+	if (write_all(msg_fd, &msg, sizeof(msg)) < 0
+	    || worker_send_results(msg_fd, stat, num_stats) < 0)
+		fprintf(stderr, "%s: failed to send results to the "
+		    "controller: %s\n", prog_name, strerror(errno));
+	close(msg_fd);
+	msg_fd = -1;
+}
+
+struct agent {
+	char           *name;	/* HOST:PORT */
+	int             sd;
+	int             have_results;
+	char           *output;
+	u_int           output_len;
+};
+
+static void
+connect_agent(struct agent *a)
+{
+	struct addrinfo hints, *res, *ai;
+	char           *host, *port;
+	int             err;
+
+	host = strdup(a->name);
+	if (!host) {
+		fprintf(stderr, "%s.agent_control: out of memory\n",
+		    prog_name);
+		exit(1);
+	}
+	port = strrchr(host, ':');
+	if (!port || port == host || !port[1]) {
+		fprintf(stderr, "%s: --agents expects HOST:PORT, not %s\n",
+		    prog_name, a->name);
+		exit(1);
+	}
+	*port++ = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if ((err = getaddrinfo(host, port, &hints, &res)) != 0) {
+		fprintf(stderr, "%s: can't resolve agent %s: %s\n",
+		    prog_name, a->name, gai_strerror(err));
+		exit(1);
+	}
+	a->sd = -1;
+	for (ai = res; ai && a->sd < 0; ai = ai->ai_next) {
+		a->sd = socket(ai->ai_family, ai->ai_socktype,
+		    ai->ai_protocol);
+		if (a->sd >= 0 && connect(a->sd, ai->ai_addr,
+		    ai->ai_addrlen) < 0) {
+			err = errno;
+			close(a->sd);
+			a->sd = -1;
+			errno = err;
+		}
+	}
+	freeaddrinfo(res);
+	if (a->sd < 0) {
+		fprintf(stderr, "%s: can't connect to agent %s: %s\n",
+		    prog_name, a->name, strerror(errno));
+		exit(1);
+	}
+	free(host);
+}
+
+/*
+ * Read one message from agent A into the collectors STAT.  Returns -1
+ * once the agent is done.
+ */
+static int
+read_message(int i, struct agent *a, Stat_Collector **stat, int num_stats)
+{
+	struct agent_msg msg;
+	struct agent_interval iv;
+
+	if (read_all(a->sd, &msg, sizeof(msg)) < 0)
+		return -1;
+
+	switch (msg.type) {
+	case AGENT_INTERVAL:
+		if (msg.len != sizeof(iv) || read_all(a->sd, &iv,
+		    sizeof(iv)) < 0)
+			return -1;
+		printf("Agent %d worker %d: %.1f s reply-rate %.1f replies "
+		    "%lu errors %lu\n", i, iv.worker, iv.time, iv.reply_rate,
+		    iv.num_replies, iv.num_errors);
+		fflush(stdout);
+		return 0;
+
+	case AGENT_RESULTS:
+		if (worker_receive_results(a->sd, stat, num_stats, 1) < 0)
+			return -1;
+		a->have_results = 1;
+		return 0;
+
+	case AGENT_OUTPUT:
+		a->output = malloc(msg.len + 1);
+		if (!a->output || read_all(a->sd, a->output, msg.len) < 0)
+			return -1;
+		a->output[msg.len] = '\0';
+		a->output_len = msg.len;
+		return 0;
+	}
+	return -1;
+}
+
+/*
+ * Have the agents of --agents run the test and merge their results into
+ * STAT.  Used by the controller in place of core_loop().
+ */
+void
+agent_control(Stat_Collector **stat, int num_stats)
+{
+	struct agent_hello hello;
+	struct agent   *agent = NULL;
+	struct pollfd  *pfd;
+	char           *list, *name, *args;
+	size_t          args_len = 0;
+	int             num_agents = 0, argc = 0, nopen, i;
+
+	list = strdup(param.agents);
+	if (!list) {
+		fprintf(stderr, "%s.agent_control: out of memory\n",
+		    prog_name);
+		exit(1);
+	}
+	for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+		agent = realloc(agent, (num_agents + 1) * sizeof(agent[0]));
+		if (!agent) {
+			fprintf(stderr, "%s.agent_control: out of memory\n",
+			    prog_name);
+			exit(1);
+		}
+		memset(&agent[num_agents], 0, sizeof(agent[0]));
+		agent[num_agents++].name = name;
+	}
+	if (num_agents == 0) {
+		fprintf(stderr, "%s: --agents needs at least one agent\n",
+		    prog_name);
+		exit(1);
+	}
+
+	/*
+	 * The agents get our command line except for --agents.
+	 */
+	args = malloc(AGENT_MAX_ARGS);
+	if (!args) {
+		fprintf(stderr, "%s.agent_control: out of memory\n",
+		    prog_name);
+		exit(1);
+	}
+	for (i = 1; i < saved_argc; ++i) {
+		if (strncmp(saved_argv[i], "--agents=", 9) == 0)
+			continue;
+		if (strcmp(saved_argv[i], "--agents") == 0) {
+			++i;
+			continue;
+		}
+		if (args_len + strlen(saved_argv[i]) + 1 > AGENT_MAX_ARGS) {
+			fprintf(stderr, "%s: command line too long for the "
+			    "agents\n", prog_name);
+			exit(1);
+		}
+		strcpy(args + args_len, saved_argv[i]);
+		args_len += strlen(saved_argv[i]) + 1;
+		++argc;
+	}
+
+	for (i = 0; i < num_agents; ++i)
+		connect_agent(&agent[i]);
+
+	memset(&hello, 0, sizeof(hello));
+	hello.magic = AGENT_MAGIC;
+	hello.argc = argc;
+	hello.args_len = args_len;
+	hello.num_agents = num_agents;
+	strncpy(hello.version, VERSION, sizeof(hello.version) - 1);
+	hello.start = wall_now() + AGENT_START_DELAY;
+	for (i = 0; i < num_agents; ++i) {
+		hello.agent_id = i;
+		if (write_all(agent[i].sd, &hello, sizeof(hello)) < 0
+		    || write_all(agent[i].sd, args, hello.args_len) < 0) {
+			fprintf(stderr, "%s: can't talk to agent %s: %s\n",
+			    prog_name, agent[i].name, strerror(errno));
+			exit(1);
+		}
+	}
+	free(args);
+
+	pfd = calloc(num_agents, sizeof(pfd[0]));
+	if (!pfd) {
+		fprintf(stderr, "%s.agent_control: out of memory\n",
+		    prog_name);
+		exit(1);
+	}
+	for (i = 0; i < num_agents; ++i) {
+		pfd[i].fd = agent[i].sd;
+		pfd[i].events = POLLIN;
+	}
+	for (nopen = num_agents; nopen > 0;) {
+		if (poll(pfd, num_agents, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "%s.agent_control: poll: %s\n",
+			    prog_name, strerror(errno));
+			exit(1);
+		}
+		for (i = 0; i < num_agents; ++i) {
+			if (pfd[i].fd < 0 || !pfd[i].revents)
+				continue;
+			if (read_message(i, &agent[i], stat, num_stats) < 0) {
+				close(pfd[i].fd);
+				pfd[i].fd = -1;
+				--nopen;
+			}
+		}
+	}
+	free(pfd);
+
+	for (i = 0; i < num_agents; ++i) {
+		printf("\n*** Agent %d (%s):\n", i, agent[i].name);
+		if (agent[i].output)
+			fwrite(agent[i].output, 1, agent[i].output_len,
+			    stdout);
+		if (!agent[i].have_results)
+			fprintf(stderr, "%s: lost results of agent %s\n",
+			    prog_name, agent[i].name);
+		free(agent[i].output);
+	}
+	printf("\n*** All %d agents:\n", num_agents);
+	free(agent);
+	free(list);
+}
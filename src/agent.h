@@ -0,0 +1,59 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef agent_h
+#define agent_h
+
+/*
+ * Non-zero in a process started by an agent on behalf of a controller
+ * (see agent.c).
+ */
+extern int	agent_mode;
+
+extern void	agent_save_args(int argc, char **argv);
+
+/*
+ * --agent: serve controllers forever.
+ */
+extern void	agent_serve(const char *argv0, const char *spec);
+
+/*
+ * In a process started by an agent: agent_init() must be called before
+ * the workers are forked, agent_start() right before the test starts and
+ * agent_report() once the results of all workers are in.
+ */
+extern void	agent_init(void);
+extern void	agent_start(void);
+extern void	agent_report(Stat_Collector **stat, int num_stats);
+
+/*
+ * --agents: run the test on the agents instead of locally.
+ */
+extern void	agent_control(Stat_Collector **stat, int num_stats);
+
+#endif /* agent_h */
@@ -0,0 +1,540 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Benchmarks of httperf itself (--bench).
+ *
+ * The micro-benchmarks time the operations on the hot path of every
+ * request: parsing a reply, scheduling and firing timers, allocating
+ * objects, signalling events and computing interarrival times.  Each is
+ * repeated until it has run for a while and reported in nanoseconds per
+ * operation, so a regression shows as a change in a single number.
+ *
+ * The end-to-end benchmark starts a minimal HTTP responder on the loopback
+ * interface and runs a closed-loop test against it with every available
+ * event loop: a fixed number of keep-alive connections, each sending its
+ * next request as soon as the reply to the previous one is in.  The
+ * responder does next to nothing per request, so the result is how many
+ * requests per second one httperf process can generate and what each
+ * costs in CPU time.  That tells how many client machines a test needs.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <core.h>
+#include <http.h>
+#include <localevent.h>
+#include <rate.h>
+#include <bench.h>
+
+#define	BENCH_TIME	0.5	/* seconds to run each micro-benchmark */
+#define	BENCH_BATCH	4096	/* timers fired per timer_tick() batch */
+
+#define	BENCH_CONNS	64	/* concurrent connections end-to-end */
+#define	BENCH_CALLS	2000	/* requests per connection */
+#define	BENCH_MAX_CLIENTS	1024	/* connections the responder takes */
+
+static const char bench_reply[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Thu, 01 Jan 2026 00:00:00 GMT\r\n"
+    "Server: httperf-bench\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 12\r\n"
+    "\r\n"
+    "hello world\n";
+
+/*
+ * The same body, a byte per chunk, the way streaming servers send it.
+ */
+static const char bench_chunked_reply[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Thu, 01 Jan 2026 00:00:00 GMT\r\n"
+    "Server: httperf-bench\r\n"
+    "Content-Type: text/plain\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n"
+    "1\r\nh\r\n1\r\ne\r\n1\r\nl\r\n1\r\nl\r\n1\r\no\r\n1\r\n \r\n"
+    "1\r\nw\r\n1\r\no\r\n1\r\nr\r\n1\r\nl\r\n1\r\nd\r\n1\r\n\n\r\n"
+    "0\r\n\r\n";
+
+static const char responder_reply[] =
+    "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+
+static Conn    *bench_conn;
+static Rate_Generator bench_rg;
+static Rate_Info bench_rate;
+static u_long   num_fired;
+
+static u_long
+bench_parse_reply(const char *reply, size_t size, u_long n)
+{
+	char            buf[sizeof(bench_chunked_reply)], *cp;
+	size_t          len;
+	Call           *c;
+	u_long          i;
+
+	for (i = 0; i < n; ++i) {
+		/*
+		 * The parser works in place, so give it a fresh copy.
+		 */
+		memcpy(buf, reply, size);
+		cp = buf;
+		len = size - 1;
+		c = call_new();
+		c->conn = bench_conn;
+		bench_conn->state = S_REPLY_STATUS;
+		http_process_reply_bytes(c, &cp, &len);
+		if (bench_conn->state != S_REPLY_DONE || len != 0) {
+			fprintf(stderr, "%s.bench: reply not parsed\n",
+			    prog_name);
+			exit(1);
+		}
+		call_dec_ref(c);
+	}
+	return n;
+}
+
+static u_long
+bench_parse(u_long n)
+{
+	return bench_parse_reply(bench_reply, sizeof(bench_reply), n);
+}
+
+static u_long
+bench_parse_chunked(u_long n)
+{
+	return bench_parse_reply(bench_chunked_reply,
+	    sizeof(bench_chunked_reply), n);
+}
+
+static void
+bench_timeout(struct Timer *t, Any_Type arg)
+{
+	++num_fired;
+}
+
+static u_long
+bench_timer_cancel(u_long n)
+{
+	struct Timer   *t;
+	Any_Type        arg;
+	u_long          i;
+
+	arg.l = 0;
+	for (i = 0; i < n; ++i) {
+		t = timer_schedule(bench_timeout, arg, 1.0);
+		timer_cancel(t);
+	}
+	return n;
+}
+
+static u_long
+bench_timer_fire(u_long n)
+{
+	Any_Type        arg;
+	u_long          i, j;
+
+	arg.l = 0;
+	for (i = 0; i < n; i += BENCH_BATCH) {
+		num_fired = 0;
+		for (j = 0; j < BENCH_BATCH; ++j)
+			timer_schedule(bench_timeout, arg, 0.0);
+		while (num_fired < BENCH_BATCH)
+			timer_tick();
+	}
+	return i;
+}
+
+static u_long
+bench_object(u_long n)
+{
+	u_long          i;
+
+	for (i = 0; i < n; ++i)
+		call_dec_ref(call_new());
+	return n;
+}
+
+static void
+bench_handler(Event_Type et, Object * obj, Any_Type reg_arg,
+    Any_Type call_arg)
+{
+	++num_fired;
+}
+
+static u_long
+bench_event(u_long n)
+{
+	Any_Type        arg;
+	u_long          i;
+
+	arg.l = 0;
+	for (i = 0; i < n; ++i)
+		event_signal(EV_HOSTNAME_LOOKUP_START, 0, arg);
+	return n;
+}
+
+static u_long
+bench_event_unwanted(u_long n)
+{
+	Any_Type        arg;
+	u_long          i;
+
+	arg.l = 0;
+	for (i = 0; i < n; ++i)
+		event_signal(EV_HOSTNAME_LOOKUP_STOP, 0, arg);
+	return n;
+}
+
+static int
+bench_tick(Any_Type arg)
+{
+	return -1;
+}
+
+/*
+ * Sets up bench_rg to draw interarrival times from distribution DIST.
+ */
+static void
+bench_rate_init(Dist_Type dist)
+{
+	bench_rate.dist = dist;
+	bench_rate.rate_param = 1000.0;
+	bench_rate.mean_iat = 1e-3;
+	bench_rate.min_iat = 0.5e-3;
+	bench_rate.max_iat = 1.5e-3;
+	bench_rg.rate = &bench_rate;
+	bench_rg.tick = bench_tick;
+	rate_generator_start(&bench_rg, EV_NULL);
+	rate_generator_stop(&bench_rg);
+}
+
+static u_long
+bench_rate_run(u_long n)
+{
+	volatile Time   sum = 0.0;
+	u_long          i;
+
+	for (i = 0; i < n; ++i)
+		sum += (*bench_rg.next_interarrival_time) (&bench_rg);
+	return n;
+}
+
+static u_long
+bench_rate_det(u_long n)
+{
+	bench_rate_init(DETERMINISTIC);
+	return bench_rate_run(n);
+}
+
+static u_long
+bench_rate_uniform(u_long n)
+{
+	bench_rate_init(UNIFORM);
+	return bench_rate_run(n);
+}
+
+static u_long
+bench_rate_exp(u_long n)
+{
+	bench_rate_init(EXPONENTIAL);
+	return bench_rate_run(n);
+}
+
+static const struct bench {
+	const char     *name;
+	u_long          (*run) (u_long n);	/* returns # of operations */
+}               micro[] = {
+	{"http_process_reply_bytes", bench_parse},
+	{"  (12 one-byte chunks)", bench_parse_chunked},
+	{"timer_schedule+cancel", bench_timer_cancel},
+	{"timer_schedule+tick", bench_timer_fire},
+	{"object_new+dec_ref", bench_object},
+	{"event_signal", bench_event},
+	{"event_signal (unwanted)", bench_event_unwanted},
+	{"interarrival (det)", bench_rate_det},
+	{"interarrival (uniform)", bench_rate_uniform},
+	{"interarrival (exp)", bench_rate_exp},
+};
+
+static void
+run_micro(void)
+{
+	Any_Type        arg;
+	Time            start, elapsed;
+	u_long          n, ops;
+	int             i;
+
+	if (timer_init() == false) {
+		fprintf(stderr, "%s.bench: timer_init() failed\n", prog_name);
+		exit(1);
+	}
+	bench_conn = conn_new();
+	arg.l = 0;
+	event_register_handler(EV_HOSTNAME_LOOKUP_START, bench_handler, arg);
+
+	printf("Micro-benchmarks [ns/op]:\n");
+	for (i = 0; i < (int) NELEMS(micro); ++i) {
+		/*
+		 * Warm up, then double the count until it takes long enough.
+		 */
+		(*micro[i].run) (BENCH_BATCH);
+		for (n = BENCH_BATCH;; n *= 2) {
+			start = timer_now_forced();
+			ops = (*micro[i].run) (n);
+			elapsed = timer_now_forced() - start;
+			if (elapsed >= BENCH_TIME)
+				break;
+		}
+		printf("  %-28s %10.1f\n", micro[i].name, 1e9 * elapsed / ops);
+		fflush(stdout);
+	}
+	conn_dec_ref(bench_conn);
+}
+
+/*
+ * The loopback responder: answers every request it reads with an empty
+ * reply.  Requests are counted by their terminating empty line.
+ */
+static void
+responder(int ld)
+{
+	struct pollfd   pfd[BENCH_MAX_CLIENTS + 1];
+	int             state[BENCH_MAX_CLIENTS + 1];
+	char            buf[16384], out[64 * sizeof(responder_reply)];
+	int             nfds = 1, i, j, k, sd, nreq;
+	ssize_t         n;
+
+	pfd[0].fd = ld;
+	pfd[0].events = POLLIN;
+	for (;;) {
+		if (poll(pfd, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			exit(1);
+		}
+		if (pfd[0].revents && nfds <= BENCH_MAX_CLIENTS
+		    && (sd = accept(ld, NULL, NULL)) >= 0) {
+			pfd[nfds].fd = sd;
+			pfd[nfds].events = POLLIN;
+			pfd[nfds].revents = 0;
+			state[nfds++] = 0;
+		}
+		for (i = 1; i < nfds; ++i) {
+			if (!pfd[i].revents)
+				continue;
+			n = read(pfd[i].fd, buf, sizeof(buf));
+			if (n <= 0) {
+				close(pfd[i].fd);
+				pfd[i] = pfd[--nfds];
+				state[i] = state[nfds];
+				--i;
+				continue;
+			}
+			/*
+			 * STATE is how much of "\r\n\r\n" has been seen.
+			 */
+			for (j = 0, nreq = 0; j < n; ++j) {
+				if (buf[j] == "\r\n\r\n"[state[i]])
+					++state[i];
+				else
+					state[i] = buf[j] == '\r';
+				if (state[i] == 4) {
+					state[i] = 0;
+					++nreq;
+				}
+			}
+			while (nreq > 0) {
+				for (k = 0; k < nreq && k < 64; ++k)
+					memcpy(out + k * (sizeof(responder_reply)
+					    - 1), responder_reply,
+					    sizeof(responder_reply) - 1);
+				if (write(pfd[i].fd, out,
+				    k * (sizeof(responder_reply) - 1)) < 0)
+					break;
+				nreq -= k;
+			}
+		}
+	}
+}
+
+/*
+ * Runs a closed-loop test against PORT in a copy of ourselves, with
+ * EXTRA_ARG (if any) selecting the event loop, and reports the outcome.
+ */
+static void
+run_engine(const char *argv0, int port, const char *engine,
+    const char *extra_arg)
+{
+	char            port_arg[32], conns_arg[32], calls_arg[32];
+	char            line[1024];
+	const char     *argv[16];
+	u_long          num_conns, num_sent, num_replies;
+	double          duration = 0.0, user = 0.0, sys = 0.0;
+	int             fds[2], argc = 0, status;
+	FILE           *in;
+	pid_t           pid;
+
+	snprintf(port_arg, sizeof(port_arg), "--port=%d", port);
+	snprintf(conns_arg, sizeof(conns_arg), "--num-conns=%d", BENCH_CONNS);
+	snprintf(calls_arg, sizeof(calls_arg), "--num-calls=%d", BENCH_CALLS);
+	argv[argc++] = argv0;
+	argv[argc++] = "--server=127.0.0.1";
+	argv[argc++] = port_arg;
+	argv[argc++] = conns_arg;
+	argv[argc++] = calls_arg;
+	/*
+	 * Open all connections right away.
+	 */
+	argv[argc++] = "--rate=1000000";
+	argv[argc++] = "--timeout=10";
+	if (extra_arg)
+		argv[argc++] = extra_arg;
+	argv[argc] = NULL;
+
+	fflush(stdout);
+	if (pipe(fds) < 0 || (pid = fork()) < 0) {
+		fprintf(stderr, "%s.bench: %s\n", prog_name, strerror(errno));
+		exit(1);
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		dup2(fds[1], 1);
+		close(fds[1]);
+		execvp(argv0, (char *const *) argv);
+		fprintf(stderr, "%s: can't run %s: %s\n", prog_name, argv0,
+		    strerror(errno));
+		_exit(127);
+	}
+	close(fds[1]);
+
+	num_replies = 0;
+	in = fdopen(fds[0], "r");
+	while (in && fgets(line, sizeof(line), in)) {
+		if (sscanf(line, "Total: connections %lu requests %lu replies "
+		    "%lu test-duration %lf", &num_conns, &num_sent,
+		    &num_replies, &duration) == 4)
+			continue;
+		sscanf(line, "CPU time [s]: user %lf system %lf", &user, &sys);
+	}
+	if (in)
+		fclose(in);
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+	if (num_replies == 0 || duration <= 0.0) {
+		printf("  %-10s failed\n", engine);
+		return;
+	}
+	printf("  %-10s %10.0f req/s %8.0f ns/request %8.0f CPU ns/request\n",
+	    engine, num_replies / duration, 1e9 * duration / num_replies,
+	    1e9 * (user + sys) / num_replies);
+	fflush(stdout);
+}
+
+static void
+run_loopback(const char *argv0)
+{
+	struct sockaddr_in sin;
+	socklen_t       len = sizeof(sin);
+	int             ld;
+	pid_t           pid;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ld = socket(AF_INET, SOCK_STREAM, 0);
+	if (ld < 0 || bind(ld, (struct sockaddr *) &sin, sizeof(sin)) < 0
+	    || listen(ld, BENCH_CONNS) < 0
+	    || getsockname(ld, (struct sockaddr *) &sin, &len) < 0) {
+		fprintf(stderr, "%s.bench: can't set up the responder: %s\n",
+		    prog_name, strerror(errno));
+		exit(1);
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "%s.bench: fork: %s\n", prog_name,
+		    strerror(errno));
+		exit(1);
+	}
+	if (pid == 0)
+		responder(ld);
+	close(ld);
+
+	printf("Loopback, %d connections of %d requests each:\n",
+	    BENCH_CONNS, BENCH_CALLS);
+	run_engine(argv0, ntohs(sin.sin_port), core_engine_name, NULL);
+#ifdef HAVE_IO_URING
+	run_engine(argv0, ntohs(sin.sin_port), "io_uring", "--io-uring");
+#endif
+
+	kill(pid, SIGTERM);
+	while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+}
+
+/*
+ * Runs the benchmarks selected by WHAT (BENCH_MICRO and/or BENCH_LOOPBACK)
+ * and exits.  ARGV0 is how httperf was started.
+ */
+void
+bench_run(const char *argv0, int what)
+{
+	if (!timer_clock_init(param.clock)) {
+		fprintf(stderr, "%s: the selected --clock is not available "
+		    "on this system\n", prog_name);
+		exit(1);
+	}
+	if (what & BENCH_MICRO)
+		run_micro();
+	if (what & BENCH_LOOPBACK) {
+		if (what & BENCH_MICRO)
+			putchar('\n');
+		run_loopback(argv0);
+	}
+	exit(0);
+}
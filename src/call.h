@@ -71,11 +71,14 @@ typedef struct Call
     struct Call *sendq_next;
     struct Call *recvq_next;
     Time timeout;		/* used for watchdog management */
+    u_int uri_key;		/* per-URI statistics key (or 0) */
 
     struct
       {
+	Time time_intended;	/* when the call should have been issued */
 	Time time_send_start;
 	Time time_recv_start;
+	u_int epoch;		/* test_epoch when the request was sent */
       }
     basic;
 
@@ -85,9 +88,14 @@ typedef struct Call
 	int version;		/* 0x10000*major + minor */
 	u_int num_extra_hdrs;	/* number of additional headers in use */
 	int iov_index;		/* first iov element that has data */
+	int started;		/* the request is on its way out */
 	size_t size;		/* # of bytes sent */
 	struct iovec iov_saved;	/* saved copy of iov[iov_index] */
 	struct iovec iov[IE_LEN];
+	/* If not null, iov[IE_CONTENT] points into this mapping of the
+	   file CONTENTS_FD (see call_set_contents_file()).  */
+	const char *contents_map;
+	int contents_fd;
       }
     req;
 
@@ -99,6 +107,9 @@ typedef struct Call
 	size_t header_bytes;	/* # of header bytes received so far */
 	size_t content_bytes;	/* # of reply data bytes received so far */
 	size_t footer_bytes;	/* # of footer bytes received so far */
+	int sampled;		/* pass the body to EV_CALL_RECV_SAMPLE */
+	int corrupt;		/* the body failed the --verify checks */
+	int reset;		/* the server reset its HTTP/2 stream */
       }
     reply;
   }
@@ -141,9 +152,18 @@ extern int call_append_request_header (Call *c, const char *hdr, size_t len);
     {							\
       c->req.iov[IE_URI].iov_base = (caddr_t) uri;	\
       c->req.iov[IE_URI].iov_len = uri_len;		\
+      c->uri_key = 0;					\
     }							\
   while (0)
 
+/* Returns the key under which the per-URI statistics (--uri-stats)
+   of URI are kept, or 0 if they are not being collected.  A load
+   generator that issues the same URIs over and over should look up
+   each key once and store it in the URI_KEY of its calls (after
+   call_set_uri(), which clears it); for calls without a key, the URI
+   is looked up on every call.  */
+extern u_int uri_stat_key (const char *uri, size_t uri_len);
+
 #define call_set_contents(c, content, content_len)		\
   do								\
     {								\
@@ -152,4 +172,17 @@ extern int call_append_request_header (Call *c, const char *hdr, size_t len);
     }								\
   while (0)
 
+/* Send the LEN bytes at OFFSET of file FD, which is mapped (in full,
+   read-only) at MAP, as the contents of the request.  The core sends
+   them with sendfile() where it can, and otherwise straight from the
+   mapping, so they are never copied into the process.  */
+#define call_set_contents_file(c, fd, map, offset, len)		\
+  do								\
+    {								\
+      call_set_contents (c, (map) + (offset), len);		\
+      c->req.contents_map = (map);				\
+      c->req.contents_fd = (fd);				\
+    }								\
+  while (0)
+
 #endif /* call_h */
@@ -0,0 +1,226 @@
+/*
+ * capdump -- decodes the call capture files of httperf
+ *
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+/*
+ * capdump prints the calls recorded by httperf --capture, one per line,
+ * in the order they were issued (merging the records of all workers),
+ * as tab-separated fields preceded by a comment line naming them.  With
+ * -H, the reply header bytes of each call follow its line, indented.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <generic_types.h>
+#include <capture.h>
+
+struct entry {
+	double          time;	/* time of day */
+	u_int           worker;
+	const Capture_Record *r;
+};
+
+static const char *prog_name;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-H] file\n", prog_name);
+	exit(1);
+}
+
+static int
+by_time(const void *a, const void *b)
+{
+	const struct entry *x = a, *y = b;
+
+	if (x->time != y->time)
+		return x->time < y->time ? -1 : 1;
+	return x->worker != y->worker ? (x->worker < y->worker ? -1 : 1)
+	    : (x->r->call < y->r->call ? -1 : x->r->call > y->r->call);
+}
+
+static void
+print_flags(const Capture_Record * r)
+{
+	const char     *sep = "";
+
+	if (r->flags & CAPTURE_TIMEOUT) {
+		printf("%stimeout", sep);
+		sep = ",";
+	}
+	if (r->flags & CAPTURE_FAILED) {
+		printf("%sfailed:%s", sep, strerror(r->error));
+		sep = ",";
+	}
+	if (!(r->flags
+		& (CAPTURE_REPLIED | CAPTURE_TIMEOUT | CAPTURE_FAILED))) {
+		printf("%snoreply", sep);
+		sep = ",";
+	}
+	if (r->flags & CAPTURE_CORRUPT) {
+		printf("%scorrupt", sep);
+		sep = ",";
+	}
+	if (r->flags & CAPTURE_TRUNCATED) {
+		printf("%struncated", sep);
+		sep = ",";
+	}
+	if (!*sep)
+		printf("-");
+}
+
+static void
+print_header(const Capture_Record * r)
+{
+	const u_char   *cp = (const u_char *) (r + 1);
+	const u_char   *end = cp + r->header_len;
+	int             bol = 1;
+
+	for (; cp < end; ++cp) {
+		if (bol)
+			putchar('\t');
+		bol = *cp == '\n';
+		if (bol || isprint(*cp))
+			putchar(*cp);
+		else
+			printf("\\x%02x", *cp);
+	}
+	if (!bol)
+		putchar('\n');
+}
+
+int
+main(int argc, char **argv)
+{
+	const Capture_Header *hdr;
+	const Capture_Region *reg;
+	const Capture_Record *r;
+	struct entry   *e;
+	struct stat     st;
+	u_wide          i, n, first, num_entries = 0;
+	const char     *base;
+	int             ch, fd, headers = 0;
+	u_int           w;
+
+	prog_name = strrchr(argv[0], '/');
+	prog_name = prog_name ? prog_name + 1 : argv[0];
+
+	while ((ch = getopt(argc, argv, "H")) != -1)
+		switch (ch) {
+		case 'H':
+			headers = 1;
+			break;
+		default:
+			usage();
+		}
+	if (optind != argc - 1)
+		usage();
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0
+	    || (base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0))
+	    == MAP_FAILED) {
+		fprintf(stderr, "%s: can't read %s: %s\n", prog_name,
+		    argv[optind], strerror(errno));
+		exit(1);
+	}
+	close(fd);
+
+	hdr = (const Capture_Header *) base;
+	if ((size_t) st.st_size < sizeof(*hdr) || hdr->magic != CAPTURE_MAGIC
+	    || hdr->version != CAPTURE_VERSION
+	    || hdr->header_size + hdr->num_regions * hdr->region_size
+	    > (u_wide) st.st_size) {
+		fprintf(stderr, "%s: %s is not a capture file of this "
+		    "version of httperf\n", prog_name, argv[optind]);
+		exit(1);
+	}
+
+	/* first the number of records kept, then the records */
+	for (w = 0; w < hdr->num_regions; ++w) {
+		reg = (const Capture_Region *) (base + hdr->header_size
+		    + w * hdr->region_size);
+		n = reg->count < reg->num_slots ? reg->count : reg->num_slots;
+		printf("# worker %u (pid %u): %llu calls recorded, the last "
+		    "%llu kept\n", w, reg->pid,
+		    (unsigned long long) reg->count, (unsigned long long) n);
+		num_entries += n;
+	}
+	e = malloc((num_entries ? num_entries : 1) * sizeof(*e));
+	if (!e) {
+		fprintf(stderr, "%s: out of memory\n", prog_name);
+		exit(1);
+	}
+	num_entries = 0;
+	for (w = 0; w < hdr->num_regions; ++w) {
+		reg = (const Capture_Region *) (base + hdr->header_size
+		    + w * hdr->region_size);
+		first = reg->count > reg->num_slots
+		    ? reg->count - reg->num_slots : 0;
+		for (i = first; i < reg->count; ++i) {
+			r = (const Capture_Record *) ((const char *) reg
+			    + CAPTURE_ROUND(sizeof(*reg))
+			    + (i % reg->num_slots) * hdr->record_size);
+			e[num_entries].time = reg->start + 1e-9 * r->time;
+			e[num_entries].worker = w;
+			e[num_entries].r = r;
+			++num_entries;
+		}
+	}
+	qsort(e, num_entries, sizeof(*e), by_time);
+
+	printf("# time\tworker\tconn\tcall\tstatus\tresponse\ttransfer"
+	    "\trequest\theader\tbody\tflags\n");
+	for (i = 0; i < num_entries; ++i) {
+		r = e[i].r;
+		printf("%.6f\t%u\t%llu\t%llu\t%u\t%.3f\t%.3f\t%u\t%u\t%llu\t",
+		    e[i].time, e[i].worker, (unsigned long long) r->conn,
+		    (unsigned long long) r->call, r->status,
+		    1e-3 * r->response, 1e-3 * r->transfer,
+		    r->request_bytes, r->header_bytes,
+		    (unsigned long long) r->body_bytes);
+		print_flags(r);
+		putchar('\n');
+		if (headers && r->header_len)
+			print_header(r);
+	}
+	return 0;
+}
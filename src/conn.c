@@ -34,8 +34,10 @@
 #include "config.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -52,14 +54,108 @@
 #include <call.h>
 #include <conn.h>
 #include <core.h>
+#include <http2.h>
+#include <websocket.h>
 
-static char *srvbase, *srvend, *srvcurrent;
+/*
+ * The servers of the --servers file.  Connections go to them in turn, but
+ * a server with weight W gets W times as many connections as one with
+ * weight 1.  The picks are spread out by smooth weighted round-robin: each
+ * pick credits every server with its weight and takes the one with the
+ * most credit, which then pays back the total weight.
+ */
+struct backend {
+	const char	*name;
+	size_t		 name_len;
+	struct server	*server;
+	int		 weight;
+	int		 credit;
+};
+
+#define MAX_WEIGHT	1000000
 
+static struct backend *backends;
+static int num_backends, max_backends, next_backend;
+static int total_weight, weighted;
+static struct server *default_server;
+
+/*
+ * Line buffers not leased to any connection, linked through their first
+ * bytes.
+ */
+static char *free_line_bufs;
+
+static void
+add_backend(const char *entry, size_t len)
+{
+	struct backend *b;
+	const char *end = entry + len, *cp;
+	char *name, *weight_end;
+	long weight = 1;
+
+	while (entry < end && isspace((unsigned char)*entry))
+		++entry;
+	if (entry == end || *entry == '#')
+		return;
+	for (cp = entry; cp < end && !isspace((unsigned char)*cp); ++cp)
+		;
+	name = strndup(entry, cp - entry);
+	if (!name)
+		panic("%s: out of memory reading %s\n", prog_name,
+		    param.servers);
+
+	while (cp < end && isspace((unsigned char)*cp))
+		++cp;
+	if (cp < end) {
+		weight = strtol(cp, &weight_end, 10);
+		while (weight_end < end && isspace((unsigned char)*weight_end))
+			++weight_end;
+		if (weight_end != end || weight < 1 || weight > MAX_WEIGHT)
+			panic("%s: bad weight for server %s in %s "
+			    "(must be 1 to %d)\n", prog_name, name,
+			    param.servers, MAX_WEIGHT);
+	}
+
+	if (num_backends == max_backends) {
+		max_backends = max_backends ? 2 * max_backends : 64;
+		backends = realloc(backends, max_backends * sizeof(*backends));
+		if (!backends)
+			panic("%s: out of memory reading %s\n", prog_name,
+			    param.servers);
+	}
+	b = &backends[num_backends++];
+	b->name = name;
+	b->name_len = strlen(name);
+	b->server = core_addr_intern(name, b->name_len, param.port);
+	b->weight = weight;
+	b->credit = 0;
+	if (num_backends > 1 && weight != backends[0].weight)
+		weighted = 1;
+	total_weight += weight;
+	if (total_weight > INT_MAX / 2)
+		panic("%s: server weights in %s add up to too much\n",
+		    prog_name, param.servers);
+}
+
+/*
+ * Reads the --servers file.  It lists one server per line (entries may also
+ * be separated by NUL characters), optionally followed by its weight.  A
+ * server is a hostname or an IPv4 or IPv6 address; IPv6 addresses may be
+ * put in brackets to make the Host: header valid.  Blank lines and lines
+ * starting with `#' are ignored.
+ */
 void
 conn_add_servers(void)
 {
 	struct stat st;
-	int fd, len;
+	const char *base, *end, *cp, *entry;
+	int fd;
+
+	if (!param.servers) {
+		default_server = core_addr_intern(param.server,
+		    strlen(param.server), param.port);
+		return;
+	}
 
 	fd = open(param.servers, O_RDONLY, 0);
 	if (fd == -1)
@@ -69,49 +165,76 @@ conn_add_servers(void)
 	if (st.st_size == 0)
 		panic("%s: file %s is empty\n", prog_name, param.servers);
 
-	srvbase = (char *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if (srvbase == (char *)-1)
+	base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == (char *)-1)
 		panic("%s: can't mmap the file: %s\n", prog_name, strerror(errno));
 
 	close(fd);
 
-	srvend = srvbase + st.st_size;
-	for (srvcurrent = srvbase; srvcurrent < srvend; srvcurrent += len + 1) {
-		len = strlen(srvcurrent);
-		core_addr_intern(srvcurrent, len, param.port);
+	end = base + st.st_size;
+	for (entry = cp = base; cp <= end; ++cp)
+		if (cp == end || *cp == '\0' || *cp == '\n') {
+			add_backend(entry, cp - entry);
+			entry = cp + 1;
+		}
+	munmap((void *)base, st.st_size);
+
+	if (num_backends == 0)
+		panic("%s: no servers in %s\n", prog_name, param.servers);
+}
+
+static struct backend *
+pick_backend(void)
+{
+	struct backend *b, *best;
+	int i;
+
+	if (!weighted) {
+		b = &backends[next_backend];
+		if (++next_backend == num_backends)
+			next_backend = 0;
+		return b;
+	}
+
+	best = backends;
+	for (i = 0, b = backends; i < num_backends; ++i, ++b) {
+		b->credit += b->weight;
+		if (b->credit > best->credit)
+			best = b;
 	}
-	srvcurrent = srvbase;
+	best->credit -= total_weight;
+	return best;
 }
 
 void
 conn_init(Conn *conn)
 {
-	if (param.servers) {
-		int len = strlen(srvcurrent);
-		conn->hostname = srvcurrent;
-		conn->hostname_len = len;
+	struct backend *b;
+
+	if (num_backends > 0) {
+		b = pick_backend();
+		conn->hostname = b->name;
+		conn->hostname_len = b->name_len;
 		conn->fqdname = conn->hostname;
 		conn->fqdname_len = conn->hostname_len;
-
-		srvcurrent += len + 1;
-		if (srvcurrent >= srvend)
-			srvcurrent = srvbase;
+		conn->server = b->server;
 	} else if (param.server_name) {
 		conn->hostname = param.server;
 		conn->hostname_len = strlen(param.server);
 		conn->fqdname = param.server_name;
 		conn->fqdname_len = strlen(param.server_name);
+		conn->server = default_server;
 	} else {
 		conn->hostname = param.server;
 		conn->hostname_len = strlen(param.server);
 		conn->fqdname = conn->hostname;
 		conn->fqdname_len = conn->hostname_len;
+		conn->server = default_server;
 	}
 
 	conn->port = param.port;
 	conn->sd = -1;
 	conn->myport = -1;
-	conn->line.iov_base = conn->line_buf;
 
 #ifdef HAVE_SSL
 	if (param.use_ssl) {
@@ -143,8 +266,49 @@ conn_deinit(Conn *conn)
 	assert(!conn->watchdog);
 	conn->state = S_FREE;
 
+	if (conn->line_save)
+		conn_line_release(conn);
+#ifdef HAVE_IO_URING
+	if (conn->uring_iov)
+		free(conn->uring_iov);
+#endif
+	if (conn->h2)
+		h2_free(conn);
+	if (conn->ws)
+		ws_free(conn);
+
 #ifdef HAVE_SSL
 	if (param.use_ssl)
 		SSL_free(conn->ssl);
 #endif
 }
+
+char *
+conn_line_lease(void)
+{
+	char *buf = free_line_bufs;
+
+	if (buf) {
+		free_line_bufs = *(char **) buf;
+		return buf;
+	}
+	buf = malloc(MAX_HDR_LINE_LEN);
+	if (!buf) {
+		fprintf(stderr, "%s.conn_line_lease: out of memory\n",
+			prog_name);
+		exit(1);
+	}
+	return buf;
+}
+
+void
+conn_line_release(Conn *conn)
+{
+	if (conn->line_save_size == MAX_HDR_LINE_LEN) {
+		*(char **) conn->line_save = free_line_bufs;
+		free_line_bufs = conn->line_save;
+	} else
+		free(conn->line_save);
+	conn->line_save = 0;
+	conn->line_save_size = 0;
+}
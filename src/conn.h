@@ -42,9 +42,8 @@
 # include <openssl/err.h>
 #endif
 
-/* Maximum header line length that we can process properly.  Longer
-   lines will be treated as if they were only this long (i.e., they
-   will be truncated).  */
+/* Size of the buffers that hold header lines spanning two reads.
+   Longer lines are moved to a buffer of their own on the heap.  */
 #define MAX_HDR_LINE_LEN	1024
 
 struct Call;
@@ -67,22 +66,63 @@ typedef enum Conn_State
 Conn_State;
 
 struct local_addr;
+struct H2_Conn;
+struct WS_Conn;
 
 typedef struct Conn
   {
     Object obj;
 
+    /* Looked at whenever the connection is ready: */
     Conn_State state;
+    int	sd;			/* socket descriptor */
     struct Conn *next;
     struct Call *sendq;		/* calls whose request needs to be sent */
     struct Call *sendq_tail;
     struct Call *recvq;		/* calls waiting for a reply */
     struct Call *recvq_tail;
-    struct Timer *watchdog;
-
+    struct Timer *watchdog;	/* times the connection out (see core.c) */
+    Time watchdog_due;		/* when WATCHDOG fires */
+    Time connect_deadline;	/* when connecting times out (or 0) */
+    /* Since replies are read off the socket sequentially, much of the
+       reply-processing related state can be kept here instead of in
+       the reply structure: */
+    struct iovec line;		/* reply header line being parsed */
+    size_t content_length;	/* content length (or INF if unknown) */
+    size_t chunk_size;		/* chunk size parsed so far (see http.c) */
+    u_int chunk_state : 3;	/* where the chunk decoder is at */
+    u_int has_body : 1;		/* does reply have a body? */
+    u_int is_chunked : 1;	/* is the reply chunked? */
+    u_int reading : 1;
+    u_int writing : 1;
+    u_int server_close : 1;	/* server closes after the current reply */
+    u_int reused : 1;		/* connection came from the idle pool */
+    u_int tfo : 1;		/* connected with TCP Fast Open (--tfo) */
+    u_int tfo_accepted : 1;	/* the server took the data in the SYN */
+#ifdef HAVE_IO_URING
+    /* io_uring requests in flight (see core.c): */
+    u_int uring_connect : 1;
+    u_int uring_send : 1;
+    u_int uring_recv : 1;
+#endif
+#ifdef HAVE_SSL
+    u_int ktls_send : 1;	/* kernel encrypts what we write */
+    SSL *ssl;			/* SSL connection info */
+#endif
+    struct H2_Conn *h2;		/* HTTP/2 state (see http2.c) or 0 */
+    struct WS_Conn *ws;		/* WebSocket state (see websocket.c) or 0 */
+
+    /* Needed only now and then: */
+    char *line_save;		/* holds a line that spans reads (see
+				   conn_line_lease()), or 0 */
+    size_t line_save_size;
+#ifdef HAVE_IO_URING
+    struct iovec *uring_iov;	/* requests being written */
+#endif
     struct
       {
 	Time time_connect_start;	/* time connect() got called */
+	Time time_intended;	/* when the first call should have started */
 	u_int num_calls_completed;	/* # of calls that completed */
       }
     basic;			/* maintained by stat/stats_basic.c */
@@ -92,30 +132,17 @@ typedef struct Conn
     size_t fqdname_len;
     const char *fqdname;	/* fully qualified server name (or 0) */
     int port;			/* server's port (or -1 for default) */
-    int	sd;			/* socket descriptor */
     int myport;			/* local port number or -1 */
+    struct server *server;	/* resolved hostname:port (see core.c) */
     struct local_addr *myaddr;
-    /* Since replies are read off the socket sequentially, much of the
-       reply-processing related state can be kept here instead of in
-       the reply structure: */
-    struct iovec line;		/* buffer used to parse reply headers */
-    size_t content_length;	/* content length (or INF if unknown) */
-    u_int has_body : 1;		/* does reply have a body? */
-    u_int is_chunked : 1;	/* is the reply chunked? */
-    u_int reading : 1;
-    u_int writing : 1;
-    char line_buf[MAX_HDR_LINE_LEN];	/* default line buffer */
-
-#ifdef HAVE_SSL
-    SSL *ssl;			/* SSL connection info */
-#endif
   }
 Conn;
 
 extern int max_num_conn;
 extern Conn *conn;
 
-/* Store the servers to connect to in memory. */
+/* Intern the server(s) to connect to: --server or the entries of the
+   --servers file.  */
 extern void conn_add_servers (void);
 
 /* Initialize the new connection object C.  */
@@ -124,6 +151,14 @@ extern void conn_init (Conn *c);
 /* Destroy the connection-specific state in connection object C.  */
 extern void conn_deinit (Conn *c);
 
+/* Header lines that span reads are rare, so connections don't have a
+   buffer for them of their own: conn_line_lease() hands out one of
+   MAX_HDR_LINE_LEN bytes from a pool shared by all connections, and
+   conn_line_release() gives C's LINE_SAVE back (or frees it, if it
+   has grown beyond that).  */
+extern char *conn_line_lease (void);
+extern void conn_line_release (Conn *c);
+
 #define conn_new()	((Conn *) object_new (OBJ_CONN))
 #define conn_inc_ref(c)	object_inc_ref ((Object *) (c))
 #define conn_dec_ref(c)	object_dec_ref ((Object *) (c))
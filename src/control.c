@@ -0,0 +1,332 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The control socket (--control=PATH).  Each process of the test listens
+ * on a Unix socket of its own: PATH for the first and PATH.W for worker W
+ * of --workers.  A client sends commands, one per line, and gets back the
+ * command's output, if any, followed by a line that is either "ok" or
+ * "error: " and the reason:
+ *
+ *	rate R		offer R connections or sessions per second from now
+ *			on (R is divided among the workers like --rate)
+ *	pause		stop starting connections or sessions
+ *	resume		start them again at the current rate
+ *	stats		print the results collected so far
+ *	epoch		discard them and measure afresh (see --warmup)
+ *	stop		end the test and print the results as usual
+ *	help		list the commands
+ *
+ * The socket is polled from a timer every CONTROL_POLL seconds, so the
+ * commands take effect between two iterations of the event loop and
+ * nothing on the hot path needs to know about them.  Replies are written
+ * with blocking writes, so clients must read them.
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <generic_types.h>
+#include <sys/resource.h>	/* after sys/types.h for BSD (in generic_types.h) */
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <core.h>
+#include <localevent.h>
+#include <rate.h>
+#include <worker.h>
+#include <warmup.h>
+#include <control.h>
+
+#define	CONTROL_POLL		0.1	/* seconds between looks at the socket */
+#define	CONTROL_MAX_CLIENTS	8
+#define	CONTROL_MAX_LINE	256
+
+struct client {
+	int             sd;	/* -1 if the slot is free */
+	size_t          len;	/* of the partial line in BUF */
+	char            buf[CONTROL_MAX_LINE];
+};
+
+static Stat_Collector **collector;
+static int      num_collectors;
+static int      listen_sd = -1;
+static char     path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+static struct client client[CONTROL_MAX_CLIENTS];
+static int      stopping;
+
+static void
+reply(struct client *c, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void
+reply(struct client *c, const char *fmt, ...)
+{
+	char            buf[256];
+	va_list         ap;
+	int             len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (len >= (int) sizeof(buf))
+		len = sizeof(buf) - 1;
+	write_all(c->sd, buf, len);
+}
+
+/*
+ * Prints the report the test would print if it ended now to C's socket.
+ */
+static void
+print_stats(struct client *c)
+{
+	struct rusage   rusage_stop = test_rusage_stop;
+	Time            time_stop = test_time_stop;
+	int             saved_stdout, i;
+
+	fflush(stdout);
+	saved_stdout = dup(1);
+	if (saved_stdout < 0 || dup2(c->sd, 1) < 0) {
+		reply(c, "error: %s\n", strerror(errno));
+		if (saved_stdout >= 0)
+			close(saved_stdout);
+		return;
+	}
+	test_time_stop = timer_now();
+	getrusage(RUSAGE_SELF, &test_rusage_stop);
+	if (param.workers > 1)
+		printf("Worker %d of %d:\n", worker_id, param.workers);
+	for (i = 0; i < num_collectors; ++i)
+		(*collector[i]->dump) ();
+	fflush(stdout);
+	dup2(saved_stdout, 1);
+	close(saved_stdout);
+	test_time_stop = time_stop;
+	test_rusage_stop = rusage_stop;
+	reply(c, "ok\n");
+}
+
+static void
+command(struct client *c, char *line)
+{
+	char           *arg, *end;
+	double          rate;
+
+	for (arg = line; *arg && !isspace((u_char) * arg); ++arg);
+	if (*arg)
+		*arg++ = '\0';
+	while (isspace((u_char) * arg))
+		++arg;
+
+	if (strcmp(line, "rate") == 0) {
+		rate = strtod(arg, &end);
+		if (end == arg || *end || rate <= 0.0)
+			reply(c, "error: usage: rate R (R > 0)\n");
+		else if (param.rate.rate_param <= 0.0
+		    || (param.rate.dist != DETERMINISTIC
+			&& param.rate.dist != EXPONENTIAL
+			&& param.rate.dist != UNIFORM))
+			reply(c, "error: only a test with a --rate or a "
+			    "deterministic, exponential or uniform --period "
+			    "can change its rate\n");
+		else if (param.search.pct > 0.0)
+			reply(c, "error: --search sets the rate\n");
+		else {
+			/* from now: any backlog is dropped (see rate_set()) */
+			rate_set(&param.rate, rate / param.workers);
+			reply(c, "ok\n");
+		}
+	} else if (strcmp(line, "pause") == 0) {
+		rate_generators_pause(1);
+		reply(c, "ok\n");
+	} else if (strcmp(line, "resume") == 0) {
+		rate_generators_pause(0);
+		reply(c, "ok\n");
+	} else if (strcmp(line, "stats") == 0)
+		print_stats(c);
+	else if (strcmp(line, "epoch") == 0) {
+		warmup_epoch();
+		reply(c, "ok\n");
+	} else if (strcmp(line, "stop") == 0) {
+		stopping = 1;
+		core_exit();
+		reply(c, "ok\n");
+	} else if (strcmp(line, "help") == 0)
+		reply(c, "rate R | pause | resume | stats | epoch | stop | "
+		    "help\nok\n");
+	else if (*line)
+		reply(c, "error: unknown command `%s'\n", line);
+}
+
+static void
+drop(struct client *c)
+{
+	close(c->sd);
+	c->sd = -1;
+}
+
+/*
+ * Runs the complete lines that have come in from client C.
+ */
+static void
+serve(struct client *c)
+{
+	char           *eol, *line;
+	ssize_t         n;
+
+	for (;;) {
+		n = recv(c->sd, c->buf + c->len, sizeof(c->buf) - c->len,
+		    MSG_DONTWAIT);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN)
+			return;
+		if (n <= 0) {
+			drop(c);
+			return;
+		}
+		c->len += n;
+		line = c->buf;
+		while ((eol = memchr(line, '\n', c->len - (line - c->buf)))) {
+			*eol = '\0';
+			if (eol > line && eol[-1] == '\r')
+				eol[-1] = '\0';
+			command(c, line);
+			line = eol + 1;
+		}
+		c->len -= line - c->buf;
+		memmove(c->buf, line, c->len);
+		if (c->len == sizeof(c->buf)) {
+			reply(c, "error: line too long\n");
+			drop(c);
+			return;
+		}
+	}
+}
+
+static void
+poll_socket(struct Timer *t, Any_Type arg)
+{
+	int             sd, i;
+
+	while ((sd = accept(listen_sd, NULL, NULL)) >= 0) {
+		for (i = 0; i < CONTROL_MAX_CLIENTS; ++i)
+			if (client[i].sd < 0)
+				break;
+		if (i == CONTROL_MAX_CLIENTS) {
+			close(sd);
+			continue;
+		}
+		client[i].sd = sd;
+		client[i].len = 0;
+	}
+	for (i = 0; i < CONTROL_MAX_CLIENTS; ++i)
+		if (client[i].sd >= 0)
+			serve(&client[i]);
+
+	if (!stopping)
+		timer_schedule(poll_socket, arg, CONTROL_POLL);
+}
+
+void
+control_init(Stat_Collector **stat, int num_stats)
+{
+	struct sockaddr_un addr;
+	struct stat     sb;
+	Any_Type        arg;
+	int             i, len;
+
+	if (!param.control)
+		return;
+	collector = stat;
+	num_collectors = num_stats;
+	for (i = 0; i < CONTROL_MAX_CLIENTS; ++i)
+		client[i].sd = -1;
+
+	if (worker_id > 0)
+		len = snprintf(path, sizeof(path), "%s.%d", param.control,
+		    worker_id);
+	else
+		len = snprintf(path, sizeof(path), "%s", param.control);
+	if (len >= (int) sizeof(path)) {
+		fprintf(stderr, "%s: control socket name %s is too long\n",
+		    prog_name, param.control);
+		exit(1);
+	}
+	/*
+	 * A socket left behind by an earlier test is in the way.
+	 */
+	if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+		unlink(path);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path, len + 1);
+	listen_sd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_sd < 0
+	    || bind(listen_sd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	    || listen(listen_sd, CONTROL_MAX_CLIENTS) < 0
+	    || fcntl(listen_sd, F_SETFL, O_NONBLOCK) < 0) {
+		fprintf(stderr, "%s: can't listen on control socket %s: %s\n",
+		    prog_name, path, strerror(errno));
+		exit(1);
+	}
+
+	arg.l = 0;
+	timer_schedule(poll_socket, arg, CONTROL_POLL);
+}
+
+void
+control_stop(void)
+{
+	int             i;
+
+	if (listen_sd < 0)
+		return;
+	stopping = 1;
+	for (i = 0; i < CONTROL_MAX_CLIENTS; ++i)
+		if (client[i].sd >= 0)
+			drop(&client[i]);
+	close(listen_sd);
+	listen_sd = -1;
+	unlink(path);
+}
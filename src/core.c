@@ -34,20 +34,29 @@
 #define	HAVE_KEVENT
 #endif
 
+#if defined(__linux__) && defined(HAVE_SYS_EPOLL_H)
+#define	HAVE_EPOLL
+#endif
+
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <sys/ioctl.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/un.h>
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
@@ -62,6 +71,14 @@
 #define	NOTE_MSECONDS		0
 #endif
 #endif
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+
+/*
+ * Maximum number of ready events fetched by a single epoll_wait().
+ */
+#define	EPOLL_MAX_EVENTS	1024
+#endif
 
 #ifdef __FreeBSD__
 #include <ifaddrs.h>
@@ -81,39 +98,161 @@
 #include <core.h>
 #include <localevent.h>
 #include <http.h>
+#include <http2.h>
+#include <websocket.h>
+#include <resolve.h>
+#include <worker.h>
+#include <uring.h>
+#include <self_stat.h>
 
-#define HASH_TABLE_SIZE	1024	/* can't have more than this many servers */
 #define MIN_IP_PORT	IPPORT_RESERVED
 #define MAX_IP_PORT	65535
 #define BITSPERLONG	(8*sizeof (u_long))
 
-struct local_addr {
-	struct in_addr ip;
-	u_long port_free_map[((MAX_IP_PORT - MIN_IP_PORT + BITSPERLONG)
+/*
+ * Reply bodies nobody looks at are read into a buffer this big when the
+ * kernel can't throw them away for us.
+ */
+#define	DISCARD_BUF_SIZE	(256*1024)
+
+/*
+ * Up to this many iovec entries worth of pipelined requests are written
+ * with a single system call.
+ */
+#define	SEND_IOV_MAX		128
+
+/*
+ * Whether to do a write or read on a connection that became ready.  HTTP/2
+ * and WebSocket connections ("framed" connections) have I/O to do even when
+ * no call is waiting on them.
+ */
+#define	IS_FRAMED(c)	(((c)->h2 || (c)->ws) && (c)->state < S_CLOSING)
+#define	WANTS_SEND(c)	((c)->sendq || IS_FRAMED(c))
+#define	WANTS_RECV(c)	((c)->recvq || IS_FRAMED(c))
+
+/*
+ * Request lines are kept pre-serialized for reuse until the templates take
+ * up this much memory; requests for other URIs are then sent from their
+ * individual pieces.
+ */
+#define	TMPL_MAX_BYTES		(16*1024*1024)
+#define	TMPL_MIN_BUCKETS	1024
+
+#if defined(__linux__) && defined(MSG_TRUNC)
+#define	HAVE_RECV_TRUNC		/* recv(MSG_TRUNC) discards TCP data */
+#endif
+
+#ifdef HAVE_IO_URING
+#define	URING_ENTRIES	4096	/* submission queue size */
+#define	URING_NBUFS	1024	/* # of provided receive buffers */
+
+/*
+ * The low bits of an io_uring request's user_data tell what kind of request
+ * it was; the rest is the Conn it belongs to.
+ */
+enum URING_OP {
+	URING_OP_NONE, URING_OP_CONNECT, URING_OP_WRITEV, URING_OP_RECV
+};
+#define	URING_OP_MASK	7UL
+#endif
+
+/*
+ * A request template holds the bytes from the method up to the end of the
+ * Host: header line of a request, ready to be written out.
+ */
+struct req_tmpl {
+	struct req_tmpl *next;
+	u_int hash;
+	size_t len;
+	char data[];
+};
+
+/*
+ * The local ports in use from one source address to one server, with
+ * --hog.  A port is only taken for that pair, so the same port can be
+ * used to reach other servers at the same time (the 4-tuples differ).
+ */
+struct port_map {
+	u_long free_map[((MAX_IP_PORT - MIN_IP_PORT + BITSPERLONG)
 		    / BITSPERLONG)];
 	u_long mask;
 	int previous;
 };
 
+/*
+ * A source address (see --myaddr).
+ */
+struct local_addr {
+	struct in_addr ip;
+	int index;		/* in myaddrs.addresses */
+	u_int num_open;		/* # of sockets bound to it */
+};
+
 struct address_pool {
 	struct local_addr *addresses;
 	int count;
 	int last;
 };
 
+#ifdef HAVE_KEVENT
+const char     *core_engine_name = "kqueue";
+#elif defined(HAVE_EPOLL)
+const char     *core_engine_name = "epoll";
+#else
+const char     *core_engine_name = "select";
+#endif
+
 static volatile int      running = 1;
 static int      iteration;
 static u_long   max_burst_len;
+
+/*
+ * The pre-connect phase (see core_preconnect()).
+ */
+static struct {
+	int             on;
+	u_int           num_opened;	/* # of connections opened so far */
+	u_int           num_pending;	/* # of them not parked or failed yet */
+	Time            start;
+} preconnect;
+
 #ifdef HAVE_KEVENT
 static int	kq, max_sd = 0;
+#elif defined(HAVE_EPOLL)
+static int	epfd, max_sd = 0;
+static int	epoll_timeout;
+static struct epoll_event epoll_events[EPOLL_MAX_EVENTS];
+static int	epoll_next, epoll_nready;
 #else
 static fd_set   rdfds, wrfds;
 static int      min_sd = 0x7fffffff, max_sd = 0, alloced_sd_to_conn = 0;
 static struct timeval select_timeout;
 #endif
+#ifdef HAVE_IO_URING
+static int	use_uring;
+#endif
 static struct sockaddr_in myaddr;
+static struct sockaddr_in6 myaddr6;
+
+/*
+ * The options every new socket gets, worked out once by core_init().
+ */
+struct sock_opt {
+	int             level;
+	int             name;
+	const void     *val;
+	socklen_t       len;
+	const char     *what;
+};
+
+static struct sock_opt sock_opts[10];
+static int      num_sock_opts;
+static int      sock_flags;	/* for socket(), besides SOCK_STREAM */
+static int      sock_one = 1, sock_sndbuf, sock_rcvbuf;
+static int      sock_busy_poll, sock_cpu;
+static struct linger sock_linger;
 static struct address_pool myaddrs;
-#ifndef HAVE_KEVENT
+#if !defined(HAVE_KEVENT) && !defined(HAVE_EPOLL)
 Conn          **sd_to_conn;
 #endif
 static char     http10req[] =
@@ -128,70 +267,135 @@ static char     http10req_nohost[] =
 static char     http11req_nohost[] =
     " HTTP/1.1\r\nUser-Agent: httperf/" VERSION;
 
+static struct req_tmpl **tmpl_table;
+static u_int    tmpl_mask, tmpl_count;
+static size_t   tmpl_bytes;
+
 #ifndef SOL_TCP
 # define SOL_TCP 6		/* probably ought to do getprotlbyname () */
 #endif
 
-#ifdef TIME_SYSCALLS
-# define SYSCALL(n,s)							\
+/*
+ * With --self-stats, the time taken by every system call is recorded;
+ * otherwise all this costs is the test of the flag.
+ */
+#define SYSCALL(n,s)							\
   {									\
-    Time start, stop;							\
-    do									\
+    if (param.self_stats)						\
       {									\
-	errno = 0;							\
-	start = timer_now_forced ();					\
-	s;				 /* execute the syscall */	\
-	stop = timer_now_forced ();					\
-	syscall_time[SC_##n] += stop - start;				\
-	++syscall_count[SC_##n];					\
+	Time start;							\
+	do								\
+	  {								\
+	    errno = 0;							\
+	    start = timer_now_forced ();				\
+	    s;				 /* execute the syscall */	\
+	    hist_small_record (&self_stats.syscall[SC_##n],		\
+			       timer_now_forced () - start);		\
+	  }								\
+	while (errno == EINTR);						\
       }									\
-    while (errno == EINTR);						\
+    else								\
+      do								\
+	{								\
+	  errno = 0;							\
+	  s;								\
+	}								\
+      while (errno == EINTR);						\
   }
 
-enum Syscalls {
-	SC_BIND, SC_CONNECT, SC_READ, SC_SELECT, SC_SOCKET, SC_WRITEV,
-	SC_SSL_READ, SC_SSL_WRITEV, SC_KEVENT,
-	SC_NUM_SYSCALLS
-};
+static Time     loop_woken;	/* when the event loop last stopped waiting */
 
-static const char *const syscall_name[SC_NUM_SYSCALLS] = {
-	"bind", "connct", "read", "select", "socket", "writev",
-	"ssl_read", "ssl_writev", "kevent"
-};
-static Time     syscall_time[SC_NUM_SYSCALLS];
-static u_int    syscall_count[SC_NUM_SYSCALLS];
-#else
-# define SYSCALL(n,s)				\
-  {						\
-    do						\
-      {						\
-	errno = 0;				\
-	s;					\
-      }						\
-    while (errno == EINTR);			\
-  }
+/*
+ * Called by the event loops right before they wait for events and right
+ * after they got NREADY of them, to keep track of how busy the loop is
+ * (--self-stats).
+ */
+static void
+loop_sleep(void)
+{
+	if (param.self_stats && loop_woken > 0)
+		hist_record(&self_stats.loop_busy,
+		    timer_now_forced() - loop_woken);
+}
+
+static void
+loop_wakeup(int nready)
+{
+	if (!param.self_stats)
+		return;
+	loop_woken = timer_now_forced();
+	++self_stats.num_wakeups;
+	if (nready <= 0) {
+		++self_stats.num_idle_wakeups;
+		return;
+	}
+	self_stats.num_ready += nready;
+	if ((u_wide) nready > self_stats.max_ready)
+		self_stats.max_ready = nready;
+}
+
+/*
+ * An open connection that is waiting to be reused (see --conn-pool).  The
+ * idle connections of a server are kept most recently used first.
+ */
+struct idle_conn {
+	struct idle_conn *next;
+	struct idle_conn *prev;
+	struct server  *server;
+	struct Timer   *timer;		/* fires when the idle timeout expires */
+	int             sd;
+	int             myport;
+	struct local_addr *myaddr;
+#ifdef HAVE_SSL
+	SSL            *ssl;
+	u_int           ktls_send : 1;
 #endif
+};
 
-struct hash_entry {
+/*
+ * A server (a hostname and port) that connections are made to.  Its address
+ * is looked up when the server is interned (and again later, with
+ * --dns-refresh), and every connection to it points at it (see
+ * Conn.server), so connecting involves no lookup.
+ */
+struct server {
 	const char     *hostname;
+	size_t          hostname_len;
 	int             port;
-	struct sockaddr_in sin;
-} hash_table[HASH_TABLE_SIZE];
+	u_int           hash;
+	char           *name;		/* what is looked up */
+	struct sockaddr_storage addr;
+	socklen_t       addr_len;	/* 0 until the address is known */
+	struct Timer   *refresh;	/* next lookup, with --dns-refresh */
+	struct idle_conn *idle;		/* idle connections to this server */
+	u_int           num_idle;
+	struct port_map **ports;	/* by source address, with --hog */
+};
 
-static int
+/*
+ * Interned servers, hashed by name and port.  The table is open addressed
+ * and doubles in size when it gets three quarters full; the servers
+ * themselves never move.
+ */
+static struct server **server_table;
+static u_int    server_table_size, num_servers;
+
+static struct idle_conn *idle_free_list;
+
+static u_int
 hash_code(const char *server, size_t server_len, int port)
 {
-	u_char         *cp = (u_char *) server;
-	u_long          h = port;
-	u_long          g;
-	int             ch;
+	const u_char   *cp = (const u_char *) server;
+	const u_char   *end = cp + server_len;
+	u_int           h = port;
+	u_int           g;
 
 	/*
 	 * Basically the ELF hash algorithm: 
 	 */
 
-	while ((ch = *cp++) != '\0') {
-		h = (h << 4) + ch;
+	while (cp < end) {
+		h = (h << 4) + *cp++;
 		if ((g = (h & 0xf0000000)) != 0) {
 			h ^= g >> 24;
 			h &= ~g;
@@ -200,46 +404,49 @@ hash_code(const char *server, size_t server_len, int port)
 	return h;
 }
 
-static struct hash_entry *
-hash_enter(const char *server, size_t server_len, int port,
-	   struct sockaddr_in *sin)
+static void
+hash_grow(void)
 {
-	struct hash_entry *he;
-
-	int             index =
-	    hash_code(server, server_len, port) % HASH_TABLE_SIZE;
-
-	while (hash_table[index].hostname) {
-		++index;
-		if (index >= HASH_TABLE_SIZE)
-			index = 0;
+	struct server **old = server_table;
+	u_int           old_size = server_table_size, i, index;
+
+	server_table_size = old_size ? 2 * old_size : 64;
+	server_table = calloc(server_table_size, sizeof(server_table[0]));
+	if (!server_table) {
+		fprintf(stderr, "%s: out of memory for the server table\n",
+		    prog_name);
+		exit(1);
+	}
+	for (i = 0; i < old_size; ++i) {
+		if (!old[i])
+			continue;
+		index = old[i]->hash & (server_table_size - 1);
+		while (server_table[index])
+			index = (index + 1) & (server_table_size - 1);
+		server_table[index] = old[i];
 	}
-	he = hash_table + index;
-	he->hostname = server;
-	he->port = port;
-	he->sin = *sin;
-	return he;
+	free(old);
 }
 
-static struct sockaddr_in *
-hash_lookup(const char *server, size_t server_len, int port)
+/*
+ * Returns the slot of server SERVER:PORT, which is empty if the server
+ * hasn't been interned yet.
+ */
+static struct server **
+hash_slot(const char *server, size_t server_len, int port, u_int hash)
 {
-	int             index, start_index;
-
-	index = start_index =
-	    hash_code(server, server_len, port) % HASH_TABLE_SIZE;
-	while (hash_table[index].hostname) {
-		if (hash_table[index].port == port
-		    && strcmp(hash_table[index].hostname, server) == 0)
-			return &hash_table[index].sin;
-
-		++index;
-		if (index >= HASH_TABLE_SIZE)
-			index = 0;
-		if (index == start_index)
+	struct server  *srv;
+	u_int           index;
+
+	index = hash & (server_table_size - 1);
+	while ((srv = server_table[index]) != NULL) {
+		if (srv->hash == hash && srv->port == port
+		    && srv->hostname_len == server_len
+		    && memcmp(srv->hostname, server, server_len) == 0)
 			break;
+		index = (index + 1) & (server_table_size - 1);
 	}
-	return 0;
+	return &server_table[index];
 }
 
 static int
@@ -266,29 +473,58 @@ lffs(long w)
 #endif
 }
 
+static struct port_map *
+port_map(struct local_addr *addr, struct server *srv)
+{
+	struct port_map *map;
+
+	if (!srv->ports) {
+		srv->ports = calloc(myaddrs.count, sizeof(srv->ports[0]));
+		if (!srv->ports)
+			return NULL;
+	}
+	map = srv->ports[addr->index];
+	if (!map) {
+		map = malloc(sizeof(*map));
+		if (!map)
+			return NULL;
+		memset(map->free_map, 0xff, sizeof(map->free_map));
+		map->mask = ~0UL;
+		map->previous = 0;
+		srv->ports[addr->index] = map;
+	}
+	return map;
+}
+
 static void
-port_put(struct local_addr *addr, int port)
+port_put(struct local_addr *addr, struct server *srv, int port)
 {
+	struct port_map *map = srv->ports[addr->index];
 	int             i, bit;
 
 	port -= MIN_IP_PORT;
 	i = port / BITSPERLONG;
 	bit = port % BITSPERLONG;
-	addr->port_free_map[i] |= (1UL << bit);
+	map->free_map[i] |= (1UL << bit);
 }
 
 static int
-port_get(struct local_addr *addr)
+port_get(struct local_addr *addr, struct server *srv)
 {
+	struct port_map *map;
 	int             port, bit, i;
 
-	i = addr->previous;
-	if ((addr->port_free_map[i] & addr->mask) == 0) {
+	map = port_map(addr, srv);
+	if (!map)
+		return -1;
+
+	i = map->previous;
+	if ((map->free_map[i] & map->mask) == 0) {
 		do {
 			++i;
-			if (i >= NELEMS(addr->port_free_map))
+			if (i >= NELEMS(map->free_map))
 				i = 0;
-			if (i == addr->previous) {
+			if (i == map->previous) {
 				if (DBG > 0)
 					fprintf(stderr,
 						"%s.port_get: Yikes! I'm out of port numbers!\n",
@@ -296,21 +532,43 @@ port_get(struct local_addr *addr)
 				return -1;
 			}
 		}
-		while (addr->port_free_map[i] == 0);
-		addr->mask = ~0UL;
+		while (map->free_map[i] == 0);
+		map->mask = ~0UL;
 	}
-	addr->previous = i;
+	map->previous = i;
 
-	bit = lffs(addr->port_free_map[i] & addr->mask) - 1;
+	bit = lffs(map->free_map[i] & map->mask) - 1;
 	if (bit >= BITSPERLONG - 1)
-		addr->mask = 0;
+		map->mask = 0;
 	else
-		addr->mask = ~((1UL << (bit + 1)) - 1);
-	addr->port_free_map[i] &= ~(1UL << bit);
+		map->mask = ~((1UL << (bit + 1)) - 1);
+	map->free_map[i] &= ~(1UL << bit);
 	port = bit + i * BITSPERLONG + MIN_IP_PORT;
 	return port;
 }
 
+/*
+ * Account for a socket bound to source address ADDR being opened or
+ * closed.
+ */
+static void
+source_open(struct local_addr *addr)
+{
+	++addr->num_open;
+	if (addr->index < SELF_MAX_SOURCES) {
+		++self_stats.source[addr->index].num_conns;
+		if (addr->num_open > self_stats.source[addr->index].max_open)
+			self_stats.source[addr->index].max_open =
+			    addr->num_open;
+	}
+}
+
+static void
+source_close(struct local_addr *addr)
+{
+	--addr->num_open;
+}
+
 static void
 conn_failure(Conn * s, int err)
 {
@@ -322,16 +580,59 @@ conn_failure(Conn * s, int err)
 	core_close(s);
 }
 
+/*
+ * Connections time out lazily.  Progress on a connection only moves the
+ * deadlines of its calls (a store to call->timeout), and its watchdog
+ * stays put; when the watchdog fires, it looks at the deadlines as they
+ * are then and either times the connection out or goes back to sleep
+ * until the earliest of them.  So the timers are scheduled about once per
+ * timeout rather than once per event.
+ */
+static void	arm_watchdog(Conn * s);
+
+/*
+ * The earliest of the deadlines of connection S, or 0 if it has none.
+ */
+static Time
+conn_deadline(Conn * s)
+{
+	Time            deadline = 0.0;
+
+	if (s->state == S_CONNECTING)
+		deadline = s->connect_deadline;
+	if (s->sendq && s->sendq->timeout > 0.0
+	    && (deadline == 0.0 || deadline > s->sendq->timeout))
+		deadline = s->sendq->timeout;
+	if (s->recvq && s->recvq->timeout > 0.0
+	    && (deadline == 0.0 || deadline > s->recvq->timeout))
+		deadline = s->recvq->timeout;
+	/*
+	 * A WebSocket message has as long as a call to come back.
+	 */
+	if (s->ws && param.timeout > 0.0 && ws_oldest(s) > 0.0
+	    && (deadline == 0.0 || deadline > ws_oldest(s) + param.timeout))
+		deadline = ws_oldest(s) + param.timeout;
+	return deadline;
+}
+
 static void
 conn_timeout(struct Timer *t, Any_Type arg)
 {
 	Conn           *s = arg.vp;
-	Time            now;
+	Time            now, deadline;
 	Call           *c;
 
 	assert(object_is_conn(s));
 	s->watchdog = 0;
 
+	deadline = conn_deadline(s);
+	if (deadline == 0.0)
+		return;
+	if (deadline > timer_now()) {
+		arm_watchdog(s);
+		return;
+	}
+
 	if (DBG > 0) {
 		c = 0;
 		if (s->sd >= 0) {
@@ -359,11 +660,68 @@ conn_timeout(struct Timer *t, Any_Type arg)
 
 enum IO_DIR { READ, WRITE };
 
+#ifdef HAVE_IO_URING
+static void	uring_send(Conn * s);
+static void	uring_recv(Conn * s);
+#endif
+
+#ifdef HAVE_EPOLL
+/*
+ * Bring the epoll interest set for connection S in line with its
+ * reading/writing flags.  WAS_ACTIVE tells whether the descriptor was
+ * registered before the flags changed.  A connection that is neither
+ * reading nor writing is removed from the set altogether since epoll
+ * would otherwise keep reporting EPOLLHUP/EPOLLERR for it.
+ */
+static void
+epoll_update(Conn * s, int was_active)
+{
+	struct epoll_event ev;
+	int             op;
+
+	ev.events = (s->reading ? EPOLLIN : 0) | (s->writing ? EPOLLOUT : 0);
+	ev.data.ptr = s;
+	if (!was_active)
+		op = EPOLL_CTL_ADD;
+	else if (ev.events == 0)
+		op = EPOLL_CTL_DEL;
+	else
+		op = EPOLL_CTL_MOD;
+
+	if (epoll_ctl(epfd, op, s->sd, &ev) < 0) {
+		fprintf(stderr, "%s: epoll_ctl failed on sd %d: %s\n",
+		    prog_name, s->sd, strerror(errno));
+		exit(1);
+	}
+}
+#endif
+
 static void
 clear_active(Conn * s, enum IO_DIR dir)
 {
- 	int             sd = s->sd;
+#ifdef HAVE_EPOLL
+	int		was_active = s->reading || s->writing;
+#endif
+
+#ifdef HAVE_IO_URING
+	if (use_uring) {
+		/*
+		 * Requests already in flight complete anyway; the completion
+		 * handlers take care of whatever is left to do.
+		 */
+		if (dir == WRITE)
+			s->writing = 0;
+		else
+			s->reading = 0;
+		return;
+	}
+#endif
+#ifdef HAVE_EPOLL
+	if (!(dir == WRITE ? s->writing : s->reading))
+		return;
+#endif
 #ifdef HAVE_KEVENT
+	int             sd = s->sd;
 	struct kevent	ev;
 
 	EV_SET(&ev, sd, dir == WRITE ? EVFILT_WRITE : EVFILT_READ, EV_DELETE,
@@ -373,7 +731,8 @@ clear_active(Conn * s, enum IO_DIR dir)
 		    "write" : "read");
 		exit(1);
 	}
-#else
+#elif !defined(HAVE_EPOLL)
+	int             sd = s->sd;
 	fd_set *	fdset;
 	
 	if (dir == WRITE)
@@ -386,15 +745,75 @@ clear_active(Conn * s, enum IO_DIR dir)
 		s->writing = 0;
 	else
 		s->reading = 0;
+#ifdef HAVE_EPOLL
+	epoll_update(s, was_active);
+#endif
+}
+
+/*
+ * Make sure connection S times out when its earliest deadline passes.  A
+ * watchdog that fires no later than that is left alone.
+ */
+static void
+arm_watchdog(Conn * s)
+{
+	Any_Type        arg;
+	Time            deadline;
+
+	deadline = conn_deadline(s);
+	if (deadline == 0.0)
+		return;
+	if (s->watchdog) {
+		if (s->watchdog_due <= deadline)
+			return;
+		timer_cancel(s->watchdog);
+	}
+	arg.vp = s;
+	s->watchdog_due = deadline;
+	s->watchdog = timer_schedule(conn_timeout, arg,
+				     deadline - timer_now());
 }
 
 static void
 set_active(Conn * s, enum IO_DIR dir)
 {
  	int             sd = s->sd;
-	Any_Type        arg;
-	Time            timeout;
-#ifdef HAVE_KEVENT
+#ifdef HAVE_EPOLL
+	int		was_active = s->reading || s->writing;
+#endif
+
+#ifdef HAVE_IO_URING
+	if (use_uring) {
+		/*
+		 * Rather than waiting for readiness, start the I/O right
+		 * away.  A write has to wait for the connect to complete and
+		 * at most one is in flight per connection since requests must
+		 * go out in order.  The multishot receive stays armed for as
+		 * long as the connection lives.
+		 */
+		if (dir == WRITE) {
+			s->writing = 1;
+			if (s->state >= S_CONNECTED && s->state < S_CLOSING
+			    && s->sendq && !s->uring_send)
+				uring_send(s);
+		} else {
+			s->reading = 1;
+			if (!s->uring_recv)
+				uring_recv(s);
+		}
+		arm_watchdog(s);
+		return;
+	}
+#endif
+#ifdef HAVE_EPOLL
+	if (!(dir == WRITE ? s->writing : s->reading)) {
+		if (dir == WRITE)
+			s->writing = 1;
+		else
+			s->reading = 1;
+		epoll_update(s, was_active);
+	}
+#elif defined(HAVE_KEVENT)
 	struct kevent	ev;
 
 	EV_SET(&ev, sd, dir == WRITE ? EVFILT_WRITE : EVFILT_READ, EV_ADD,
@@ -422,69 +841,516 @@ set_active(Conn * s, enum IO_DIR dir)
 	else
 		s->reading = 1;
 
-	if (s->watchdog)
-		return;
+	arm_watchdog(s);
+}
 
-	timeout = 0.0;
-	if (s->sendq)
-		timeout = s->sendq->timeout;
-	if (s->recvq && (timeout == 0.0 || timeout > s->recvq->timeout))
-		timeout = s->recvq->timeout;
+/*
+ * Returns the hash of the request line and Host: header of CALL.
+ */
+static u_int
+tmpl_hash(Call * call, size_t *lenp)
+{
+	const u_char   *cp, *end;
+	u_int           h = 2166136261U;	/* FNV-1a */
+	size_t          len = 0;
+	int             i;
+
+	for (i = IE_METHOD; i <= IE_NEWLINE1; ++i) {
+		cp = (const u_char *) call->req.iov[i].iov_base;
+		end = cp + call->req.iov[i].iov_len;
+		len += call->req.iov[i].iov_len;
+		while (cp < end)
+			h = (h ^ *cp++) * 16777619U;
+	}
+	*lenp = len;
+	return h;
+}
 
-	if (timeout > 0.0) {
-		arg.vp = s;
-		s->watchdog = timer_schedule(conn_timeout, arg,
-					     timeout - timer_now());
+static int
+tmpl_match(struct req_tmpl *t, Call * call)
+{
+	const char     *cp = t->data;
+	int             i;
+
+	for (i = IE_METHOD; i <= IE_NEWLINE1; ++i) {
+		if (memcmp(cp, call->req.iov[i].iov_base,
+		    call->req.iov[i].iov_len) != 0)
+			return 0;
+		cp += call->req.iov[i].iov_len;
 	}
+	return 1;
 }
 
 static void
-do_send(Conn * conn)
+tmpl_grow(void)
 {
-	int             async_errno;
-	socklen_t       len;
-	struct iovec   *iovp;
-	int             sd = conn->sd;
-	ssize_t         nsent = 0;
+	struct req_tmpl **table, *t, *next;
+	u_int           size, i;
+
+	size = tmpl_table ? 2 * (tmpl_mask + 1) : TMPL_MIN_BUCKETS;
+	table = calloc(size, sizeof(*table));
+	if (!table) {
+		fprintf(stderr, "%s.tmpl_grow: %s\n", prog_name,
+		    strerror(errno));
+		exit(1);
+	}
+	if (tmpl_table) {
+		for (i = 0; i <= tmpl_mask; ++i)
+			for (t = tmpl_table[i]; t; t = next) {
+				next = t->next;
+				t->next = table[t->hash & (size - 1)];
+				table[t->hash & (size - 1)] = t;
+			}
+		free(tmpl_table);
+	}
+	tmpl_table = table;
+	tmpl_mask = size - 1;
+}
+
+/*
+ * Returns the template for CALL's request line and Host: header, making one
+ * if this is the first request of its kind.  Returns NULL once the templates
+ * have used up their memory budget.
+ */
+static struct req_tmpl *
+tmpl_lookup(Call * call)
+{
+	struct req_tmpl *t;
+	size_t          len;
+	u_int           h;
+	char           *cp;
+	int             i;
+
+	if (!tmpl_table)
+		tmpl_grow();
+
+	h = tmpl_hash(call, &len);
+	for (t = tmpl_table[h & tmpl_mask]; t; t = t->next)
+		if (t->hash == h && t->len == len && tmpl_match(t, call))
+			return t;
+
+	if (tmpl_bytes + len > TMPL_MAX_BYTES)
+		return NULL;
+	t = malloc(sizeof(*t) + len);
+	if (!t)
+		return NULL;
+	t->hash = h;
+	t->len = len;
+	for (cp = t->data, i = IE_METHOD; i <= IE_NEWLINE1; ++i) {
+		memcpy(cp, call->req.iov[i].iov_base,
+		    call->req.iov[i].iov_len);
+		cp += call->req.iov[i].iov_len;
+	}
+	tmpl_bytes += sizeof(*t) + len;
+
+	if (++tmpl_count > 2 * (tmpl_mask + 1))
+		tmpl_grow();
+	t->next = tmpl_table[h & tmpl_mask];
+	tmpl_table[h & tmpl_mask] = t;
+	return t;
+}
+
+/*
+ * Get CALL ready to be written: the pieces of the request line and the Host:
+ * header are replaced by the matching template so they go out as a single
+ * iovec entry.  IE_NEWLINE1 is the last of those pieces; it carries the
+ * template until send_done() puts it back, leaving the call's request as its
+ * generator set it up.
+ */
+static void
+start_request(Call * call)
+{
+	struct req_tmpl *t;
 	Any_Type        arg;
-	Call           *call;
 
-	while (1) {
-		call = conn->sendq;
-		assert(call);
+	call->req.started = 1;
+	arg.l = 0;
+	event_signal(EV_CALL_SEND_RAW_DATA, (Object *) call, arg);
 
-		arg.l = 0;
-		event_signal(EV_CALL_SEND_RAW_DATA, (Object *) call, arg);
+	t = tmpl_lookup(call);
+	if (!t)
+		return;
+	call->req.iov_index = IE_NEWLINE1;
+	call->req.iov_saved = call->req.iov[IE_NEWLINE1];
+	call->req.iov[IE_NEWLINE1].iov_base = t->data;
+	call->req.iov[IE_NEWLINE1].iov_len = t->len;
+}
 
+/*
+ * Returns 1 if the contents of CALL come from a file (see
+ * call_set_contents_file()) and go out on their own, after the rest of the
+ * request: with sendfile(), or as the only buffer passed to SSL_writev(),
+ * which would otherwise copy them.  io_uring writes them straight from the
+ * file's mapping along with the headers.
+ */
+static int
+contents_apart(Conn * conn, Call * call)
+{
+	if (!call->req.contents_map)
+		return 0;
+#ifdef HAVE_IO_URING
+	if (use_uring)
+		return 0;
+#endif
 #ifdef HAVE_SSL
-		if (param.use_ssl) {
-			extern ssize_t  SSL_writev(SSL *, const struct iovec *,
-						   int);
-			SYSCALL(SSL_WRITEV, nsent =
-				SSL_writev(conn->ssl,
-					   call->req.iov + call->req.iov_index,
-					   (NELEMS(call->req.iov)
-					    - call->req.iov_index)));
-		} else
+	if (param.use_ssl && !conn->ktls_send)
+		return 1;
 #endif
-		{
-			SYSCALL(WRITEV,
-				nsent =
-				writev(sd, call->req.iov + call->req.iov_index,
-				       (NELEMS(call->req.iov)
-					- call->req.iov_index)));
-		}
+#ifdef HAVE_SYS_SENDFILE_H
+	return 1;
+#else
+	return 0;
+#endif
+}
 
-		if (DBG > 0)
-			fprintf(stderr, "do_send.%lu: wrote %ld bytes on %p\n",
-				call->id, (long) nsent, conn);
+/*
+ * Returns 1 if all of CALL's request but its file contents has been sent.
+ */
+static int
+contents_next(Conn * conn, Call * call)
+{
+	return call->req.iov_index == IE_CONTENT
+	    && call->req.iov[IE_CONTENT].iov_base
+	    == call->req.iov_saved.iov_base && contents_apart(conn, call);
+}
 
-		if (nsent < 0) {
-			if (errno == EAGAIN)
-				return;
+/*
+ * Write (some of) the file contents of CALL, the first call on CONN's send
+ * queue.
+ */
+static ssize_t
+send_contents(Conn * conn, Call * call)
+{
+	struct iovec   *iov = &call->req.iov[IE_CONTENT];
+	ssize_t         nsent;
+#ifdef HAVE_SYS_SENDFILE_H
+	off_t           off;
+#endif
 
-			len = sizeof(async_errno);
-			if (getsockopt
+#ifdef HAVE_SSL
+	if (param.use_ssl && !conn->ktls_send) {
+		extern ssize_t  SSL_writev(SSL *, const struct iovec *, int);
+
+		SYSCALL(SSL_WRITEV, nsent = SSL_writev(conn->ssl, iov, 1));
+		return nsent;
+	}
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+	off = (char *) iov->iov_base - call->req.contents_map;
+	SYSCALL(SENDFILE, nsent = sendfile(conn->sd, call->req.contents_fd,
+		&off, iov->iov_len));
+#else
+	SYSCALL(WRITEV, nsent = writev(conn->sd, iov, 1));
+#endif
+	return nsent;
+}
+
+/*
+ * Fill IOV with the unsent parts of the requests on CONN's send queue so
+ * that pipelined requests go out together.  Only whole requests are added
+ * after the first one, and nothing after contents that have to go out on
+ * their own (see contents_apart()).  Returns the number of entries used.
+ */
+static int
+gather_sendq(Conn * conn, struct iovec *iov)
+{
+	struct iovec   *iovp, *end;
+	Call           *call;
+	int             n = 0;
+
+	for (call = conn->sendq; call; call = call->sendq_next) {
+		if (n > 0 && n + IE_LEN > SEND_IOV_MAX)
+			break;
+		if (!call->req.started)
+			start_request(call);
+		end = call->req.iov + NELEMS(call->req.iov);
+		if (contents_apart(conn, call))
+			end = call->req.iov + IE_CONTENT;
+		for (iovp = call->req.iov + call->req.iov_index;
+		    iovp < end; ++iovp)
+			if (iovp->iov_len > 0)
+				iov[n++] = *iovp;
+		if (end < call->req.iov + NELEMS(call->req.iov))
+			break;
+	}
+	return n;
+}
+
+/*
+ * Account for NSENT bytes of CALL's request having been written.  Returns 1
+ * if the request went out completely and the next call on the send queue
+ * should be sent right away.
+ */
+static int
+send_done(Conn * conn, Call * call, ssize_t nsent)
+{
+	struct iovec   *iovp;
+	Any_Type        arg;
+
+	call->req.size += nsent;
+
+	iovp = call->req.iov + call->req.iov_index;
+	while (iovp < call->req.iov + NELEMS(call->req.iov)) {
+		if (nsent < iovp->iov_len) {
+			iovp->iov_len -= nsent;
+			iovp->iov_base =
+			    (caddr_t) ((char *) iovp->iov_base +
+				       nsent);
+			break;
+		} else {
+			/*
+			 * we're done with this fragment: 
+			 */
+			nsent -= iovp->iov_len;
+			*iovp = call->req.iov_saved;
+			++iovp;
+			call->req.iov_saved = *iovp;
+		}
+	}
+	call->req.iov_index = iovp - call->req.iov;
+	if (call->req.iov_index < NELEMS(call->req.iov)) {
+		/*
+		 * there are more header bytes to write 
+		 */
+		call->timeout =
+		    param.timeout ? timer_now() + param.timeout : 0.0;
+		set_active(conn, WRITE);
+		return 0;
+	}
+
+	/*
+	 * we're done with sending this request 
+	 */
+	conn->sendq = call->sendq_next;
+	if (!conn->sendq) {
+		conn->sendq_tail = 0;
+		clear_active(conn, WRITE);
+	}
+	arg.l = 0;
+	event_signal(EV_CALL_SEND_STOP, (Object *) call, arg);
+	if (conn->state >= S_CLOSING) {
+		call_dec_ref(call);
+		return 0;
+	}
+
+	/*
+	 * get ready to receive matching reply (note that we
+	 * implicitly pass on the reference to the call from the sendq 
+	 * to the recvq): 
+	 */
+	call->recvq_next = 0;
+	if (!conn->recvq)
+		conn->recvq = conn->recvq_tail = call;
+	else {
+		conn->recvq_tail->recvq_next = call;
+		conn->recvq_tail = call;
+	}
+	call->timeout = param.timeout + param.think_timeout;
+	if (call->timeout > 0.0)
+		call->timeout += timer_now();
+	set_active(conn, READ);
+	if (conn->state < S_REPLY_STATUS)
+		conn->state = S_REPLY_STATUS;	/* expecting reply
+						 * status */
+
+	if (!conn->sendq)
+		return 0;
+
+	arg.l = 0;
+	event_signal(EV_CALL_SEND_START, (Object *) conn->sendq, arg);
+	if (conn->state >= S_CLOSING)
+		return 0;
+	return 1;
+}
+
+/*
+ * Hand the NSENT bytes written off CONN's send queue to the calls they came
+ * from.  Returns 1 if there are more requests to be sent right away.
+ */
+static int
+sendq_done(Conn * conn, ssize_t nsent)
+{
+	struct iovec   *iovp;
+	Call           *call;
+	size_t          len;
+
+	do {
+		call = conn->sendq;
+		len = 0;
+		for (iovp = call->req.iov + call->req.iov_index;
+		    iovp < call->req.iov + NELEMS(call->req.iov); ++iovp)
+			len += iovp->iov_len;
+		if (len > nsent)
+			len = nsent;
+		nsent -= len;
+		if (!send_done(conn, call, len))
+			return 0;
+	} while (nsent > 0);
+	return 1;
+}
+
+/*
+ * Write as much of the output of a framed connection as the socket takes.
+ */
+static void
+framed_flush(Conn * conn)
+{
+	struct iovec    iov;
+	int             async_errno;
+	socklen_t       len;
+	ssize_t         nsent;
+
+	while (conn->h2 ? h2_output(conn, &iov) : ws_output(conn, &iov)) {
+#ifdef HAVE_SSL
+		if (param.use_ssl && !conn->ktls_send) {
+			extern ssize_t  SSL_writev(SSL *, const struct iovec *,
+						   int);
+			SYSCALL(SSL_WRITEV, nsent =
+				SSL_writev(conn->ssl, &iov, 1));
+		} else
+#endif
+		{
+			SYSCALL(WRITEV, nsent = writev(conn->sd, &iov, 1));
+		}
+
+		if (DBG > 0)
+			fprintf(stderr, "framed_flush: wrote %ld bytes on %p\n",
+				(long) nsent, conn);
+
+		if (nsent < 0) {
+			/*
+			 * With --tfo, EINPROGRESS means that the server
+			 * has no cookie for us yet: the SYN went out
+			 * without the data.
+			 */
+			if (errno == EAGAIN || errno == EINPROGRESS) {
+				set_active(conn, WRITE);
+				return;
+			}
+
+			len = sizeof(async_errno);
+			if (getsockopt(conn->sd, SOL_SOCKET, SO_ERROR,
+				&async_errno, &len) == 0 && async_errno != 0)
+				errno = async_errno;
+			conn_failure(conn, errno);
+			return;
+		}
+		if (conn->h2)
+			h2_sent(conn, nsent);
+		else
+			ws_sent(conn, nsent);
+		if (conn->state >= S_CLOSING)
+			return;
+		if (nsent < iov.iov_len) {
+			set_active(conn, WRITE);
+			return;
+		}
+	}
+	clear_active(conn, WRITE);
+	arm_watchdog(conn);
+}
+
+/*
+ * Sending on an HTTP/2 connection: every call on the send queue for which
+ * there is a stream to spare moves to the receive queue right away, then as
+ * much of the connection's output as the socket takes is written.
+ */
+static void
+h2_do_send(Conn * conn)
+{
+	Any_Type        arg;
+	Call           *call;
+
+	while (conn->sendq && h2_can_start(conn)) {
+		call = conn->sendq;
+		arg.l = 0;
+		event_signal(EV_CALL_SEND_RAW_DATA, (Object *) call, arg);
+		if (conn->state >= S_CLOSING)
+			return;
+
+		/*
+		 * the reference to the call moves from the sendq to the
+		 * recvq:
+		 */
+		conn->sendq = call->sendq_next;
+		if (!conn->sendq)
+			conn->sendq_tail = 0;
+		call->recvq_next = 0;
+		if (!conn->recvq)
+			conn->recvq = conn->recvq_tail = call;
+		else {
+			conn->recvq_tail->recvq_next = call;
+			conn->recvq_tail = call;
+		}
+		call->timeout = param.timeout + param.think_timeout;
+		if (call->timeout > 0.0)
+			call->timeout += timer_now();
+		h2_submit(conn, call);
+
+		if (conn->sendq) {
+			arg.l = 0;
+			event_signal(EV_CALL_SEND_START, (Object *) conn->sendq,
+			    arg);
+			if (conn->state >= S_CLOSING)
+				return;
+			conn->sendq->timeout =
+			    param.timeout ? timer_now() + param.timeout : 0.0;
+		}
+	}
+
+	framed_flush(conn);
+}
+
+static void
+do_send(Conn * conn)
+{
+	struct iovec    iov[SEND_IOV_MAX];
+	int             async_errno, iovcnt;
+	socklen_t       len;
+	int             sd = conn->sd;
+	ssize_t         nsent = 0;
+
+	if (conn->h2) {
+		h2_do_send(conn);
+		return;
+	}
+	if (conn->ws) {
+		framed_flush(conn);
+		return;
+	}
+
+	do {
+		assert(conn->sendq);
+		if (conn->sendq->req.iov_index == IE_CONTENT
+		    && contents_apart(conn, conn->sendq))
+			nsent = send_contents(conn, conn->sendq);
+		else {
+			iovcnt = gather_sendq(conn, iov);
+
+#ifdef HAVE_SSL
+			if (param.use_ssl && !conn->ktls_send) {
+				extern ssize_t  SSL_writev(SSL *,
+				    const struct iovec *, int);
+				SYSCALL(SSL_WRITEV, nsent =
+				    SSL_writev(conn->ssl, iov, iovcnt));
+			} else
+#endif
+			{
+				SYSCALL(WRITEV, nsent =
+				    writev(sd, iov, iovcnt));
+			}
+		}
+
+		if (DBG > 0)
+			fprintf(stderr, "do_send.%lu: wrote %ld bytes on %p\n",
+				conn->sendq->id, (long) nsent, conn);
+
+		if (nsent < 0) {
+			if (errno == EAGAIN || errno == EINPROGRESS)
+				return;
+
+			len = sizeof(async_errno);
+			if (getsockopt
 			    (sd, SOL_SOCKET, SO_ERROR, &async_errno, &len) == 0
 			    && async_errno != 0)
 				errno = async_errno;
@@ -497,243 +1363,884 @@ do_send(Conn * conn)
 			conn_failure(conn, errno);
 			return;
 		}
+	} while (sendq_done(conn, nsent) || (nsent > 0 && conn->sendq
+		&& conn->state < S_CLOSING
+		&& contents_next(conn, conn->sendq)));
+}
 
-		call->req.size += nsent;
+static void
+recv_done(Call * call)
+{
+	Conn           *conn = call->conn;
+	Any_Type        arg;
 
-		iovp = call->req.iov + call->req.iov_index;
-		while (iovp < call->req.iov + NELEMS(call->req.iov)) {
-			if (nsent < iovp->iov_len) {
-				iovp->iov_len -= nsent;
-				iovp->iov_base =
-				    (caddr_t) ((char *) iovp->iov_base +
-					       nsent);
-				break;
-			} else {
+	conn->recvq = call->recvq_next;
+	if (!conn->recvq) {
+		clear_active(conn, READ);
+		conn->recvq_tail = 0;
+	}
+	/*
+	 * we're done with receiving this request 
+	 */
+	arg.l = 0;
+	event_signal(EV_CALL_RECV_STOP, (Object *) call, arg);
+
+	call_dec_ref(call);
+}
+
+/*
+ * Process the NREAD bytes received on connection S.  BUF must have room for
+ * a terminating '\0' after the data.  NREAD is 0 if the server closed the
+ * connection and negative if the read failed with SAVED_ERRNO.
+ */
+static void
+recv_data(Conn * s, char *buf, ssize_t nread, int saved_errno)
+{
+	char           *cp;
+	Call           *c = s->recvq;
+	int             i;
+	size_t          buf_len;
+
+	assert(c);
+
+	if (nread <= 0) {
+		if (DBG > 0) {
+			fprintf(stderr,
+				"do_recv.%lu: received %lu reply bytes on %p\n",
+				c->id,
+				(u_long) (c->reply.header_bytes +
+					  c->reply.content_bytes), s);
+			if (nread < 0)
+				fprintf(stderr,
+					"%s.do_recv: read() failed: %s\n",
+					prog_name, strerror(saved_errno));
+		}
+		if (nread < 0) {
+			if (saved_errno != EAGAIN)
+				conn_failure(s, saved_errno);
+		} else if (s->state != S_REPLY_DATA)
+			conn_failure(s, ECONNRESET);
+		else {
+			if (s->state < S_CLOSING)
+				s->state = S_REPLY_DONE;
+			recv_done(c);
+		}
+		return;
+	}
+	buf[nread] = '\0';	/* ensure buffer is '\0' terminated */
+
+	if (DBG > 3) {
+		/*
+		 * dump received data in hex & ascii: 
+		 */
+
+		fprintf(stderr, "do_recv.%lu: received reply data:\n", c->id);
+		for (cp = buf; cp < buf + nread;) {
+			fprintf(stderr, "  %04x:",
+				(int) (c->reply.header_bytes +
+				       c->reply.content_bytes + (cp - buf)));
+			for (i = 0; i < 16 && i < buf + nread - cp; ++i)
+				fprintf(stderr, " %02x", cp[i] & 0xff);
+			i *= 3;
+			while (i++ < 50)
+				fputc(' ', stderr);
+			for (i = 0; i < 16 && cp < buf + nread; ++i, ++cp)
+				fprintf(stderr, "%c",
+					isprint(*cp) ? *cp : '.');
+			fprintf(stderr, "\n");
+		}
+	}
+
+	/*
+	 * process the replies in this buffer: 
+	 */
+
+	buf_len = nread;
+	cp = buf;
+	do {
+		c = s->recvq;
+		assert(c);
+		/*
+		 * sets right start time, but doesn't update each packet 
+		 */
+		if (s->state == S_REPLY_STATUS) {
+			c->timeout = param.timeout + param.think_timeout;
+			if (c->timeout > 0.0)
+				c->timeout += timer_now();
+		}
+
+		http_process_reply_bytes(c, &cp, &buf_len);
+		if (s->state == S_REPLY_DONE) {
+			recv_done(c);
+			if (s->state >= S_CLOSING)
+				return;
+
+			s->state = S_REPLY_STATUS;
+			if (s->ws) {
 				/*
-				 * we're done with this fragment: 
+				 * The reply was the upgrade to WebSocket;
+				 * frames may follow right behind it.
 				 */
-				nsent -= iovp->iov_len;
-				*iovp = call->req.iov_saved;
-				++iovp;
-				call->req.iov_saved = *iovp;
+				if (buf_len > 0 && (i = ws_input(s, cp,
+					    buf_len)) != 0
+				    && s->state < S_CLOSING)
+					conn_failure(s, i);
+				return;
 			}
 		}
-		call->req.iov_index = iovp - call->req.iov;
-		if (call->req.iov_index < NELEMS(call->req.iov)) {
-			/*
-			 * there are more header bytes to write 
-			 */
-			call->timeout =
-			    param.timeout ? timer_now() + param.timeout : 0.0;
-			set_active(conn, WRITE);
-			return;
+	}
+	while (buf_len > 0);
+
+	if (s->recvq)
+		set_active(c->conn, READ);
+}
+
+/*
+ * Returns how many bytes of the body of the reply being received on S can
+ * be drained without going through the reply parser, or 0 if the bytes have
+ * to take the normal path.  That is the case unless the length of the body
+ * (or, for a chunked reply, of the chunk being received) is known and no
+ * module wants to see its contents, neither of all replies nor of this one
+ * in particular (see Call.reply.sampled).
+ */
+static size_t
+discardable_body(Conn * s)
+{
+	if ((s->state != S_REPLY_DATA && s->state != S_REPLY_CHUNKED)
+	    || s->content_length == ~(size_t) 0 || DBG > 3)
+		return 0;
+	if (s->recvq->reply.content_bytes >= s->content_length)
+		return 0;
+	if (event_has_handler(EV_CALL_RECV_DATA)
+	    || event_has_handler(EV_CALL_RECV_RAW_DATA)
+	    || s->recvq->reply.sampled)
+		return 0;
+	return s->content_length - s->recvq->reply.content_bytes;
+}
+
+#if defined(HAVE_SSL) || !defined(HAVE_RECV_TRUNC)
+/*
+ * Returns the scratch buffer for discarded data, trimming *LENP to its size.
+ */
+static char *
+discard_buf(size_t *lenp)
+{
+	static char    *scratch;
+
+	if (!scratch) {
+		scratch = malloc(DISCARD_BUF_SIZE);
+		if (!scratch) {
+			fprintf(stderr, "%s.discard_buf: out of memory\n",
+			    prog_name);
+			exit(1);
 		}
+	}
+	if (*lenp > DISCARD_BUF_SIZE)
+		*lenp = DISCARD_BUF_SIZE;
+	return scratch;
+}
+#endif
 
+/*
+ * Drains up to LEN bytes of reply body from S, only counting them.  Never
+ * reads past the end of the body so pipelined replies are left alone.
+ */
+static void
+discard_body(Conn * s, size_t len)
+{
+	Call           *c = s->recvq;
+	ssize_t         nread = 0;
+#if defined(HAVE_SSL) || !defined(HAVE_RECV_TRUNC)
+	char           *buf;
+#endif
+
+#ifdef HAVE_SSL
+	if (param.use_ssl) {
+		buf = discard_buf(&len);
+		SYSCALL(SSL_READ, nread = SSL_read(s->ssl, buf, len));
+	} else
+#endif
+	{
+#ifdef HAVE_RECV_TRUNC
 		/*
-		 * we're done with sending this request 
+		 * MSG_TRUNC makes TCP drop the data instead of copying it.
 		 */
-		conn->sendq = call->sendq_next;
-		if (!conn->sendq) {
-			conn->sendq_tail = 0;
-			clear_active(conn, WRITE);
+		SYSCALL(READ, nread = recv(s->sd, NULL, len, MSG_TRUNC));
+#else
+		buf = discard_buf(&len);
+		SYSCALL(READ, nread = read(s->sd, buf, len));
+#endif
+	}
+	if (nread <= 0) {
+		/*
+		 * Errors and EOF are handled just like in the normal path.
+		 */
+		recv_data(s, NULL, nread, errno);
+		return;
+	}
+
+	if (DBG > 0)
+		fprintf(stderr, "do_recv.%lu: discarded %ld body bytes on %p\n",
+			c->id, (long) nread, s);
+
+	c->reply.content_bytes += nread;
+	if (c->reply.content_bytes >= s->content_length
+	    && s->state == S_REPLY_DATA) {
+		s->state = S_REPLY_DONE;
+		recv_done(c);
+		if (s->state >= S_CLOSING)
+			return;
+		s->state = S_REPLY_STATUS;
+	}
+	if (s->recvq)
+		set_active(s, READ);
+}
+
+/*
+ * Receiving on a framed connection.  The connection is read whether or not
+ * calls are waiting on it since the server may send control frames at any
+ * time.
+ */
+static void
+framed_do_recv(Conn * s)
+{
+	char            buf[16384];
+	struct iovec    iov;
+	ssize_t         nread;
+	int             err;
+
+	do {
+#ifdef HAVE_SSL
+		if (param.use_ssl) {
+			SYSCALL(SSL_READ,
+				nread = SSL_read(s->ssl, buf, sizeof(buf)));
+		} else
+#endif
+		{
+			SYSCALL(READ, nread = read(s->sd, buf, sizeof(buf)));
 		}
-		arg.l = 0;
-		event_signal(EV_CALL_SEND_STOP, (Object *) call, arg);
-		if (conn->state >= S_CLOSING) {
-			call_dec_ref(call);
+
+		if (nread <= 0) {
+			if (nread < 0 && errno == EAGAIN)
+				break;
+			if (DBG > 0 && nread < 0)
+				fprintf(stderr, "%s.framed_do_recv: read() failed: "
+				    "%s\n", prog_name, strerror(errno));
+			if (nread < 0)
+				conn_failure(s, errno);
+			else if (s->sendq || s->recvq
+			    || (s->ws && ws_oldest(s) > 0.0))
+				conn_failure(s, ECONNRESET);
+			else
+				core_close(s);
+			return;
+		}
+		err = s->h2 ? h2_input(s, buf, nread)
+		    : ws_input(s, buf, nread);
+		if (s->state >= S_CLOSING)
+			return;
+		if (err) {
+			conn_failure(s, err);
 			return;
 		}
+	}
+#ifdef HAVE_SSL
+	while (param.use_ssl && SSL_pending(s->ssl) > 0);
+#else
+	while (0);
+#endif
 
+	if (s->h2 ? h2_done(s) : ws_done(s)) {
 		/*
-		 * get ready to receive matching reply (note that we
-		 * implicitly pass on the reference to the call from the sendq 
-		 * to the recvq): 
+		 * Calls the server went away before taking fail the
+		 * connection, so the session workloads issue them anew.
 		 */
-		call->recvq_next = 0;
-		if (!conn->recvq)
-			conn->recvq = conn->recvq_tail = call;
-		else {
-			conn->recvq_tail->recvq_next = call;
-			conn->recvq_tail = call;
+		if (s->sendq)
+			conn_failure(s, ECONNRESET);
+		else
+			core_close(s);
+		return;
+	}
+	if (s->h2 ? h2_wants_write(s) : ws_output(s, &iov))
+		set_active(s, WRITE);
+	arm_watchdog(s);
+}
+
+static void
+do_recv(Conn * s)
+{
+	char            buf[8193];
+	ssize_t         nread = 0;
+	size_t          len;
+
+	if (s->h2 || s->ws) {
+		framed_do_recv(s);
+		return;
+	}
+
+	len = discardable_body(s);
+	if (len > 0) {
+		discard_body(s, len);
+		return;
+	}
+
+#ifdef HAVE_SSL
+	if (param.use_ssl) {
+		SYSCALL(SSL_READ,
+			nread = SSL_read(s->ssl, buf, sizeof(buf) - 1));
+	} else
+#endif
+	{
+		SYSCALL(READ, nread = read(s->sd, buf, sizeof(buf) - 1));
+	}
+	recv_data(s, buf, nread, errno);
+}
+
+#ifdef HAVE_IO_URING
+/*
+ * The io_uring engine.  Connects, writes and receives are queued on the
+ * ring as the connections ask for them and go to the kernel in one batch per
+ * core_loop() iteration.  Every request in flight holds a reference to its
+ * connection (and a write to its call) so neither can go away before the
+ * kernel is done with them.  Completions for connections that have been
+ * closed in the meantime are dropped on the floor.
+ */
+
+static void
+uring_send(Conn * s)
+{
+	struct io_uring_sqe *sqe;
+
+	/*
+	 * The iovec array has to stay put until the write completes.
+	 */
+	if (!s->uring_iov) {
+		s->uring_iov = malloc(SEND_IOV_MAX * sizeof(struct iovec));
+		if (!s->uring_iov) {
+			fprintf(stderr, "%s.uring_send: %s\n", prog_name,
+			    strerror(errno));
+			exit(1);
+		}
+	}
+
+	sqe = uring_get_sqe();
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = s->sd;
+	sqe->addr = (u_long) s->uring_iov;
+	sqe->len = gather_sendq(s, s->uring_iov);
+	sqe->user_data = (u_long) s | URING_OP_WRITEV;
+
+	s->uring_send = 1;
+	conn_inc_ref(s);
+}
+
+static void
+uring_recv(Conn * s)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_get_sqe();
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = s->sd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	sqe->user_data = (u_long) s | URING_OP_RECV;
+
+	s->uring_recv = 1;
+	conn_inc_ref(s);
+}
+
+static void
+uring_connect(Conn * s, const struct sockaddr *sa, socklen_t sa_len)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_get_sqe();
+	sqe->opcode = IORING_OP_CONNECT;
+	sqe->fd = s->sd;
+	sqe->addr = (u_long) sa;
+	sqe->off = sa_len;
+	sqe->user_data = (u_long) s | URING_OP_CONNECT;
+
+	s->uring_connect = 1;
+	conn_inc_ref(s);
+}
+
+static void
+uring_connect_done(Conn * s, int res)
+{
+	Any_Type        arg;
+
+	s->uring_connect = 0;
+	if (s->state != S_CONNECTING)
+		return;
+
+	if (res < 0) {
+		if (DBG > 0)
+			fprintf(stderr, "%s.core_connect.connect: %s\n",
+				prog_name, strerror(-res));
+		conn_failure(s, -res);
+		return;
+	}
+	s->state = S_CONNECTED;
+	arg.l = 0;
+	event_signal(EV_CONN_CONNECTED, (Object *) s, arg);
+}
+
+static void
+uring_send_done(Conn * s, int res)
+{
+	s->uring_send = 0;
+	if (s->state >= S_CLOSING || !s->sendq)
+		return;
+
+	if (DBG > 0)
+		fprintf(stderr, "do_send.%lu: wrote %ld bytes on %p\n",
+			s->sendq->id, (long) res, s);
+
+	if (res < 0) {
+		if (DBG > 0)
+			fprintf(stderr, "%s.do_send: writev() failed: %s\n",
+				prog_name, strerror(-res));
+		conn_failure(s, -res);
+		return;
+	}
+	if (sendq_done(s, res))
+		uring_send(s);
+}
+
+static void
+uring_recv_done(Conn * s, int res, u_int flags)
+{
+	char           *buf = NULL;
+	u_int           bid = 0;
+
+	if (flags & IORING_CQE_F_BUFFER) {
+		bid = flags >> IORING_CQE_BUFFER_SHIFT;
+		buf = uring_buf(bid);
+	}
+	if (!(flags & IORING_CQE_F_MORE))
+		s->uring_recv = 0;
+
+	if (s->state < S_CLOSING && res != -ENOBUFS) {
+		if (!s->recvq)
+			/*
+			 * Data or a close while we aren't waiting for a
+			 * reply; the next call wouldn't get anywhere anyway.
+			 */
+			conn_failure(s, res < 0 ? -res : ECONNRESET);
+		else if (res > 0 && buf)
+			recv_data(s, buf, res, 0);
+		else
+			recv_data(s, NULL, res < 0 ? -1 : 0, -res);
+	}
+	if (buf)
+		uring_buf_recycle(bid);
+
+	/*
+	 * The kernel ends a multishot receive when it runs out of buffers or
+	 * decides to; start a new one unless the connection is done for.
+	 */
+	if (!s->uring_recv && s->state < S_CLOSING
+	    && (res > 0 || res == -ENOBUFS))
+		uring_recv(s);
+}
+
+static void
+uring_loop(void)
+{
+	struct io_uring_cqe *cqe;
+	u_long          user_data;
+	u_int           flags;
+	Conn           *conn;
+	int             res;
+
+	while (running) {
+		timer_tick();
+
+		loop_sleep();
+#ifdef DONT_POLL
+		SYSCALL(IO_URING_ENTER, res = uring_enter(1, 1e-3));
+#else
+		SYSCALL(IO_URING_ENTER, res = uring_enter(0, 0.0));
+#endif
+		if (res < 0) {
+			fprintf(stderr, "%s.core_loop: io_uring_enter failed: "
+			    "%s\n", prog_name, strerror(errno));
+			exit(1);
+		}
+		loop_wakeup(uring_cq_ready());
+
+		++iteration;
+
+		while ((cqe = uring_peek_cqe()) != NULL) {
+			user_data = cqe->user_data;
+			res = cqe->res;
+			flags = cqe->flags;
+			uring_cqe_seen();
+
+			if ((user_data & URING_OP_MASK) == URING_OP_NONE)
+				continue;	/* cancel or close */
+
+			conn = (Conn *) (user_data & ~URING_OP_MASK);
+
+			conn_inc_ref(conn);
+
+			switch (user_data & URING_OP_MASK) {
+			case URING_OP_CONNECT:
+				uring_connect_done(conn, res);
+				conn_dec_ref(conn);
+				break;
+
+			case URING_OP_WRITEV:
+				uring_send_done(conn, res);
+				conn_dec_ref(conn);
+				break;
+
+			case URING_OP_RECV:
+				uring_recv_done(conn, res, flags);
+				if (!(flags & IORING_CQE_F_MORE))
+					conn_dec_ref(conn);
+				break;
+			}
+
+			/*
+			 * Not every completion ends up in set_active(), so
+			 * make sure the timeout is back in place.
+			 */
+			if (conn->state < S_CLOSING)
+				arm_watchdog(conn);
+			conn_dec_ref(conn);
+
+			if (uring_peek_cqe())
+				timer_tick();
 		}
-		call->timeout = param.timeout + param.think_timeout;
-		if (call->timeout > 0.0)
-			call->timeout += timer_now();
-		set_active(conn, READ);
-		if (conn->state < S_REPLY_STATUS)
-			conn->state = S_REPLY_STATUS;	/* expecting reply
-							 * status */
+	}
+}
+#endif /* HAVE_IO_URING */
 
-		if (!conn->sendq)
-			return;
+/*
+ * The idle connection pool.  When a session or connection generator is done
+ * with a connection that is still good for another request, the socket is
+ * parked here (see core_release()) and handed to the next core_connect() to
+ * the same server instead of opening a new one.  A connection leaves the
+ * pool when it is reused, when it has been idle for too long or when the
+ * server turns out to have closed it in the meantime.
+ */
 
-		arg.l = 0;
-		event_signal(EV_CALL_SEND_START, (Object *) conn->sendq, arg);
-		if (conn->state >= S_CLOSING)
-			return;
+static void
+pool_unlink(struct idle_conn *ic)
+{
+	if (ic->prev)
+		ic->prev->next = ic->next;
+	else
+		ic->server->idle = ic->next;
+	if (ic->next)
+		ic->next->prev = ic->prev;
+	--ic->server->num_idle;
+
+	if (ic->timer) {
+		timer_cancel(ic->timer);
+		ic->timer = 0;
 	}
 }
 
 static void
-recv_done(Call * call)
+pool_discard(struct idle_conn *ic)
 {
-	Conn           *conn = call->conn;
+	close(ic->sd);
+	if (ic->myport > 0)
+		port_put(ic->myaddr, ic->server, ic->myport);
+	if (ic->myaddr)
+		source_close(ic->myaddr);
+#ifdef HAVE_SSL
+	SSL_free(ic->ssl);
+#endif
+	ic->next = idle_free_list;
+	idle_free_list = ic;
+}
+
+static void
+pool_expire(struct Timer *t, Any_Type arg)
+{
+	struct idle_conn *ic = arg.vp;
+
+	ic->timer = 0;
+	pool_unlink(ic);
+	pool_discard(ic);
+}
+
+/*
+ * Park the socket of connection CONN.  Returns 0 if the pool for its server
+ * is full.
+ */
+static int
+pool_put(Conn * conn, int sd)
+{
+	struct idle_conn *ic;
+	struct server  *he = conn->server;
 	Any_Type        arg;
 
-	conn->recvq = call->recvq_next;
-	if (!conn->recvq) {
-		clear_active(conn, READ);
-		conn->recvq_tail = 0;
+	if (!he || he->num_idle >= param.conn_pool.max_idle)
+		return 0;
+
+	if (idle_free_list) {
+		ic = idle_free_list;
+		idle_free_list = ic->next;
+	} else {
+		ic = malloc(sizeof(*ic));
+		if (!ic)
+			return 0;
 	}
+	ic->server = he;
+	ic->sd = sd;
+	ic->myport = conn->myport;
+	ic->myaddr = conn->myaddr;
+	conn->myport = 0;
+	conn->myaddr = NULL;
+#ifdef HAVE_SSL
+	ic->ssl = conn->ssl;
+	ic->ktls_send = conn->ktls_send;
+	conn->ssl = NULL;
+#endif
+
+	ic->prev = NULL;
+	ic->next = he->idle;
+	if (he->idle)
+		he->idle->prev = ic;
+	he->idle = ic;
+	++he->num_idle;
+
 	/*
-	 * we're done with receiving this request 
+	 * The connections opened ahead of the test start idling when the
+	 * test does.
 	 */
-	arg.l = 0;
-	event_signal(EV_CALL_RECV_STOP, (Object *) call, arg);
-
-	call_dec_ref(call);
+	ic->timer = 0;
+	if (!preconnect.on) {
+		arg.vp = ic;
+		ic->timer = timer_schedule(pool_expire, arg,
+		    param.conn_pool.idle_timeout);
+	}
+	return 1;
 }
 
-static void
-do_recv(Conn * s)
+/*
+ * Try to give connection S an idle connection to its server.  Returns 1 if
+ * it got one, in which case S is connected already.
+ */
+static int
+pool_get(Conn * s)
 {
-	char           *cp, buf[8193];
-	Call           *c = s->recvq;
-	int             i, saved_errno;
-	ssize_t         nread = 0;
-	size_t          buf_len;
+	struct idle_conn *ic;
+	struct server  *he = s->server;
+	Any_Type        arg;
+	ssize_t         n;
+	char            ch;
 
-	assert(c);
+	if (!he)
+		return 0;
 
+	while ((ic = he->idle) != NULL) {
+		pool_unlink(ic);
+
+		/*
+		 * An idle HTTP connection has nothing to read unless the
+		 * server closed it.  With SSL, there may be records for the
+		 * library to deal with, such as TLS 1.3 session tickets.
+		 */
+		n = recv(ic->sd, &ch, 1, MSG_PEEK | MSG_DONTWAIT);
+		if ((n < 0 && errno == EAGAIN)
 #ifdef HAVE_SSL
-	if (param.use_ssl) {
-		SYSCALL(SSL_READ,
-			nread = SSL_read(s->ssl, buf, sizeof(buf) - 1));
-	} else
+		    || (n > 0 && param.use_ssl)
 #endif
-	{
-		SYSCALL(READ, nread = read(s->sd, buf, sizeof(buf) - 1));
+		    )
+			break;
+		if (DBG > 0)
+			fprintf(stderr, "%s.pool_get: dropping stale "
+			    "connection (sd=%d)\n", prog_name, ic->sd);
+		pool_discard(ic);
 	}
-	saved_errno = errno;
-	if (nread <= 0) {
-		if (DBG > 0) {
-			fprintf(stderr,
-				"do_recv.%lu: received %lu reply bytes on %p\n",
-				c->id,
-				(u_long) (c->reply.header_bytes +
-					  c->reply.content_bytes), s);
-			if (nread < 0)
-				fprintf(stderr,
-					"%s.do_recv: read() failed: %s\n",
-					prog_name, strerror(saved_errno));
-		}
-		if (nread < 0) {
-			if (saved_errno != EAGAIN)
-				conn_failure(s, saved_errno);
-		} else if (s->state != S_REPLY_DATA)
-			conn_failure(s, ECONNRESET);
-		else {
-			if (s->state < S_CLOSING)
-				s->state = S_REPLY_DONE;
-			recv_done(c);
+	if (!ic)
+		return 0;
+
+	s->sd = ic->sd;
+	s->myport = ic->myport;
+	s->myaddr = ic->myaddr;
+#ifdef HAVE_SSL
+	SSL_free(s->ssl);
+	s->ssl = ic->ssl;
+	s->ktls_send = ic->ktls_send;
+#endif
+	ic->next = idle_free_list;
+	idle_free_list = ic;
+#if !defined(HAVE_KEVENT) && !defined(HAVE_EPOLL)
+	assert(!sd_to_conn[s->sd]);
+	sd_to_conn[s->sd] = s;
+#endif
+	s->reused = 1;
+
+	if (DBG > 0)
+		fprintf(stderr, "%s.pool_get: reusing sd=%d for %p\n",
+		    prog_name, s->sd, s);
+
+	arg.l = 0;
+	event_signal(EV_CONN_CONNECTING, (Object *) s, arg);
+	if (s->state >= S_CLOSING)
+		return 1;
+	s->state = S_CONNECTED;
+	event_signal(EV_CONN_CONNECTED, (Object *) s, arg);
+	return 1;
+}
+
+static void     server_resolved(void *arg, const char *name,
+		    const Resolve_Result * res);
+
+static void
+server_refresh(struct Timer *t, Any_Type arg)
+{
+	struct server  *srv = arg.vp;
+
+	srv->refresh = NULL;
+	++self_stats.num_lookups;
+	resolve_start(srv->name, server_resolved, srv);
+}
+
+/*
+ * Takes the result RES of looking up the address of server ARG.  Failing
+ * to find the address of a server is fatal before the test starts; once
+ * it runs, the server keeps the address it has.
+ */
+static void
+server_resolved(void *arg, const char *name, const Resolve_Result * res)
+{
+	struct server  *srv = arg;
+	struct sockaddr_storage addr;
+	Time            delay;
+	Any_Type        a;
+	int             i;
+
+	if (res->err != 0) {
+		if (srv->addr_len == 0) {
+			fprintf(stderr, "%s.core_addr_intern: invalid server "
+			    "address %s: %s\n", prog_name, name,
+			    gai_strerror(res->err));
+			exit(1);
 		}
-		return;
+		++self_stats.num_lookup_failures;
+		goto done;
 	}
-	buf[nread] = '\0';	/* ensure buffer is '\0' terminated */
-
-	if (DBG > 3) {
+	if (res->addr.ss_family == AF_INET6) {
 		/*
-		 * dump received data in hex & ascii: 
+		 * The local addresses of --myaddr are IPv4 addresses. 
 		 */
+		for (i = 0; i < myaddrs.count; ++i)
+			if (myaddrs.addresses[i].ip.s_addr != htonl(INADDR_ANY)) {
+				fprintf(stderr, "%s: --myaddr can't be used "
+				    "with IPv6 server %s\n", prog_name, name);
+				exit(1);
+			}
+	} else if (res->addr.ss_family != AF_INET) {
+		fprintf(stderr, "%s: can't deal with addr family %d\n",
+		    prog_name, res->addr.ss_family);
+		exit(1);
+	}
 
-		fprintf(stderr, "do_recv.%lu: received reply data:\n", c->id);
-		for (cp = buf; cp < buf + nread;) {
-			fprintf(stderr, "  %04x:",
-				(int) (c->reply.header_bytes +
-				       c->reply.content_bytes + (cp - buf)));
-			for (i = 0; i < 16 && i < buf + nread - cp; ++i)
-				fprintf(stderr, " %02x", cp[i] & 0xff);
-			i *= 3;
-			while (i++ < 50)
-				fputc(' ', stderr);
-			for (i = 0; i < 16 && cp < buf + nread; ++i, ++cp)
-				fprintf(stderr, "%c",
-					isprint(*cp) ? *cp : '.');
-			fprintf(stderr, "\n");
-		}
+	memcpy(&addr, &res->addr, res->addr_len);
+	if (addr.ss_family == AF_INET6)
+		((struct sockaddr_in6 *) &addr)->sin6_port = htons(srv->port);
+	else
+		((struct sockaddr_in *) &addr)->sin_port = htons(srv->port);
+	if (srv->addr_len != 0 && (srv->addr_len != res->addr_len
+		|| memcmp(&srv->addr, &addr, res->addr_len) != 0)) {
+		++self_stats.num_addr_changes;
+		if (DBG > 0)
+			fprintf(stderr, "%s: server %s changed address\n",
+			    prog_name, name);
 	}
+	memcpy(&srv->addr, &addr, res->addr_len);
+	srv->addr_len = res->addr_len;
+	if (res->numeric)
+		return;
 
+      done:
 	/*
-	 * process the replies in this buffer: 
+	 * Look the name up again when its TTL runs out, but at most every
+	 * second and at least every --dns-refresh seconds.
 	 */
-
-	buf_len = nread;
-	cp = buf;
-	do {
-		c = s->recvq;
-		assert(c);
-		/*
-		 * sets right start time, but doesn't update each packet 
-		 */
-		if (s->state == S_REPLY_STATUS) {
-			c->timeout = param.timeout + param.think_timeout;
-			if (c->timeout > 0.0)
-				c->timeout += timer_now();
-		}
-
-		http_process_reply_bytes(c, &cp, &buf_len);
-		if (s->state == S_REPLY_DONE) {
-			recv_done(c);
-			if (s->state >= S_CLOSING)
-				return;
-
-			s->state = S_REPLY_STATUS;
-		}
+	if (param.dns_refresh > 0.0 && !srv->refresh) {
+		delay = param.dns_refresh;
+		if (res->ttl > 0 && res->ttl < delay)
+			delay = res->ttl < 1.0 ? 1.0 : res->ttl;
+		a.vp = srv;
+		srv->refresh = timer_schedule(server_refresh, a, delay);
 	}
-	while (buf_len > 0);
-
-	if (s->recvq)
-		set_active(c->conn, READ);
 }
 
-struct sockaddr_in *
+/*
+ * Returns the server SERVER:PORT.  The first time the server is asked
+ * for, the lookup of its address is started; core_init() waits for the
+ * servers known by then.  SERVER may be a hostname or an IPv4 or IPv6
+ * address; an IPv6 address may be enclosed in brackets, as in a URL.
+ * SERVER must stay around as long as the server is used.
+ */
+struct server *
 core_addr_intern(const char *server, size_t server_len, int port)
 {
-	struct sockaddr_in sin;
-	struct hash_entry *h;
-	struct hostent *he;
-	Any_Type        arg;
+	struct server  *srv, **slot;
+	const char     *host = server;
+	size_t          host_len = server_len;
+	u_int           hash;
+
+	if ((num_servers + 1) * 4 > server_table_size * 3)
+		hash_grow();
+	hash = hash_code(server, server_len, port);
+	slot = hash_slot(server, server_len, port, hash);
+	if (*slot)
+		return *slot;
+
+	if (host_len >= 2 && host[0] == '[' && host[host_len - 1] == ']') {
+		++host;
+		host_len -= 2;
+	}
 
-	memset(&sin, 0, sizeof(sin));
-	sin.sin_family = AF_INET;
-	sin.sin_port = htons(port);
+	srv = calloc(1, sizeof(*srv));
+	if (!srv || !(srv->name = strndup(host, host_len))) {
+		fprintf(stderr, "%s: out of memory for the server table\n",
+		    prog_name);
+		exit(1);
+	}
+	srv->hostname = server;
+	srv->hostname_len = server_len;
+	srv->port = port;
+	srv->hash = hash;
 
-	arg.cvp = server;
-	event_signal(EV_HOSTNAME_LOOKUP_START, 0, arg);
-	he = gethostbyname(server);
-	event_signal(EV_HOSTNAME_LOOKUP_STOP, 0, arg);
-	if (he) {
-		if (he->h_addrtype != AF_INET
-		    || he->h_length != sizeof(sin.sin_addr)) {
-			fprintf(stderr,
-				"%s: can't deal with addr family %d or size %d\n",
-				prog_name, he->h_addrtype, he->h_length);
-			exit(1);
-		}
-		memcpy(&sin.sin_addr, he->h_addr_list[0],
-		       sizeof(sin.sin_addr));
-	} else {
-		if (!inet_aton(server, &sin.sin_addr)) {
-			fprintf(stderr,
-				"%s.core_addr_intern: invalid server address %s\n",
-				prog_name, server);
-			exit(1);
+	*slot = srv;
+	++num_servers;
+
+	if (param.unix_socket) {
+		struct sockaddr_un *sun = (struct sockaddr_un *) &srv->addr;
+		size_t          len = strlen(param.unix_socket);
+
+		/*
+		 * Every server is reached through the same socket; its name
+		 * only goes into the Host header.  A leading '@' stands for
+		 * Linux's abstract namespace, where the name isn't
+		 * NUL-terminated.
+		 */
+		sun->sun_family = AF_UNIX;
+		memcpy(sun->sun_path, param.unix_socket, len + 1);
+		srv->addr_len = offsetof(struct sockaddr_un, sun_path) + len + 1;
+		if (sun->sun_path[0] == '@') {
+			sun->sun_path[0] = '\0';
+			--srv->addr_len;
 		}
+		return srv;
 	}
-	h = hash_enter(server, server_len, port, &sin);
-	if (!h)
-		return 0;
-	return &h->sin;
+
+	++self_stats.num_lookups;
+	resolve_start(srv->name, server_resolved, srv);
+	return srv;
 }
 
 static void
@@ -751,9 +2258,12 @@ core_add_address(struct in_addr ip)
 	}
 	addr = &myaddrs.addresses[myaddrs.count];
 	addr->ip = ip;
-	memset(&addr->port_free_map, 0xff, sizeof(addr->port_free_map));
-	addr->mask = ~0UL;
-	addr->previous = 0;
+	addr->index = myaddrs.count;
+	addr->num_open = 0;
+	if (addr->index < SELF_MAX_SOURCES) {
+		self_stats.source[addr->index].ip = ip;
+		self_stats.num_sources = addr->index + 1;
+	}
 	myaddrs.count++;
 }
 
@@ -868,6 +2378,110 @@ core_get_next_myaddr(void)
 	return (addr);
 }
 
+static void
+add_sock_opt(int level, int name, const void *val, socklen_t len,
+    const char *what)
+{
+	struct sock_opt *o;
+
+	assert(num_sock_opts < NELEMS(sock_opts));
+	o = &sock_opts[num_sock_opts++];
+	o->level = level;
+	o->name = name;
+	o->val = val;
+	o->len = len;
+	o->what = what;
+}
+
+static void
+sock_opts_init(void)
+{
+#ifdef SOCK_NONBLOCK
+	/*
+	 * io_uring never blocks on a socket, whatever its mode.
+	 */
+#ifdef HAVE_IO_URING
+	if (!use_uring)
+#endif
+		sock_flags = SOCK_NONBLOCK;
+#endif
+
+	if (param.close_with_reset) {
+		sock_linger.l_onoff = 1;
+		sock_linger.l_linger = 0;
+		add_sock_opt(SOL_SOCKET, SO_LINGER, &sock_linger,
+		    sizeof(sock_linger), "SO_LINGER");
+	}
+
+	/*
+	 * Disable Nagle algorithm so we don't delay needlessly when
+	 * pipelining requests.  
+	 */
+	add_sock_opt(SOL_TCP, TCP_NODELAY, &sock_one, sizeof(sock_one),
+	    "TCP_NODELAY");
+
+	sock_sndbuf = param.send_buffer_size;
+	add_sock_opt(SOL_SOCKET, SO_SNDBUF, &sock_sndbuf, sizeof(sock_sndbuf),
+	    "SO_SNDBUF");
+	sock_rcvbuf = param.recv_buffer_size;
+	add_sock_opt(SOL_SOCKET, SO_RCVBUF, &sock_rcvbuf, sizeof(sock_rcvbuf),
+	    "SO_RCVBUF");
+
+	if (param.hog)
+		add_sock_opt(SOL_SOCKET, SO_REUSEADDR, &sock_one,
+		    sizeof(sock_one), "SO_REUSEADDR");
+
+#ifdef TCP_FASTOPEN_CONNECT
+	/*
+	 * connect() returns at once and the SYN goes out with the first
+	 * write, carrying its data if the server gave us a cookie before.
+	 */
+	if (param.tfo)
+		add_sock_opt(SOL_TCP, TCP_FASTOPEN_CONNECT, &sock_one,
+		    sizeof(sock_one), "TCP_FASTOPEN_CONNECT");
+#endif
+
+	if (param.busy_poll > 0) {
+#if defined(SO_BUSY_POLL) && defined(SO_INCOMING_CPU)
+		int             sd;
+
+		/*
+		 * Reads spin on the device queue for up to BUSY_POLL
+		 * microseconds rather than wait for its interrupt.  Going
+		 * above net.core.busy_read takes CAP_NET_ADMIN, so find out
+		 * now rather than on every connection.
+		 */
+		sock_busy_poll = param.busy_poll;
+		sd = socket(AF_INET, SOCK_STREAM, 0);
+		if (sd >= 0 && setsockopt(sd, SOL_SOCKET, SO_BUSY_POLL,
+		    &sock_busy_poll, sizeof(sock_busy_poll)) < 0) {
+			fprintf(stderr, "%s: failed to set SO_BUSY_POLL to "
+			    "%u: %s\n", prog_name, param.busy_poll,
+			    strerror(errno));
+			exit(1);
+		}
+		if (sd >= 0)
+			close(sd);
+		add_sock_opt(SOL_SOCKET, SO_BUSY_POLL, &sock_busy_poll,
+		    sizeof(sock_busy_poll), "SO_BUSY_POLL");
+
+		/*
+		 * Ask for the socket to be processed on the CPU the event
+		 * loop is pinned to (see --cpus).
+		 */
+		if (worker_cpu >= 0) {
+			sock_cpu = worker_cpu;
+			add_sock_opt(SOL_SOCKET, SO_INCOMING_CPU, &sock_cpu,
+			    sizeof(sock_cpu), "SO_INCOMING_CPU");
+		}
+#else
+		fprintf(stderr, "%s: --busy-poll is not supported on this "
+		    "system\n", prog_name);
+		exit(1);
+#endif
+	}
+}
+
 static void
 core_runtime_timer(struct Timer *t, Any_Type arg)
 {
@@ -881,8 +2495,7 @@ core_init(void)
 	struct rlimit   rlimit;
 	Any_Type        arg;
 
-	memset(&hash_table, 0, sizeof(hash_table));
-#ifndef HAVE_KEVENT
+#if !defined(HAVE_KEVENT) && !defined(HAVE_EPOLL)
 	memset(&rdfds, 0, sizeof(rdfds));
 	memset(&wrfds, 0, sizeof(wrfds));
 #endif
@@ -892,6 +2505,12 @@ core_init(void)
 #endif
 	myaddr.sin_family = AF_INET;
 	myaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	memset(&myaddr6, 0, sizeof(myaddr6));
+#ifdef __FreeBSD__
+	myaddr6.sin6_len = sizeof(myaddr6);
+#endif
+	myaddr6.sin6_family = AF_INET6;
+	myaddr6.sin6_addr = in6addr_any;
 
 	if (myaddrs.count == 0)
 		core_add_address(myaddr.sin_addr);
@@ -901,6 +2520,30 @@ core_init(void)
 	 */
 	signal(SIGPIPE, SIG_IGN);
 
+#ifdef HAVE_IO_URING
+	if (param.use_io_uring) {
+#ifdef HAVE_SSL
+		if (param.use_ssl)
+			fprintf(stderr, "%s: --io-uring does not support "
+			    "--ssl; using the default event loop\n",
+			    prog_name);
+		else
+#endif
+		if (param.http2 || param.websocket.num_msgs || param.tfo)
+			fprintf(stderr, "%s: --io-uring does not support "
+			    "--%s; using the default event loop\n",
+			    prog_name, param.http2 ? "http2"
+			    : param.tfo ? "tfo" : "websocket");
+		else if (uring_init(URING_ENTRIES, URING_NBUFS) < 0)
+			fprintf(stderr, "%s: failed to set up io_uring (%s); "
+			    "using the default event loop\n", prog_name,
+			    strerror(errno));
+		else
+			use_uring = 1;
+	}
+#endif
+	sock_opts_init();
+
 #ifdef HAVE_KEVENT
 	kq = kqueue();
 	if (kq < 0) {
@@ -921,6 +2564,26 @@ core_init(void)
 		    "%s: failed to add timer event: %s", prog_name,
 		    strerror(errno));
 	}	
+#elif defined(HAVE_EPOLL)
+	epfd = epoll_create(EPOLL_MAX_EVENTS);
+	if (epfd < 0) {
+		fprintf(stderr,
+		    "%s: failed to create epoll instance: %s\n", prog_name,
+		    strerror(errno));
+		exit(1);
+	}
+	(void) fcntl(epfd, F_SETFD, FD_CLOEXEC);
+#ifdef DONT_POLL
+	/*
+	 * Sleep for up to a millisecond when there is nothing to do.
+	 */
+	epoll_timeout = 1;
+#else
+	/*
+	 * Same as for select() below: poll without ever blocking.
+	 */
+	epoll_timeout = 0;
+#endif
 #else
 #ifdef DONT_POLL
 	/*
@@ -963,23 +2626,78 @@ core_init(void)
 		printf("%s: maximum number of open descriptors = %ld\n",
 		       prog_name, rlimit.rlim_max);
 
-	if (param.servers)
-		conn_add_servers();
-	else if (param.server)
-		core_addr_intern(param.server, strlen(param.server), param.port);
+	conn_add_servers();
+	resolve_wait();
 
-	if (param.runtime) {
+	if (param.runtime && !param.preconnect.num_conns) {
 		arg.l = 0;
 		timer_schedule(core_runtime_timer, arg, param.runtime);
 	}
 }
 
+static void	close_conn(Conn * conn, int keep);
+
+/*
+ * Connection S is established (and, with --ssl, the handshake done).  With
+ * --http2, the connection preface goes out first; over SSL that is only if
+ * the server picked "h2" during the handshake.  During the pre-connect
+ * phase, the connection goes straight to the idle pool.
+ */
+static void
+conn_connected(Conn * s)
+{
+	Any_Type        arg;
+	socklen_t       len;
+	int             err;
+#ifdef HAVE_SSL
+	static int      warned;
+	const u_char   *proto;
+	u_int           proto_len;
+#endif
+
+	s->state = S_CONNECTED;
+	if (preconnect.on) {
+		/*
+		 * Nothing is sent on the connection yet, which is where a
+		 * failed connect would otherwise show.
+		 */
+		len = sizeof(err);
+		if (getsockopt(s->sd, SOL_SOCKET, SO_ERROR, &err, &len) == 0
+		    && err != 0)
+			conn_failure(s, err);
+		else
+			close_conn(s, 1);
+		return;
+	}
+	if (param.http2) {
+#ifdef HAVE_SSL
+		if (param.use_ssl) {
+			SSL_get0_alpn_selected(s->ssl, &proto, &proto_len);
+			if (proto_len != 2 || memcmp(proto, "h2", 2) != 0) {
+				if (!warned++)
+					fprintf(stderr, "%s: server does not "
+					    "support HTTP/2; using HTTP/1.1\n",
+					    prog_name);
+				goto done;
+			}
+		}
+#endif
+		h2_init(s);
+		set_active(s, READ);
+		set_active(s, WRITE);
+	}
+#ifdef HAVE_SSL
+      done:
+#endif
+	arg.l = 0;
+	event_signal(EV_CONN_CONNECTED, (Object *) s, arg);
+}
+
 #ifdef HAVE_SSL
 
 void
 core_ssl_connect(Conn * s)
 {
-	Any_Type        arg;
 	int             ssl_err;
 
 	if (DBG > 2)
@@ -1020,10 +2738,20 @@ core_ssl_connect(Conn * s)
 		exit(-1);
 	}
 
-	s->state = S_CONNECTED;
+#ifdef SSL_OP_ENABLE_KTLS
+	/*
+	 * With the kernel doing the encryption, requests can be written to
+	 * the socket directly.  Replies are still read with SSL_read() since
+	 * the kernel leaves non-data records (such as TLS 1.3 session
+	 * tickets) to OpenSSL, but it no longer decrypts anything itself.
+	 */
+	if (param.ssl_ktls)
+		s->ktls_send = BIO_get_ktls_send(SSL_get_wbio(s->ssl)) > 0;
+#endif
 
 	if (DBG > 0)
-		fprintf(stderr, "core_ssl_connect: SSL is connected!\n");
+		fprintf(stderr, "core_ssl_connect: SSL is connected%s!\n",
+		    s->ktls_send ? " (kernel TLS)" : "");
 
 	if (DBG > 1) {
 		const SSL_CIPHER     *ssl_cipher;
@@ -1040,8 +2768,7 @@ core_ssl_connect(Conn * s)
 				SSL_CIPHER_get_id(ssl_cipher));
 	}
 
-	arg.l = 0;
-	event_signal(EV_CONN_CONNECTED, (Object *) s, arg);
+	conn_connected(s);
 }
 
 #endif /* HAVE_SSL */
@@ -1050,14 +2777,19 @@ int
 core_connect(Conn * s)
 {
 	int             sd, result, async_errno;
-	socklen_t       len;
-	struct sockaddr_in *sin;
-	struct linger   linger;
-	int             myport, optval;
+	socklen_t       len, local_len;
+	struct server  *srv = s->server;
+	struct sockaddr *local;
+	in_port_t      *local_port;
+	struct local_addr *addr;
+	int             myport, optval, tries, i;
 	Any_Type        arg;
 	static int      prev_iteration = -1;
 	static u_long   burst_len;
 
+	if (param.conn_pool.max_idle > 0 && !preconnect.on && pool_get(s))
+		return 0;
+
 	if (iteration == prev_iteration)
 		++burst_len;
 	else {
@@ -1067,7 +2799,16 @@ core_connect(Conn * s)
 		prev_iteration = iteration;
 	}
 
-	SYSCALL(SOCKET, sd = socket(AF_INET, SOCK_STREAM, 0));
+	if (srv->addr_len == 0) {
+		/*
+		 * Its address is still being looked up. 
+		 */
+		errno = EHOSTUNREACH;
+		goto failure;
+	}
+
+	SYSCALL(SOCKET, sd = socket(srv->addr.ss_family,
+		SOCK_STREAM | sock_flags, 0));
 	if (sd < 0) {
 		if (DBG > 0)
 			fprintf(stderr,
@@ -1076,51 +2817,37 @@ core_connect(Conn * s)
 		goto failure;
 	}
 
+#ifndef SOCK_NONBLOCK
+	/*
+	 * io_uring never blocks on a socket, whatever its mode.
+	 */
+#ifdef HAVE_IO_URING
+	if (!use_uring)
+#endif
 	if (fcntl(sd, F_SETFL, O_NONBLOCK) < 0) {
 		fprintf(stderr, "%s.core_connect.fcntl: %s\n",
 			prog_name, strerror(errno));
+		close(sd);
 		goto failure;
 	}
+#endif
 
-	if (param.close_with_reset) {
-		linger.l_onoff = 1;
-		linger.l_linger = 0;
-		if (setsockopt
-		    (sd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger)) < 0) {
-			fprintf(stderr,
-				"%s.core_connect.setsockopt(SO_LINGER): %s\n",
-				prog_name, strerror(errno));
+	for (i = 0; i < num_sock_opts; ++i) {
+		if (sock_opts[i].level == SOL_TCP
+		    && srv->addr.ss_family == AF_UNIX)
+			continue;
+		if (setsockopt(sd, sock_opts[i].level, sock_opts[i].name,
+			sock_opts[i].val, sock_opts[i].len) < 0) {
+			fprintf(stderr, "%s.core_connect.setsockopt(%s): %s\n",
+			    prog_name, sock_opts[i].what, strerror(errno));
+			close(sd);
 			goto failure;
 		}
 	}
 
-	/*
-	 * Disable Nagle algorithm so we don't delay needlessly when
-	 * pipelining requests.  
-	 */
-	optval = 1;
-	if (setsockopt(sd, SOL_TCP, TCP_NODELAY, &optval, sizeof(optval)) < 0) {
-		fprintf(stderr, "%s.core_connect.setsockopt(SO_SNDBUF): %s\n",
-			prog_name, strerror(errno));
-		goto failure;
-	}
-
-	optval = param.send_buffer_size;
-	if (setsockopt(sd, SOL_SOCKET, SO_SNDBUF, &optval, sizeof(optval)) < 0) {
-		fprintf(stderr, "%s.core_connect.setsockopt(SO_SNDBUF): %s\n",
-			prog_name, strerror(errno));
-		goto failure;
-	}
-
-	optval = param.recv_buffer_size;
-	if (setsockopt(sd, SOL_SOCKET, SO_RCVBUF, &optval, sizeof(optval)) < 0) {
-		fprintf(stderr, "%s.core_connect.setsockopt(SO_SNDBUF): %s\n",
-			prog_name, strerror(errno));
-		goto failure;
-	}
-
 	s->sd = sd;
-#ifndef HAVE_KEVENT
+	s->tfo = param.tfo;
+#if !defined(HAVE_KEVENT) && !defined(HAVE_EPOLL)
 	if (sd >= alloced_sd_to_conn) {
 		size_t          size, old_size;
 
@@ -1144,65 +2871,115 @@ core_connect(Conn * s)
 	sd_to_conn[sd] = s;
 #endif
 
-	sin = hash_lookup(s->hostname, s->hostname_len, s->port);
-	if (!sin) {
-		if (DBG > 0)
-			fprintf(stderr,
-				"%s.core_connect: unknown server/port %s:%d\n",
-				prog_name, s->hostname, s->port);
-		goto failure;
-	}
-
 	arg.l = 0;
 	event_signal(EV_CONN_CONNECTING, (Object *) s, arg);
 	if (s->state >= S_CLOSING)
 		goto failure;
 
-	s->myaddr = core_get_next_myaddr();
-	myaddr.sin_addr = s->myaddr->ip;
-	if (param.hog) {
+	addr = core_get_next_myaddr();
+	if (srv->addr.ss_family == AF_UNIX) {
+		/*
+		 * There is no source address or port to pick.
+		 */
+		addr = NULL;
+		local = NULL;
+	} else if (srv->addr.ss_family == AF_INET6) {
+		local = (struct sockaddr *) &myaddr6;
+		local_len = sizeof(myaddr6);
+		local_port = &myaddr6.sin6_port;
+	} else {
+		myaddr.sin_addr = addr->ip;
+		local = (struct sockaddr *) &myaddr;
+		local_len = sizeof(myaddr);
+		local_port = &myaddr.sin_port;
+	}
+	if (param.hog && local) {
+		/*
+		 * Ports are accounted per source address and server, so
+		 * sockets to different servers may share a local port (they
+		 * all have SO_REUSEADDR set for this).  When a source
+		 * address has no port left for this server, the next one is
+		 * tried.
+		 */
+		tries = 0;
 		while (1) {
-			myport = port_get(s->myaddr);
-			if (myport < 0)
-				goto failure;
+			myport = port_get(addr, srv);
+			if (myport < 0) {
+				if (addr->index < SELF_MAX_SOURCES)
+					++self_stats.source[addr->index].
+					    num_exhausted;
+				if (++tries >= myaddrs.count) {
+					errno = EADDRNOTAVAIL;
+					goto failure;
+				}
+				addr = core_get_next_myaddr();
+				myaddr.sin_addr = addr->ip;
+				continue;
+			}
 
-			myaddr.sin_port = htons(myport);
-			SYSCALL(BIND,
-				result = bind(sd, (struct sockaddr *) &myaddr,
-					      sizeof(myaddr)));
+			*local_port = htons(myport);
+			SYSCALL(BIND, result = bind(sd, local, local_len));
 			if (result == 0)
 				break;
 
-			if (errno != EADDRINUSE && errno == EADDRNOTAVAIL) {
+			if (errno != EADDRINUSE) {
 				if (DBG > 0)
 					fprintf(stderr,
 						"%s.core_connect.bind: %s\n",
 						prog_name, strerror(errno));
+				port_put(addr, srv, myport);
 				goto failure;
 			}
 		}
 		s->myport = myport;
-	} else if (myaddr.sin_addr.s_addr != htonl(INADDR_ANY)) {
-		SYSCALL(BIND,
-		    result = bind(sd, (struct sockaddr *) &myaddr,
-			sizeof(myaddr)));
+	} else if (local == (struct sockaddr *) &myaddr
+	    && myaddr.sin_addr.s_addr != htonl(INADDR_ANY)) {
+#ifdef IP_BIND_ADDRESS_NO_PORT
+		/*
+		 * Leave the choice of the port to connect(), which only
+		 * needs the 4-tuple to be unique, rather than have bind()
+		 * reserve a port on the source address for good.
+		 */
+		optval = 1;
+		(void) setsockopt(sd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT,
+		    &optval, sizeof(optval));
+#endif
+		SYSCALL(BIND, result = bind(sd, local, local_len));
 		if (result != 0)
 			goto failure;
 	}
+	s->myaddr = addr;
+	if (addr)
+		source_open(addr);
+
+#ifdef HAVE_IO_URING
+	if (use_uring) {
+		s->state = S_CONNECTING;
+		uring_connect(s, (struct sockaddr *) &srv->addr,
+		    srv->addr_len);
+		if (param.timeout > 0.0) {
+			s->connect_deadline = timer_now() + param.timeout;
+			arm_watchdog(s);
+		}
+		return 0;
+	}
+#endif
 
 	SYSCALL(CONNECT,
-		result = connect(sd, (struct sockaddr *) sin, sizeof(*sin)));
+		result = connect(sd, (struct sockaddr *) &srv->addr,
+		    srv->addr_len));
 	if (result == 0) {
 #ifdef HAVE_SSL
-		if (param.use_ssl)
+		/*
+		 * With --tfo, connect() returns at once and the handshake
+		 * may have to be resumed from the event loop.
+		 */
+		if (param.use_ssl) {
+			s->state = S_CONNECTING;
 			core_ssl_connect(s);
-		else
+		} else
 #endif
-		{
-			s->state = S_CONNECTED;
-			arg.l = 0;
-			event_signal(EV_CONN_CONNECTED, (Object *) s, arg);
-		}
+			conn_connected(s);
 	} else if (errno == EINPROGRESS) {
 		/*
 		 * The socket becomes writable only after the connection has
@@ -1210,13 +2987,9 @@ core_connect(Conn * s)
 		 * connection establishment.  
 		 */
 		s->state = S_CONNECTING;
+		if (param.timeout > 0.0)
+			s->connect_deadline = timer_now() + param.timeout;
 		set_active(s, WRITE);
-		if (param.timeout > 0.0) {
-			arg.vp = s;
-			assert(!s->watchdog);
-			s->watchdog =
-			    timer_schedule(conn_timeout, arg, param.timeout);
-		}
 	} else {
 		len = sizeof(async_errno);
 		if (getsockopt(sd, SOL_SOCKET, SO_ERROR, &async_errno, &len) ==
@@ -1227,8 +3000,20 @@ core_connect(Conn * s)
 			fprintf(stderr,
 				"%s.core_connect.connect: %s (max_sd=%d)\n",
 				prog_name, strerror(errno), max_sd);
-		if (s->myport > 0)
-			port_put(s->myaddr, s->myport);
+		if (errno == EADDRNOTAVAIL && s->myaddr
+		    && s->myaddr->index < SELF_MAX_SOURCES)
+			++self_stats.source[s->myaddr->index].num_exhausted;
+		/*
+		 * A Unix domain socket is refused (or finds a full backlog)
+		 * right away rather than from the event loop.  That is the
+		 * server's doing, not a shortage on our side worth waiting
+		 * out, so it fails the connection like a refusal over TCP
+		 * would.
+		 */
+		if (srv->addr.ss_family == AF_UNIX) {
+			conn_failure(s, errno);
+			return 0;
+		}
 		goto failure;
 	}
 	return 0;
@@ -1243,11 +3028,11 @@ core_send(Conn * conn, Call * call)
 {
 	Any_Type        arg;
 
+	call->conn = conn;	/* NO refcounting here (see call.h).  */
+
 	arg.l = 0;
 	event_signal(EV_CALL_ISSUE, (Object *) call, arg);
 
-	call->conn = conn;	/* NO refcounting here (see call.h).  */
-
 	if (param.no_host_hdr) {
 		call->req.iov[IE_HOST].iov_base = (caddr_t) "";
 		call->req.iov[IE_HOST].iov_len = 0;
@@ -1299,6 +3084,7 @@ core_send(Conn * conn, Call * call)
 	}
 	call->req.iov_index = 0;
 	call->req.iov_saved = call->req.iov[0];
+	call->req.started = 0;
 
 	/*
 	 * insert call into connection's send queue: 
@@ -1322,7 +3108,77 @@ core_send(Conn * conn, Call * call)
 }
 
 void
-core_close(Conn * conn)
+core_ws_start(Conn * conn)
+{
+	assert(!conn->ws && !conn->sendq && !conn->recvq);
+
+	ws_init(conn);
+	set_active(conn, READ);
+}
+
+int
+core_ws_send(Conn * conn)
+{
+	if (conn->state >= S_CLOSING || ws_queue(conn) < 0)
+		return -1;
+	set_active(conn, WRITE);
+	return 0;
+}
+
+static void
+close_socket(Conn * conn, int sd)
+{
+#ifdef HAVE_IO_URING
+	if (use_uring && (conn->uring_connect || conn->uring_send
+	    || conn->uring_recv)) {
+		struct io_uring_sqe *sqe;
+
+		/*
+		 * Cancel what's still in flight on the socket, and
+		 * only then close it so the descriptor can't be
+		 * reused under the feet of those requests.
+		 */
+		sqe = uring_get_sqe();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = sd;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD
+		    | IORING_ASYNC_CANCEL_ALL;
+		sqe->flags = IOSQE_IO_HARDLINK;
+		sqe->user_data = URING_OP_NONE;
+
+		sqe = uring_get_sqe();
+		sqe->opcode = IORING_OP_CLOSE;
+		sqe->fd = sd;
+		sqe->user_data = URING_OP_NONE;
+	} else
+#endif
+	close(sd);
+}
+
+#ifdef TCP_FASTOPEN_CONNECT
+/*
+ * Find out whether the server took the data that went out with the SYN of
+ * connection CONN (socket SD).
+ */
+static void
+tfo_check(Conn * conn, int sd)
+{
+	struct tcp_info info;
+	socklen_t       len = sizeof(info);
+
+	if (getsockopt(sd, SOL_TCP, TCP_INFO, &info, &len) == 0
+	    && (info.tcpi_options & TCPI_OPT_SYN_DATA))
+		conn->tfo_accepted = 1;
+}
+#endif
+
+/*
+ * Close connection CONN.  If KEEP is non-zero and the connection is idle
+ * and still usable, its socket goes to the idle connection pool instead of
+ * being closed.
+ */
+static void
+close_conn(Conn * conn, int keep)
 {
 	Call           *call, *call_next;
 	Any_Type        arg;
@@ -1330,6 +3186,30 @@ core_close(Conn * conn)
 
 	if (conn->state >= S_CLOSING)
 		return;		/* guard against recursive calls */
+
+	/*
+	 * Only a connection that is between requests can be reused.  The
+	 * io_uring engine keeps a receive armed on each connection, so it
+	 * doesn't take part, and neither do HTTP/2 and WebSocket
+	 * connections.
+	 */
+	keep = keep && param.conn_pool.max_idle > 0 && conn->sd >= 0
+	    && !conn->sendq && !conn->recvq && !conn->server_close
+	    && (conn->state == S_CONNECTED || conn->state == S_REPLY_STATUS
+		|| conn->state == S_REPLY_DONE);
+#ifdef HAVE_IO_URING
+	keep = keep && !use_uring;
+#endif
+	keep = keep && !conn->h2 && !conn->ws;
+	/*
+	 * A parked socket must not stay registered with the event loop on
+	 * behalf of a connection that is about to go away; an SSL handshake,
+	 * for one, leaves the connection reading.
+	 */
+	if (keep && conn->reading)
+		clear_active(conn, READ);
+	if (keep && conn->writing)
+		clear_active(conn, WRITE);
 	conn->state = S_CLOSING;
 
 	if (DBG >= 10)
@@ -1358,18 +3238,41 @@ core_close(Conn * conn)
 	sd = conn->sd;
 	conn->sd = -1;
 
+#ifdef TCP_FASTOPEN_CONNECT
+	if (conn->tfo && sd >= 0)
+		tfo_check(conn, sd);
+#endif
+
 	arg.l = 0;
 	event_signal(EV_CONN_CLOSE, (Object *) conn, arg);
 	assert(conn->state == S_CLOSING);
 
+	if (keep && !pool_put(conn, sd))
+		keep = 0;
 #ifdef HAVE_SSL
-	if (param.use_ssl)
+	if (param.use_ssl && !keep)
 		SSL_shutdown(conn->ssl);
 #endif
 
 	if (sd >= 0) {
-		close(sd);
-#ifndef HAVE_KEVENT
+		if (!keep)
+			close_socket(conn, sd);
+#ifdef HAVE_EPOLL
+		{
+			int             i;
+
+			/*
+			 * Closing the descriptor took it out of the epoll
+			 * set, but events for this connection may still be
+			 * pending in the batch core_loop() is working on.
+			 * Forget about them so we don't touch the
+			 * connection once it has been destroyed.
+			 */
+			for (i = epoll_next; i < epoll_nready; ++i)
+				if (epoll_events[i].data.ptr == conn)
+					epoll_events[i].data.ptr = NULL;
+		}
+#elif !defined(HAVE_KEVENT)
 		sd_to_conn[sd] = 0;
 		FD_CLR(sd, &wrfds);
 		FD_CLR(sd, &rdfds);
@@ -1378,7 +3281,11 @@ core_close(Conn * conn)
 		conn->writing = 0;
 	}
 	if (conn->myport > 0)
-		port_put(conn->myaddr, conn->myport);
+		port_put(conn->myaddr, conn->server, conn->myport);
+	if (conn->myaddr) {
+		source_close(conn->myaddr);
+		conn->myaddr = NULL;
+	}
 
 	/*
 	 * A connection that has been closed is not useful anymore, so we give 
@@ -1386,6 +3293,22 @@ core_close(Conn * conn)
 	 * initiates destruction of the connection.  
 	 */
 	conn_dec_ref(conn);
+
+	if (preconnect.on && --preconnect.num_pending == 0
+	    && preconnect.num_opened == param.preconnect.num_conns)
+		running = 0;
+}
+
+void
+core_close(Conn * conn)
+{
+	close_conn(conn, 0);
+}
+
+void
+core_release(Conn * conn)
+{
+	close_conn(conn, 1);
 }
 
 #ifdef HAVE_KEVENT
@@ -1394,18 +3317,19 @@ core_loop(void)
 {
 	struct kevent ev;
 	int n;
-	Any_Type   arg;
 	Conn      *conn;
 
 	while (running) {
 		++iteration;
 
-		n = kevent(kq, NULL, 0, &ev, 1, NULL);
-		if (n < 0 && errno != EINTR) {
+		loop_sleep();
+		SYSCALL(KEVENT, n = kevent(kq, NULL, 0, &ev, 1, NULL));
+		if (n < 0) {
 			fprintf(stderr, "failed to fetch event: %s",
 			    strerror(errno));
 			exit(1);
 		}
+		loop_wakeup(n);
 
 		switch (ev.filter) {
 		case EVFILT_TIMER:
@@ -1416,10 +3340,6 @@ core_loop(void)
 			conn = ev.udata;
 	                conn_inc_ref(conn);
 
-	                if (conn->watchdog) {
-	                    timer_cancel(conn->watchdog);
-	                    conn->watchdog = 0;
-	                }
 	                if (conn->state == S_CONNECTING) {
 #ifdef HAVE_SSL
 	                    if (param.use_ssl)
@@ -1428,14 +3348,12 @@ core_loop(void)
 #endif
 	                    if (ev.filter == EVFILT_WRITE) {
 				clear_active(conn, WRITE);
-	                        conn->state = S_CONNECTED;
-	                        arg.l = 0;
-	                        event_signal(EV_CONN_CONNECTED, (Object*)conn, arg);
+	                        conn_connected(conn);
 	                    }
 	                } else {
-			    if (ev.filter == EVFILT_WRITE && conn->sendq)
+			    if (ev.filter == EVFILT_WRITE && WANTS_SEND(conn))
 	                        do_send(conn);
-	                    if (ev.filter == EVFILT_READ && conn->recvq)
+	                    if (ev.filter == EVFILT_READ && WANTS_RECV(conn))
 	                        do_recv(conn);
 	                }
 	                    
@@ -1444,6 +3362,88 @@ core_loop(void)
 		}
 	}
 }
+#elif defined(HAVE_EPOLL)
+void
+core_loop(void)
+{
+	int        is_readable, is_writable, n;
+	struct epoll_event *ev;
+	Conn      *conn;
+
+#ifdef HAVE_IO_URING
+	if (use_uring) {
+		uring_loop();
+		return;
+	}
+#endif
+
+	while (running) {
+	    timer_tick();
+
+	    loop_sleep();
+	    SYSCALL(EPOLL_WAIT,
+		n = epoll_wait(epfd, epoll_events, EPOLL_MAX_EVENTS,
+		    epoll_timeout));
+	    loop_wakeup(n);
+
+	    ++iteration;
+
+	    if (n <= 0) {
+	        if (n < 0) {
+	            fprintf(stderr, "%s.core_loop: epoll_wait failed: %s\n",
+			prog_name, strerror(errno));
+	            exit(1);
+	        }
+	        continue;
+	    }
+
+	    epoll_nready = n;
+	    for (epoll_next = 0; epoll_next < epoll_nready; ) {
+		ev = &epoll_events[epoll_next++];
+		conn = ev->data.ptr;
+		if (!conn)
+		    continue;	/* closed earlier in this batch */
+
+		/*
+		 * Errors and hangups are reported to whichever direction
+		 * we're waiting for so that do_send()/do_recv() get to see
+		 * them.  Only handle directions that are still of interest;
+		 * earlier events in this batch may have changed that.
+		 */
+		is_readable = conn->reading
+		    && (ev->events & (EPOLLIN | EPOLLERR | EPOLLHUP));
+		is_writable = conn->writing
+		    && (ev->events & (EPOLLOUT | EPOLLERR | EPOLLHUP));
+		if (!is_readable && !is_writable)
+		    continue;
+
+		conn_inc_ref(conn);
+
+		if (conn->state == S_CONNECTING) {
+#ifdef HAVE_SSL
+		    if (param.use_ssl)
+			core_ssl_connect(conn);
+		    else
+#endif
+		    if (is_writable) {
+			clear_active(conn, WRITE);
+			conn_connected(conn);
+		    }
+		} else {
+		    if (is_writable && WANTS_SEND(conn))
+			do_send(conn);
+		    if (is_readable && WANTS_RECV(conn))
+			do_recv(conn);
+		}
+
+		conn_dec_ref(conn);
+
+		if (epoll_next < epoll_nready)
+		    timer_tick();
+	    }
+	    epoll_nready = 0;
+	}
+}
 #else
 void
 core_loop(void)
@@ -1451,8 +3451,14 @@ core_loop(void)
 	int        is_readable, is_writable, n, sd, bit, min_i, max_i, i = 0;
 	fd_set     readable, writable;
 	fd_mask    mask;
-	Any_Type   arg;
 	Conn      *conn;
+
+#ifdef HAVE_IO_URING
+	if (use_uring) {
+		uring_loop();
+		return;
+	}
+#endif
  
 	while (running) {
 	    struct timeval  tv = select_timeout;
@@ -1464,7 +3470,9 @@ core_loop(void)
 	    min_i = min_sd / NFDBITS;
 	    max_i = max_sd / NFDBITS;
 
+	    loop_sleep();
 	    SYSCALL(SELECT,	n = select(max_sd + 1, &readable, &writable, 0, &tv));
+	    loop_wakeup(n);
 
 	    ++iteration;
 
@@ -1505,10 +3513,6 @@ core_loop(void)
 	                    conn = sd_to_conn[sd];
 	                    conn_inc_ref(conn);
 
-	                    if (conn->watchdog) {
-	                        timer_cancel(conn->watchdog);
-	                        conn->watchdog = 0;
-	                    }
 	                    if (conn->state == S_CONNECTING) {
 #ifdef HAVE_SSL
 	                        if (param.use_ssl)
@@ -1517,14 +3521,12 @@ core_loop(void)
 #endif
 	                        if (is_writable) {
 				    clear_active(conn, WRITE);
-	                            conn->state = S_CONNECTED;
-	                            arg.l = 0;
-	                            event_signal(EV_CONN_CONNECTED, (Object*)conn, arg);
+	                            conn_connected(conn);
 	                        }
 	                    } else {
-	                        if (is_writable && conn->sendq)
+	                        if (is_writable && WANTS_SEND(conn))
 	                            do_send(conn);
-	                        if (is_readable && conn->recvq)
+	                        if (is_readable && WANTS_RECV(conn))
 	                            do_recv(conn);
 	                    }
 	                    
@@ -1542,31 +3544,111 @@ core_loop(void)
 }
 #endif
 
-void
-core_exit(void)
+static void
+preconnect_tick(struct Timer *t, Any_Type arg)
 {
-	running = 0;
-	param.num_conns = 0;
+	u_int           due = param.preconnect.num_conns;
+	double          n;
+	Conn           *s;
+
+	if (param.preconnect.rate > 0.0) {
+		n = (timer_now() - preconnect.start) * param.preconnect.rate
+		    + 1;
+		if (n < due)
+			due = n;
+	}
+
+	while (preconnect.num_opened < due) {
+		s = conn_new();
+		if (!s) {
+			due = preconnect.num_opened;
+			param.preconnect.num_conns = due;
+			break;
+		}
+		++preconnect.num_opened;
+		++preconnect.num_pending;
+		core_connect(s);
+	}
 
-	printf("Maximum connect burst length: %lu\n", max_burst_len);
+	if (preconnect.num_opened < param.preconnect.num_conns)
+		timer_schedule(preconnect_tick, arg,
+		    1.0 / param.preconnect.rate);
+	else if (preconnect.num_pending == 0)
+		running = 0;
+}
 
-#ifdef TIME_SYSCALLS
-	{
-		u_int           count;
-		Time            time;
-		int             i;
-
-		printf("Average syscall execution times:\n");
-		for (i = 0; i < NELEMS(syscall_name); ++i) {
-			count = syscall_count[i];
-			time = syscall_time[i];
-			printf("\t%s:\t%.3f ms/call (%.3fs total, %u calls)\n",
-			       syscall_name[i],
-			       count > 0 ? 1e3 * time / count : 0, time,
-			       count);
+/*
+ * Open the --preconnect connections, at the rate asked for, and park them
+ * in the idle pool, so the test starts with them established and the
+ * generators' first core_connect() calls pick them up.  Nobody hears about
+ * the pre-connect phase: all events are held back while it lasts, so its
+ * connect storm neither shows up in the statistics nor reaches the
+ * generators.  The event loop runs until every connection is in the pool
+ * or has failed.  The --runtime and idle timeouts start counting when it
+ * is over.
+ */
+void
+core_preconnect(void)
+{
+	struct idle_conn *ic;
+	struct server  *he;
+	u_int           saved_mask = event_mask, num_idle = 0, i;
+	Any_Type        arg;
 
+	if (param.preconnect.num_conns == 0)
+		return;
+
+	preconnect.on = 1;
+	preconnect.start = timer_now_forced();
+	event_mask = 0;
+	arg.l = 0;
+	preconnect_tick(0, arg);
+	if (running)
+		core_loop();
+	event_mask = saved_mask;
+	preconnect.on = 0;
+
+	for (i = 0; i < server_table_size; ++i) {
+		if (!(he = server_table[i]))
+			continue;
+		for (ic = he->idle; ic; ic = ic->next) {
+			arg.vp = ic;
+			ic->timer = timer_schedule(pool_expire, arg,
+			    param.conn_pool.idle_timeout);
 		}
-		putchar('\n');
+		num_idle += he->num_idle;
 	}
-#endif
+
+	if (worker_id == 0)
+		printf("Pre-connect: %u connections in %.3f s, %u failed\n",
+		    preconnect.num_opened, timer_now_forced() - preconnect.start,
+		    preconnect.num_opened - num_idle);
+
+	/*
+	 * Stopped by core_exit() before it was done, so is the test.
+	 */
+	if (preconnect.num_pending > 0
+	    || preconnect.num_opened < param.preconnect.num_conns)
+		return;
+
+	max_burst_len = 0;
+	running = 1;
+	if (param.runtime) {
+		arg.l = 0;
+		timer_schedule(core_runtime_timer, arg, param.runtime);
+	}
+}
+
+void
+core_exit(void)
+{
+	running = 0;
+	param.num_conns = 0;
+
+	/*
+	 * Only the first worker talks about itself; the results of the others
+	 * show up in the merged statistics.
+	 */
+	if (worker_id == 0)
+		printf("Maximum connect burst length: %lu\n", max_burst_len);
 }
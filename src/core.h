@@ -37,11 +37,31 @@
 
 extern void core_init (void);
 extern void core_add_addresses (const char *spec);
-extern struct sockaddr_in *core_addr_intern (const char *hostname,
-					     size_t hostname_len, int port);
+/* Look up (and resolve, the first time) server HOSTNAME:PORT.  The
+   result is what Conn.server points at.  */
+extern struct server *core_addr_intern (const char *hostname,
+					size_t hostname_len, int port);
 extern int core_connect (Conn *conn);
 extern int core_send (Conn *conn, Call *call);
 extern void core_close (Conn *conn);
+/* Like core_close(), but for a connection that is done with its calls:
+   if --conn-pool is on, the connection is kept open so a later
+   core_connect() to the same server can reuse it.  */
+extern void core_release (Conn *conn);
+
+/* Switch CONN, whose upgrade request got a "101 Switching Protocols"
+   reply, over to WebSocket framing (see websocket.h).  */
+extern void core_ws_start (Conn *conn);
+/* Send a WebSocket message on CONN.  Returns -1 if too many messages
+   are waiting for their echo.  */
+extern int core_ws_send (Conn *conn);
+
+/* Name of the readiness-based event loop built in ("epoll", say).  */
+extern const char *core_engine_name;
+
+/* Run the --preconnect phase: open the connections and park them in
+   the idle pool before the test starts.  */
+extern void core_preconnect (void);
 
 extern void core_loop (void);
 extern void core_exit (void);
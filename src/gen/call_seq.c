@@ -119,11 +119,13 @@ call_destroyed (Event_Type et, Call *call)
 
   if (++priv->num_destroyed >= MIN (param.burst_len, param.num_calls))
     {
-      if (priv->num_completed == priv->num_destroyed
-	  && priv->num_calls < param.num_calls)
+      if (priv->num_completed != priv->num_destroyed)
+	core_close (conn);
+      else if (priv->num_calls < param.num_calls)
 	issue_calls (conn);
       else
-	core_close (conn);
+	/* all calls went through, so the connection may be reused */
+	core_release (conn);
     }
 }
 
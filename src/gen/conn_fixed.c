@@ -0,0 +1,339 @@
+/*
+    httperf -- a tool for measuring web server performance
+    Copyright 2000-2007 Hewlett-Packard Company
+
+    This file is part of httperf, a web server performance measurment
+    tool.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+    
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this work with the OpenSSL project's
+    "OpenSSL" library (or with modified versions of it that use the same
+    license as the "OpenSSL" library), and distribute linked combinations
+    including the two.  You must obey the GNU General Public License in
+    all respects for all of the code used other than "OpenSSL".  If you
+    modify this file, you may extend this exception to your version of the
+    file, but you are not obligated to do so.  If you do not wish to do
+    so, delete this exception statement from your version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  
+    02110-1301, USA
+*/
+
+/* Keeps PARAM.CONCURRENCY.NUM_CONNS connections busy (closed loop).
+   Each connection has up to PARAM.CONCURRENCY.DEPTH calls outstanding
+   and issues the next call as soon as one completes, until it has
+   issued PARAM.NUM_CALLS calls; a connection that is done (or fails) is
+   replaced right away, until PARAM.NUM_CONNS connections have been
+   created.  No call is issued before all the connections are up, and
+   the test is timed from then on.  */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/resource.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <core.h>
+#include <localevent.h>
+
+#define CONN_PRIVATE_DATA(c) \
+  ((Conn_Private_Data *) ((char *)(c) + conn_private_data_offset))
+
+/* How long to wait before retrying when no connection could be
+   created at all (out of file descriptors, for example).  */
+#define RETRY_DELAY	0.01
+
+typedef struct Conn_Private_Data
+  {
+    u_long num_calls;		/* # of calls issued */
+    u_long num_completed;	/* # of calls that got a reply */
+    u_long num_destroyed;	/* # of calls done with */
+    int closing;		/* connection is being closed? */
+    int ready_index;		/* index in READY while warming up */
+  }
+Conn_Private_Data;
+
+static size_t conn_private_data_offset;
+
+static u_int num_conns_generated;
+static u_int num_conns_destroyed;
+static u_int num_conns_open;
+static int filling;
+static Conn *connecting;		/* connection being set up by fill() */
+static struct Timer *retry_timer;
+
+static int warming_up;
+static Time warm_up_start;
+static Conn **ready;		/* connections that are up during warm-up */
+static u_int num_ready;
+
+static void
+issue_call (Conn *conn)
+{
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+  Call *call;
+
+  ++priv->num_calls;
+  call = call_new ();
+  if (call)
+    {
+      core_send (conn, call);
+      call_dec_ref (call);
+    }
+}
+
+static void
+issue_calls (Conn *conn)
+{
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+  u_long i;
+
+  for (i = 0; i < param.concurrency.depth; ++i)
+    if (priv->num_calls < param.num_calls)
+      issue_call (conn);
+}
+
+static void fill (void);
+
+static void
+retry (struct Timer *t, Any_Type arg)
+{
+  retry_timer = 0;
+  fill ();
+}
+
+/* Opens connections until there are as many as asked for.  */
+static void
+fill (void)
+{
+  Conn_Private_Data *priv;
+  Any_Type arg;
+  Conn *conn;
+
+  if (filling)
+    return;
+  filling = 1;
+
+  while (num_conns_open < param.concurrency.num_conns
+	 && num_conns_generated < param.num_conns)
+    {
+      conn = conn_new ();
+      if (!conn)
+	panic ("%s: out of memory creating connections\n", prog_name);
+
+      priv = CONN_PRIVATE_DATA (conn);
+      priv->ready_index = -1;
+
+      ++num_conns_generated;
+      ++num_conns_open;
+      connecting = conn;
+      if (core_connect (conn) < 0)
+	{
+	  connecting = 0;
+	  /* CONN has been destroyed already; don't count it and try
+	     again once a connection goes away (or after a while if
+	     there are none).  */
+	  --num_conns_generated;
+	  if (num_conns_open == 0 && !retry_timer)
+	    {
+	      arg.l = 0;
+	      retry_timer = timer_schedule (retry, arg, RETRY_DELAY);
+	    }
+	  break;
+	}
+      if (!connecting)
+	{
+	  /* CONN failed and went away on the spot (refused by a Unix
+	     domain socket, for example), which counts like any other
+	     failed connection.  */
+	  if (++num_conns_destroyed >= param.num_conns)
+	    {
+	      core_exit ();
+	      break;
+	    }
+	  continue;
+	}
+      connecting = 0;
+    }
+  filling = 0;
+}
+
+static void
+end_warm_up (void)
+{
+  u_int i;
+
+  warming_up = 0;
+  if (verbose)
+    printf ("%s: %u connections up after %.3f s\n",
+	    prog_name, num_ready, timer_now () - warm_up_start);
+
+  test_time_start = timer_now ();
+  getrusage (RUSAGE_SELF, &test_rusage_start);
+
+  for (i = 0; i < num_ready; ++i)
+    {
+      CONN_PRIVATE_DATA (ready[i])->ready_index = -1;
+      issue_calls (ready[i]);
+    }
+  num_ready = 0;
+}
+
+static void
+check_warm_up (void)
+{
+  if (num_ready > 0 && num_ready == num_conns_open
+      && (num_conns_open >= param.concurrency.num_conns
+	  || num_conns_generated >= param.num_conns))
+    end_warm_up ();
+}
+
+static void
+conn_connected (Event_Type et, Conn *conn)
+{
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+
+  assert (et == EV_CONN_CONNECTED && object_is_conn (conn));
+
+  if (warming_up)
+    {
+      priv->ready_index = num_ready;
+      ready[num_ready++] = conn;
+      check_warm_up ();
+    }
+  else
+    issue_calls (conn);
+}
+
+static void
+conn_destroyed (Event_Type et, Conn *conn)
+{
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+
+  assert (et == EV_CONN_DESTROYED && object_is_conn (conn));
+
+  if (conn == connecting)
+    {
+      /* gone before core_connect() returned (see fill()) */
+      connecting = 0;
+      --num_conns_open;
+      return;
+    }
+
+  if (priv->ready_index >= 0)
+    {
+      ready[priv->ready_index] = ready[--num_ready];
+      CONN_PRIVATE_DATA (ready[priv->ready_index])->ready_index
+	= priv->ready_index;
+    }
+
+  --num_conns_open;
+  if (++num_conns_destroyed >= param.num_conns)
+    {
+      core_exit ();
+      return;
+    }
+  fill ();
+  if (warming_up)
+    check_warm_up ();
+}
+
+static void
+call_done (Event_Type et, Call *call)
+{
+  Conn *conn = call->conn;
+
+  assert (et == EV_CALL_RECV_STOP && conn && object_is_conn (conn));
+
+  ++CONN_PRIVATE_DATA (conn)->num_completed;
+}
+
+static void
+call_destroyed (Event_Type et, Call *call)
+{
+  Conn_Private_Data *priv;
+  Conn *conn;
+
+  assert (et == EV_CALL_DESTROYED && object_is_call (call));
+
+  conn = call->conn;
+  priv = CONN_PRIVATE_DATA (conn);
+  ++priv->num_destroyed;
+
+  if (priv->closing)
+    return;
+
+  if (priv->num_completed != priv->num_destroyed)
+    {
+      /* a call failed; the connection is no good */
+      priv->closing = 1;
+      core_close (conn);
+    }
+  else if (priv->num_calls < param.num_calls)
+    issue_call (conn);
+  else if (priv->num_destroyed >= priv->num_calls)
+    {
+      /* all calls went through, so the connection may be reused */
+      priv->closing = 1;
+      core_release (conn);
+    }
+}
+
+static void
+init (void)
+{
+  Any_Type arg;
+
+  conn_private_data_offset = object_expand (OBJ_CONN,
+					    sizeof (Conn_Private_Data));
+
+  ready = malloc (param.concurrency.num_conns * sizeof (ready[0]));
+  if (!ready)
+    panic ("%s: out of memory\n", prog_name);
+
+  arg.l = 0;
+  event_register_handler (EV_CONN_CONNECTED, (Event_Handler) conn_connected,
+			  arg);
+  event_register_handler (EV_CONN_DESTROYED, (Event_Handler) conn_destroyed,
+			  arg);
+  event_register_handler (EV_CALL_RECV_STOP, (Event_Handler) call_done, arg);
+  event_register_handler (EV_CALL_DESTROYED, (Event_Handler) call_destroyed,
+			  arg);
+}
+
+static void
+start (void)
+{
+  warming_up = 1;
+  warm_up_start = timer_now ();
+  fill ();
+}
+
+Load_Generator conn_fixed =
+  {
+    "keeps a fixed number of connections busy",
+    init,
+    start,
+    no_op
+  };
@@ -37,6 +37,10 @@
 	--add-header	Adds one or more command-line specified header(s)
 			to each call request.
 
+	--accept-encoding
+			Adds an Accept-Encoding header to each call
+			request.
+
 	--method	Sets the method to be used when performing a
 			call.  */
 
@@ -65,6 +69,9 @@ static size_t extra_len;
 
 static size_t method_len, file_len;
 
+static char *accept_encoding;
+static size_t accept_encoding_len;
+
 /* A simple module that collects cookies from the server responses and
    includes them in future calls to the server.  */
 
@@ -133,6 +140,9 @@ call_created (Event_Type et, Object *obj, Any_Type reg_arg, Any_Type arg)
 
   if (file_len > 0)
     call_append_request_header (c, extra_file, file_len);
+
+  if (accept_encoding_len > 0)
+    call_append_request_header (c, accept_encoding, accept_encoding_len);
 }
 
 
@@ -168,6 +178,17 @@ init (void)
   if (param.method)
     method_len = strlen (param.method);
 
+  if (param.encoding.accept)
+    {
+      accept_encoding_len = strlen ("Accept-Encoding: \r\n")
+	+ strlen (param.encoding.accept);
+      accept_encoding = malloc (accept_encoding_len + 1);
+      if (!accept_encoding)
+	panic ("%s: malloc() failed: %s\n", prog_name, strerror (errno));
+      sprintf (accept_encoding, "Accept-Encoding: %s\r\n",
+	       param.encoding.accept);
+    }
+
   arg.l = 0;
   event_register_handler (EV_CALL_NEW, call_created, arg);
 }
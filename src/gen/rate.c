@@ -33,9 +33,11 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <generic_types.h>
 #include <object.h>
@@ -46,6 +48,17 @@
 
 int current_rate = 0;
 Time duration_in_current_rate = 0;
+Time rate_intended_time;
+Time (*rate_trace_next_iat) (void);
+
+static Rate_Generator *generators;	/* all that were started */
+static int paused;
+
+/* The arrival times read from the file given with --period=t; client I
+   of N keeps every Nth of them, starting with the Ith.  */
+static Time *trace_time;
+static u_long trace_len;
+static u_long trace_next;
 
 /* By pushing the random number generator state into the caller via
    the xsubi array below, we gain some test repeatability.  For
@@ -98,6 +111,90 @@ next_arrival_time_variable (Rate_Generator *rg)
   return (next);
 }
 
+static Time
+next_arrival_time_trace (Rate_Generator *rg)
+{
+  return (*rate_trace_next_iat) ();
+}
+
+static Time
+next_trace_file_arrival (void)
+{
+  Time delay;
+
+  if (trace_next + 1 >= trace_len)
+    {
+      /* start over, as if the trace went on at its average rate: */
+      trace_next = 0;
+      return param.rate.mean_iat;
+    }
+  delay = trace_time[trace_next + 1] - trace_time[trace_next];
+  ++trace_next;
+  return delay;
+}
+
+/* Reads this client's arrival times from RATE->trace_file.  The
+   first one determines when this client starts.  */
+static void
+trace_load (Rate_Info *rate)
+{
+  u_long n = 0, max = 0;
+  Time t, first = 0.0, last = 0.0;
+  char line[256], *end;
+  FILE *fp;
+
+  fp = fopen (rate->trace_file, "r");
+  if (!fp)
+    {
+      fprintf (stderr, "%s: can't open %s: %s\n",
+	       prog_name, rate->trace_file, strerror (errno));
+      exit (1);
+    }
+  while (fgets (line, sizeof (line), fp))
+    {
+      if (line[0] == '#' || line[strspn (line, " \t\r\n")] == '\0')
+	continue;
+      t = strtod (line, &end);
+      if (end == line || (n > 0 && t < last))
+	{
+	  fprintf (stderr, "%s: bad or out of order arrival time `%s' in "
+		   "%s\n", prog_name, line, rate->trace_file);
+	  exit (1);
+	}
+      if (n++ == 0)
+	first = t;
+      last = t;
+      if ((n - 1) % param.client.num_clients != param.client.id)
+	continue;
+      if (trace_len >= max)
+	{
+	  max = max ? 2 * max : 4096;
+	  trace_time = realloc (trace_time, max * sizeof (*trace_time));
+	  if (!trace_time)
+	    {
+	      fprintf (stderr, "%s.rate: out of memory\n", prog_name);
+	      exit (1);
+	    }
+	}
+      trace_time[trace_len++] = t;
+    }
+  fclose (fp);
+  if (trace_len == 0)
+    {
+      fprintf (stderr, "%s: %s has fewer arrival times than there are "
+	       "clients\n", prog_name, rate->trace_file);
+      exit (1);
+    }
+
+  rate->mean_iat = 1.0;
+  if (trace_len > 1 && trace_time[trace_len - 1] > trace_time[0])
+    rate->mean_iat = ((trace_time[trace_len - 1] - trace_time[0])
+		      / (trace_len - 1));
+  rate->rate_param = 1.0 / rate->mean_iat;
+  rate->phase = trace_time[0] - first;
+  rate_trace_next_iat = next_trace_file_arrival;
+}
+
 static void
 tick (struct Timer *t, Any_Type arg)
 {
@@ -113,12 +210,15 @@ tick (struct Timer *t, Any_Type arg)
       delay = (*rg->next_interarrival_time) (rg);
       if (verbose > 2)
 	fprintf (stderr, "next arrival delay = %.4f\n", delay);
+      rate_intended_time = rg->next_time;
       rg->next_time += delay;
       rg->done = ((*rg->tick) (rg->arg) < 0);
+      rate_intended_time = 0;
       if (rg->done)
 	return;
     }
-  rg->timer = timer_schedule ((Timer_Callback) tick, arg, rg->next_time - now);
+  rg->timer = timer_schedule_precise ((Timer_Callback) tick, arg,
+				      rg->next_time - now);
 }
 
 static void
@@ -128,7 +228,14 @@ done (Event_Type type, Object *obj, Any_Type reg_arg, Any_Type call_arg)
 
   if (rg->done)
     return;
+  if (paused)
+    {
+      rg->stalled = 1;
+      return;
+    }
+  rate_intended_time = timer_now ();
   rg->done = ((*rg->tick) (rg->arg) < 0);
+  rate_intended_time = 0;
 }
 
 void
@@ -148,6 +255,9 @@ rate_generator_start (Rate_Generator *rg, Event_Type completion_event)
   rg->xsubi[1] = 0x5678 ^ (param.client.id << 8);
   rg->xsubi[2] = 0x9abc ^ ~param.client.id;
 
+  rg->next = generators;
+  generators = rg;
+
   arg.vp = rg;
   if (rg->rate->rate_param > 0.0)
     {
@@ -157,24 +267,41 @@ rate_generator_start (Rate_Generator *rg, Event_Type completion_event)
 	case UNIFORM:	    func = next_arrival_time_uniform; break;
 	case EXPONENTIAL:   func = next_arrival_time_exp; break;
 	case VARIABLE:      func = next_arrival_time_variable; break;
+	case TRACE:
+	  if (!rate_trace_next_iat)
+	    trace_load (rg->rate);
+	  func = next_arrival_time_trace;
+	  break;
 	default:
 	  fprintf (stderr, "%s: unrecognized interarrival distribution %d\n",
 		   prog_name, rg->rate->dist);
 	  exit (-1);
 	}
       rg->next_interarrival_time = func;
+      if (rg->rate->phase > 0.0)
+	{
+	  /* hold off the first arrival; tick () takes it from there: */
+	  rg->next_time = timer_now () + rg->rate->phase;
+	  rg->timer = timer_schedule_precise ((Timer_Callback) tick, arg,
+					      rg->rate->phase);
+	  rg->start = timer_now ();
+	  return;
+	}
       delay = (*func) (rg);
       /* bias `next time' so that timeouts are rounded to the closest
          tick: */
       rg->next_time = timer_now () + delay;
-      rg->timer = timer_schedule ((Timer_Callback) tick, arg, delay);
+      rg->timer = timer_schedule_precise ((Timer_Callback) tick, arg,
+					  delay);
     }
   else
     /* generate callbacks sequentially: */
     event_register_handler (completion_event, done, arg);
 
   rg->start = timer_now ();
+  rate_intended_time = rg->start;
   rg->done = ((*rg->tick) (rg->arg) < 0);
+  rate_intended_time = 0;
 }
 
 void
@@ -187,3 +314,74 @@ rate_generator_stop (Rate_Generator *rg)
     }
   rg->done = 1;
 }
+
+void
+rate_set (Rate_Info *rate, double r)
+{
+  double scale = rate->rate_param / r;
+  Rate_Generator *rg;
+  Time now = timer_now ();
+  Any_Type arg;
+
+  if (rate->dist == UNIFORM)
+    {
+      rate->min_iat *= scale;
+      rate->max_iat *= scale;
+    }
+  rate->rate_param = r;
+  rate->mean_iat = 1.0 / r;
+
+  for (rg = generators; rg; rg = rg->next)
+    {
+      if (rg->rate != rate || !rg->timer)
+	continue;
+      /* A generator that fell behind would fire its whole backlog at
+	 the new rate; the new rate applies from now instead.  */
+      if (rg->next_time < now)
+	rg->next_time = now;
+      else if (rg->next_time > now + rate->mean_iat)
+	rg->next_time = now + rate->mean_iat;
+      else
+	continue;
+      timer_cancel (rg->timer);
+      arg.vp = rg;
+      rg->timer = timer_schedule_precise ((Timer_Callback) tick, arg,
+					  rg->next_time - now);
+    }
+}
+
+void
+rate_generators_pause (int pause)
+{
+  Rate_Generator *rg;
+  Any_Type arg;
+
+  if (!pause == !paused)
+    return;
+  paused = pause;
+  for (rg = generators; rg; rg = rg->next)
+    {
+      if (rg->done)
+	continue;
+      arg.vp = rg;
+      if (pause)
+	{
+	  if (rg->timer)
+	    {
+	      timer_cancel (rg->timer);
+	      rg->timer = 0;
+	    }
+	}
+      else if (rg->next_interarrival_time)
+	{
+	  /* start over from now, one arrival at a time: */
+	  rg->next_time = timer_now ();
+	  rg->timer = timer_schedule_precise ((Timer_Callback) tick, arg, 0);
+	}
+      else if (rg->stalled)
+	{
+	  rg->stalled = 0;
+	  done (0, 0, arg, arg);
+	}
+    }
+}
@@ -47,12 +47,37 @@ typedef struct Rate_Generator
     struct Timer *timer;
     int (*tick) (Any_Type arg);
     int done;
+    int stalled;		/* skipped an arrival while paused */
     Time (*next_interarrival_time) (struct Rate_Generator *rg);
+    struct Rate_Generator *next;	/* in the list of all generators */
   }
 Rate_Generator;
 
+/* While a rate generator's tick function runs, this is the time at
+   which the arrival it generates was due.  When the generator falls
+   behind (e.g., because httperf could not keep up), this is earlier
+   than timer_now ().  Outside of tick functions, it is 0.  */
+extern Time rate_intended_time;
+
+/* With the TRACE distribution, the interarrival times come from this
+   function (see uri_wlog.c).  */
+extern Time (*rate_trace_next_iat) (void);
+
 extern void rate_generator_start (Rate_Generator *rg,
 				  Event_Type completion_event);
 extern void rate_generator_stop (Rate_Generator *rg);
 
+/* Change RATE to R arrivals per second in place (R > 0; for the
+   deterministic, uniform and exponential distributions only).  The
+   generators using RATE go on at the new rate from their next arrival,
+   which is moved up if it was due later than one new interarrival time
+   from now.  Arrivals a generator fell behind on are dropped, not fired
+   at the new rate.  */
+extern void rate_set (Rate_Info *rate, double r);
+
+/* Hold off all rate generators (if PAUSE is non-zero) or let them go
+   on where they left off.  Arrivals that fall into a pause are
+   skipped, not made up for.  */
+extern void rate_generators_pause (int pause);
+
 #endif /* rate_h */
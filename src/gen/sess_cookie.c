@@ -34,9 +34,18 @@
 /* This module intercepts `Set-Cookie:' headers on a per-session basis
    and includes set cookies in future calls of the session.
 
+   Each session has a cookie jar of up to MAX_COOKIES cookies whose
+   data is kept in a fixed-size arena in the session's private data,
+   so no memory is allocated while the test runs.  A cookie is sent
+   on calls whose host and path match its domain and path (RFC 6265),
+   until its Max-Age runs out.  The `Cookie:' header of a call is
+   assembled in a buffer that the call holds until it is destroyed,
+   from where it goes into the request's iovec as is.  The buffers are
+   recycled, so only the calls that carry cookies cost one.
+
    Missing features:
-	- intercepted cookies are always sent, independent of any constraints
-	   that may be present in the set-cookie header
+	- the Expires attribute is ignored (cookies without Max-Age
+	   last as long as the session)
 */
 
 #include "config.h"
@@ -59,7 +68,10 @@
 #include <localevent.h>
 #include <session.h>
 
-#define MAX_COOKIE_LEN	256
+#define COOKIE_JAR_SIZE	4096	/* bytes of cookie data per session */
+#define MAX_COOKIES	32	/* max # of cookies per session */
+/* "Cookie: " name=value pairs separated by "; " and CRLF: */
+#define COOKIE_HDR_SIZE	(COOKIE_JAR_SIZE + 2 * MAX_COOKIES + 10)
 
 #define SESS_PRIVATE_DATA(c) \
   ((Sess_Private_Data *) ((char *)(c) + sess_private_data_offset))
@@ -67,18 +79,27 @@
 #define CALL_PRIVATE_DATA(c) \
   ((Call_Private_Data *) ((char *)(c) + call_private_data_offset))
 
+typedef struct Cookie
+  {
+    Time expires;		/* when the cookie expires (0 = never) */
+    u_short off;		/* where name=value, domain and path are */
+    u_short nv_len;		/* length of name=value */
+    u_short name_len;		/* length of the name part */
+    u_short domain_len;
+    u_short path_len;
+    u_char host_only;		/* no Domain attribute? */
+    u_char secure;		/* only send over SSL? */
+  }
+Cookie;
+
 typedef struct Sess_Private_Data
   {
-    /* For now, we support just one cookie per session.  If we get
-       more than one cookie, we'll print a warning message when
-       --debug is turned on.  */
-    size_t cookie_len;
-    /* We can't malloc the cookie string because we may get a
-       ``Set-Cookie:'' while there are calls pending that refer to an
-       existing cookie.  So if we were to malloc & free cookies, we
-       would have to use reference counting to avoid the risk of
-       dangling pointers.  */
-    char cookie[MAX_COOKIE_LEN];
+    u_int num_cookies;
+    u_int arena_len;		/* # of bytes of ARENA in use */
+    /* Sorted by decreasing path length, which is the order cookies
+       go into the `Cookie:' header in.  */
+    Cookie cookie[MAX_COOKIES];
+    char arena[COOKIE_JAR_SIZE];
   }
 Sess_Private_Data;
 
@@ -86,27 +107,127 @@ Sess_Private_Data;
    only once.  EV_CALL_ISSUE gets signalled each time a call is sent
    on a connection.  Since a connection may fail, the same call may be
    issued multiple times, hence we need to make sure that the cookie
-   gets set only once per call.  */
+   gets set only once per call.  The header can't point into the jar
+   because a ``Set-Cookie:'' may change the jar while the call is
+   pending.  */
 typedef struct Call_Private_Data
   {
     u_int cookie_present;	/* non-zero if cookie has been set already */
-    char cookie[MAX_COOKIE_LEN];
+    char *hdr;			/* leased header buffer (or 0) */
   }
 Call_Private_Data;
 
 static size_t sess_private_data_offset = -1;
 static size_t call_private_data_offset = -1;
 
-/* A simple module that collects cookies from the server responses and
-   includes them in future calls to the server.  */
+/* Header buffers of COOKIE_HDR_SIZE bytes that no call holds, linked
+   through their first bytes.  */
+static char *free_hdrs;
+
+static char *
+hdr_lease (void)
+{
+  char *buf = free_hdrs;
+
+  if (!buf)
+    return malloc (COOKIE_HDR_SIZE);
+  free_hdrs = *(char **) buf;
+  return buf;
+}
+
+static void
+hdr_release (char *buf)
+{
+  *(char **) buf = free_hdrs;
+  free_hdrs = buf;
+}
+
+#define COOKIE_NAME(p,c)	((p)->arena + (c)->off)
+#define COOKIE_DOMAIN(p,c)	(COOKIE_NAME (p, c) + (c)->nv_len)
+#define COOKIE_PATH(p,c)	(COOKIE_DOMAIN (p, c) + (c)->domain_len)
+#define COOKIE_SIZE(c)		((c)->nv_len + (c)->domain_len + (c)->path_len)
+
+static void
+jar_remove (Sess_Private_Data *priv, u_int i)
+{
+  Cookie *c = priv->cookie + i;
+  u_int j, off = c->off, len = COOKIE_SIZE (c);
+
+  memmove (priv->arena + off, priv->arena + off + len,
+	   priv->arena_len - off - len);
+  priv->arena_len -= len;
+
+  memmove (c, c + 1, (priv->num_cookies - i - 1) * sizeof (*c));
+  --priv->num_cookies;
+
+  for (j = 0; j < priv->num_cookies; ++j)
+    if (priv->cookie[j].off > off)
+      priv->cookie[j].off -= len;
+}
+
+static void
+jar_expire (Sess_Private_Data *priv, Time now)
+{
+  u_int i = 0;
+
+  while (i < priv->num_cookies)
+    if (priv->cookie[i].expires > 0 && priv->cookie[i].expires <= now)
+      jar_remove (priv, i);
+    else
+      ++i;
+}
+
+/* Returns non-zero if HOST domain-matches the cookie domain DOMAIN.  */
+static int
+domain_match (const char *host, size_t host_len,
+	      const char *domain, size_t domain_len, int host_only)
+{
+  if (host_len == domain_len)
+    return strncasecmp (host, domain, domain_len) == 0;
+  return (!host_only && host_len > domain_len
+	  && host[host_len - domain_len - 1] == '.'
+	  && strncasecmp (host + host_len - domain_len, domain,
+			  domain_len) == 0);
+}
+
+/* Returns non-zero if request path PATH path-matches cookie path
+   CPATH.  */
+static int
+path_match (const char *path, size_t path_len,
+	    const char *cpath, size_t cpath_len)
+{
+  if (path_len < cpath_len || memcmp (path, cpath, cpath_len) != 0)
+    return 0;
+  return (path_len == cpath_len || cpath[cpath_len - 1] == '/'
+	  || path[cpath_len] == '/');
+}
+
+static size_t
+uri_path_len (const char *uri, size_t uri_len)
+{
+  const char *q = memchr (uri, '?', uri_len);
+
+  return q ? (size_t) (q - uri) : uri_len;
+}
+
+#ifdef HAVE_SSL
+# define USE_SSL	param.use_ssl
+#else
+# define USE_SSL	0
+#endif
 
 static void
 call_issue (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
 {
   Call_Private_Data *cpriv;
   Sess_Private_Data *priv;
+  const char *path;
+  size_t len, path_len;
+  Cookie *c;
   Sess *sess;
   Call *call;
+  Conn *conn;
+  u_int i;
 
   assert (et == EV_CALL_ISSUE && object_is_call (obj));
   call = (Call *) obj;
@@ -118,62 +239,306 @@ call_issue (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
 
   sess = session_get_sess_from_call (call);
   priv = SESS_PRIVATE_DATA (sess);
+  if (priv->num_cookies == 0)
+    return;
+  jar_expire (priv, timer_now ());
+
+  conn = call->conn;
+  path = call->req.iov[IE_URI].iov_base;
+  path_len = uri_path_len (path, call->req.iov[IE_URI].iov_len);
 
-  if (priv->cookie_len > 0)
+  if (!cpriv->hdr && !(cpriv->hdr = hdr_lease ()))
+    return;
+  memcpy (cpriv->hdr, "Cookie: ", 8);
+  len = 8;
+  for (i = 0; i < priv->num_cookies; ++i)
     {
-      if (DBG > 1)
-	fprintf (stderr, "call_issue.%ld: inserting `%s'\n",
-		 call->id, priv->cookie);
-      cpriv->cookie_present = 1;
-      memcpy (cpriv->cookie, priv->cookie, priv->cookie_len + 1);
-      call_append_request_header (call, cpriv->cookie, priv->cookie_len);
+      c = priv->cookie + i;
+      if ((c->secure && !USE_SSL)
+	  || !domain_match (conn->fqdname, conn->fqdname_len,
+			    COOKIE_DOMAIN (priv, c), c->domain_len,
+			    c->host_only)
+	  || !path_match (path, path_len, COOKIE_PATH (priv, c), c->path_len))
+	continue;
+      if (len > 8)
+	{
+	  memcpy (cpriv->hdr + len, "; ", 2);
+	  len += 2;
+	}
+      memcpy (cpriv->hdr + len, COOKIE_NAME (priv, c), c->nv_len);
+      len += c->nv_len;
     }
+  if (len == 8)
+    {
+      hdr_release (cpriv->hdr);
+      cpriv->hdr = 0;
+      return;
+    }
+  memcpy (cpriv->hdr + len, "\r\n", 2);
+  len += 2;
+
+  if (DBG > 1)
+    fprintf (stderr, "call_issue.%ld: inserting `%.*s'\n",
+	     call->id, (int) len - 2, cpriv->hdr);
+  cpriv->cookie_present = 1;
+  call_append_request_header (call, cpriv->hdr, len);
+}
+
+static void
+call_destroyed (Event_Type et, Object *obj, Any_Type regarg,
+		Any_Type callarg)
+{
+  Call_Private_Data *cpriv;
+
+  assert (et == EV_CALL_DESTROYED && object_is_call (obj));
+  cpriv = CALL_PRIVATE_DATA ((Call *) obj);
+  if (cpriv->hdr)
+    hdr_release (cpriv->hdr);
+}
+
+/* Parses the value of a Max-Age attribute, VAL up to END, into *AGE.
+   Returns 0 if it isn't an optional minus sign followed by digits, in
+   which case the attribute is to be ignored (RFC 6265, 5.2.2).  */
+static int
+parse_max_age (const char *val, const char *end, long *age)
+{
+  const char *cp = val;
+  int neg = 0;
+
+  if (cp < end && *cp == '-')
+    {
+      neg = 1;
+      ++cp;
+    }
+  if (cp == end)
+    return 0;
+  for (*age = 0; cp < end; ++cp)
+    {
+      if (!isdigit ((u_char) *cp))
+	return 0;
+      if (*age < 1000000000L)
+	*age = 10 * *age + (*cp - '0');
+    }
+  if (neg)
+    *age = -*age;
+  return 1;
+}
+
+/* Stores cookie NEW, whose name=value is NV, in the jar, replacing the
+   one with the same name, domain and path.  If DELETED is non-zero
+   (the cookie came with a Max-Age of zero or less), that one is only
+   removed.  */
+static void
+jar_set (Sess_Private_Data *priv, Cookie *new, const char *nv,
+	 const char *domain, const char *path, int deleted)
+{
+  static int warned;
+  Cookie *c;
+  u_int i;
+
+  for (i = 0; i < priv->num_cookies; ++i)
+    {
+      c = priv->cookie + i;
+      if (c->name_len == new->name_len
+	  && memcmp (COOKIE_NAME (priv, c), nv, c->name_len) == 0
+	  && c->domain_len == new->domain_len
+	  && strncasecmp (COOKIE_DOMAIN (priv, c), domain,
+			  c->domain_len) == 0
+	  && c->path_len == new->path_len
+	  && memcmp (COOKIE_PATH (priv, c), path, c->path_len) == 0)
+	{
+	  jar_remove (priv, i);
+	  break;
+	}
+    }
+  if (deleted)
+    return;
+
+  if (priv->num_cookies >= MAX_COOKIES
+      || priv->arena_len + COOKIE_SIZE (new) > COOKIE_JAR_SIZE)
+    {
+      jar_expire (priv, timer_now ());
+      if (priv->num_cookies >= MAX_COOKIES
+	  || priv->arena_len + COOKIE_SIZE (new) > COOKIE_JAR_SIZE)
+	{
+	  if (!warned)
+	    fprintf (stderr, "%s.sess_cookie: cookie jar full (%u cookies, "
+		     "%u bytes), dropping cookies\n", prog_name,
+		     MAX_COOKIES, COOKIE_JAR_SIZE);
+	  warned = 1;
+	  return;
+	}
+    }
+
+  new->off = priv->arena_len;
+  memcpy (priv->arena + priv->arena_len, nv, new->nv_len);
+  priv->arena_len += new->nv_len;
+  memcpy (priv->arena + priv->arena_len, domain, new->domain_len);
+  priv->arena_len += new->domain_len;
+  memcpy (priv->arena + priv->arena_len, path, new->path_len);
+  priv->arena_len += new->path_len;
+
+  /* longer paths first; otherwise, older cookies first */
+  for (i = priv->num_cookies; i > 0; --i)
+    if (priv->cookie[i - 1].path_len >= new->path_len)
+      break;
+  memmove (priv->cookie + i + 1, priv->cookie + i,
+	   (priv->num_cookies - i) * sizeof (priv->cookie[0]));
+  priv->cookie[i] = *new;
+  ++priv->num_cookies;
+}
+
+static const char *
+skip_space (const char *cp, const char *end)
+{
+  while (cp < end && isspace ((u_char) *cp))
+    ++cp;
+  return cp;
+}
+
+static const char *
+trim_space (const char *start, const char *cp)
+{
+  while (cp > start && isspace ((u_char) cp[-1]))
+    --cp;
+  return cp;
 }
 
 static void
 call_recv_hdr (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
 {
-  char *hdr, *start, *end;
+  const char *hdr, *start, *end, *nv_end, *eq, *attr, *attr_end, *val;
+  const char *domain, *path, *uri;
+  size_t nv_len, domain_len, path_len, uri_len;
   Sess_Private_Data *priv;
-  size_t len;
   struct iovec *line;
+  int deleted = 0;
+  Cookie new;
   Sess *sess;
   Call *call;
+  Conn *conn;
+  long age;
 
   assert (et == EV_CALL_RECV_HDR && object_is_call (obj));
   call = (Call *) obj;
-  sess = session_get_sess_from_call (call);
-  priv = SESS_PRIVATE_DATA (sess);
 
   line = callarg.vp;
   hdr = line->iov_base;
-  if (tolower (hdr[0]) == 's' && line->iov_len > 12
-      && strncasecmp (hdr + 1, "et-cookie: ", 11) == 0)
+  if (!(tolower (hdr[0]) == 's' && line->iov_len > 12
+	&& strncasecmp (hdr + 1, "et-cookie: ", 11) == 0))
+    return;
+
+  /* munch time! */
+  sess = session_get_sess_from_call (call);
+  priv = SESS_PRIVATE_DATA (sess);
+  conn = call->conn;
+
+  end = hdr + line->iov_len;
+  start = skip_space (hdr + 12, end);
+  nv_end = memchr (start, ';', end - start);
+  if (!nv_end)
+    nv_end = end;
+  nv_end = trim_space (start, nv_end);
+  eq = memchr (start, '=', nv_end - start);
+  if (!eq || eq == start)
+    return;		/* not a cookie */
+
+  memset (&new, 0, sizeof (new));
+  nv_len = nv_end - start;
+  new.name_len = trim_space (start, eq) - start;
+  new.host_only = 1;
+  domain = conn->fqdname;
+  domain_len = conn->fqdname_len;
+  path = 0;
+  path_len = 0;
+
+  for (attr = nv_end; attr < end; attr = attr_end)
     {
-      /* munch time! */
-      start = hdr + 12;
-      end = strchr (start, ';');
-      if (!end)
-	end = hdr + line->iov_len;
-      len = end - start;
-      if (DBG > 0 && priv->cookie_len > 0)
-	fprintf (stderr, "%s: can't handle more than one "
-		 "cookie at a time, replacing existing one\n", prog_name);
-      if (len + 10 >= MAX_COOKIE_LEN)
+      attr = skip_space (attr + 1, end);
+      attr_end = memchr (attr, ';', end - attr);
+      if (!attr_end)
+	attr_end = end;
+      eq = memchr (attr, '=', attr_end - attr);
+      val = eq ? skip_space (eq + 1, attr_end) : attr_end;
+      if (!eq)
+	eq = attr_end;
+      eq = trim_space (attr, eq);
+
+      if (eq - attr == 4 && strncasecmp (attr, "path", 4) == 0)
+	{
+	  if (val < attr_end && *val == '/')
+	    {
+	      path = val;
+	      path_len = trim_space (val, attr_end) - val;
+	    }
+	}
+      else if (eq - attr == 6 && strncasecmp (attr, "domain", 6) == 0)
+	{
+	  if (val < attr_end && *val == '.')
+	    ++val;
+	  if (trim_space (val, attr_end) > val)
+	    {
+	      domain = val;
+	      domain_len = trim_space (val, attr_end) - val;
+	      new.host_only = 0;
+	    }
+	}
+      else if (eq - attr == 7 && strncasecmp (attr, "max-age", 7) == 0)
 	{
-	  fprintf (stderr, "%s.sess_cookie: truncating cookie to %d bytes\n",
-		   prog_name, MAX_COOKIE_LEN - 11);
-	  len = MAX_COOKIE_LEN - 11;
+	  if (!parse_max_age (val, trim_space (val, attr_end), &age))
+	    continue;
+	  deleted = age <= 0;
+	  new.expires = deleted ? 0 : timer_now () + age;
 	}
-      memcpy (priv->cookie, "Cookie: ", 8);
-      memcpy (priv->cookie + 8, start, len);
-      memcpy (priv->cookie + 8 + len, "\r\n", 2);
-      priv->cookie[10 + len] = '\0';
-      priv->cookie_len = len + 10;
+      else if (eq - attr == 6 && strncasecmp (attr, "secure", 6) == 0)
+	new.secure = 1;
+    }
 
+  if (!new.host_only
+      && !domain_match (conn->fqdname, conn->fqdname_len,
+			domain, domain_len, 0))
+    {
       if (DBG > 0)
-	fprintf (stderr, "%s: got cookie `%s'\n", prog_name, start);
+	fprintf (stderr, "%s: ignoring cookie for domain `%.*s'\n",
+		 prog_name, (int) domain_len, domain);
+      return;
     }
+
+  if (!path)
+    {
+      /* the default path is the directory of the request URI */
+      uri = call->req.iov[IE_URI].iov_base;
+      uri_len = uri_path_len (uri, call->req.iov[IE_URI].iov_len);
+      path = uri;
+      path_len = 1;
+      if (uri_len > 0 && uri[0] == '/')
+	{
+	  for (path_len = uri_len; path_len > 1; --path_len)
+	    if (uri[path_len - 1] == '/')
+	      break;
+	  if (path_len > 1)
+	    --path_len;	/* without the trailing slash */
+	}
+      else
+	path = "/";
+    }
+
+  if (nv_len + domain_len + path_len > COOKIE_JAR_SIZE)
+    {
+      fprintf (stderr, "%s.sess_cookie: ignoring cookie longer than %d "
+	       "bytes\n", prog_name, COOKIE_JAR_SIZE);
+      return;
+    }
+  new.nv_len = nv_len;
+  new.domain_len = domain_len;
+  new.path_len = path_len;
+
+  if (DBG > 0)
+    fprintf (stderr, "%s: got cookie `%.*s' (domain `%.*s', path `%.*s')\n",
+	     prog_name, (int) new.nv_len, start, (int) domain_len, domain,
+	     (int) path_len, path);
+
+  jar_set (priv, &new, start, domain, path, deleted);
 }
 
 static void
@@ -188,6 +553,7 @@ init (void)
   arg.l = 0;
   event_register_handler (EV_CALL_ISSUE, call_issue, arg);
   event_register_handler (EV_CALL_RECV_HDR, call_recv_hdr, arg);
+  event_register_handler (EV_CALL_DESTROYED, call_destroyed, arg);
 }
 
 Load_Generator sess_cookie =
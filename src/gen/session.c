@@ -77,7 +77,8 @@
 #include <sess.h>
 #include <session.h>
 
-#define MAX_CONN		 4	/* max # of connections per session */
+#define MAX_CONN		 8	/* max # of connections per session */
+#define DEFAULT_CONN		 4	/* default # of connections per session */
 #define MAX_PIPED		32	/* max # of calls that can be piped */
 
 #define SESS_PRIVATE_DATA(c)						\
@@ -125,6 +126,7 @@ static size_t sess_private_data_offset = -1;
 static size_t conn_private_data_offset = -1;
 static size_t call_private_data_offset = -1;
 static size_t max_qlen;
+static Conn *connecting;	/* connection being set up by create_conn() */
 
 static void
 create_conn (Sess *sess, struct Conn_Info *ci)
@@ -159,8 +161,10 @@ create_conn (Sess *sess, struct Conn_Info *ci)
     }
 #endif
 
+  connecting = ci->conn;
   if (core_connect (ci->conn) < 0)
     sess_failure (sess);
+  connecting = 0;
 }
 
 static void
@@ -206,7 +210,14 @@ sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
       ci = priv->conn_info + i;
 
       if (ci->conn)
-	core_close (ci->conn);
+	{
+	  /* a connection that is done with its calls may be reused by
+	     another session */
+	  if (ci->num_pending == 0)
+	    core_release (ci->conn);
+	  else
+	    core_close (ci->conn);
+	}
 
       rd = ci->rd;
       for (j = 0; j < ci->num_pending; ++j)
@@ -261,7 +272,14 @@ conn_failed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
   sess = cpriv->sess;
   ci = cpriv->ci;
 
-  if (ci->is_successful || param.retry_on_failure)
+  /* A connection that failed on the spot (refused by a Unix domain
+     socket, or no file descriptor to be had) isn't tried again: that
+     would only recurse.  A connection taken from the idle pool may
+     have been closed by the server just as we started using it, which
+     is no fault of this session.  */
+  if (conn == connecting)
+    sess_failure (sess);
+  else if (ci->is_successful || conn->reused || param.retry_on_failure)
     /* try to create a new connection so we can issue the remaining
        calls. */
     create_conn (sess, ci);
@@ -339,7 +357,7 @@ session_init (void)
   Any_Type arg;
 
   if (!param.max_conns)
-    param.max_conns = MAX_CONN;
+    param.max_conns = DEFAULT_CONN;
 
   if (!param.max_piped)
     {
@@ -403,36 +421,80 @@ session_current_qlen (Sess *sess)
   return num_pending;
 }
 
+static void
+queue_call (Sess *sess, struct Conn_Info *ci, Call *call)
+{
+  Call_Private_Data *cpriv;
+
+  cpriv = CALL_PRIVATE_DATA (call);
+  cpriv->sess = sess;
+
+  ++ci->num_pending;
+  ci->call[ci->wr] = call;
+  call_inc_ref (call);
+  ci->wr = (ci->wr + 1) % MAX_PIPED;
+  send_calls (sess, ci);
+}
+
+static void
+too_many_calls (void)
+{
+  fprintf (stderr, "%s.session_issue_call: too many calls pending!\n"
+	   "\tIncrease --max-connections and/or --max-piped-calls.\n",
+	   prog_name);
+  exit (1);
+}
+
 int
 session_issue_call (Sess *sess, Call *call)
 {
-  Call_Private_Data *cpriv;
   Sess_Private_Data *priv;
   struct Conn_Info *ci;
   int i;
 
   priv = SESS_PRIVATE_DATA (sess);
 
-  cpriv = CALL_PRIVATE_DATA (call);
-  cpriv->sess = sess;
-
   for (i = 0; i < param.max_conns; ++i)
     {
       ci = priv->conn_info + i;
       if (ci->num_pending < param.max_piped)
 	{
-	  ++ci->num_pending;
-	  ci->call[ci->wr] = call;
-	  call_inc_ref (call);
-	  ci->wr = (ci->wr + 1) % MAX_PIPED;
-	  send_calls (sess, ci);
+	  queue_call (sess, ci, call);
 	  return 0;
 	}
     }
-  fprintf (stderr, "%s.session_issue_call: too many calls pending!\n"
-	   "\tIncrease --max-connections and/or --max-piped-calls.\n",
-	   prog_name);
-  exit (1);
+  too_many_calls ();
+  return -1;
+}
+
+int
+session_issue_call_parallel (Sess *sess, Call *call)
+{
+  Sess_Private_Data *priv;
+  struct Conn_Info *ci, *best = 0;
+  u_int rank, best_rank = 0;
+  int i;
+
+  priv = SESS_PRIVATE_DATA (sess);
+
+  /* An idle connection is best, then a new one, then the connection
+     with the fewest calls to pipeline behind.  */
+  for (i = 0; i < param.max_conns; ++i)
+    {
+      ci = priv->conn_info + i;
+      if (ci->num_pending >= param.max_piped)
+	continue;
+      rank = 2 * ci->num_pending + (ci->conn ? 0 : 1);
+      if (!best || rank < best_rank)
+	{
+	  best = ci;
+	  best_rank = rank;
+	}
+    }
+  if (!best)
+    too_many_calls ();
+  queue_call (sess, best, call);
+  return 0;
 }
 
 Sess *
@@ -48,6 +48,12 @@ extern size_t session_current_qlen (Sess *sess);
    of failure.  */
 extern int session_issue_call (Sess *sess, Call *call);
 
+/* Like session_issue_call(), but spreads calls over the session's
+   connections the way browsers do: CALL goes to an idle connection if
+   there is one, else to a new connection (while there are fewer than
+   --max-connections), else it is pipelined behind the fewest calls.  */
+extern int session_issue_call_parallel (Sess *sess, Call *call);
+
 /* Given a connection object, find the session object that the
    connection belongs to.  */
 extern Sess *session_get_sess_from_conn (Conn *conn);
@@ -47,12 +47,14 @@
 #include <localevent.h>
 
 static size_t uri_len;
+static u_int uri_key;
 
 static void
 set_uri (Event_Type et, Call *call)
 {
   assert (et == EV_CALL_NEW && object_is_call (call));
   call_set_uri (call, param.uri, uri_len);
+  call->uri_key = uri_key;
 }
 
 static void
@@ -61,6 +63,7 @@ init (void)
   Any_Type arg;
 
   uri_len = strlen (param.uri);
+  uri_key = uri_stat_key (param.uri, uri_len);
 
   arg.l = 0;
   event_register_handler (EV_CALL_NEW, (Event_Handler) set_uri, arg);
@@ -61,6 +61,25 @@
        % httperf .... --wlog y,my_uri_file
 
    Otherwise httperf will stop once it reaches the end of the list.
+
+   For replaying complete requests, --wlog-compile translates a file of
+   HTTP request messages into a trace that this module maps as well.
+   A trace has a header (Wlog_Header), an index with one record per
+   request (Wlog_Record), and the requests' data.  The index allows
+   each client (see --client) to replay every Nth request of the trace
+   and to pick requests at random, without reading the rest of the
+   trace.  The input is a sequence of requests, each optionally
+   preceded by a line with an `@' and its arrival time in seconds:
+
+	@1187205795.010
+	POST /api/items HTTP/1.1
+	Host: www.example.com
+	Content-Length: 13
+
+	{"name":"x"}
+
+   Host: headers are left out of the trace, as httperf sends its own.
+   The trace is in host byte order.
  
    Any comment on this module contact eranian@hpl.hp.com or
    davidm@hpl.hp.com.  */
@@ -68,10 +87,13 @@
 #include "config.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -85,9 +107,51 @@
 #include <conn.h>
 #include <core.h>
 #include <localevent.h>
+#include <rate.h>
+#include <uri_wlog.h>
+
+#define WLOG_MAGIC	"httperfR"
+#define WLOG_VERSION	1
+#define WLOG_BYTE_ORDER	0x01020304
+
+#define WLOG_TIMED	0x1	/* the records have arrival times */
+
+typedef struct Wlog_Header
+  {
+    char magic[8];		/* WLOG_MAGIC */
+    u_int version;		/* WLOG_VERSION */
+    u_int byte_order;		/* WLOG_BYTE_ORDER */
+    u_int flags;
+    u_int pad;
+    u_wide num_records;
+    u_wide size;		/* of the whole file */
+  }
+Wlog_Header;
+
+/* The index (an array of these) follows the header.  A request's data is
+   its method, a '\0', its URI, a '\0', its header lines (each ending in
+   CRLF) and its body.  */
+typedef struct Wlog_Record
+  {
+    u_wide data;		/* file offset of the request's data */
+    u_int method_len;
+    u_int uri_len;
+    u_int headers_len;
+    u_int body_len;
+    double time;		/* arrival time since the first request */
+  }
+Wlog_Record;
 
 static char *fbase, *fend, *fcurrent;
 
+/* The trace, if the file is one: */
+static const Wlog_Record *records;
+static u_wide num_records;
+static u_wide num_shard_records;	/* # of records for this client */
+static u_wide next_record;		/* the next one to send */
+static u_wide next_arrival;		/* the next one to arrive */
+static u_short xsubi[3];		/* for --wlog=r */
+
 static void
 set_uri (Event_Type et, Call * c)
 {
@@ -124,6 +188,127 @@ set_uri (Event_Type et, Call * c)
     printf ("%s: accessing URI `%s'\n", prog_name, uri);
 }
 
+/* Returns this client's Ith record of the trace.  */
+static const Wlog_Record *
+shard_record (u_wide i)
+{
+  return &records[param.client.id + i * param.client.num_clients];
+}
+
+static void
+set_request (Event_Type et, Call * c)
+{
+  const Wlog_Record *r;
+  const char *data;
+  u_wide i;
+
+  assert (et == EV_CALL_NEW && object_is_call (c));
+
+  if (param.wlog.random)
+    i = num_shard_records * erand48 (xsubi);
+  else
+    {
+      if (next_record >= num_shard_records)
+	{
+	  /* Like above, the current request still goes out.  */
+	  next_record = 0;
+	  if (!param.wlog.do_loop)
+	    core_exit ();
+	}
+      i = next_record++;
+    }
+
+  r = shard_record (i);
+  if (r->data > (u_wide) (fend - fbase)
+      || (u_wide) (fend - fbase) - r->data < (u_wide) r->method_len
+	 + r->uri_len + 2 + r->headers_len + r->body_len)
+    panic ("%s: %s is corrupt\n", prog_name, param.wlog.file);
+
+  data = fbase + r->data;
+  call_set_method (c, data, r->method_len);
+  data += r->method_len + 1;
+  call_set_uri (c, data, r->uri_len);
+  data += r->uri_len + 1;
+  if (r->headers_len > 0)
+    call_append_request_header (c, data, r->headers_len);
+  data += r->headers_len;
+  if (r->body_len > 0)
+    call_set_contents (c, data, r->body_len);
+
+  if (verbose)
+    printf ("%s: accessing URI `%.*s'\n",
+	    prog_name, (int) r->uri_len, fbase + r->data + r->method_len + 1);
+}
+
+/* Interarrival times of a timed replay (--wlog=t).  */
+static Time
+next_arrival_time (void)
+{
+  Time delay;
+
+  if (next_arrival + 1 >= num_shard_records)
+    {
+      /* past the end, pretend the trace goes on at its average rate: */
+      next_arrival = 0;
+      return param.rate.mean_iat;
+    }
+  delay = shard_record (next_arrival + 1)->time
+	  - shard_record (next_arrival)->time;
+  ++next_arrival;
+  return delay > 0.0 ? delay : 0.0;
+}
+
+/* Sets up the replay of the trace mapped at FBASE.  */
+static void
+init_trace (void)
+{
+  const Wlog_Header *hdr = (const Wlog_Header *) fbase;
+  Time duration;
+
+  if (hdr->version != WLOG_VERSION || hdr->byte_order != WLOG_BYTE_ORDER)
+    panic ("%s: %s was compiled by another version of httperf or on "
+	   "another kind of machine\n", prog_name, param.wlog.file);
+  if (hdr->size != (u_wide) (fend - fbase)
+      || hdr->num_records > (hdr->size - sizeof (*hdr)) / sizeof (*records))
+    panic ("%s: %s is corrupt\n", prog_name, param.wlog.file);
+
+  records = (const Wlog_Record *) (hdr + 1);
+  num_records = hdr->num_records;
+  if (num_records <= param.client.id)
+    panic ("%s: %s has fewer requests than there are clients\n",
+	   prog_name, param.wlog.file);
+  num_shard_records = (num_records - param.client.id
+		       + param.client.num_clients - 1)
+		      / param.client.num_clients;
+
+  xsubi[0] = 0x1234 ^ param.client.id;
+  xsubi[1] = 0x5678 ^ (param.client.id << 8);
+  xsubi[2] = 0x9abc ^ ~param.client.id;
+
+  /* Each client reads its part of the trace front to back, unless it
+     picks requests at random.  */
+  madvise (fbase, fend - fbase,
+	   param.wlog.random ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+  if (param.wlog.timed)
+    {
+      if (!(hdr->flags & WLOG_TIMED))
+	panic ("%s: %s has no arrival times\n", prog_name, param.wlog.file);
+
+      /* Arrivals are paced by the rate generator, at the trace's
+	 average rate as far as the statistics are concerned.  Start
+	 when this client's first request arrived in the trace.  */
+      rate_trace_next_iat = next_arrival_time;
+      param.rate.dist = TRACE;
+      duration = shard_record (num_shard_records - 1)->time
+		 - shard_record (0)->time;
+      param.rate.mean_iat = (num_shard_records > 1 && duration > 0.0
+			     ? duration / (num_shard_records - 1) : 1.0);
+      param.rate.rate_param = 1.0 / param.rate.mean_iat;
+      param.rate.phase = shard_record (0)->time;
+    }
+}
+
 void
 init_wlog (void)
 {
@@ -152,7 +337,19 @@ init_wlog (void)
   fcurrent = fbase;
 
   arg.l = 0;
-  event_register_handler (EV_CALL_NEW, (Event_Handler) set_uri, arg);
+  if ((size_t) st.st_size >= sizeof (Wlog_Header)
+      && memcmp (fbase, WLOG_MAGIC, sizeof (WLOG_MAGIC) - 1) == 0)
+    {
+      init_trace ();
+      event_register_handler (EV_CALL_NEW, (Event_Handler) set_request, arg);
+    }
+  else
+    {
+      if (param.wlog.random || param.wlog.timed)
+	panic ("%s: %s is a list of URIs, not a trace\n",
+	       prog_name, param.wlog.file);
+      event_register_handler (EV_CALL_NEW, (Event_Handler) set_uri, arg);
+    }
 }
 
 static void
@@ -161,6 +358,207 @@ stop_wlog (void)
   munmap (fbase, fend - fbase);
 }
 
+/* A request parsed by next_request ().  */
+struct request
+  {
+    const char *method, *uri, *body;
+    size_t method_len, uri_len, body_len;
+    int timed;
+    double time;
+  };
+
+/* Returns the length of the line at P (without its end of line) and
+   sets *NEXT to the start of the next line.  */
+static size_t
+line_len (const char *p, const char *end, const char **next)
+{
+  const char *eol;
+
+  if (p >= end)
+    {
+      *next = end;
+      return 0;
+    }
+  eol = memchr (p, '\n', end - p);
+  if (eol == NULL)
+    eol = end;
+  *next = eol < end ? eol + 1 : end;
+  if (eol > p && eol[-1] == '\r')
+    --eol;
+  return eol - p;
+}
+
+/* Parses the request at *P in the file NAME, which ends at END, into R
+   and its header lines (minus Host:) into HDRS, which has room for
+   *HDRS_MAX bytes.  Returns the length of the headers, or -1 at the
+   end of the file.  */
+static long
+next_request (const char **pp, const char *end, const char *name,
+	      struct request *r, char **hdrs, size_t *hdrs_max)
+{
+  const char *p = *pp, *next, *sp;
+  size_t len, hdrs_len = 0;
+  char *stop;
+
+  /* skip empty lines between requests: */
+  while (p < end && line_len (p, end, &next) == 0)
+    p = next;
+  if (p >= end)
+    return -1;
+
+  r->timed = (*p == '@');
+  if (r->timed)
+    {
+      r->time = strtod (p + 1, &stop);
+      if (stop == p + 1)
+	panic ("%s: bad arrival time in %s\n", prog_name, name);
+      line_len (p, end, &p);
+    }
+
+  len = line_len (p, end, &next);
+  sp = memchr (p, ' ', len);
+  if (sp == NULL || sp == p)
+    panic ("%s: bad request line `%.*s' in %s\n",
+	   prog_name, (int) len, p, name);
+  r->method = p;
+  r->method_len = sp - p;
+  r->uri = sp + 1;
+  len -= r->method_len + 1;
+  sp = memchr (r->uri, ' ', len);
+  r->uri_len = sp ? (size_t) (sp - r->uri) : len;
+  r->body_len = 0;
+  p = next;
+
+  for (;;)
+    {
+      if (p >= end)
+	panic ("%s: premature EOF seen in %s\n", prog_name, name);
+      len = line_len (p, end, &next);
+      if (len == 0)
+	break;
+      if (len >= 5 && strncasecmp (p, "Host:", 5) == 0)
+	{
+	  p = next;
+	  continue;
+	}
+      if (len >= 15 && strncasecmp (p, "Content-Length:", 15) == 0)
+	r->body_len = strtoul (p + 15, NULL, 10);
+      else if (len >= 18 && strncasecmp (p, "Transfer-Encoding:", 18) == 0)
+	panic ("%s: chunked requests are not supported (in %s)\n",
+	       prog_name, name);
+      while (hdrs_len + len + 2 > *hdrs_max)
+	{
+	  *hdrs_max = *hdrs_max ? 2 * *hdrs_max : 4096;
+	  *hdrs = realloc (*hdrs, *hdrs_max);
+	  if (*hdrs == NULL)
+	    panic ("%s: out of memory\n", prog_name);
+	}
+      memcpy (*hdrs + hdrs_len, p, len);
+      memcpy (*hdrs + hdrs_len + len, "\r\n", 2);
+      hdrs_len += len + 2;
+      p = next;
+    }
+  p = next;
+
+  if ((size_t) (end - p) < r->body_len)
+    panic ("%s: premature EOF seen in %s\n", prog_name, name);
+  r->body = p;
+  *pp = p + r->body_len;
+  return hdrs_len;
+}
+
+void
+wlog_compile (const char *file)
+{
+  const char *base, *end, *p;
+  size_t hdrs_max = 0;
+  FILE *idx, *dat;
+  struct request r;
+  char *hdrs = NULL;
+  Wlog_Header hdr;
+  Wlog_Record rec;
+  double first = 0.0;
+  u_wide i, n, data;
+  struct stat st;
+  int fd, timed;
+  long hdrs_len;
+
+  fd = open (param.wlog.file, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) < 0)
+    panic ("%s: can't open %s\n", prog_name, param.wlog.file);
+  if (st.st_size == 0)
+    panic ("%s: file %s is empty\n", prog_name, param.wlog.file);
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED)
+    panic ("%s: can't mmap the file: %s\n", prog_name, strerror (errno));
+  close (fd);
+  end = base + st.st_size;
+  madvise ((void *) base, st.st_size, MADV_SEQUENTIAL);
+
+  /* The first pass counts the requests, so the data can be written
+     right behind the index in the second.  */
+  timed = -1;
+  n = 0;
+  for (p = base; next_request (&p, end, param.wlog.file, &r,
+			       &hdrs, &hdrs_max) >= 0; ++n)
+    {
+      if (timed >= 0 && r.timed != timed)
+	panic ("%s: either all or none of the requests in %s need an "
+	       "arrival time\n", prog_name, param.wlog.file);
+      timed = r.timed;
+    }
+  if (n == 0)
+    panic ("%s: %s does not contain any requests\n",
+	   prog_name, param.wlog.file);
+
+  idx = fopen (file, "w");
+  if (idx == NULL)
+    panic ("%s: can't create %s: %s\n", prog_name, file, strerror (errno));
+  dat = fopen (file, "r+");
+  data = sizeof (hdr) + n * sizeof (rec);
+  if (dat == NULL || fseeko (dat, data, SEEK_SET) < 0)
+    panic ("%s: can't write %s: %s\n", prog_name, file, strerror (errno));
+
+  memset (&hdr, 0, sizeof (hdr));
+  fwrite (&hdr, sizeof (hdr), 1, idx);
+  for (p = base, i = 0; (hdrs_len = next_request (&p, end, param.wlog.file,
+						  &r, &hdrs, &hdrs_max)) >= 0;
+       ++i)
+    {
+      if (i == 0)
+	first = r.time;
+      memset (&rec, 0, sizeof (rec));
+      rec.data = data;
+      rec.method_len = r.method_len;
+      rec.uri_len = r.uri_len;
+      rec.headers_len = hdrs_len;
+      rec.body_len = r.body_len;
+      rec.time = timed ? r.time - first : 0.0;
+      fwrite (&rec, sizeof (rec), 1, idx);
+
+      fwrite (r.method, 1, r.method_len, dat);
+      putc ('\0', dat);
+      fwrite (r.uri, 1, r.uri_len, dat);
+      putc ('\0', dat);
+      fwrite (hdrs, 1, hdrs_len, dat);
+      fwrite (r.body, 1, r.body_len, dat);
+      data += r.method_len + r.uri_len + 2 + hdrs_len + r.body_len;
+    }
+
+  memcpy (hdr.magic, WLOG_MAGIC, sizeof (hdr.magic));
+  hdr.version = WLOG_VERSION;
+  hdr.byte_order = WLOG_BYTE_ORDER;
+  hdr.flags = timed ? WLOG_TIMED : 0;
+  hdr.num_records = n;
+  hdr.size = data;
+  if (fclose (dat) != 0 || fseeko (idx, 0, SEEK_SET) < 0
+      || fwrite (&hdr, sizeof (hdr), 1, idx) != 1 || fclose (idx) != 0)
+    panic ("%s: can't write %s: %s\n", prog_name, file, strerror (errno));
+
+  printf ("%s: compiled %llu requests%s into %s\n", prog_name,
+	  (unsigned long long) n, timed ? " with arrival times" : "", file);
+}
+
 Load_Generator uri_wlog =
   {
     "Generates URIs based on a predetermined list",
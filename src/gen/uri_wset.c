@@ -55,6 +55,7 @@ static double miss_prob;
 static unsigned file_num;
 static size_t call_private_data_offset;
 static size_t uri_prefix_len;
+static u_int *file_key;		/* per-URI statistics key of each file */
 
 static void
 set_uri (Event_Type et, Call *c)
@@ -97,6 +98,12 @@ set_uri (Event_Type et, Call *c)
   memcpy (cp, param.uri, uri_prefix_len);
 
   call_set_uri (c, cp, (buf_end - cp) - 1);
+  if (file_key)
+    {
+      if (!file_key[file_num])
+	file_key[file_num] = uri_stat_key (cp, (buf_end - cp) - 1);
+      c->uri_key = file_key[file_num];
+    }
 
   if (verbose)
     printf ("%s: accessing URI `%s'\n", prog_name, cp);
@@ -119,6 +126,16 @@ init (void)
       --uri_prefix_len;
     }
 
+  if (param.uri_stats)
+    {
+      file_key = calloc (param.wset.num_files, sizeof (*file_key));
+      if (!file_key)
+	{
+	  fprintf (stderr, "%s.uri_wset: out of memory\n", prog_name);
+	  exit (1);
+	}
+    }
+
   arg.l = 0;
   event_register_handler (EV_CALL_NEW, (Event_Handler) set_uri, arg);
 }
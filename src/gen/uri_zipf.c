@@ -0,0 +1,291 @@
+/*
+    httperf -- a tool for measuring web server performance
+    Copyright 2000-2007 Hewlett-Packard Company
+
+    This file is part of httperf, a web server performance measurment
+    tool.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+    
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this work with the OpenSSL project's
+    "OpenSSL" library (or with modified versions of it that use the same
+    license as the "OpenSSL" library), and distribute linked combinations
+    including the two.  You must obey the GNU General Public License in
+    all respects for all of the code used other than "OpenSSL".  If you
+    modify this file, you may extend this exception to your version of the
+    file, but you are not obligated to do so.  If you do not wish to do
+    so, delete this exception statement from your version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  
+    02110-1301, USA
+*/
+
+
+/* Causes accesses to a fixed set of files whose popularity follows a
+   Zipf distribution or weights read from a file (--popularity), like
+   the requests a cache sees.  The files are named as with --wset.
+   Files are drawn with Walker's alias method: a table of N entries,
+   each of which holds the probability of picking the entry itself and
+   an alias to pick otherwise, turns one random number into a file in
+   constant time.  */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <generic_types.h>
+#include <object.h>
+#include <httperf.h>
+#include <call.h>
+#include <localevent.h>
+
+#define MAX_URI_LEN		128
+#define CALL_PRIVATE_DATA(c) \
+ ((void *) ((char *)(c) + call_private_data_offset))
+
+static u_int num_files;
+static double *prob;		/* probability of taking entry I itself */
+static u_int *alias;		/* the entry to take otherwise */
+static u_short xsubi[3];
+static size_t call_private_data_offset;
+static size_t uri_prefix_len;
+static u_int *file_key;		/* per-URI statistics key of each file */
+
+static void
+set_uri (Event_Type et, Call *c)
+{
+  char *cp, *buf_end;
+  unsigned j, n, file;
+  double u;
+
+  assert (et == EV_CALL_NEW && object_is_call (c));
+
+  u = erand48 (xsubi) * num_files;
+  file = (u_int) u;
+  if (u - file >= prob[file])
+    file = alias[file];
+
+  /* fill in extension: */
+  buf_end = (char *) CALL_PRIVATE_DATA (c) + MAX_URI_LEN;
+  cp = buf_end - 6;
+  memcpy (cp, ".html", 6);
+
+  /* fill in file & pathname: */
+  n = file;
+  for (j = 1; j < num_files; j *= 10, n /= 10)
+    {
+      cp -= 2;
+      cp[0] = '/'; cp[1] = '0' + (n % 10);
+    }
+
+  /* fill in the uri prefix specified by param.uri: */
+  cp -= uri_prefix_len;
+  if (cp < (char *) CALL_PRIVATE_DATA (c))
+    {
+      fprintf (stderr, "%s.uri_zipf: URI buffer overflow!\n", prog_name);
+      exit (1);
+    }
+  memcpy (cp, param.uri, uri_prefix_len);
+
+  call_set_uri (c, cp, (buf_end - cp) - 1);
+  if (file_key)
+    {
+      if (!file_key[file])
+	file_key[file] = uri_stat_key (cp, (buf_end - cp) - 1);
+      c->uri_key = file_key[file];
+    }
+
+  if (verbose)
+    printf ("%s: accessing URI `%s'\n", prog_name, cp);
+}
+
+static void *
+alloc (size_t size)
+{
+  void *p = malloc (size);
+
+  if (!p)
+    {
+      fprintf (stderr, "%s.uri_zipf: out of memory\n", prog_name);
+      exit (1);
+    }
+  return p;
+}
+
+/* Reads the weights of the files, one per line, from FILE.  Returns the
+   number of files.  */
+static u_int
+read_weights (const char *file, double **weight)
+{
+  u_int n = 0, max = 0;
+  char line[256], *end;
+  double w;
+  FILE *fp;
+
+  fp = fopen (file, "r");
+  if (!fp)
+    {
+      fprintf (stderr, "%s: can't open %s: %s\n",
+	       prog_name, file, strerror (errno));
+      exit (1);
+    }
+  *weight = NULL;
+  while (fgets (line, sizeof (line), fp))
+    {
+      if (line[0] == '#' || line[strspn (line, " \t\r\n")] == '\0')
+	continue;
+      w = strtod (line, &end);
+      if (end == line || w < 0.0 || end[strspn (end, " \t\r\n")] != '\0')
+	{
+	  fprintf (stderr, "%s: bad weight `%s' in %s\n",
+		   prog_name, line, file);
+	  exit (1);
+	}
+      if (n >= max)
+	{
+	  max = max ? 2 * max : 1024;
+	  *weight = realloc (*weight, max * sizeof (**weight));
+	  if (!*weight)
+	    {
+	      fprintf (stderr, "%s.uri_zipf: out of memory\n", prog_name);
+	      exit (1);
+	    }
+	}
+      (*weight)[n++] = w;
+    }
+  fclose (fp);
+  return n;
+}
+
+/* Sets up the alias table for picking file I with a probability
+   proportional to WEIGHT[I] (Vose's algorithm).  */
+static void
+make_alias_table (double *weight)
+{
+  u_int *small, *large, num_small = 0, num_large = 0, i, s, l;
+  double sum = 0.0;
+
+  for (i = 0; i < num_files; ++i)
+    sum += weight[i];
+  if (sum <= 0.0)
+    {
+      fprintf (stderr, "%s: the popularity weights add up to 0\n",
+	       prog_name);
+      exit (1);
+    }
+
+  prob = alloc (num_files * sizeof (*prob));
+  alias = alloc (num_files * sizeof (*alias));
+  small = alloc (num_files * sizeof (*small));
+  large = alloc (num_files * sizeof (*large));
+
+  /* Scale the weights so they average 1; entries below 1 get topped
+     up from entries above 1 until all are full.  */
+  for (i = 0; i < num_files; ++i)
+    {
+      prob[i] = weight[i] * num_files / sum;
+      if (prob[i] < 1.0)
+	small[num_small++] = i;
+      else
+	large[num_large++] = i;
+    }
+  while (num_small > 0 && num_large > 0)
+    {
+      s = small[--num_small];
+      l = large[--num_large];
+      alias[s] = l;
+      prob[l] -= 1.0 - prob[s];
+      if (prob[l] < 1.0)
+	small[num_small++] = l;
+      else
+	large[num_large++] = l;
+    }
+  /* What is left is full, give or take rounding errors.  */
+  while (num_large > 0)
+    prob[large[--num_large]] = 1.0;
+  while (num_small > 0)
+    prob[small[--num_small]] = 1.0;
+
+  free (small);
+  free (large);
+}
+
+static void
+init (void)
+{
+  double *weight;
+  Any_Type arg;
+  u_int i;
+
+  if (param.popularity.file)
+    {
+      num_files = read_weights (param.popularity.file, &weight);
+      if (num_files == 0)
+	{
+	  fprintf (stderr, "%s: no weights in %s\n",
+		   prog_name, param.popularity.file);
+	  exit (1);
+	}
+    }
+  else
+    {
+      num_files = param.popularity.num_files;
+      weight = alloc (num_files * sizeof (*weight));
+      for (i = 0; i < num_files; ++i)
+	weight[i] = pow (i + 1, -param.popularity.exponent);
+    }
+  make_alias_table (weight);
+  free (weight);
+
+  /* Every client draws from the whole set, with its own random
+     numbers.  */
+  xsubi[0] = 0x4321 ^ param.client.id;
+  xsubi[1] = 0x8765 ^ (param.client.id << 8);
+  xsubi[2] = 0xcba9 ^ ~param.client.id;
+
+  call_private_data_offset = object_expand (OBJ_CALL, MAX_URI_LEN);
+
+  uri_prefix_len = strlen (param.uri);
+  if (param.uri[uri_prefix_len - 1] == '/')
+    {
+      ++param.uri;
+      --uri_prefix_len;
+    }
+
+  if (param.uri_stats)
+    {
+      file_key = calloc (num_files, sizeof (*file_key));
+      if (!file_key)
+	{
+	  fprintf (stderr, "%s.uri_zipf: out of memory\n", prog_name);
+	  exit (1);
+	}
+    }
+
+  arg.l = 0;
+  event_register_handler (EV_CALL_NEW, (Event_Handler) set_uri, arg);
+}
+
+Load_Generator uri_zipf =
+  {
+    "Generates URIs with a given popularity distribution",
+    init,
+    no_op,
+    no_op
+  };
@@ -0,0 +1,213 @@
+/*
+    httperf -- a tool for measuring web server performance
+    Copyright 2000-2007 Hewlett-Packard Company
+
+    This file is part of httperf, a web server performance measurment
+    tool.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+    
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this work with the OpenSSL project's
+    "OpenSSL" library (or with modified versions of it that use the same
+    license as the "OpenSSL" library), and distribute linked combinations
+    including the two.  You must obey the GNU General Public License in
+    all respects for all of the code used other than "OpenSSL".  If you
+    modify this file, you may extend this exception to your version of the
+    file, but you are not obligated to do so.  If you do not wish to do
+    so, delete this exception statement from your version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  
+    02110-1301, USA
+*/
+
+
+/* WebSocket echo load (see --websocket).  Takes the place of call_seq:
+   once a connection is up, a WebSocket upgrade request is sent on it.
+   When that is answered with "101 Switching Protocols",
+   PARAM.WEBSOCKET.NUM_MSGS messages are sent on the connection,
+   PARAM.WEBSOCKET.RATE per second or, if the rate is 0, each as soon
+   as the previous one has been echoed.  A message that is due while
+   WS_WINDOW messages are waiting for their echo goes out as soon as
+   one of them is back.  The connection is closed after the last
+   echo.  */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <core.h>
+#include <localevent.h>
+#include <websocket.h>
+
+#define CONN_PRIVATE_DATA(c) \
+  ((Conn_Private_Data *) ((char *)(c) + conn_private_data_offset))
+
+/* The key is fixed: it only proves to the server that the client
+   speaks WebSocket.  */
+static const char upgrade_hdr[] =
+  "Upgrade: websocket\r\n"
+  "Connection: Upgrade\r\n"
+  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+  "Sec-WebSocket-Version: 13\r\n";
+
+typedef struct Conn_Private_Data
+  {
+    u_long num_sent;		/* # of messages sent */
+    u_long num_due;		/* # of messages due but not sent yet */
+    u_long num_echoed;		/* # of echoes received */
+    struct Timer *timer;	/* sends the next message (or 0) */
+  }
+Conn_Private_Data;
+
+static size_t conn_private_data_offset;
+
+static void
+send_msg (Conn *conn)
+{
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+
+  if (core_ws_send (conn) == 0)
+    ++priv->num_sent;
+  else
+    ++priv->num_due;
+}
+
+static void
+tick (struct Timer *t, Any_Type arg)
+{
+  Conn *conn = arg.vp;
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+
+  priv->timer = 0;
+  send_msg (conn);
+  if (priv->num_sent + priv->num_due < param.websocket.num_msgs)
+    priv->timer = timer_schedule (tick, arg, 1.0 / param.websocket.rate);
+}
+
+static void
+conn_connected (Event_Type et, Object *obj, Any_Type regarg, Any_Type arg)
+{
+  Conn *conn = (Conn *) obj;
+  Call *call;
+
+  assert (et == EV_CONN_CONNECTED && object_is_conn (conn));
+
+  call = call_new ();
+  if (!call)
+    {
+      core_close (conn);
+      return;
+    }
+  call_append_request_header (call, upgrade_hdr, sizeof (upgrade_hdr) - 1);
+  core_send (conn, call);
+  call_dec_ref (call);
+}
+
+static void
+upgraded (Event_Type et, Object *obj, Any_Type regarg, Any_Type arg)
+{
+  static int warned;
+  Call *call = (Call *) obj;
+  Conn *conn = call->conn;
+
+  assert (et == EV_CALL_RECV_STOP && object_is_call (call));
+
+  if (conn->ws)
+    return;
+
+  if (call->reply.status != 101)
+    {
+      if (!warned++)
+	fprintf (stderr, "%s: server refused the WebSocket upgrade "
+		 "(status %d)\n", prog_name, call->reply.status);
+      core_close (conn);
+      return;
+    }
+
+  core_ws_start (conn);
+  send_msg (conn);
+  if (param.websocket.rate > 0.0 && param.websocket.num_msgs > 1)
+    {
+      arg.vp = conn;
+      CONN_PRIVATE_DATA (conn)->timer =
+	timer_schedule (tick, arg, 1.0 / param.websocket.rate);
+    }
+}
+
+static void
+echoed (Event_Type et, Object *obj, Any_Type regarg, Any_Type arg)
+{
+  Conn *conn = (Conn *) obj;
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+
+  assert (et == EV_WS_ECHO && object_is_conn (conn));
+
+  if (++priv->num_echoed >= param.websocket.num_msgs)
+    core_close (conn);
+  else if (priv->num_due > 0)
+    {
+      --priv->num_due;
+      send_msg (conn);
+    }
+  else if (param.websocket.rate <= 0.0
+	   && priv->num_sent < param.websocket.num_msgs)
+    send_msg (conn);
+}
+
+static void
+conn_closed (Event_Type et, Object *obj, Any_Type regarg, Any_Type arg)
+{
+  Conn *conn = (Conn *) obj;
+  Conn_Private_Data *priv = CONN_PRIVATE_DATA (conn);
+
+  assert (et == EV_CONN_CLOSE && object_is_conn (conn));
+
+  if (priv->timer)
+    {
+      timer_cancel (priv->timer);
+      priv->timer = 0;
+    }
+}
+
+static void
+init (void)
+{
+  Any_Type arg;
+
+  conn_private_data_offset = object_expand (OBJ_CONN,
+					    sizeof (Conn_Private_Data));
+
+  arg.l = 0;
+  event_register_handler (EV_CONN_CONNECTED, conn_connected, arg);
+  event_register_handler (EV_CALL_RECV_STOP, upgraded, arg);
+  event_register_handler (EV_WS_ECHO, echoed, arg);
+  event_register_handler (EV_CONN_CLOSE, conn_closed, arg);
+}
+
+Load_Generator ws_echo =
+  {
+    "sends WebSocket messages and waits for their echo",
+    init,
+    no_op,
+    no_op
+  };
@@ -70,6 +70,18 @@
    /foo4.html
 	/pict5.gif
 
+   Besides think=SECONDS, method=METHOD and contents=STRING, a request
+   may take its contents from a file with
+   contents-file=PATH[,OFFSET[,LENGTH]] (PATH must not contain a
+   comma).  The contents are the LENGTH bytes at OFFSET, or the rest of
+   the file if no LENGTH is given.  Such files are opened and mapped
+   once, when the test starts, and their contents are sent without
+   being copied into httperf (see call_set_contents_file()).
+
+   A session log can be compiled into a binary file with
+   --wsesslog-compile; a compiled log is given to --wsesslog like a text
+   one and is mapped into memory instead of being parsed.
+
    Any comment on this module contact carter@hpl.hp.com.  */
 
 #include "config.h"
@@ -77,9 +89,14 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <generic_types.h>
 
@@ -92,10 +109,7 @@
 #include <localevent.h>
 #include <rate.h>
 #include <session.h>
-
-/* Maximum number of sessions that can be defined in the configuration
-   file.  */
-#define MAX_SESSION_TEMPLATES	1000
+#include <wsesslog.h>
 
 #ifndef TRUE
 #define TRUE  (1)
@@ -107,27 +121,74 @@
 #define SESS_PRIVATE_DATA(c)						\
   ((Sess_Private_Data *) ((char *)(c) + sess_private_data_offset))
 
-typedef struct req REQ;
-struct req
+/* A session log is kept in four tables: the sessions, each of which
+   refers to a range of bursts, the bursts, each of which refers to a
+   range of requests, the requests, and a pool with the ('\0'
+   terminated) strings of the requests.  References are indices and pool
+   offsets rather than pointers, so the tables can be written to a file
+   as they are.  Such a compiled log starts with a Wsl_Header, followed
+   by the tables in the above order, and is mapped read-only when the
+   test starts.  It is in host byte order.  */
+#define WSL_MAGIC	"httperfL"
+#define WSL_VERSION	2
+#define WSL_BYTE_ORDER	0x01020304
+
+typedef struct Wsl_Header
   {
-    REQ *next;
-    int method;
-    char *uri;
-    int uri_len;
-    char *contents;
-    int contents_len;
-    char extra_hdrs[50];	/* plenty for "Content-length: 1234567890" */
-    int extra_hdrs_len;
-  };
+    char magic[8];		/* WSL_MAGIC */
+    u_int version;		/* WSL_VERSION */
+    u_int byte_order;		/* WSL_BYTE_ORDER */
+    u_int num_sessions;
+    u_int num_bursts;
+    u_int num_reqs;
+    u_int pad;
+    u_wide pool_size;		/* # of bytes in the string pool */
+  }
+Wsl_Header;
+
+typedef struct Wsl_Session
+  {
+    u_int first_burst;
+    u_int num_bursts;
+    u_int total_num_reqs;	/* total number of requests in this session */
+    u_int pad;
+  }
+Wsl_Session;
+
+typedef struct Wsl_Burst
+  {
+    u_int first_req;
+    u_int num_reqs;
+    double user_think_time;	/* < 0 for the --wsesslog default */
+  }
+Wsl_Burst;
 
-typedef struct burst BURST;
-struct burst
+typedef struct Wsl_Req
   {
-    BURST *next;
-    int num_reqs;
-    Time user_think_time;
-    REQ *req_list;
-  };
+    u_int method;
+    u_int uri_len;
+    u_int contents_len;		/* 0 if the request has no contents */
+    u_int extra_hdrs_len;
+    u_int contents_file_len;	/* 0 unless the contents come from a file */
+    u_int pad;
+    u_wide uri;			/* pool offsets */
+    u_wide contents;
+    u_wide extra_hdrs;		/* "Content-length: N\r\n" */
+    u_wide contents_file;	/* name of the file with the contents */
+    u_wide contents_offset;	/* where the contents start in that file */
+  }
+Wsl_Req;
+
+/* A file that request contents are sent from, mapped in full.  */
+typedef struct Body_File
+  {
+    struct Body_File *next;
+    const char *name;
+    int fd;
+    const char *map;
+    u_wide size;
+  }
+Body_File;
 
 typedef struct Sess_Private_Data Sess_Private_Data;
 struct Sess_Private_Data
@@ -138,9 +199,10 @@ struct Sess_Private_Data
     struct Timer *timer;		/* timer for session think time */
 
     int total_num_reqs;		/* total number of requests in this session */
+    u_int num_bursts_left;	/* # of bursts after the current one */
 
-    BURST *current_burst;	/* the current burst we're working on */
-    REQ *current_req;		/* the current request we're working on */
+    const Wsl_Burst *current_burst; /* the current burst we're working on */
+    const Wsl_Req *current_req;	/* the current request we're working on */
   };
 
 /* Methods allowed for a request: */
@@ -160,15 +222,29 @@ static int num_sessions_generated;
 static int num_sessions_destroyed;
 static Rate_Generator rg_sess;
 
-/* This is an array rather than a list because we may want different
-   httperf clients to start at different places in the sequence of
-   sessions. */
-static int num_templates;
-static int next_session_template;
-static Sess_Private_Data session_templates[MAX_SESSION_TEMPLATES] =
-  {
-    { 0, }
-  };
+/* The session log.  The sessions are an array rather than a list
+   because we may want different httperf clients to start at different
+   places in the sequence of sessions. */
+static u_int num_templates;
+static u_int num_bursts;
+static u_int num_reqs;
+static u_wide pool_size;
+static const Wsl_Session *session_templates;
+static const Wsl_Burst *bursts;
+static const Wsl_Req *reqs;
+static const char *pool;
+static u_int *uri_keys;		/* per-URI statistics key by request */
+static const Body_File **req_files; /* contents file by request (or 0) */
+static Body_File *body_files;
+static u_int next_session_template;
+
+/* The tables while a text log is parsed.  */
+static Wsl_Session *sess_tab;
+static Wsl_Burst *burst_tab;
+static Wsl_Req *req_tab;
+static char *pool_tab;
+static u_int max_sessions, max_bursts, max_reqs;
+static u_wide max_pool_size;
 
 static void
 sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
@@ -195,8 +271,8 @@ issue_calls (Sess *sess, Sess_Private_Data *priv)
 {
   int i, to_create, retval, n;
   const char *method_str;
+  const Wsl_Req *req;
   Call *call;
-  REQ *req;
 
   /* Mimic browser behavior of fetching html object, then a couple of
      embedded objects: */
@@ -222,24 +298,34 @@ issue_calls (Sess *sess, Sess_Private_Data *priv)
 
       /* fill in the new call: */
       req = priv->current_req;
-      if (req == NULL)
+      if (req >= reqs + priv->current_burst->first_req
+		 + priv->current_burst->num_reqs)
 	panic ("%s: internal error, requests ran past end of burst\n",
 	       prog_name);
 
       method_str = call_method_name[req->method];
       call_set_method (call, method_str, strlen (method_str));
-      call_set_uri (call, req->uri, req->uri_len);
+      call_set_uri (call, pool + req->uri, req->uri_len);
+      if (uri_keys)
+	call->uri_key = uri_keys[req - reqs];
       if (req->contents_len > 0)
 	{
 	  /* add "Content-length:" header and contents, if necessary: */
-	  call_append_request_header (call, req->extra_hdrs,
+	  call_append_request_header (call, pool + req->extra_hdrs,
 				      req->extra_hdrs_len);
-	  call_set_contents (call, req->contents, req->contents_len);
+	  if (req_files && req_files[req - reqs])
+	    call_set_contents_file (call, req_files[req - reqs]->fd,
+				    req_files[req - reqs]->map,
+				    req->contents_offset, req->contents_len);
+	  else
+	    call_set_contents (call, pool + req->contents,
+			       req->contents_len);
 	}
-      priv->current_req = req->next;
+      priv->current_req = req + 1;
 
       if (DBG > 0)
-	fprintf (stderr, "%s: accessing URI `%s'\n", prog_name, req->uri);
+	fprintf (stderr, "%s: accessing URI `%s'\n",
+		 prog_name, pool + req->uri);
 
       retval = session_issue_call (sess, call);
       call_dec_ref (call);
@@ -266,7 +352,8 @@ user_think_time_expired (struct Timer *t, Any_Type arg)
 static int
 sess_create (Any_Type arg)
 {
-  Sess_Private_Data *priv, *template;
+  const Wsl_Session *template;
+  Sess_Private_Data *priv;
   Sess *sess;
 
   if (num_sessions_generated++ >= param.wsesslog.num_sessions)
@@ -279,8 +366,9 @@ sess_create (Any_Type arg)
     next_session_template = 0;
 
   priv = SESS_PRIVATE_DATA (sess);
-  priv->current_burst = template->current_burst;
-  priv->current_req = priv->current_burst->req_list;
+  priv->current_burst = &bursts[template->first_burst];
+  priv->num_bursts_left = template->num_bursts - 1;
+  priv->current_req = &reqs[priv->current_burst->first_req];
   priv->total_num_reqs = template->total_num_reqs;
   priv->num_calls_target = priv->current_burst->num_reqs;
 
@@ -301,13 +389,15 @@ prepare_for_next_burst (Sess *sess, Sess_Private_Data *priv)
   if (priv->current_burst != NULL)
     {
       think_time = priv->current_burst->user_think_time;
+      if (think_time < 0.0)
+	think_time = param.wsesslog.think_time;
 
       /* advance to next burst: */
-      priv->current_burst = priv->current_burst->next;
-
-      if (priv->current_burst != NULL)
+      if (priv->num_bursts_left > 0)
 	{
-	  priv->current_req = priv->current_burst->req_list;
+	  --priv->num_bursts_left;
+	  ++priv->current_burst;
+	  priv->current_req = &reqs[priv->current_burst->first_req];
 	  priv->num_calls_in_this_burst = 0;
 	  priv->num_calls_target += priv->current_burst->num_reqs;
 
@@ -316,6 +406,8 @@ prepare_for_next_burst (Sess *sess, Sess_Private_Data *priv)
 	  priv->timer = timer_schedule (user_think_time_expired,
 					arg, think_time);
 	}
+      else
+	priv->current_burst = NULL;
     }
 }
 
@@ -345,39 +437,130 @@ call_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
     prepare_for_next_burst (sess, priv);
 }
 
-/* Allocates memory for a REQ and assigns values to data members.
+/* Makes sure the table TAB with room for *MAX elements of SIZE bytes
+   has room for one more than N.  Returns the (possibly moved) table.
    This is used during configuration file parsing only.  */
-static REQ*
-new_request (char *uristr)
+static void *
+grow (void *tab, u_int *max, u_int n, size_t size)
 {
-  REQ *retptr;
-
-  retptr = (REQ *) malloc (sizeof (*retptr));
-  if (retptr == NULL || uristr == NULL)
+  if (n < *max)
+    return tab;
+
+  if (*max >= UINT_MAX / 2)
+    panic ("%s: too many entries in %s\n", prog_name, param.wsesslog.file);
+  *max = *max ? 2 * *max : 1024;
+  tab = realloc (tab, (size_t) *max * size);
+  if (tab == NULL)
     panic ("%s: ran out of memory while parsing %s\n",
-	   prog_name, param.wsesslog.file);  
+	   prog_name, param.wsesslog.file);
+  return tab;
+}
 
-  memset (retptr, 0, sizeof (*retptr));
-  retptr->uri = uristr;
-  retptr->uri_len = strlen (uristr);
-  retptr->method = HM_GET;
-  return retptr;
+/* Adds the LEN bytes at STR and a '\0' to the string pool and returns
+   their offset.  */
+static u_wide
+pool_add (const char *str, size_t len)
+{
+  u_wide off = pool_size;
+
+  while (pool_size + len + 1 > max_pool_size)
+    {
+      max_pool_size = max_pool_size ? 2 * max_pool_size : 65536;
+      pool_tab = realloc (pool_tab, max_pool_size);
+      if (pool_tab == NULL)
+	panic ("%s: ran out of memory while parsing %s\n",
+	       prog_name, param.wsesslog.file);
+    }
+  memcpy (pool_tab + off, str, len);
+  pool_tab[off + len] = '\0';
+  pool_size += len + 1;
+  return off;
 }
 
-/* Like new_request except this is for burst descriptors.  */
-static BURST*
-new_burst (REQ *r)
+/* Adds a GET request for URISTR to the tables.  */
+static Wsl_Req *
+new_request (const char *uristr)
 {
-  BURST *retptr;
-    
-  retptr = (BURST *) malloc (sizeof (*retptr));
-  if (retptr == NULL)
-    panic ("%s: ran out of memory while parsing %s\n",
-	   prog_name, param.wsesslog.file);  
-  memset (retptr, 0, sizeof (*retptr));
-  retptr->user_think_time = param.wsesslog.think_time;
-  retptr->req_list = r;
-  return retptr;
+  Wsl_Req *req;
+
+  req_tab = grow (req_tab, &max_reqs, num_reqs, sizeof (*req_tab));
+  req = &req_tab[num_reqs++];
+  memset (req, 0, sizeof (*req));
+  req->method = HM_GET;
+  req->uri_len = strlen (uristr);
+  req->uri = pool_add (uristr, req->uri_len);
+  return req;
+}
+
+/* Like new_request except this is for burst descriptors.  The burst
+   starts with the request that was added last and belongs to the
+   session that was added last.  */
+static Wsl_Burst *
+new_burst (void)
+{
+  Wsl_Burst *burst;
+
+  burst_tab = grow (burst_tab, &max_bursts, num_bursts, sizeof (*burst_tab));
+  burst = &burst_tab[num_bursts++];
+  burst->first_req = num_reqs - 1;
+  burst->num_reqs = 0;
+  burst->user_think_time = -1.0;
+  ++sess_tab[num_templates - 1].num_bursts;
+  return burst;
+}
+
+/* Sets REQ's contents to the file named by SPEC, the argument of
+   contents-file=.  */
+static void
+parse_contents_file (Wsl_Req *req, const char *spec)
+{
+  const char *comma;
+  unsigned long long offset, len;
+  struct stat st;
+  char *end;
+  char path[PATH_MAX];
+
+  comma = strchr (spec, ',');
+  len = comma ? (size_t) (comma - spec) : strlen (spec);
+  if (len == 0 || len >= sizeof (path))
+    panic ("%s: bad contents-file=%s in %s\n",
+	   prog_name, spec, param.wsesslog.file);
+  memcpy (path, spec, len);
+  path[len] = '\0';
+  if (stat (path, &st) < 0)
+    panic ("%s: can't stat %s, named in %s: %s\n",
+	   prog_name, path, param.wsesslog.file, strerror (errno));
+
+  offset = 0;
+  len = st.st_size;
+  if (comma)
+    {
+      offset = strtoull (comma + 1, &end, 10);
+      if (end == comma + 1 || (*end != '\0' && *end != ','))
+	panic ("%s: bad offset in contents-file=%s in %s\n",
+	       prog_name, spec, param.wsesslog.file);
+      if (offset > (unsigned long long) st.st_size)
+	panic ("%s: offset %llu is past the end of %s\n",
+	       prog_name, offset, path);
+      len = st.st_size - offset;
+      if (*end == ',')
+	{
+	  comma = end;
+	  len = strtoull (comma + 1, &end, 10);
+	  if (end == comma + 1 || *end != '\0')
+	    panic ("%s: bad length in contents-file=%s in %s\n",
+		   prog_name, spec, param.wsesslog.file);
+	}
+    }
+  if (len > UINT_MAX)
+    panic ("%s: contents-file=%s in %s is too long\n",
+	   prog_name, spec, param.wsesslog.file);
+
+  req->contents_len = len;
+  req->contents = 0;
+  req->contents_offset = offset;
+  req->contents_file_len = strlen (path);
+  req->contents_file = pool_add (path, req->contents_file_len);
 }
 
 /* Read in session-defining configuration file and create in-memory
@@ -386,27 +569,27 @@ static void
 parse_config (void)
 {
   FILE *fp;
-  int lineno, i, reqnum;
-  Sess_Private_Data *sptr;
+  int lineno, i;
+  Wsl_Session *sptr;
   char line[500000];	/* some uri's get pretty long */
   char uri[500000];	/* some uri's get pretty long */
   char method_str[1000];
   char this_arg[500000];
   char contents[500000];
+  char extra_hdrs[50];	/* plenty for "Content-length: 1234567890" */
   double think_time;
   int bytes_read;
-  REQ *reqptr;
-  BURST *bptr, *current_burst = 0;
+  Wsl_Req *reqptr;
+  Wsl_Burst *current_burst = 0;
   char *from, *to, *parsed_so_far;
   int ch;
-  int single_quoted, double_quoted, escaped, done;
+  int single_quoted, double_quoted, escaped, done, in_session;
 
   fp = fopen (param.wsesslog.file, "r");
   if (fp == NULL)
     panic ("%s: can't open %s\n", prog_name, param.wsesslog.file);  
 
-  num_templates = 0;
-  sptr = &session_templates[0];
+  in_session = FALSE;
 
   for (lineno = 1; fgets (line, sizeof (line), fp); lineno++)
     {
@@ -416,33 +599,28 @@ parse_config (void)
       if (sscanf (line,"%s%n", uri, &bytes_read) != 1)
 	{
 	  /* must be a session-delimiting blank line */
-	  if (sptr->current_req != NULL)
-	    sptr++;		/* advance to next session */
+	  in_session = FALSE;	/* advance to next session */
 	  continue;
 	}
       /* looks like a request-specifying line */
-      reqptr = new_request (strdup (uri));
+      reqptr = new_request (uri);
 
-      if (sptr->current_req == NULL)
+      if (!in_session)
 	{
-	  num_templates++;
-	  if (num_templates > MAX_SESSION_TEMPLATES)
-	    panic ("%s: too many sessions (%d) specified in %s\n",
-		   prog_name, num_templates, param.wsesslog.file);  
-	  current_burst = sptr->current_burst = new_burst (reqptr);
-	}
-      else
-	{
-	  if (!isspace (line[0]))
-	    /* this uri starts a new burst */
-	    current_burst = (current_burst->next = new_burst (reqptr));
-	  else
-	    sptr->current_req->next = reqptr;
+	  sess_tab = grow (sess_tab, &max_sessions, num_templates,
+			   sizeof (*sess_tab));
+	  sptr = &sess_tab[num_templates++];
+	  memset (sptr, 0, sizeof (*sptr));
+	  sptr->first_burst = num_bursts;
+	  in_session = TRUE;
+	  current_burst = new_burst ();
 	}
+      else if (!isspace (line[0]))
+	/* this uri starts a new burst */
+	current_burst = new_burst ();
       /* do some common steps for all new requests */
       current_burst->num_reqs++;
-      sptr->total_num_reqs++;
-      sptr->current_req = reqptr;
+      sess_tab[num_templates - 1].total_num_reqs++;
 
       /* parse rest of line to specify additional parameters of this
 	 request and burst */
@@ -456,7 +634,7 @@ parse_config (void)
 		  if (!strncmp (method_str,call_method_name[i],
 				strlen (call_method_name[i])))
 		    {
-		      sptr->current_req->method = i;
+		      reqptr->method = i;
 		      break;
 		    }
 		}
@@ -466,6 +644,18 @@ parse_config (void)
 	    }
 	  else if (sscanf (this_arg, "think=%lf", &think_time) == 1)
 	    current_burst->user_think_time = think_time;
+	  else if (strncmp (this_arg, "contents-file=", 14) == 0)
+	    {
+	      parse_contents_file (reqptr, this_arg + 14);
+	      if (reqptr->contents_len > 0)
+		{
+		  snprintf (extra_hdrs, sizeof (extra_hdrs),
+			    "Content-length: %u\r\n", reqptr->contents_len);
+		  reqptr->extra_hdrs_len = strlen (extra_hdrs);
+		  reqptr->extra_hdrs = pool_add (extra_hdrs,
+						 reqptr->extra_hdrs_len);
+		}
+	    }
 	  else if (sscanf (this_arg, "contents=%s", contents) == 1)
 	    {
 	      /* this is tricky since contents might be a quoted
@@ -555,15 +745,16 @@ parse_config (void)
 	      *to = '\0';
 	      from--;		/* back up 'from' to '\0' or white-space */
 	      bytes_read = from - parsed_so_far;
-	      if ((sptr->current_req->contents_len = strlen (contents)) != 0)
+	      reqptr->contents_file_len = 0;
+	      if ((reqptr->contents_len = strlen (contents)) != 0)
 		{
-		  sptr->current_req->contents = strdup (contents);
-		  snprintf (sptr->current_req->extra_hdrs,
-			    sizeof(sptr->current_req->extra_hdrs),
-			    "Content-length: %d\r\n",
-			   sptr->current_req->contents_len);
-		  sptr->current_req->extra_hdrs_len =
-		    strlen (sptr->current_req->extra_hdrs);
+		  reqptr->contents = pool_add (contents,
+					       reqptr->contents_len);
+		  snprintf (extra_hdrs, sizeof (extra_hdrs),
+			    "Content-length: %u\r\n", reqptr->contents_len);
+		  reqptr->extra_hdrs_len = strlen (extra_hdrs);
+		  reqptr->extra_hdrs = pool_add (extra_hdrs,
+						 reqptr->extra_hdrs_len);
 		}
 	    }
 	  else
@@ -577,6 +768,131 @@ parse_config (void)
     }
   fclose (fp);
 
+  session_templates = sess_tab;
+  bursts = burst_tab;
+  reqs = req_tab;
+  pool = pool_tab;
+}
+
+static void
+bad_compiled_config (void)
+{
+  panic ("%s: %s is not a valid compiled session log\n",
+	 prog_name, param.wsesslog.file);
+}
+
+/* Checks that the pool string at OFF is LEN bytes long.  */
+static int
+valid_string (u_wide off, u_int len)
+{
+  return off < pool_size && pool_size - off > len && pool[off + len] == '\0';
+}
+
+/* Maps the configuration file if it is a compiled session log.
+   Returns FALSE if it is a text file.  */
+static int
+map_compiled_config (void)
+{
+  const Wsl_Header *hdr;
+  const Wsl_Session *s;
+  const Wsl_Burst *b;
+  const Wsl_Req *r;
+  const char *base;
+  struct stat st;
+  u_wide size;
+  u_int i, j, n;
+  int fd;
+
+  fd = open (param.wsesslog.file, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) < 0)
+    panic ("%s: can't open %s\n", prog_name, param.wsesslog.file);
+  if ((size_t) st.st_size < sizeof (*hdr))
+    {
+      close (fd);
+      return FALSE;
+    }
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    panic ("%s: can't map %s: %s\n",
+	   prog_name, param.wsesslog.file, strerror (errno));
+
+  hdr = (const Wsl_Header *) base;
+  if (memcmp (hdr->magic, WSL_MAGIC, sizeof (hdr->magic)) != 0)
+    {
+      munmap ((void *) base, st.st_size);
+      return FALSE;
+    }
+  if (hdr->version != WSL_VERSION || hdr->byte_order != WSL_BYTE_ORDER)
+    panic ("%s: %s was compiled by another version of httperf or on "
+	   "another kind of machine\n", prog_name, param.wsesslog.file);
+
+  num_templates = hdr->num_sessions;
+  num_bursts = hdr->num_bursts;
+  num_reqs = hdr->num_reqs;
+  pool_size = hdr->pool_size;
+  size = sizeof (*hdr) + (u_wide) num_templates * sizeof (Wsl_Session)
+    + (u_wide) num_bursts * sizeof (Wsl_Burst)
+    + (u_wide) num_reqs * sizeof (Wsl_Req) + pool_size;
+  if (size != (u_wide) st.st_size)
+    bad_compiled_config ();
+
+  session_templates = (const Wsl_Session *) (hdr + 1);
+  bursts = (const Wsl_Burst *) (session_templates + num_templates);
+  reqs = (const Wsl_Req *) (bursts + num_bursts);
+  pool = (const char *) (reqs + num_reqs);
+
+  /* Check the references once, so a bad file can't make us crash in
+     the middle of the test.  */
+  for (i = 0; i < num_templates; ++i)
+    {
+      s = &session_templates[i];
+      if (s->num_bursts == 0 || s->first_burst >= num_bursts
+	  || num_bursts - s->first_burst < s->num_bursts)
+	bad_compiled_config ();
+      for (j = n = 0; j < s->num_bursts; ++j)
+	n += bursts[s->first_burst + j].num_reqs;
+      if (n != s->total_num_reqs)
+	bad_compiled_config ();
+    }
+  for (i = 0; i < num_bursts; ++i)
+    {
+      b = &bursts[i];
+      if (b->num_reqs == 0 || b->first_req >= num_reqs
+	  || num_reqs - b->first_req < b->num_reqs)
+	bad_compiled_config ();
+    }
+  for (i = 0; i < num_reqs; ++i)
+    {
+      r = &reqs[i];
+      if (r->method >= HM_LEN || !valid_string (r->uri, r->uri_len)
+	  || (r->contents_len > 0
+	      && ((r->contents_file_len == 0
+		   && !valid_string (r->contents, r->contents_len))
+		  || (r->contents_file_len > 0
+		      && !valid_string (r->contents_file,
+					r->contents_file_len))
+		  || !valid_string (r->extra_hdrs, r->extra_hdrs_len))))
+	bad_compiled_config ();
+    }
+  return TRUE;
+}
+
+static void
+load_config (void)
+{
+  const Wsl_Session *sptr;
+  const Wsl_Burst *bptr;
+  const Wsl_Req *reqptr;
+  u_int i, j, reqnum;
+
+  if (!map_compiled_config ())
+    parse_config ();
+
+  if (num_templates == 0)
+    panic ("%s: no sessions specified in %s\n",
+	   prog_name, param.wsesslog.file);
+
   if (DBG > 3)
     {
       fprintf (stderr,"%s: session list follows:\n\n", prog_name);
@@ -587,27 +903,30 @@ parse_config (void)
 	  fprintf (stderr, "#session %d (total_reqs=%d):\n",
 		   i, sptr->total_num_reqs);
 	    
-	  for (bptr = sptr->current_burst; bptr; bptr = bptr->next)
+	  for (j = 0; j < sptr->num_bursts; j++)
 	    {
-	      for (reqptr = bptr->req_list, reqnum = 0;
-		   reqptr;
-		   reqptr = reqptr->next, reqnum++)
+	      bptr = &bursts[sptr->first_burst + j];
+	      for (reqnum = 0; reqnum < bptr->num_reqs; reqnum++)
 		{
-		  if (reqnum >= bptr->num_reqs)
-		    panic ("%s: internal error detected in parsing %s\n",
-			   prog_name, param.wsesslog.file);  
+		  reqptr = &reqs[bptr->first_req + reqnum];
 		  if (reqnum > 0)
 		    fprintf (stderr, "\t");
-		  fprintf (stderr, "%s", reqptr->uri);
-		  if (reqnum == 0
-		      && bptr->user_think_time != param.wsesslog.think_time)
+		  fprintf (stderr, "%s", pool + reqptr->uri);
+		  if (reqnum == 0 && bptr->user_think_time >= 0.0)
 		    fprintf (stderr, " think=%0.2f",
 			     (double) bptr->user_think_time);
 		  if (reqptr->method != HM_GET)
 		    fprintf (stderr," method=%s",
 			     call_method_name[reqptr->method]);
-		  if (reqptr->contents != NULL)
-		    fprintf (stderr, " contents='%s'", reqptr->contents);
+		  if (reqptr->contents_len > 0
+		      && reqptr->contents_file_len > 0)
+		    fprintf (stderr, " contents-file=%s,%llu,%u",
+			     pool + reqptr->contents_file,
+			     (unsigned long long) reqptr->contents_offset,
+			     reqptr->contents_len);
+		  else if (reqptr->contents_len > 0)
+		    fprintf (stderr, " contents='%s'",
+			     pool + reqptr->contents);
 		  fprintf (stderr, "\n");
 		}
 	    }
@@ -616,12 +935,112 @@ parse_config (void)
     }
 }
 
+/* Opens and maps the files that requests take their contents from,
+   each one once, and checks that the contents are still there.  */
+static void
+open_body_files (void)
+{
+  const char *name;
+  Body_File *f;
+  struct stat st;
+  const Wsl_Req *r;
+  u_int i;
+
+  for (i = 0; i < num_reqs; ++i)
+    {
+      r = &reqs[i];
+      if (r->contents_len == 0 || r->contents_file_len == 0)
+	continue;
+      if (!req_files)
+	{
+	  req_files = calloc (num_reqs, sizeof (*req_files));
+	  if (!req_files)
+	    panic ("%s: ran out of memory while loading %s\n",
+		   prog_name, param.wsesslog.file);
+	}
+
+      name = pool + r->contents_file;
+      for (f = body_files; f; f = f->next)
+	if (strcmp (f->name, name) == 0)
+	  break;
+      if (!f)
+	{
+	  f = malloc (sizeof (*f));
+	  if (!f)
+	    panic ("%s: ran out of memory while loading %s\n",
+		   prog_name, param.wsesslog.file);
+	  f->next = body_files;
+	  body_files = f;
+	  f->name = name;
+	  f->fd = open (name, O_RDONLY);
+	  if (f->fd < 0 || fstat (f->fd, &st) < 0)
+	    panic ("%s: can't open %s: %s\n", prog_name, name,
+		   strerror (errno));
+	  f->size = st.st_size;
+	  f->map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, f->fd, 0);
+	  if (f->map == MAP_FAILED)
+	    panic ("%s: can't map %s: %s\n", prog_name, name,
+		   strerror (errno));
+	}
+      if (r->contents_offset > f->size
+	  || f->size - r->contents_offset < r->contents_len)
+	panic ("%s: %s is shorter than the contents of %s in %s\n",
+	       prog_name, name, pool + r->uri, param.wsesslog.file);
+      req_files[i] = f;
+    }
+}
+
+void
+wsesslog_compile (const char *file)
+{
+  Wsl_Header hdr;
+  FILE *fp;
+
+  load_config ();
+
+  memset (&hdr, 0, sizeof (hdr));
+  memcpy (hdr.magic, WSL_MAGIC, sizeof (hdr.magic));
+  hdr.version = WSL_VERSION;
+  hdr.byte_order = WSL_BYTE_ORDER;
+  hdr.num_sessions = num_templates;
+  hdr.num_bursts = num_bursts;
+  hdr.num_reqs = num_reqs;
+  hdr.pool_size = pool_size;
+
+  fp = fopen (file, "w");
+  if (fp == NULL)
+    panic ("%s: can't create %s: %s\n", prog_name, file, strerror (errno));
+  if (fwrite (&hdr, sizeof (hdr), 1, fp) != 1
+      || fwrite (session_templates, sizeof (Wsl_Session), num_templates, fp)
+	 != num_templates
+      || fwrite (bursts, sizeof (Wsl_Burst), num_bursts, fp) != num_bursts
+      || fwrite (reqs, sizeof (Wsl_Req), num_reqs, fp) != num_reqs
+      || fwrite (pool, 1, pool_size, fp) != pool_size
+      || fclose (fp) != 0)
+    panic ("%s: can't write %s: %s\n", prog_name, file, strerror (errno));
+
+  printf ("%s: compiled %u sessions with %u requests into %s\n",
+	  prog_name, num_templates, num_reqs, file);
+}
+
 static void
 init (void)
 {
   Any_Type arg;
+  u_int i;
+
+  load_config ();
+  open_body_files ();
 
-  parse_config ();
+  if (param.uri_stats)
+    {
+      uri_keys = malloc (num_reqs * sizeof (*uri_keys));
+      if (uri_keys == NULL)
+	panic ("%s: ran out of memory while loading %s\n",
+	       prog_name, param.wsesslog.file);
+      for (i = 0; i < num_reqs; ++i)
+	uri_keys[i] = uri_stat_key (pool + reqs[i].uri, reqs[i].uri_len);
+    }
 
   sess_private_data_offset = object_expand (OBJ_SESS,
 					    sizeof (Sess_Private_Data));
@@ -33,7 +33,10 @@
 
 /* Similar to wsess but instead of generating fixed bursts, each
    fetched html page is parsed and the embedded objects are fetched in
-   a burst.
+   a burst.  Like a browser, a session fetches each object only once
+   (it has a cache) and spreads the embedded objects over up to
+   --max-connections connections (6 by default), pipelining up to
+   --max-piped-calls requests on each.
 
    This is NOT a high performance workload generator!  Use it only for
    non-performance critical tests.  */
@@ -59,6 +62,9 @@
 #include <rate.h>
 #include <session.h>
 
+#define OFFSET_BASIS	0xcbf29ce484222325ULL	/* of FNV-1a */
+#define BROWSER_CONNS	6	/* default # of connections per session */
+
 #define CALL_PRIVATE_DATA(c) \
   ((Call_Private_Data *) ((char *)(c) + call_private_data_offset))
 #define SESS_PRIVATE_DATA(c) \
@@ -100,6 +106,11 @@ typedef struct Sess_Private_Data
 	char uri[1];		/* really URI_LEN+1 bytes... */
       }
     *uri_list;
+    /* Hashes of the URIs fetched so far (an open-addressing hash set
+       with NUM_SEEN of SEEN_SIZE slots used; 0 marks a free slot): */
+    u_wide *seen;
+    u_int seen_size;
+    u_int num_seen;
   }
 Sess_Private_Data;
 
@@ -113,6 +124,52 @@ static Rate_Generator rg_sess;
 static size_t prefix_len;
 static char *prefix;
 
+static u_wide
+hash_uri (u_wide h, const char *uri, size_t uri_len)
+{
+  /* FNV-1a */
+  while (uri_len-- > 0)
+    h = (h ^ (u_char) *uri++) * 0x100000001b3ULL;
+  return h;
+}
+
+/* Returns non-zero if the URI with hash H has been fetched by this
+   session before and remembers it otherwise.  */
+static int
+seen_before (Sess_Private_Data *priv, u_wide h)
+{
+  u_wide *old = priv->seen;
+  u_int i, j, old_size = priv->seen_size;
+
+  if (h == 0)
+    h = 1;
+
+  if (2 * (priv->num_seen + 1) > priv->seen_size)
+    {
+      priv->seen_size = old_size ? 2 * old_size : 64;
+      priv->seen = calloc (priv->seen_size, sizeof (priv->seen[0]));
+      if (!priv->seen)
+	panic ("%s.seen_before: out of memory!\n", prog_name);
+      for (i = 0; i < old_size; ++i)
+	if (old[i])
+	  {
+	    for (j = old[i] & (priv->seen_size - 1); priv->seen[j];
+		 j = (j + 1) & (priv->seen_size - 1))
+	      ;
+	    priv->seen[j] = old[i];
+	  }
+      free (old);
+    }
+
+  for (i = h & (priv->seen_size - 1); priv->seen[i];
+       i = (i + 1) & (priv->seen_size - 1))
+    if (priv->seen[i] == h)
+      return 1;
+  priv->seen[i] = h;
+  ++priv->num_seen;
+  return 0;
+}
+
 static void
 issue_calls (Sess *sess, Sess_Private_Data *priv)
 {
@@ -155,7 +212,10 @@ issue_calls (Sess *sess, Sess_Private_Data *priv)
 	printf ("%s: fetching `%s'\n",
 		prog_name, (char *)call->req.iov[IE_URI].iov_base);
 
-      retval = session_issue_call (sess, call);
+      if (embedded)
+	retval = session_issue_call_parallel (sess, call);
+      else
+	retval = session_issue_call (sess, call);
       call_dec_ref (call);
       if (retval < 0)
 	return;
@@ -170,6 +230,7 @@ fetch_uri (Sess *sess, Sess_Private_Data *priv, Call_Private_Data *cpriv,
   int is_relative;
   size_t len;
   char *dst;
+  u_wide h;
 
   if (strchr (uri, ':'))
     {
@@ -194,6 +255,15 @@ fetch_uri (Sess *sess, Sess_Private_Data *priv, Call_Private_Data *cpriv,
 
   is_relative = (uri[0] != '/');
 
+  h = hash_uri (OFFSET_BASIS, is_relative ? prefix : "",
+		is_relative ? prefix_len : 0);
+  if (seen_before (priv, hash_uri (h, uri, uri_len)))
+    {
+      if (verbose > 1)
+	printf ("%s: `%.*s' is cached\n", prog_name, (int) uri_len, uri);
+      return;
+    }
+
   /* enqueue the new uri: */
   len = uri_len;
   if (is_relative)
@@ -488,7 +558,10 @@ sess_create (Any_Type arg)
 
   priv = SESS_PRIVATE_DATA (sess);
 
-  issue_calls (sess, SESS_PRIVATE_DATA (sess));
+  /* the page itself is in the cache too */
+  seen_before (priv, hash_uri (OFFSET_BASIS, param.uri, strlen (param.uri)));
+
+  issue_calls (sess, priv);
   return 0;
 }
 
@@ -507,6 +580,9 @@ sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
       timer_cancel (priv->timer);
       priv->timer = 0;
     }
+  free (priv->seen);
+  priv->seen = 0;
+  priv->seen_size = priv->num_seen = 0;
 
   if (++num_sessions_destroyed >= param.wsesspage.num_sessions)
     core_exit ();
@@ -527,6 +603,8 @@ init (void)
   prefix = strdup (param.uri);
   prefix[prefix_len] = '\0';
 
+  if (!param.max_conns)
+    param.max_conns = BROWSER_CONNS;
   session_init ();
 
   call_private_data_offset = object_expand (OBJ_CALL,
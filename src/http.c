@@ -39,6 +39,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <generic_types.h>
 
@@ -50,60 +53,159 @@
 #include <httperf.h>
 #include <http.h>
 
-/* Read a CRLF terminated line of characters into c->reply.line.
+/* States of the chunk decoder (Conn.chunk_state), see xfer_chunked().  */
+enum
+  {
+    CHUNK_START,		/* expecting a chunk-size line */
+    CHUNK_SIZE,			/* in the hex digits of the size */
+    CHUNK_EXT,			/* in the rest of the chunk-size line */
+    CHUNK_DATA,			/* in the chunk's data */
+    CHUNK_CRLF			/* in the line ending the chunk's data */
+  };
+
+/* Returns a pointer to the first '\n' in the LEN bytes at BUF or 0 if
+   there is none.  Most header lines are short, so scan 16 bytes at a
+   time where SSE2 is available rather than calling memchr().  */
+static char *
+find_lf (char *buf, size_t len)
+{
+#ifdef __SSE2__
+  const __m128i lf = _mm_set1_epi8 ('\n');
+  char *end = buf + len;
+  int mask;
+
+  for (; end - buf >= 16; buf += 16)
+    {
+      mask = _mm_movemask_epi8 (_mm_cmpeq_epi8
+				(_mm_loadu_si128 ((const __m128i *) buf), lf));
+      if (mask)
+	return buf + __builtin_ctz (mask);
+    }
+  len = end - buf;
+#endif
+  return memchr (buf, '\n', len);
+}
+
+/* Append the LEN bytes at BUF to the partial line saved in S->line,
+   leasing a save buffer for a new line and growing it as needed.  */
+static void
+save_line (Conn *s, const char *buf, size_t len)
+{
+  size_t size = s->line_save_size;
+  char *save;
+
+  if (!s->line_save)
+    {
+      s->line_save = conn_line_lease ();
+      s->line_save_size = size = MAX_HDR_LINE_LEN;
+    }
+  if (s->line.iov_len == 0)
+    s->line.iov_base = s->line_save;
+  if (s->line.iov_len + len >= size)
+    {
+      while (s->line.iov_len + len >= size)
+	size *= 2;
+      save = malloc (size);
+      if (!save)
+	{
+	  fprintf (stderr, "%s.save_line: out of memory\n", prog_name);
+	  exit (1);
+	}
+      memcpy (save, s->line_save, s->line.iov_len);
+      conn_line_release (s);
+      s->line_save = s->line.iov_base = save;
+      s->line_save_size = size;
+    }
+  memcpy ((char *) s->line.iov_base + s->line.iov_len, buf, len);
+  s->line.iov_len += len;
+}
+
+/* Get the next CRLF terminated line of characters into c->conn->line.
    Returns 1 when the line is complete, 0 when the line is incomplete
-   and more data is needed.  */
+   and more data is needed.  A complete line is '\0' terminated (with
+   the CRLF chopped off) and normally points right into the receive
+   buffer; only a line that spans two reads is copied to a save buffer,
+   which is given back once the next line is looked for.  The caller
+   must reset s->line.iov_len to zero once it is done with a complete
+   line.  */
 static int
 get_line (Call *c, char **bufp, size_t *buf_lenp)
 {
-  size_t to_copy, buf_len = *buf_lenp;
+  size_t len, buf_len = *buf_lenp;
   Conn *s = c->conn;
   char *buf = *bufp;
-  const char *eol;
-  int has_lf;
+  char *eol;
 
   if (buf_len <= 0)
     return 0;
 
-  /* Note that core.c guarantees that BUF is '\0' terminated. */
-  eol = strchr (buf, '\n');
-  if (eol)
-    ++eol;
-  else
-    eol = buf + buf_len;
+  if (s->line.iov_len == 0 && s->line_save)
+    conn_line_release (s);
 
-  to_copy = eol - buf;
-  buf_len -= to_copy;
-  if (s->line.iov_len + to_copy >= sizeof (s->line_buf))
+  eol = find_lf (buf, buf_len);
+  if (!eol)
     {
-      fprintf (stderr,
-	       "%s.get_line: truncating header from %lu to %lu bytes\n",
-	       prog_name, (u_long) (s->line.iov_len + to_copy),
-	       (u_long) sizeof (s->line_buf));
-      to_copy = sizeof (s->line_buf) - 1 - s->line.iov_len;
+      /* the line continues in the next read */
+      save_line (s, buf, buf_len);
+      *bufp = buf + buf_len;
+      *buf_lenp = 0;
+      return 0;
     }
-  memcpy ((char *) s->line.iov_base + s->line.iov_len, buf, to_copy);
-  s->line.iov_len += to_copy;
 
-  has_lf = ((char *) s->line.iov_base)[s->line.iov_len - 1] == '\n';
+  len = eol - buf;
+  *bufp = eol + 1;
+  *buf_lenp = buf_len - (len + 1);
 
-  *bufp = (char *) eol;
-  *buf_lenp = buf_len;
-
-  if (has_lf || s->line.iov_len == sizeof (s->line_buf) - 1)
+  if (s->line.iov_len == 0)
     {
-      /* We got a full header line.  Chop off \r\n at the tail if
-	 necessary.  */
-      if (((char *) s->line.iov_base)[s->line.iov_len - 1] == '\n')
-	{
-	  --s->line.iov_len;
-	  if (((char *) s->line.iov_base)[s->line.iov_len - 1] == '\r')
-	    --s->line.iov_len;
-	}
-      ((char *) s->line.iov_base)[s->line.iov_len] = '\0';
-      return 1;
+      /* common case: the whole line is in this buffer; use it in place */
+      s->line.iov_base = buf;
+      s->line.iov_len = len;
     }
-  return 0;
+  else
+    save_line (s, buf, len);
+
+  /* Chop off \r\n at the tail if necessary.  */
+  buf = s->line.iov_base;
+  if (s->line.iov_len > 0 && buf[s->line.iov_len - 1] == '\r')
+    --s->line.iov_len;
+  buf[s->line.iov_len] = '\0';
+  return 1;
+}
+
+/* Parse an unsigned decimal number at *CPP, advancing *CPP past it.
+   Returns 0 if there is no number there.  */
+static int
+parse_uint (const char **cpp, u_int *valp)
+{
+  const char *cp = *cpp;
+  u_int val = 0;
+
+  if (!isdigit ((u_char) *cp))
+    return 0;
+  do
+    val = 10*val + (*cp++ - '0');
+  while (isdigit ((u_char) *cp));
+  *cpp = cp;
+  *valp = val;
+  return 1;
+}
+
+/* Parse "HTTP/<major>.<minor> <status>" at the start of status line
+   LINE.  Returns 0 if LINE doesn't look like a status line.  */
+static int
+parse_status (const char *line, u_int *major, u_int *minor, u_int *status)
+{
+  const char *cp = line;
+
+  if (strncmp (cp, "HTTP/", 5) != 0)
+    return 0;
+  cp += 5;
+  if (!parse_uint (&cp, major) || *cp++ != '.' || !parse_uint (&cp, minor))
+    return 0;
+  while (isspace ((u_char) *cp))
+    ++cp;
+  return parse_uint (&cp, status);
 }
 
 static void
@@ -123,7 +225,7 @@ parse_status_line (Call *c, char **bufp, size_t *buf_lenp)
     return;
 
   buf = c->conn->line.iov_base;
-  if (sscanf (buf, "HTTP/%u.%u %u ", &major, &minor, &status) == 3)
+  if (parse_status (buf, &major, &minor, &status))
     {
       c->reply.version = 0x10000*major + minor;
       c->reply.status = status;
@@ -131,11 +233,14 @@ parse_status_line (Call *c, char **bufp, size_t *buf_lenp)
   else
     {
       c->reply.version = 0x10000;		/* default to 1.0 */
-      c->reply.status = 599;
-      if (c->reply.status == 599)
-	fprintf (stderr, "%s.parse_status_line: invalid status line `%s'!!\n",
-		 prog_name, buf);
+      c->reply.status = status = 599;
+      fprintf (stderr, "%s.parse_status_line: invalid status line `%s'!!\n",
+	       prog_name, buf);
     }
+  /* An HTTP/1.0 server closes the connection after the reply unless
+     it says otherwise.  */
+  s->server_close = (c->reply.version < 0x10001);
+
   if (DBG > 0)
     fprintf (stderr,
 	     "parse_status_line.%lu: reply is HTTP/%u.%u, status = %d\n",
@@ -213,14 +318,24 @@ parse_headers (Call *c, char **bufp, size_t *buf_lenp)
       if (!hdr_len)
 	{
 	  /* empty header implies end of headers */
+	  if (s->line_save)
+	    conn_line_release (s);
 	  if (s->has_body)
 	    if (s->is_chunked)
 	      {
 		s->content_length = 0;
+		s->chunk_size = 0;
+		s->chunk_state = CHUNK_START;
 		s->state = S_REPLY_CHUNKED;
 	      }
 	    else
-	      s->state = S_REPLY_DATA;
+	      {
+		/* without a length, the body ends when the server closes
+		   the connection */
+		if (s->content_length == ~(size_t) 0)
+		  s->server_close = 1;
+		s->state = S_REPLY_DATA;
+	      }
 	  else if (s->state == S_REPLY_CONTINUE)
 	    s->state = S_REPLY_HEADER;
 	  else
@@ -239,6 +354,16 @@ parse_headers (Call *c, char **bufp, size_t *buf_lenp)
 	      if (!s->content_length)
 	    s->has_body = 0;
 	    }
+	  else if (strncasecmp (hdr, "connection:", 11) == 0)
+	    {
+	      hdr += 11;
+	      while (isspace (*hdr))
+		++hdr;
+	      if (strncasecmp (hdr, "close", 5) == 0)
+		s->server_close = 1;
+	      else if (strncasecmp (hdr, "keep-alive", 10) == 0)
+		s->server_close = 0;
+	    }
 	  break;
 
 	case 't':
@@ -311,6 +436,8 @@ parse_data (Call *c, char **bufp, size_t *buf_lenp)
   iov.iov_len = buf_len;
   arg.vp = &iov;
   event_signal (EV_CALL_RECV_DATA, (Object *) c, arg);
+  if (c->reply.sampled)
+    event_signal (EV_CALL_RECV_SAMPLE, (Object *) c, arg);
 
   c->reply.content_bytes += buf_len;
   *bufp = buf + buf_len;
@@ -319,43 +446,116 @@ parse_data (Call *c, char **bufp, size_t *buf_lenp)
   return (buf_len == bytes_needed);
 }
 
+/* Returns the end of the line that starts at CP, that is, the byte
+   after its '\n', or 0 if it doesn't end before END.  The lines the
+   chunk decoder skips are mostly a bare CRLF.  */
+static char *
+skip_line (char *cp, char *end)
+{
+  if (end - cp >= 2 && cp[0] == '\r' && cp[1] == '\n')
+    return cp + 2;
+  cp = find_lf (cp, end - cp);
+  return cp ? cp + 1 : 0;
+}
+
+/* Decode the chunked body of a reply.  Chunk-size lines are parsed in
+   place, a digit at a time, so a size split over two reads needs no
+   copy; the state in between is kept in S->chunk_state and
+   S->chunk_size.  The bytes of a chunk go to parse_data() all at once
+   (and those the core drains without reading, see discardable_body()
+   in core.c, never come here).  While a chunk is being received,
+   S->content_length is the number of body bytes up to its end.  */
 static void
 xfer_chunked  (Call *c, char **bufp, size_t *buf_lenp)
 {
   Conn *s = c->conn;
-  size_t chunk_length;
-  char *end;
-
-  while (*buf_lenp > 0 && s->state < S_CLOSING)
-    {
-      if (c->reply.content_bytes >= s->content_length)
-	{
-	  /* need to parse next chunk length line: */
-	  if (!get_line (c, bufp, buf_lenp))
-	    return;				/* need more data */
-	  if (s->line.iov_len == 0)
-	    continue;				/* skip over empty line */
-
-	  errno = 0;
-	  chunk_length = strtoul (s->line.iov_base, &end, 16);
-	  s->line.iov_len = 0;
-	  if (errno == ERANGE || end == s->line.iov_base)
-	    {
-	      fprintf (stderr, "%s.xfer_chunked: bad chunk line `%s'\n",
-		       prog_name, (char *) s->line.iov_base);
-	      continue;
-	    }
-
-	  if (chunk_length == 0)
-	    {
-	      /* a final chunk of zero bytes indicates the end of the reply */
-	      s->state = S_REPLY_FOOTER;
-	      return;
-	    }
-	  s->content_length += chunk_length;
-	}
-      parse_data (c, bufp, buf_lenp);
-    }
+  char *cp = *bufp, *end = cp + *buf_lenp, *eol;
+  u_int digit;
+
+  while (cp < end && s->state == S_REPLY_CHUNKED)
+    switch (s->chunk_state)
+      {
+      case CHUNK_START:
+      case CHUNK_SIZE:
+	for (; cp < end; ++cp)
+	  {
+	    digit = (u_char) *cp - '0';
+	    if (digit > 9)
+	      {
+		digit = ((u_char) *cp | 0x20) - 'a' + 10;
+		if (digit < 10 || digit > 15)
+		  break;
+	      }
+	    if (s->chunk_size > (~(size_t) 0 >> 4))
+	      break;
+	    s->chunk_size = (s->chunk_size << 4) | digit;
+	    s->chunk_state = CHUNK_SIZE;
+	  }
+	if (cp == end)
+	  break;			/* the size continues in the next read */
+	if (s->chunk_state == CHUNK_START && (*cp == '\r' || *cp == '\n'))
+	  {
+	    /* skip over empty line */
+	    s->chunk_state = CHUNK_CRLF;
+	    break;
+	  }
+	if (s->chunk_state == CHUNK_START
+	    || (*cp != '\r' && *cp != '\n' && *cp != ';' && *cp != ' '
+		&& *cp != '\t'))
+	  {
+	    fprintf (stderr, "%s.xfer_chunked: bad chunk size line\n",
+		     prog_name);
+	    s->chunk_size = 0;
+	    s->chunk_state = CHUNK_CRLF;
+	    break;
+	  }
+	s->chunk_state = CHUNK_EXT;
+	/* fall through */
+
+      case CHUNK_EXT:
+	/* skip chunk extensions and the CRLF */
+	eol = skip_line (cp, end);
+	if (!eol)
+	  {
+	    cp = end;
+	    break;
+	  }
+	cp = eol;
+	if (s->chunk_size == 0)
+	  {
+	    /* a final chunk of zero bytes indicates the end of the reply */
+	    s->state = S_REPLY_FOOTER;
+	    break;
+	  }
+	s->content_length += s->chunk_size;
+	s->chunk_size = 0;
+	s->chunk_state = CHUNK_DATA;
+	/* fall through */
+
+      case CHUNK_DATA:
+	if (c->reply.content_bytes < s->content_length)
+	  {
+	    *buf_lenp = end - cp;
+	    if (!parse_data (c, &cp, buf_lenp))
+	      break;			/* the chunk continues in the next read */
+	  }
+	s->chunk_state = CHUNK_CRLF;
+	/* fall through */
+
+      case CHUNK_CRLF:
+	/* skip the CRLF after the chunk's data */
+	eol = skip_line (cp, end);
+	if (!eol)
+	  {
+	    cp = end;
+	    break;
+	  }
+	cp = eol;
+	s->chunk_state = CHUNK_START;
+	break;
+      }
+  *bufp = cp;
+  *buf_lenp = end - cp;
 }
 
 void
@@ -0,0 +1,1514 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The HTTP/2 framing layer.  Requests are HPACK encoded without Huffman
+ * coding; header fields are entered into the dynamic table so that the
+ * ones every request on a connection repeats (:authority, user-agent, extra
+ * headers) shrink to a byte each after the first request.  Replies are
+ * decoded in full and handed to the rest of httperf as the same events an
+ * HTTP/1.x reply produces: a ":status" pseudo-header triggers
+ * EV_CALL_RECV_START and every regular header field is passed on as a
+ * "name: value" line.
+ *
+ * Server push is turned off in our SETTINGS.  A stream the server resets
+ * fails only its own call, and the other streams go on.  Calls the server
+ * never processed (a stream refused with REFUSED_STREAM, or one above the
+ * last stream ID of a GOAWAY) go back on the send queue; after a GOAWAY
+ * they fail the connection once its other streams are done, so that the
+ * session workloads issue them on a new one.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/uio.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <localevent.h>
+#include <http2.h>
+
+#define	PREFACE			"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+#define	FRAME_HDR_LEN		9
+#define	DEFAULT_FRAME_SIZE	16384	/* also the largest frame we accept */
+#define	DEFAULT_WINDOW		65535
+#define	RECV_WINDOW		(1 << 24)	/* what the server may send ahead */
+#define	MAX_WINDOW		0x7fffffffL
+#define	MAX_STREAM_ID		0x7fffffffU
+
+/*
+ * Streams open at once on a connection (a power of two).  A stream lives in
+ * slot (id / 2) % MAX_STREAMS; stream IDs that would land on a busy slot are
+ * skipped, which RFC 7540 allows.
+ */
+#define	MAX_STREAMS		128
+#define	SLOT(id)		(((id) >> 1) & (MAX_STREAMS - 1))
+
+/*
+ * Until its SETTINGS arrive, assume the server takes as many streams as RFC
+ * 7540 recommends it should; opening more could get them refused.
+ */
+#define	INITIAL_MAX_STREAMS	100
+
+#define	OUT_HIGH_WATER		(64 * 1024)	/* request body queued ahead */
+#define	TABLE_SIZE		4096	/* HPACK dynamic table size */
+#define	MAX_FIELD		16384	/* longest header field we accept */
+
+enum {
+	DATA, HEADERS, PRIORITY, RST_STREAM, SETTINGS, PUSH_PROMISE, PING,
+	GOAWAY, WINDOW_UPDATE, CONTINUATION
+};
+
+#define	F_END_STREAM		0x01
+#define	F_ACK			0x01
+#define	F_END_HEADERS		0x04
+#define	F_PADDED		0x08
+#define	F_PRIORITY		0x20
+
+#define	SET_HEADER_TABLE_SIZE	1
+#define	SET_ENABLE_PUSH		2
+#define	SET_MAX_CONCURRENT_STREAMS 3
+#define	SET_INITIAL_WINDOW_SIZE	4
+#define	SET_MAX_FRAME_SIZE	5
+
+#define	NO_ERROR		0
+#define	REFUSED_STREAM		7
+
+struct h2_buf {
+	char           *data;
+	size_t          len, size;
+};
+
+struct h2_stream {
+	Call           *call;	/* 0 if the slot is free */
+	u_int           id;
+	long            send_window;
+	const char     *body;	/* request body still to be sent */
+	size_t          body_left;
+	u_wide          end_offset;	/* where the request ends in the output */
+	size_t          recv_unacked;	/* received but not acknowledged */
+	u_int           queued:1;	/* all of the request is in the output */
+	u_int           sent:1;	/* EV_CALL_SEND_STOP has been signalled */
+	u_int           have_status:1;
+	u_int           headers_done:1;	/* further headers are trailers */
+	u_int           interim:1;	/* block being decoded is a 1xx reply */
+};
+
+struct hp_entry {
+	u_int           off;	/* into data[] */
+	u_int           name_len, value_len;
+};
+
+/*
+ * An HPACK dynamic table, oldest entry first.
+ */
+struct hp_table {
+	struct hp_entry entry[TABLE_SIZE / 32];
+	u_int           num_entries;
+	size_t          len;	/* bytes used in data[] */
+	size_t          size;	/* as defined by RFC 7541 */
+	size_t          max;
+	char            data[TABLE_SIZE];
+};
+
+struct H2_Conn {
+	struct h2_stream stream[MAX_STREAMS];
+	u_int           num_streams;
+	u_int           num_bodies;	/* streams with a body left to send */
+	u_int           num_unsent;	/* queued streams not yet written */
+	u_int           next_id;
+	u_int           peer_max_streams;
+	u_int           peer_max_frame;
+	long            peer_window;	/* initial window of new streams */
+	long            send_window;
+	size_t          recv_unacked;
+	u_int           goaway:1;	/* no more streams can be started */
+	u_int           got_settings:1;
+
+	struct h2_buf   out;	/* frames waiting to be written */
+	size_t          out_start;	/* first byte not written yet */
+	u_wide          out_total;	/* bytes ever queued */
+	u_wide          out_written;	/* bytes ever written */
+
+	struct h2_buf   in;	/* frame spanning reads */
+	struct h2_buf   block;	/* header block spanning frames */
+	u_int           block_id;	/* its stream (or 0) */
+	u_char          block_flags;	/* flags of its HEADERS frame */
+	size_t          block_bytes;	/* frame bytes it took */
+
+	struct h2_buf   enc;	/* request header block */
+	struct hp_table enc_table;	/* what the server's decoder holds */
+	u_int           enc_resized:1;	/* announce enc_table.max */
+	struct hp_table dec_table;
+};
+
+#define	E(n, v)		{ n, sizeof(n) - 1, v, sizeof(v) - 1 }
+
+static const struct {
+	const char     *name;
+	size_t          name_len;
+	const char     *value;
+	size_t          value_len;
+} static_table[] = {
+	E(":authority", ""), E(":method", "GET"), E(":method", "POST"),
+	E(":path", "/"), E(":path", "/index.html"), E(":scheme", "http"),
+	E(":scheme", "https"), E(":status", "200"), E(":status", "204"),
+	E(":status", "206"), E(":status", "304"), E(":status", "400"),
+	E(":status", "404"), E(":status", "500"), E("accept-charset", ""),
+	E("accept-encoding", "gzip, deflate"), E("accept-language", ""),
+	E("accept-ranges", ""), E("accept", ""),
+	E("access-control-allow-origin", ""), E("age", ""), E("allow", ""),
+	E("authorization", ""), E("cache-control", ""),
+	E("content-disposition", ""), E("content-encoding", ""),
+	E("content-language", ""), E("content-length", ""),
+	E("content-location", ""), E("content-range", ""),
+	E("content-type", ""), E("cookie", ""), E("date", ""), E("etag", ""),
+	E("expect", ""), E("expires", ""), E("from", ""), E("host", ""),
+	E("if-match", ""), E("if-modified-since", ""), E("if-none-match", ""),
+	E("if-range", ""), E("if-unmodified-since", ""),
+	E("last-modified", ""), E("link", ""), E("location", ""),
+	E("max-forwards", ""), E("proxy-authenticate", ""),
+	E("proxy-authorization", ""), E("range", ""), E("referer", ""),
+	E("refresh", ""), E("retry-after", ""), E("server", ""),
+	E("set-cookie", ""), E("strict-transport-security", ""),
+	E("transfer-encoding", ""), E("user-agent", ""), E("vary", ""),
+	E("via", ""), E("www-authenticate", "")
+};
+
+#define	NUM_STATIC		NELEMS(static_table)
+
+/*
+ * Static table indices the request encoder uses.
+ */
+#define	IDX_AUTHORITY		1
+#define	IDX_METHOD_GET		2
+#define	IDX_METHOD_POST		3
+#define	IDX_PATH_ROOT		4
+#define	IDX_SCHEME_HTTP		6
+#define	IDX_SCHEME_HTTPS	7
+#define	IDX_USER_AGENT		58
+#define	FIRST_REGULAR		15	/* first entry that isn't a pseudo-header */
+
+/*
+ * Header fields that have no meaning in HTTP/2 (RFC 7540, 8.1.2.2).  Host
+ * becomes the :authority pseudo-header.
+ */
+static const char *const hop_by_hop[] = {
+	"connection", "keep-alive", "proxy-connection", "transfer-encoding",
+	"upgrade", "host"
+};
+
+/*
+ * Lengths of the codes of the HPACK Huffman code (RFC 7541, Appendix B),
+ * indexed by symbol; 256 is EOS.  The code is canonical, so these are all
+ * that's needed to rebuild it.
+ */
+static const u_char huff_len[257] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+	28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+	6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+	5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+	13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+	15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+	6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+	20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+	24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+	22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+	21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+	26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+	19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+	20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+	26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+	30,
+};
+
+#define	HUFF_MAX_LEN		30
+
+static u_int    huff_first[HUFF_MAX_LEN + 1];	/* first code of each length */
+static u_int    huff_count[HUFF_MAX_LEN + 1];
+static u_int    huff_offset[HUFF_MAX_LEN + 1];	/* into huff_sym[] */
+static u_short  huff_sym[257];		/* symbols ordered by code */
+
+/*
+ * The header line handed to EV_CALL_RECV_HDR and EV_CALL_RECV_FOOTER.
+ */
+static char     line[MAX_FIELD + 4];
+
+static void
+huff_init(void)
+{
+	u_int           code, len, sym, n;
+
+	for (sym = 0; sym < NELEMS(huff_len); ++sym)
+		++huff_count[huff_len[sym]];
+	code = n = 0;
+	for (len = 1; len <= HUFF_MAX_LEN; ++len) {
+		huff_first[len] = code;
+		huff_offset[len] = n;
+		code = (code + huff_count[len]) << 1;
+		n += huff_count[len];
+	}
+	for (len = 1; len <= HUFF_MAX_LEN; ++len)
+		for (sym = 0; sym < NELEMS(huff_len); ++sym)
+			if (huff_len[sym] == len)
+				huff_sym[huff_offset[len]++] = sym;
+	for (len = 1; len <= HUFF_MAX_LEN; ++len)
+		huff_offset[len] -= huff_count[len];
+}
+
+/*
+ * Decode the LEN Huffman coded bytes at P into DST, which has room for ROOM
+ * bytes.  Returns the decoded length or -1 if the string is malformed.
+ */
+static ssize_t
+huff_decode(const u_char *p, size_t len, char *dst, size_t room)
+{
+	u_int           code = 0, bits = 0;
+	size_t          n = 0;
+	int             b;
+
+	for (; len > 0; --len, ++p)
+		for (b = 7; b >= 0; --b) {
+			code = (code << 1) | ((*p >> b) & 1);
+			if (++bits > HUFF_MAX_LEN)
+				return -1;
+			if (code - huff_first[bits] < huff_count[bits]) {
+				code = huff_sym[huff_offset[bits] + code
+				    - huff_first[bits]];
+				if (code == 256 || n == room)
+					return -1;
+				dst[n++] = code;
+				code = bits = 0;
+			}
+		}
+	/*
+	 * Padding is the most significant bits of EOS: fewer than eight
+	 * one-bits.
+	 */
+	if (bits > 7 || code != (1U << bits) - 1)
+		return -1;
+	return n;
+}
+
+static char *
+buf_grow(struct h2_buf *b, size_t n)
+{
+	size_t          size;
+	char           *data;
+
+	if (b->len + n > b->size) {
+		size = b->size ? b->size : 1024;
+		while (size < b->len + n)
+			size *= 2;
+		data = realloc(b->data, size);
+		if (!data) {
+			fprintf(stderr, "%s.http2: out of memory\n", prog_name);
+			exit(1);
+		}
+		b->data = data;
+		b->size = size;
+	}
+	return b->data + b->len;
+}
+
+static void
+buf_add(struct h2_buf *b, const void *data, size_t n)
+{
+	memcpy(buf_grow(b, n), data, n);
+	b->len += n;
+}
+
+static u_int
+get24(const u_char *p)
+{
+	return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+static u_int
+get32(const u_char *p)
+{
+	return ((u_int) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void
+put32(char *p, u_int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/*
+ * Queue a frame with a payload of LEN bytes and return where the payload
+ * goes.
+ */
+static char *
+queue_frame(struct H2_Conn *h, size_t len, int type, int flags, u_int id)
+{
+	char           *p;
+
+	p = buf_grow(&h->out, FRAME_HDR_LEN + len);
+	p[0] = len >> 16;
+	p[1] = len >> 8;
+	p[2] = len;
+	p[3] = type;
+	p[4] = flags;
+	put32(p + 5, id);
+	h->out.len += FRAME_HDR_LEN + len;
+	h->out_total += FRAME_HDR_LEN + len;
+	return p + FRAME_HDR_LEN;
+}
+
+static void
+queue_window_update(struct H2_Conn *h, u_int id, size_t inc)
+{
+	put32(queue_frame(h, 4, WINDOW_UPDATE, 0, id), inc);
+}
+
+static struct h2_stream *
+find_stream(struct H2_Conn *h, u_int id)
+{
+	struct h2_stream *st = &h->stream[SLOT(id)];
+
+	return st->call && st->id == id ? st : NULL;
+}
+
+void
+h2_init(Conn * s)
+{
+	static int      huff_ready;
+	struct H2_Conn *h;
+	char           *p;
+
+	if (!huff_ready) {
+		huff_init();
+		huff_ready = 1;
+	}
+
+	h = calloc(1, sizeof(*h));
+	if (!h) {
+		fprintf(stderr, "%s.h2_init: out of memory\n", prog_name);
+		exit(1);
+	}
+	h->next_id = 1;
+	h->peer_max_streams = INITIAL_MAX_STREAMS;
+	h->peer_max_frame = DEFAULT_FRAME_SIZE;
+	h->peer_window = h->send_window = DEFAULT_WINDOW;
+	h->enc_table.max = h->dec_table.max = TABLE_SIZE;
+
+	buf_add(&h->out, PREFACE, sizeof(PREFACE) - 1);
+	h->out_total = h->out.len;
+	p = queue_frame(h, 12, SETTINGS, 0, 0);
+	p[0] = 0;
+	p[1] = SET_ENABLE_PUSH;
+	put32(p + 2, 0);
+	p[6] = 0;
+	p[7] = SET_INITIAL_WINDOW_SIZE;
+	put32(p + 8, RECV_WINDOW);
+	queue_window_update(h, 0, RECV_WINDOW - DEFAULT_WINDOW);
+
+	s->h2 = h;
+}
+
+void
+h2_free(Conn * s)
+{
+	struct H2_Conn *h = s->h2;
+
+	free(h->out.data);
+	free(h->in.data);
+	free(h->block.data);
+	free(h->enc.data);
+	free(h);
+	s->h2 = NULL;
+}
+
+int
+h2_can_start(Conn * s)
+{
+	struct H2_Conn *h = s->h2;
+
+	return !h->goaway && h->num_streams < MAX_STREAMS
+	    && h->num_streams < h->peer_max_streams;
+}
+
+int
+h2_done(Conn * s)
+{
+	return s->h2->goaway && s->h2->num_streams == 0;
+}
+
+/*
+ * Evict the oldest entries of T until it fits in SIZE.
+ */
+static void
+hp_evict(struct hp_table *t, size_t size)
+{
+	size_t          len = 0;
+	u_int           i, n = 0;
+
+	while (t->size > size) {
+		len += t->entry[n].name_len + t->entry[n].value_len;
+		t->size -= t->entry[n].name_len + t->entry[n].value_len
+		    + 32;
+		++n;
+	}
+	if (n == 0)
+		return;
+	t->num_entries -= n;
+	memmove(t->entry, t->entry + n, t->num_entries * sizeof(t->entry[0]));
+	for (i = 0; i < t->num_entries; ++i)
+		t->entry[i].off -= len;
+	t->len -= len;
+	memmove(t->data, t->data + len, t->len);
+}
+
+static void
+hp_insert(struct hp_table *t, const char *name, size_t name_len,
+    const char *value, size_t value_len)
+{
+	struct hp_entry *e;
+	size_t          size = name_len + value_len + 32;
+
+	if (size > t->max) {
+		hp_evict(t, 0);
+		return;
+	}
+	hp_evict(t, t->max - size);
+	e = &t->entry[t->num_entries++];
+	e->off = t->len;
+	e->name_len = name_len;
+	e->value_len = value_len;
+	memcpy(t->data + t->len, name, name_len);
+	memcpy(t->data + t->len + name_len, value, value_len);
+	t->len += name_len + value_len;
+	t->size += size;
+}
+
+/*
+ * HPACK encoding of the request.
+ */
+
+static void
+enc_int(struct h2_buf *b, int prefix, int bits, size_t val)
+{
+	u_char         *p = (u_char *) buf_grow(b, 2 + sizeof(val) * 8 / 7);
+	size_t          max = (1U << prefix) - 1, n = 0;
+
+	if (val < max)
+		p[n++] = bits | val;
+	else {
+		p[n++] = bits | max;
+		for (val -= max; val >= 0x80; val >>= 7)
+			p[n++] = (val & 0x7f) | 0x80;
+		p[n++] = val;
+	}
+	b->len += n;
+}
+
+static void
+enc_str(struct h2_buf *b, const char *str, size_t len, int lower)
+{
+	char           *p;
+	size_t          i;
+
+	enc_int(b, 7, 0, len);
+	p = buf_grow(b, len);
+	for (i = 0; i < len; ++i)
+		p[i] = lower ? tolower((u_char) str[i]) : str[i];
+	b->len += len;
+}
+
+/*
+ * Encode header field NAME: VALUE.  A field that went out before on the
+ * connection is sent as a reference to the dynamic table, a new one is
+ * entered into it if it fits.  NAME_IDX is the static table entry with the
+ * same name (or 0).
+ */
+static void
+enc_field(struct H2_Conn *h, u_int name_idx, const char *name,
+    size_t name_len, const char *value, size_t value_len)
+{
+	struct hp_table *t = &h->enc_table;
+	struct h2_buf  *b = &h->enc;
+	struct hp_entry *e;
+	u_int           i;
+	size_t          k;
+
+	for (i = t->num_entries; i-- > 0;) {
+		e = &t->entry[i];
+		if (e->name_len != name_len
+		    || strncasecmp(t->data + e->off, name, name_len) != 0)
+			continue;
+		if (e->value_len == value_len && memcmp(t->data + e->off
+			+ name_len, value, value_len) == 0) {
+			enc_int(b, 7, 0x80, NUM_STATIC + t->num_entries - i);
+			return;
+		}
+		if (!name_idx)
+			name_idx = NUM_STATIC + t->num_entries - i;
+	}
+
+	if (name_len + value_len + 32 > t->max) {
+		/*
+		 * literal header field without indexing
+		 */
+		enc_int(b, 4, 0, name_idx);
+		if (!name_idx)
+			enc_str(b, name, name_len, 1);
+		enc_str(b, value, value_len, 0);
+		return;
+	}
+	enc_int(b, 6, 0x40, name_idx);
+	if (!name_idx)
+		enc_str(b, name, name_len, 1);
+	enc_str(b, value, value_len, 0);
+	for (k = 0; k < name_len; ++k)
+		line[k] = tolower((u_char) name[k]);
+	hp_insert(t, line, name_len, value, value_len);
+}
+
+static u_int
+static_name(const char *name, size_t len)
+{
+	u_int           i;
+
+	for (i = FIRST_REGULAR - 1; i < NUM_STATIC; ++i)
+		if (static_table[i].name_len == len
+		    && strncasecmp(static_table[i].name, name, len) == 0)
+			return i + 1;
+	return 0;
+}
+
+/*
+ * Split off the next "Name: value" line of the extra request headers at *PP
+ * (which end at END).  Returns 0 when there are no more.
+ */
+static int
+next_field(const char **pp, const char *end, const char **name,
+    size_t *name_len, const char **value, size_t *value_len)
+{
+	const char     *p, *eol, *colon, *v, *ve;
+
+	for (p = *pp; p < end; p = eol + 1) {
+		eol = memchr(p, '\n', end - p);
+		if (!eol)
+			eol = end;
+		colon = memchr(p, ':', eol - p);
+		if (!colon || colon == p)
+			continue;
+		for (v = colon + 1; v < eol && (*v == ' ' || *v == '\t'); ++v);
+		for (ve = eol; ve > v && isspace((u_char) ve[-1]); --ve);
+		*name = p;
+		*name_len = colon - p;
+		*value = v;
+		*value_len = ve - v;
+		*pp = eol < end ? eol + 1 : end;
+		return 1;
+	}
+	*pp = end;
+	return 0;
+}
+
+static void
+encode_request(Conn * s, Call * c)
+{
+	static const char user_agent[] = "httperf/" VERSION;
+	struct H2_Conn *h = s->h2;
+	struct h2_buf  *b = &h->enc;
+	struct iovec   *iov = c->req.iov;
+	const char     *host, *p, *end, *name, *value;
+	size_t          host_len, name_len, value_len, i;
+	int             hdr;
+
+	/*
+	 * An explicit Host: header wins over the default.
+	 */
+	host = iov[IE_HOST].iov_base;
+	host_len = iov[IE_HOST].iov_len;
+	for (hdr = IE_FIRST_HEADER; hdr <= IE_LAST_HEADER; ++hdr) {
+		p = iov[hdr].iov_base;
+		end = p + iov[hdr].iov_len;
+		while (next_field(&p, end, &name, &name_len, &value,
+			&value_len))
+			if (name_len == 4 && strncasecmp(name, "host", 4) == 0) {
+				host = value;
+				host_len = value_len;
+			}
+	}
+
+	b->len = 0;
+	if (h->enc_resized) {
+		enc_int(b, 5, 0x20, h->enc_table.max);
+		h->enc_resized = 0;
+	}
+	p = iov[IE_METHOD].iov_base;
+	if (iov[IE_METHOD].iov_len == 3 && memcmp(p, "GET", 3) == 0)
+		enc_int(b, 7, 0x80, IDX_METHOD_GET);
+	else if (iov[IE_METHOD].iov_len == 4 && memcmp(p, "POST", 4) == 0)
+		enc_int(b, 7, 0x80, IDX_METHOD_POST);
+	else
+		enc_field(h, IDX_METHOD_GET, ":method", 7, p,
+		    iov[IE_METHOD].iov_len);
+#ifdef HAVE_SSL
+	if (param.use_ssl)
+		enc_int(b, 7, 0x80, IDX_SCHEME_HTTPS);
+	else
+#endif
+		enc_int(b, 7, 0x80, IDX_SCHEME_HTTP);
+	p = iov[IE_URI].iov_base;
+	if (iov[IE_URI].iov_len == 1 && *p == '/')
+		enc_int(b, 7, 0x80, IDX_PATH_ROOT);
+	else
+		enc_field(h, IDX_PATH_ROOT, ":path", 5, p, iov[IE_URI].iov_len);
+	if (host_len > 0)
+		enc_field(h, IDX_AUTHORITY, ":authority", 10, host, host_len);
+	enc_field(h, IDX_USER_AGENT, "user-agent", 10, user_agent,
+	    sizeof(user_agent) - 1);
+
+	for (hdr = IE_FIRST_HEADER; hdr <= IE_LAST_HEADER; ++hdr) {
+		p = iov[hdr].iov_base;
+		end = p + iov[hdr].iov_len;
+		while (next_field(&p, end, &name, &name_len, &value,
+			&value_len)) {
+			for (i = 0; i < NELEMS(hop_by_hop); ++i)
+				if (strlen(hop_by_hop[i]) == name_len
+				    && strncasecmp(hop_by_hop[i], name,
+					name_len) == 0)
+					break;
+			if (i < NELEMS(hop_by_hop))
+				continue;
+			enc_field(h, static_name(name, name_len), name,
+			    name_len, value, value_len);
+		}
+	}
+}
+
+void
+h2_submit(Conn * s, Call * call)
+{
+	struct H2_Conn *h = s->h2;
+	struct h2_stream *st;
+	u_wide          start = h->out_total;
+	const char     *p;
+	size_t          left, n;
+	int             type, flags;
+
+	assert(h2_can_start(s));
+
+	while (h->stream[SLOT(h->next_id)].call)
+		h->next_id += 2;
+	st = &h->stream[SLOT(h->next_id)];
+	memset(st, 0, sizeof(*st));
+	st->call = call;
+	st->id = h->next_id;
+	st->send_window = h->peer_window;
+	st->body = call->req.iov[IE_CONTENT].iov_base;
+	st->body_left = call->req.iov[IE_CONTENT].iov_len;
+	++h->num_streams;
+	h->next_id += 2;
+	if (h->next_id > MAX_STREAM_ID - 2 * MAX_STREAMS)
+		h->goaway = 1;	/* out of stream IDs */
+
+	encode_request(s, call);
+
+	/*
+	 * The header block goes out in a HEADERS frame followed by as many
+	 * CONTINUATION frames as it takes.
+	 */
+	p = h->enc.data;
+	left = h->enc.len;
+	type = HEADERS;
+	flags = st->body_left ? 0 : F_END_STREAM;
+	do {
+		n = left < h->peer_max_frame ? left : h->peer_max_frame;
+		if (n == left)
+			flags |= F_END_HEADERS;
+		memcpy(queue_frame(h, n, type, flags, st->id), p, n);
+		p += n;
+		left -= n;
+		type = CONTINUATION;
+		flags = 0;
+	} while (left > 0);
+
+	if (st->body_left)
+		++h->num_bodies;
+	else {
+		st->queued = 1;
+		st->end_offset = h->out_total;
+		++h->num_unsent;
+	}
+	call->req.size = h->out_total - start;
+
+	if (DBG > 0)
+		fprintf(stderr, "h2_submit.%lu: stream %u on %p\n", call->id,
+		    st->id, s);
+}
+
+/*
+ * Queue as much of the request bodies as the flow control windows allow.
+ */
+static void
+queue_data(struct H2_Conn *h)
+{
+	struct h2_stream *st;
+	size_t          n;
+	int             i;
+
+	for (i = 0; i < MAX_STREAMS && h->num_bodies > 0; ++i) {
+		st = &h->stream[i];
+		while (st->call && st->body_left > 0 && h->send_window > 0
+		    && st->send_window > 0
+		    && h->out.len - h->out_start < OUT_HIGH_WATER) {
+			n = st->body_left;
+			if (n > h->send_window)
+				n = h->send_window;
+			if (n > st->send_window)
+				n = st->send_window;
+			if (n > h->peer_max_frame)
+				n = h->peer_max_frame;
+			memcpy(queue_frame(h, n, DATA, n == st->body_left ?
+				F_END_STREAM : 0, st->id), st->body, n);
+			st->body += n;
+			st->body_left -= n;
+			st->send_window -= n;
+			h->send_window -= n;
+			st->call->req.size += FRAME_HDR_LEN + n;
+			if (st->body_left == 0) {
+				st->queued = 1;
+				st->end_offset = h->out_total;
+				--h->num_bodies;
+				++h->num_unsent;
+			}
+		}
+	}
+}
+
+static int
+data_ready(struct H2_Conn *h)
+{
+	int             i;
+
+	if (h->num_bodies == 0 || h->send_window <= 0)
+		return 0;
+	for (i = 0; i < MAX_STREAMS; ++i)
+		if (h->stream[i].call && h->stream[i].body_left > 0
+		    && h->stream[i].send_window > 0)
+			return 1;
+	return 0;
+}
+
+int
+h2_wants_write(Conn * s)
+{
+	struct H2_Conn *h = s->h2;
+
+	return h->out.len > h->out_start || data_ready(h)
+	    || (s->sendq && h2_can_start(s));
+}
+
+int
+h2_output(Conn * s, struct iovec *iov)
+{
+	struct H2_Conn *h = s->h2;
+
+	queue_data(h);
+	iov->iov_base = h->out.data + h->out_start;
+	iov->iov_len = h->out.len - h->out_start;
+	return iov->iov_len > 0;
+}
+
+void
+h2_sent(Conn * s, size_t len)
+{
+	struct H2_Conn *h = s->h2;
+	struct h2_stream *st;
+	Any_Type        arg;
+	int             i;
+
+	h->out_start += len;
+	h->out_written += len;
+	if (h->out_start == h->out.len)
+		h->out_start = h->out.len = 0;
+	else if (h->out_start >= OUT_HIGH_WATER) {
+		memmove(h->out.data, h->out.data + h->out_start,
+		    h->out.len - h->out_start);
+		h->out.len -= h->out_start;
+		h->out_start = 0;
+	}
+
+	for (i = 0; i < MAX_STREAMS && h->num_unsent > 0; ++i) {
+		st = &h->stream[i];
+		if (!st->call || !st->queued || st->sent
+		    || st->end_offset > h->out_written)
+			continue;
+		st->sent = 1;
+		--h->num_unsent;
+		arg.l = 0;
+		event_signal(EV_CALL_SEND_STOP, (Object *) st->call, arg);
+		if (s->state >= S_CLOSING)
+			return;
+	}
+}
+
+/*
+ * HPACK decoding of the replies.
+ */
+
+static int
+hp_int(const u_char **pp, const u_char *end, int prefix, u_int *valp)
+{
+	const u_char   *p = *pp;
+	u_int           max = (1U << prefix) - 1, val, shift = 0;
+
+	val = *p++ & max;
+	if (val == max)
+		do {
+			if (p == end || shift > 21)
+				return -1;
+			val += (*p & 0x7f) << shift;
+			shift += 7;
+		} while (*p++ & 0x80);
+	*valp = val;
+	*pp = p;
+	return 0;
+}
+
+static ssize_t
+hp_string(const u_char **pp, const u_char *end, char *dst, size_t room)
+{
+	const u_char   *p = *pp;
+	ssize_t         n;
+	u_int           len;
+
+	if (p == end || hp_int(&p, end, 7, &len) < 0 || len > end - p)
+		return -1;
+	if (**pp & 0x80)
+		n = huff_decode(p, len, dst, room);
+	else if (len > room)
+		return -1;
+	else {
+		memcpy(dst, p, len);
+		n = len;
+	}
+	*pp = p + len;
+	return n;
+}
+
+static int
+hp_lookup(struct hp_table *t, u_int idx, const char **name,
+    size_t *name_len, const char **value, size_t *value_len)
+{
+	struct hp_entry *e;
+
+	if (idx == 0)
+		return -1;
+	if (idx <= NUM_STATIC) {
+		*name = static_table[idx - 1].name;
+		*name_len = static_table[idx - 1].name_len;
+		*value = static_table[idx - 1].value;
+		*value_len = static_table[idx - 1].value_len;
+		return 0;
+	}
+	idx -= NUM_STATIC + 1;
+	if (idx >= t->num_entries)
+		return -1;
+	e = &t->entry[t->num_entries - 1 - idx];
+	*name = t->data + e->off;
+	*name_len = e->name_len;
+	*value = t->data + e->off + e->name_len;
+	*value_len = e->value_len;
+	return 0;
+}
+
+/*
+ * Pass on the header field in line[] (whose name is NAME_LEN bytes long and
+ * which is LEN bytes long in all) to whoever is interested in the reply on
+ * stream ST.
+ */
+static void
+reply_field(Conn * s, struct h2_stream *st, size_t name_len, size_t len)
+{
+	Call           *c = st->call;
+	struct iovec    iov;
+	Any_Type        arg;
+
+	if (line[0] == ':') {
+		if (name_len != 7 || memcmp(line, ":status", 7) != 0
+		    || st->have_status || st->headers_done)
+			return;
+		arg.l = atoi(line + 9);
+		if (arg.l / 100 == 1) {
+			st->interim = 1;
+			return;
+		}
+		st->have_status = 1;
+		c->reply.status = arg.l;
+		c->reply.version = 0x20000;
+		if (DBG > 0)
+			fprintf(stderr, "reply_field.%lu: reply is HTTP/2, "
+			    "status = %d\n", c->id, c->reply.status);
+		event_signal(EV_CALL_RECV_START, (Object *) c, arg);
+		return;
+	}
+	if (st->interim || !st->have_status)
+		return;
+
+	iov.iov_base = line;
+	iov.iov_len = len;
+	arg.vp = &iov;
+	event_signal(st->headers_done ? EV_CALL_RECV_FOOTER : EV_CALL_RECV_HDR,
+	    (Object *) c, arg);
+}
+
+/*
+ * Decode the LEN byte header block at P.  The fields go to stream ST, if
+ * it's still around.  Returns -1 if the block can't be decoded.
+ */
+static int
+hp_decode(Conn * s, struct h2_stream *st, const u_char *p, size_t len)
+{
+	struct H2_Conn *h = s->h2;
+	const u_char   *end = p + len;
+	const char     *name, *value;
+	size_t          name_len, value_len;
+	ssize_t         n;
+	u_int           idx;
+	int             add;
+
+	while (p < end) {
+		if (*p & 0x80) {
+			/*
+			 * indexed header field
+			 */
+			if (hp_int(&p, end, 7, &idx) < 0
+			    || hp_lookup(&h->dec_table, idx, &name, &name_len, &value,
+				&value_len) < 0
+			    || name_len + value_len > MAX_FIELD)
+				return -1;
+			memcpy(line, name, name_len);
+			memcpy(line + name_len + 2, value, value_len);
+		} else if ((*p & 0xe0) == 0x20) {
+			/*
+			 * dynamic table size update
+			 */
+			if (hp_int(&p, end, 5, &idx) < 0 || idx > TABLE_SIZE)
+				return -1;
+			h->dec_table.max = idx;
+			hp_evict(&h->dec_table, idx);
+			continue;
+		} else {
+			/*
+			 * literal header field, with incremental indexing
+			 * if ADD
+			 */
+			add = (*p & 0x40) != 0;
+			if (hp_int(&p, end, add ? 6 : 4, &idx) < 0)
+				return -1;
+			if (idx) {
+				if (hp_lookup(&h->dec_table, idx, &name, &name_len, &value,
+					&value_len) < 0 || name_len > MAX_FIELD)
+					return -1;
+				memcpy(line, name, name_len);
+			} else {
+				n = hp_string(&p, end, line, MAX_FIELD);
+				if (n < 0)
+					return -1;
+				name_len = n;
+			}
+			n = hp_string(&p, end, line + name_len + 2,
+			    MAX_FIELD - name_len);
+			if (n < 0)
+				return -1;
+			value_len = n;
+			if (add)
+				hp_insert(&h->dec_table, line, name_len,
+				    line + name_len + 2, value_len);
+		}
+		line[name_len] = ':';
+		line[name_len + 1] = ' ';
+		line[name_len + 2 + value_len] = '\0';
+		if (st) {
+			reply_field(s, st, name_len, name_len + 2 + value_len);
+			if (s->state >= S_CLOSING)
+				return 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Take call C off the receive queue of S.
+ */
+static void
+recvq_remove(Conn * s, Call * c)
+{
+	Call           *prev, *p;
+
+	prev = NULL;
+	for (p = s->recvq; p != c; p = p->recvq_next)
+		prev = p;
+	if (prev)
+		prev->recvq_next = c->recvq_next;
+	else
+		s->recvq = c->recvq_next;
+	if (s->recvq_tail == c)
+		s->recvq_tail = prev;
+}
+
+/*
+ * Free stream ST, which won't get a reply, and return its call, still
+ * referenced.  What is queued of the request already goes out anyway.
+ */
+static Call *
+stream_drop(Conn * s, struct h2_stream *st)
+{
+	struct H2_Conn *h = s->h2;
+	Call           *c = st->call;
+
+	if (!st->sent) {
+		if (st->body_left > 0)
+			--h->num_bodies;
+		else if (st->queued)
+			--h->num_unsent;
+	}
+	st->call = NULL;
+	--h->num_streams;
+	recvq_remove(s, c);
+	return c;
+}
+
+/*
+ * The server didn't process stream ST: put its call back at the head of
+ * the send queue.
+ */
+static void
+stream_retry(Conn * s, struct h2_stream *st)
+{
+	Call           *c = stream_drop(s, st);
+
+	if (DBG > 0)
+		fprintf(stderr, "stream_retry.%lu: stream %u on %p\n", c->id,
+		    st->id, s);
+
+	c->sendq_next = s->sendq;
+	s->sendq = c;
+	if (!s->sendq_tail)
+		s->sendq_tail = c;
+}
+
+/*
+ * Stream ST is done: hand its call over to whoever is waiting for the
+ * reply.
+ */
+static void
+stream_end(Conn * s, struct h2_stream *st)
+{
+	struct H2_Conn *h = s->h2;
+	Call           *c = st->call;
+	Any_Type        arg;
+
+	if (DBG > 0)
+		fprintf(stderr, "stream_end.%lu: stream %u received %lu reply "
+		    "bytes on %p\n", c->id, st->id,
+		    (u_long) (c->reply.header_bytes + c->reply.content_bytes),
+		    s);
+
+	if (!st->sent) {
+		/*
+		 * The server answered without waiting for all of the
+		 * request.  Whatever is queued already still goes out, but
+		 * the rest of the body doesn't.
+		 */
+		if (st->body_left > 0) {
+			st->body_left = 0;
+			--h->num_bodies;
+			put32(queue_frame(h, 4, RST_STREAM, 0, st->id),
+			    NO_ERROR);
+		} else if (st->queued)
+			--h->num_unsent;
+		st->sent = 1;
+		arg.l = 0;
+		event_signal(EV_CALL_SEND_STOP, (Object *) c, arg);
+		if (s->state >= S_CLOSING)
+			return;
+	}
+	st->call = NULL;
+	--h->num_streams;
+	recvq_remove(s, c);
+
+	arg.l = 0;
+	event_signal(EV_CALL_RECV_STOP, (Object *) c, arg);
+
+	call_dec_ref(c);
+}
+
+/*
+ * The header block of stream ID (LEN bytes at P, which took NBYTES bytes of
+ * frames) is complete.
+ */
+static int
+header_block(Conn * s, u_int id, int flags, const u_char *p, size_t len,
+    size_t nbytes)
+{
+	struct h2_stream *st = find_stream(s->h2, id);
+
+	/*
+	 * Even the headers of a stream we're not interested in have to be
+	 * decoded to keep the dynamic table in sync.
+	 */
+	if (hp_decode(s, st, p, len) < 0) {
+		if (DBG > 0)
+			fprintf(stderr, "%s.header_block: bad header block on "
+			    "stream %u\n", prog_name, id);
+		return EPROTO;
+	}
+	if (!st || s->state >= S_CLOSING)
+		return 0;
+
+	if (st->interim) {
+		st->interim = 0;
+		st->call->reply.header_bytes += nbytes;
+		return (flags & F_END_STREAM) ? EPROTO : 0;
+	}
+	if (st->headers_done)
+		st->call->reply.footer_bytes += nbytes;
+	else {
+		if (!st->have_status)
+			return EPROTO;
+		st->call->reply.header_bytes += nbytes;
+		st->headers_done = 1;
+	}
+	if (flags & F_END_STREAM)
+		stream_end(s, st);
+	return 0;
+}
+
+static int
+recv_stream_data(Conn * s, u_int id, int flags, const u_char *p, size_t len)
+{
+	struct H2_Conn *h = s->h2;
+	struct h2_stream *st;
+	struct iovec    iov;
+	Any_Type        arg;
+	size_t          frame_len = len;
+
+	h->recv_unacked += frame_len;
+	if (h->recv_unacked >= RECV_WINDOW / 2) {
+		queue_window_update(h, 0, h->recv_unacked);
+		h->recv_unacked = 0;
+	}
+	if (flags & F_PADDED) {
+		if (len == 0 || p[0] >= len)
+			return EPROTO;
+		len -= 1 + p[0];
+		++p;
+	}
+
+	st = find_stream(h, id);
+	if (!st)
+		return 0;
+	if (!st->headers_done)
+		return EPROTO;
+	st->recv_unacked += frame_len;
+	if (!(flags & F_END_STREAM) && st->recv_unacked >= RECV_WINDOW / 2) {
+		queue_window_update(h, id, st->recv_unacked);
+		st->recv_unacked = 0;
+	}
+
+	if (len > 0) {
+		iov.iov_base = (char *) p;
+		iov.iov_len = len;
+		arg.vp = &iov;
+		event_signal(EV_CALL_RECV_DATA, (Object *) st->call, arg);
+		if (st->call->reply.sampled)
+			event_signal(EV_CALL_RECV_SAMPLE, (Object *) st->call,
+			    arg);
+		if (s->state >= S_CLOSING)
+			return 0;
+		st->call->reply.content_bytes += len;
+	}
+	if (flags & F_END_STREAM)
+		stream_end(s, st);
+	return 0;
+}
+
+static int
+recv_settings(struct H2_Conn *h, const u_char *p, size_t len)
+{
+	u_int           id, val, i;
+	long            delta;
+
+	if (!h->got_settings) {
+		h->peer_max_streams = ~0U;	/* unless it says otherwise */
+		h->got_settings = 1;
+	}
+	for (; len >= 6; p += 6, len -= 6) {
+		id = (p[0] << 8) | p[1];
+		val = get32(p + 2);
+		switch (id) {
+		case SET_MAX_CONCURRENT_STREAMS:
+			h->peer_max_streams = val;
+			break;
+
+		case SET_INITIAL_WINDOW_SIZE:
+			if (val > MAX_WINDOW)
+				return EPROTO;
+			delta = (long) val - h->peer_window;
+			h->peer_window = val;
+			for (i = 0; i < MAX_STREAMS; ++i)
+				if (h->stream[i].call)
+					h->stream[i].send_window += delta;
+			break;
+
+		case SET_MAX_FRAME_SIZE:
+			if (val < DEFAULT_FRAME_SIZE || val > 0xffffff)
+				return EPROTO;
+			h->peer_max_frame = val;
+			break;
+
+		case SET_HEADER_TABLE_SIZE:
+			if (val > TABLE_SIZE)
+				val = TABLE_SIZE;
+			if (val != h->enc_table.max) {
+				h->enc_table.max = val;
+				hp_evict(&h->enc_table, val);
+				h->enc_resized = 1;
+			}
+			break;
+		}
+	}
+	queue_frame(h, 0, SETTINGS, F_ACK, 0);
+	return 0;
+}
+
+/*
+ * Process the frame at P, which is LEN bytes long including the frame
+ * header.
+ */
+static int
+recv_frame(Conn * s, const u_char *p, size_t len)
+{
+	struct H2_Conn *h = s->h2;
+	struct h2_stream *st;
+	Call           *c;
+	int             type = p[3], flags = p[4], i;
+	u_int           id = get32(p + 5) & MAX_STREAM_ID, inc, pad;
+
+	p += FRAME_HDR_LEN;
+	len -= FRAME_HDR_LEN;
+
+	if (DBG > 2)
+		fprintf(stderr, "recv_frame: type %d, flags 0x%x, stream %u, "
+		    "%lu bytes on %p\n", type, flags, id, (u_long) len, s);
+
+	if (h->block_id && type != CONTINUATION)
+		return EPROTO;
+
+	switch (type) {
+	case DATA:
+		if (id == 0)
+			return EPROTO;
+		return recv_stream_data(s, id, flags, p, len);
+
+	case HEADERS:
+		if (id == 0)
+			return EPROTO;
+		pad = 0;
+		if (flags & F_PADDED) {
+			if (len == 0)
+				return EPROTO;
+			pad = *p++;
+			--len;
+		}
+		if (flags & F_PRIORITY) {
+			if (len < 5)
+				return EPROTO;
+			p += 5;
+			len -= 5;
+		}
+		if (pad > len)
+			return EPROTO;
+		len -= pad;
+		if (flags & F_END_HEADERS)
+			return header_block(s, id, flags, p, len,
+			    FRAME_HDR_LEN + len);
+		h->block.len = 0;
+		buf_add(&h->block, p, len);
+		h->block_id = id;
+		h->block_flags = flags;
+		h->block_bytes = FRAME_HDR_LEN + len;
+		return 0;
+
+	case CONTINUATION:
+		if (!h->block_id || id != h->block_id)
+			return EPROTO;
+		buf_add(&h->block, p, len);
+		h->block_bytes += FRAME_HDR_LEN + len;
+		if (!(flags & F_END_HEADERS))
+			return 0;
+		h->block_id = 0;
+		return header_block(s, id, h->block_flags,
+		    (u_char *) h->block.data, h->block.len, h->block_bytes);
+
+	case RST_STREAM:
+		if (id == 0 || len != 4)
+			return EPROTO;
+		if ((st = find_stream(h, id)) == NULL)
+			return 0;
+		if (DBG > 0)
+			fprintf(stderr, "%s.recv_frame: stream %u reset "
+			    "(error %u)\n", prog_name, id, get32(p));
+		if (get32(p) == REFUSED_STREAM) {
+			stream_retry(s, st);
+			return 0;
+		}
+		c = stream_drop(s, st);
+		c->reply.reset = 1;
+		call_dec_ref(c);
+		return 0;
+
+	case SETTINGS:
+		if (id != 0 || len % 6 != 0)
+			return EPROTO;
+		if (flags & F_ACK)
+			return 0;
+		return recv_settings(h, p, len);
+
+	case PING:
+		if (id != 0 || len != 8)
+			return EPROTO;
+		if (!(flags & F_ACK))
+			memcpy(queue_frame(h, 8, PING, F_ACK, 0), p, 8);
+		return 0;
+
+	case GOAWAY:
+		if (id != 0 || len < 8)
+			return EPROTO;
+		id = get32(p) & MAX_STREAM_ID;
+		if (DBG > 0)
+			fprintf(stderr, "%s.recv_frame: GOAWAY (last stream %u, "
+			    "error %u)\n", prog_name, id, get32(p + 4));
+		h->goaway = 1;
+		/*
+		 * Streams beyond the last one the server will process go
+		 * back on the send queue.
+		 */
+		for (i = 0; i < MAX_STREAMS; ++i)
+			if (h->stream[i].call && h->stream[i].id > id)
+				stream_retry(s, &h->stream[i]);
+		return 0;
+
+	case WINDOW_UPDATE:
+		if (len != 4)
+			return EPROTO;
+		inc = get32(p) & MAX_STREAM_ID;
+		if (inc == 0)
+			return EPROTO;
+		if (id == 0) {
+			h->send_window += inc;
+			if (h->send_window > MAX_WINDOW)
+				return EPROTO;
+		} else if ((st = find_stream(h, id)) != NULL) {
+			st->send_window += inc;
+			if (st->send_window > MAX_WINDOW)
+				return EPROTO;
+		}
+		return 0;
+
+	case PUSH_PROMISE:
+		return EPROTO;	/* we turned push off */
+
+	default:
+		return 0;	/* PRIORITY and unknown types */
+	}
+}
+
+int
+h2_input(Conn * s, const char *buf, size_t len)
+{
+	struct H2_Conn *h = s->h2;
+	const u_char   *p = (const u_char *) buf;
+	size_t          need, n;
+	int             err;
+
+	while (len > 0) {
+		if (h->in.len == 0 && len >= FRAME_HDR_LEN
+		    && FRAME_HDR_LEN + get24(p) <= len) {
+			/*
+			 * the common case: the whole frame is here
+			 */
+			need = FRAME_HDR_LEN + get24(p);
+			if (need > FRAME_HDR_LEN + DEFAULT_FRAME_SIZE)
+				return EPROTO;
+			err = recv_frame(s, p, need);
+			p += need;
+			len -= need;
+		} else {
+			/*
+			 * collect a frame that spans reads in h->in
+			 */
+			need = FRAME_HDR_LEN;
+			if (h->in.len >= FRAME_HDR_LEN)
+				need += get24((u_char *) h->in.data);
+			if (need > FRAME_HDR_LEN + DEFAULT_FRAME_SIZE)
+				return EPROTO;
+			n = need - h->in.len;
+			if (n > len)
+				n = len;
+			buf_add(&h->in, p, n);
+			p += n;
+			len -= n;
+			if (h->in.len < need)
+				continue;
+			if (need == FRAME_HDR_LEN
+			    && get24((u_char *) h->in.data) > 0)
+				continue;	/* now for the payload */
+			h->in.len = 0;
+			err = recv_frame(s, (u_char *) h->in.data, need);
+		}
+		if (err || s->state >= S_CLOSING)
+			return err;
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef http2_h
+#define http2_h
+
+/*
+ * HTTP/2 (RFC 7540) for the core.  A connection that speaks HTTP/2 has
+ * c->h2 set; its calls still go through the send queue first, but once a
+ * call has been started on a stream of its own it sits on the receive queue
+ * until the reply is complete, in whatever order the replies come in.  The
+ * core does the reading and writing, this module the framing and HPACK.
+ */
+
+struct H2_Conn;
+
+/*
+ * Turn connection S into an HTTP/2 connection and queue the connection
+ * preface.
+ */
+extern void	h2_init(Conn * s);
+extern void	h2_free(Conn * s);
+
+/*
+ * Returns non-zero if another call can be started on a stream of its own.
+ */
+extern int	h2_can_start(Conn * s);
+
+/*
+ * Encode the request of CALL on a new stream.  The call must be on the
+ * receive queue of S already.
+ */
+extern void	h2_submit(Conn * s, Call * call);
+
+/*
+ * Point IOV at the bytes waiting to be written on S.  Returns 0 if there
+ * are none.  Once some of them went out, h2_sent() has to be called with
+ * their number.
+ */
+extern int	h2_output(Conn * s, struct iovec *iov);
+extern void	h2_sent(Conn * s, size_t len);
+
+/*
+ * Returns non-zero if S has something to write.
+ */
+extern int	h2_wants_write(Conn * s);
+
+/*
+ * Process the LEN bytes read from S.  Returns 0 or the errno value the
+ * connection should fail with.
+ */
+extern int	h2_input(Conn * s, const char *buf, size_t len);
+
+/*
+ * Returns non-zero if the server shut down S gracefully and no call is left
+ * in flight on it.
+ */
+extern int	h2_done(Conn * s);
+
+#endif /* http2_h */
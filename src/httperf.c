@@ -73,6 +73,9 @@
 
 #include <generic_types.h>
 #include <sys/resource.h>	/* after sys/types.h for BSD (in generic_types.h) */
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <object.h>
 #include <timer.h>
@@ -81,6 +84,13 @@
 #include <core.h>
 #include <localevent.h>
 #include <httperf.h>
+#include <worker.h>
+#include <agent.h>
+#include <warmup.h>
+#include <control.h>
+#include <bench.h>
+#include <uri_wlog.h>
+#include <wsesslog.h>
 
 
 #ifdef HAVE_SSL
@@ -94,6 +104,7 @@ int             verbose;
 int             periodic_stats;
 Cmdline_Params  param;
 Time            test_time_start;
+u_int           test_epoch;	/* bumped by warmup_epoch() */
 Time            test_time_stop;
 struct rusage   test_rusage_start;
 struct rusage   test_rusage_stop;
@@ -110,16 +121,35 @@ int             debug_level;
 static Time     perf_sample_start;
 
 static struct option longopts[] = {
+	{"accept-encoding", required_argument,
+	    (int *) &param.encoding.accept, 0},
 	{"add-header", required_argument, (int *) &param.additional_header, 0},
 	{"add-header-file", required_argument, (int *) &param.additional_header_file, 0 },
+	{"agent", required_argument, (int *) &param.agent, 0},
+	{"agents", required_argument, (int *) &param.agents, 0},
+	{"bench", optional_argument, &param.bench, 0},
 	{"burst-length", required_argument, (int *) &param.burst_len, 0},
+	{"busy-poll", optional_argument, (int *) &param.busy_poll, 0},
+	{"capture", required_argument, (int *) &param.capture, 0},
 	{"client", required_argument, (int *) &param.client, 0},
+	{"clock", required_argument, &param.clock, 0},
 	{"close-with-reset", no_argument, &param.close_with_reset, 1},
+	{"concurrency", required_argument, (int *) &param.concurrency, 0},
+	{"conn-pool", required_argument, (int *) &param.conn_pool, 0},
+	{"control", required_argument, (int *) &param.control, 0},
+	{"cpus", required_argument, (int *) &param.cpus, 0},
 	{"debug", required_argument, 0, 'd'},
+	{"decode", no_argument, &param.encoding.decode, 1},
+	{"dns-refresh", optional_argument, (int *) &param.dns_refresh, 0},
 	{"failure-status", required_argument, &param.failure_status, 0},
 	{"help", no_argument, 0, 'h'},
 	{"hog", no_argument, &param.hog, 1},
 	{"http-version", required_argument, (int *) &param.http_version, 0},
+	{"http2", no_argument, &param.http2, 1},
+#ifdef HAVE_IO_URING
+	{"io-uring", no_argument, &param.use_io_uring, 1},
+#endif
+	{"live-stats", required_argument, (int *) &param.live_stats, 0},
 	{"max-connections", required_argument, (int *) &param.max_conns, 0},
 	{"max-piped-calls", required_argument, (int *) &param.max_piped, 0},
 	{"method", required_argument, (int *) &param.method, 0},
@@ -128,7 +158,10 @@ static struct option longopts[] = {
 	{"num-calls", required_argument, (int *) &param.num_calls, 0},
 	{"num-conns", required_argument, (int *) &param.num_conns, 0},
 	{"period", required_argument, (int *) &param.rate.mean_iat, 0},
+	{"popularity", required_argument, (int *) &param.popularity, 0},
 	{"port", required_argument, (int *) &param.port, 0},
+	{"prealloc", required_argument, (int *) &param.prealloc, 0},
+	{"preconnect", required_argument, (int *) &param.preconnect, 0},
 	{"print-reply", optional_argument, &param.print_reply, 0},
 	{"print-request", optional_argument, &param.print_request, 0},
 	{"rate", required_argument, (int *) &param.rate, 0},
@@ -136,10 +169,16 @@ static struct option longopts[] = {
 	{"retry-on-failure", no_argument, &param.retry_on_failure, 1},
 	{"runtime", required_argument, (int *) &param.runtime, 0},
 	{"send-buffer", required_argument, (int *) &param.send_buffer_size, 0},
+	{"search", required_argument, (int *) &param.search, 0},
+	{"self-stats", no_argument, &param.self_stats, 1},
+	{"series", required_argument, (int *) &param.series, 0},
 	{"server", required_argument, (int *) &param.server, 0},
 	{"server-name", required_argument, (int *) &param.server_name, 0},
 	{"servers", required_argument, (int *) &param.servers, 0},
 	{"uri", required_argument, (int *) &param.uri, 0},
+	{"uri-stats", optional_argument, (int *) &param.uri_stats, 0},
+	{"verify", required_argument, (int *) &param.verify, 0},
+	{"warmup", required_argument, (int *) &param.warmup, 0},
 	{"session-cookies", no_argument, (int *) &param.session_cookies, 1},
 #ifdef HAVE_SSL
 	{"ssl", no_argument, &param.use_ssl, 1},
@@ -151,18 +190,28 @@ static struct option longopts[] = {
         {"ssl-ca-file",  required_argument, (int *) &param.ssl_ca_file,     0},
         {"ssl-ca-path",  required_argument, (int *) &param.ssl_ca_path,     0},
         {"ssl-protocol", required_argument, &param.ssl_protocol,            0},
+	{"ssl-ktls", no_argument, &param.ssl_ktls, 1},
+#endif
+#ifdef TCP_FASTOPEN_CONNECT
+	{"tfo", no_argument, &param.tfo, 1},
 #endif
 	{"think-timeout", required_argument, (int *) &param.think_timeout, 0},
 	{"timeout", required_argument, (int *) &param.timeout, 0},
+	{"unix-socket", required_argument, (int *) &param.unix_socket, 0},
 	{"use-timer-cache", no_argument, &param.use_timer_cache, 1},
 	{"verbose", no_argument, 0, 'v'},
 	{"version", no_argument, 0, 'V'},
 	{"periodic-stats", no_argument, 0, 'n'},
+	{"websocket", required_argument, (int *) &param.websocket, 0},
 	{"wlog", required_argument, (int *) &param.wlog, 0},
+	{"wlog-compile", required_argument, (int *) &param.wlog.compile, 0},
 	{"wsess", required_argument, (int *) &param.wsess, 0},
 	{"wsesslog", required_argument, (int *) &param.wsesslog, 0},
+	{"wsesslog-compile", required_argument,
+	    (int *) &param.wsesslog.compile, 0},
 	{"wsesspage", required_argument, (int *) &param.wsesspage, 0},
 	{"wset", required_argument, (int *) &param.wset, 0},
+	{"workers", required_argument, (int *) &param.workers, 0},
 	{0, 0, 0, 0}
 };
 
@@ -170,25 +219,45 @@ static void
 usage(void)
 {
 	printf("Usage: %s "
-	       "[-hdvV] [--add-header S] [--burst-length N] [--client N/N]\n"
-	       "\t[--close-with-reset] [--debug N] [--failure-status N]\n"
-	       "\t[--help] [--hog] [--http-version S] [--max-connections N]\n"
+	       "[-hdvV] [--accept-encoding S] [--add-header S] [--agent [A:]P]\n"
+	       "\t[--agents H:P,...]\n"
+	       "\t[--bench [micro|loopback]] [--burst-length N] [--busy-poll [U]]\n"
+	       "\t[--capture file[,N|errors[,H[,M]]]]\n"
+	       "\t[--client N/N] [--clock gettimeofday|monotonic|coarse|tsc]\n"
+	       "\t[--close-with-reset] [--concurrency C[,D]] [--conn-pool N[,X]]\n"
+	       "\t[--control P] [--cpus L]\n"
+	       "\t[--debug N] [--decode] [--dns-refresh [T]] [--failure-status N]\n"
+	       "\t[--help] [--hog] [--http-version S] [--http2] [--live-stats file]\n"
+	       "\t[--max-connections N]\n"
+#ifdef HAVE_IO_URING
+	       "\t[--io-uring]\n"
+#endif
 	       "\t[--max-piped-calls N] [--method S] [--no-host-hdr]\n"
 	       "\t[--num-calls N] [--num-conns N] [--session-cookies]\n"
-	       "\t[--period [d|u|e]T1[,T2]|[v]T1,D1[,T2,D2]...[,Tn,Dn]\n"
+	       "\t[--period [d|u|e]T1[,T2]|[v]T1,D1[,T2,D2]...[,Tn,Dn]|tfile]\n"
+	       "\t[--popularity zipf,N,S|weights,F] [--prealloc N[,N[,N]]]\n"
+	       "\t[--preconnect N[,R]]\n"
 	       "\t[--print-reply [header|body]] [--print-request [header|body]]\n"
 	       "\t[--rate X] [--recv-buffer N] [--retry-on-failure] [--send-buffer N]\n"
+	       "\t[--search P,L[,E[,T]]] [--self-stats] [--series file[,csv|json]]\n"
 	       "\t[--server S|--servers file] [--server-name S] [--port N] [--uri S] "
 	       "[--myaddr S]\n"
+	       "\t[--unix-socket P] [--uri-stats [N]] [--verify file[,F]]\n"
+	       "\t[--warmup time,T|replies,N|auto[,T]]\n"
 #ifdef HAVE_SSL
 	       "\t[--ssl] [--ssl-ciphers L] [--ssl-no-reuse]\n"
                "\t[--ssl-certificate file] [--ssl-key file]\n"
                "\t[--ssl-ca-file file] [--ssl-ca-path path]\n"
-               "\t[--ssl-verify [yes|no]] [--ssl-protocol S]\n"
+               "\t[--ssl-verify [yes|no]] [--ssl-protocol S] [--ssl-ktls]\n"
+#endif
+#ifdef TCP_FASTOPEN_CONNECT
+	       "\t[--tfo]\n"
 #endif
 	       "\t[--think-timeout X] [--timeout X] [--verbose] [--version]\n"
-	       "\t[--wlog y|n,file] [--wsess N,N,X] [--wsesslog N,X,file]\n"
-	       "\t[--wset N,X]\n"
+	       "\t[--websocket N[,R[,S]]]\n"
+	       "\t[--wlog y|n[r|t],file] [--wlog-compile file]\n"
+	       "\t[--wsess N,N,X] [--wsesslog N,X,file] [--wsesslog-compile file]\n"
+	       "\t[--wset N,X] [--workers N]\n"
 	       "\t[--runtime X]\n"
 	       "\t[--use-timer-cache]\n"
 	       "\t[--periodic-stats]\n", prog_name);
@@ -230,11 +299,13 @@ perf_sample(struct Timer *t, Any_Type regarg)
 int
 main(int argc, char **argv)
 {
-	extern Load_Generator uri_fixed, uri_wlog, uri_wset, conn_rate,
-	    call_seq;
+	extern Load_Generator uri_fixed, uri_wlog, uri_wset, uri_zipf,
+	    conn_rate, conn_fixed, call_seq, ws_echo;
 	extern Load_Generator wsess, wsesslog, wsesspage, sess_cookie, misc;
 	extern Stat_Collector stats_basic, session_stat;
-	extern Stat_Collector stats_print_reply;
+	extern Stat_Collector stats_print_reply, stats_series, stats_uri,
+	    stats_self, stats_live, stats_search, stats_ws, stats_verify,
+	    stats_encoding, stats_capture;
 	extern char    *optarg;
 	int             session_workload = 0;
 	int             num_gen = 3;
@@ -244,7 +315,7 @@ main(int argc, char **argv)
 		&conn_rate,
 	};
 	int             num_stats = 1;
-	Stat_Collector *stat[3] = {
+	Stat_Collector *stat[16] = {
 		&stats_basic
 	};
 	int             i, ch, longindex;
@@ -276,6 +347,11 @@ main(int argc, char **argv)
 	param.num_calls = 1;
 	param.burst_len = 1;
 	param.num_conns = 1;
+	param.workers = 1;
+	param.conn_pool.idle_timeout = 5.0;
+#ifdef HAVE_CLOCK_GETTIME
+	param.clock = TIMER_CLOCK_MONOTONIC;
+#endif
 	/*
 	 * These should be set to the minimum of 2*bandwidth*delay and the
 	 * maximum request/reply size for single-call connections.  
@@ -298,6 +374,8 @@ main(int argc, char **argv)
 	else
 		prog_name = argv[0];
 
+	agent_save_args(argc, argv);
+
 	/*
 	 * process command line options: 
 	 */
@@ -309,8 +387,33 @@ main(int argc, char **argv)
 
 			if (flag == &param.method)
 				param.method = optarg;
+			else if (flag == &param.agent)
+				param.agent = optarg;
+			else if (flag == &param.agents)
+				param.agents = optarg;
+			else if (flag == &param.live_stats)
+				param.live_stats = optarg;
+			else if (flag == &param.control)
+				param.control = optarg;
+			else if (flag == &param.bench) {
+				if (!optarg)
+					param.bench = BENCH_MICRO
+					    | BENCH_LOOPBACK;
+				else if (strcmp(optarg, "micro") == 0)
+					param.bench = BENCH_MICRO;
+				else if (strcmp(optarg, "loopback") == 0)
+					param.bench = BENCH_LOOPBACK;
+				else {
+					fprintf(stderr,
+						"%s: illegal benchmark %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+			}
 			else if (flag == &param.additional_header)
 				param.additional_header = optarg;
+			else if (flag == &param.encoding.accept)
+				param.encoding.accept = optarg;
 			else if (flag == &param.additional_header_file)
 				param.additional_header_file = optarg;
 			else if (flag == &param.num_calls) {
@@ -445,6 +548,9 @@ main(int argc, char **argv)
 					case 'v':
 						param.rate.dist = VARIABLE;
 						break;
+					case 't':
+						param.rate.dist = TRACE;
+						break;
 					default:
 						fprintf(stderr,
 							"%s: illegal interarrival distribution "
@@ -577,6 +683,20 @@ main(int argc, char **argv)
 					param.rate.mean_iat /= numRates;
 					break;
 
+				case TRACE:
+					if (!*optarg) {
+						fprintf(stderr,
+							"%s: --period=t needs a "
+							"file name\n", prog_name);
+						exit(1);
+					}
+					param.rate.trace_file = optarg;
+					/*
+					 * until the file is read:
+					 */
+					param.rate.mean_iat = 1.0;
+					break;
+
 				default:
 					fprintf(stderr,
 						"%s: internal error parsing %s\n",
@@ -670,7 +790,7 @@ main(int argc, char **argv)
                         {
                             if (strcasecmp (optarg, "auto") == 0)
                                 param.ssl_protocol = 0;
-#ifndef OPENSSL_NO_SSL2
+#if !defined(OPENSSL_NO_SSL2) && OPENSSL_VERSION_NUMBER < 0x10100000L
                             else if (strcasecmp (optarg, "SSLv2") == 0)
                                 param.ssl_protocol = 2;
 #endif
@@ -708,6 +828,373 @@ main(int argc, char **argv)
 						prog_name, optarg);
 					exit(1);
 				}
+			} else if (flag == &param.workers) {
+				errno = 0;
+				param.workers = strtoul(optarg, &end, 10);
+				if (errno == ERANGE || end == optarg || *end
+				    || param.workers < 1) {
+					fprintf(stderr,
+						"%s: illegal number of workers %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+			} else if (flag == &param.clock) {
+				if (strcmp(optarg, "gettimeofday") == 0)
+					param.clock = TIMER_CLOCK_GETTIMEOFDAY;
+				else if (strcmp(optarg, "monotonic") == 0)
+					param.clock = TIMER_CLOCK_MONOTONIC;
+				else if (strcmp(optarg, "coarse") == 0)
+					param.clock = TIMER_CLOCK_COARSE;
+				else if (strcmp(optarg, "tsc") == 0)
+					param.clock = TIMER_CLOCK_TSC;
+				else {
+					fprintf(stderr,
+						"%s: illegal clock source %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+			} else if (flag == &param.conn_pool) {
+				errno = 0;
+				param.conn_pool.max_idle =
+				    strtoul(optarg, &end, 10);
+				if (errno == ERANGE || end == optarg
+				    || (*end && *end != ',')) {
+					fprintf(stderr,
+						"%s: illegal number of idle "
+						"connections %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+				if (*end) {
+					optarg = end + 1;
+					param.conn_pool.idle_timeout =
+					    strtod(optarg, &end);
+					if (errno == ERANGE || end == optarg
+					    || *end
+					    || param.conn_pool.idle_timeout
+					    <= 0.0) {
+						fprintf(stderr,
+							"%s: illegal idle "
+							"timeout %s\n",
+							prog_name, optarg);
+						exit(1);
+					}
+				}
+			} else if (flag == &param.prealloc) {
+				u_int          *count[3];
+				int             n;
+
+				count[0] = &param.prealloc.num_conns;
+				count[1] = &param.prealloc.num_calls;
+				count[2] = &param.prealloc.num_sessions;
+				errno = 0;
+				for (n = 0;; ++n) {
+					*count[n] = strtoul(optarg, &end, 10);
+					if (errno == ERANGE || end == optarg
+					    || (*end && (*end != ',' || n == 2))) {
+						fprintf(stderr,
+							"%s: illegal preallocation "
+							"count %s\n",
+							prog_name, optarg);
+						exit(1);
+					}
+					if (!*end)
+						break;
+					optarg = end + 1;
+				}
+				/*
+				 * Counts that were left out are the same as
+				 * the one before.
+				 */
+				for (++n; n < 3; ++n)
+					*count[n] = *count[n - 1];
+			} else if (flag == &param.preconnect) {
+				errno = 0;
+				param.preconnect.num_conns =
+				    strtoul(optarg, &end, 10);
+				if (errno == ERANGE || end == optarg
+				    || (*end && *end != ',')
+				    || param.preconnect.num_conns == 0) {
+					fprintf(stderr,
+						"%s: illegal number of "
+						"connections %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+				if (*end) {
+					optarg = end + 1;
+					param.preconnect.rate =
+					    strtod(optarg, &end);
+					if (errno == ERANGE || end == optarg
+					    || *end
+					    || param.preconnect.rate <= 0.0) {
+						fprintf(stderr,
+							"%s: illegal "
+							"pre-connect rate "
+							"%s\n",
+							prog_name, optarg);
+						exit(1);
+					}
+				}
+			} else if (flag == &param.series) {
+				char           *fmt;
+
+				param.series.file = optarg;
+				fmt = strrchr(optarg, ',');
+				if (fmt) {
+					*fmt++ = '\0';
+					if (strcmp(fmt, "json") == 0)
+						param.series.json = 1;
+					else if (strcmp(fmt, "csv") != 0) {
+						fprintf(stderr,
+							"%s: illegal series "
+							"format %s\n",
+							prog_name, fmt);
+						exit(1);
+					}
+				}
+				if (!*param.series.file) {
+					fprintf(stderr,
+						"%s: missing series file name\n",
+						prog_name);
+					exit(1);
+				}
+			} else if (flag == &param.verify) {
+				char           *frac;
+
+				param.verify.file = optarg;
+				param.verify.fraction = 1.0;
+				frac = strrchr(optarg, ',');
+				if (frac) {
+					*frac++ = '\0';
+					param.verify.fraction =
+					    strtod(frac, &end);
+					if (end == frac || *end
+					    || param.verify.fraction <= 0.0
+					    || param.verify.fraction > 1.0) {
+						fprintf(stderr,
+							"%s: illegal fraction "
+							"of replies to verify "
+							"%s\n", prog_name, frac);
+						exit(1);
+					}
+				}
+			} else if (flag == &param.warmup) {
+				char           *val = strchr(optarg, ',');
+				size_t          len = val ? (size_t) (val - optarg)
+				    : strlen(optarg);
+
+				errno = 0;
+				if (strncmp(optarg, "time", len) == 0 && val) {
+					param.warmup.mode = WARMUP_TIME;
+					param.warmup.time = strtod(val + 1, &end);
+				} else if (strncmp(optarg, "replies", len) == 0
+					   && val) {
+					param.warmup.mode = WARMUP_REPLIES;
+					param.warmup.replies =
+					    strtoul(val + 1, &end, 0);
+				} else if (strncmp(optarg, "auto", len) == 0) {
+					param.warmup.mode = WARMUP_AUTO;
+					param.warmup.time = 60.0;
+					end = optarg + len;
+					if (val)
+						param.warmup.time =
+						    strtod(val + 1, &end);
+				} else
+					end = optarg;
+				if (len == 0 || errno == ERANGE || *end
+				    || (val && end == val + 1)
+				    || (param.warmup.mode == WARMUP_REPLIES
+					? param.warmup.replies == 0
+					: param.warmup.time <= 0.0)) {
+					fprintf(stderr,
+						"%s: illegal warm-up "
+						"parameter %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+			} else if (flag == &param.capture) {
+				char           *arg[4] = {NULL, NULL, NULL,
+							  NULL};
+				u_long          size = 64, len = 0;
+				int             n, bad = 0;
+
+				/* F[,S[,H[,M]]] */
+				arg[0] = optarg;
+				for (n = 1; n < 4 && (arg[n] = strchr(arg[n - 1],
+							   ',')); ++n)
+					*arg[n]++ = '\0';
+				param.capture.file = arg[0];
+				param.capture.sample = 1;
+				errno = 0;
+				if (arg[1] && strcmp(arg[1], "errors") == 0)
+					param.capture.sample = 0;
+				else if (arg[1]) {
+					param.capture.sample =
+					    strtoul(arg[1], &end, 10);
+					bad |= end == arg[1] || *end
+					    || param.capture.sample == 0;
+				}
+				if (arg[2]) {
+					len = strtoul(arg[2], &end, 10);
+					bad |= end == arg[2] || *end
+					    || len > 4096;
+				}
+				if (arg[3]) {
+					size = strtoul(arg[3], &end, 10);
+					bad |= end == arg[3] || *end
+					    || size == 0;
+				}
+				if (bad || errno || !*param.capture.file) {
+					fprintf(stderr,
+						"%s: illegal capture "
+						"parameter %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+				param.capture.header_len = len;
+				param.capture.size = (u_wide) size << 20;
+			} else if (flag == &param.concurrency) {
+				char           *depth = NULL;
+
+				errno = 0;
+				param.concurrency.num_conns =
+				    strtoul(optarg, &end, 10);
+				param.concurrency.depth = 1;
+				if (errno == 0 && end != optarg && *end == ',') {
+					depth = end + 1;
+					param.concurrency.depth =
+					    strtoul(depth, &end, 10);
+				}
+				if (errno == ERANGE || end == optarg
+				    || end == depth || *end != '\0'
+				    || param.concurrency.num_conns == 0
+				    || param.concurrency.depth == 0) {
+					fprintf(stderr,
+						"%s: illegal concurrency "
+						"parameter %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+			} else if (flag == &param.websocket) {
+				u_long          size = 32;
+
+				errno = 0;
+				param.websocket.num_msgs =
+				    strtoul(optarg, &end, 10);
+				name = end;
+				if (errno == 0 && end != optarg && *end == ',') {
+					param.websocket.rate =
+					    strtod(end + 1, &name);
+					if (name != end + 1 && *name == ',')
+						size = strtoul(name + 1, &end,
+						    10);
+					else
+						end = name;
+				}
+				if (errno == ERANGE || end == optarg
+				    || *end != '\0'
+				    || param.websocket.num_msgs == 0
+				    || param.websocket.rate < 0.0
+				    || size > (1UL << 24)) {
+					fprintf(stderr,
+						"%s: illegal websocket "
+						"parameter %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+				param.websocket.msg_size = size;
+			} else if (flag == &param.search) {
+				double          v[4] = {0.0, 0.0, 1.0, 1.0};
+				int             n;
+
+				end = optarg;
+				for (n = 0; n < 4; ++n) {
+					errno = 0;
+					v[n] = strtod(end, &end);
+					if (errno == ERANGE || v[n] < 0.0)
+						break;
+					if (*end != ',')
+						break;
+					++end;
+				}
+				if (n < 1 || n > 3 || *end != '\0' || v[0] <= 0.0
+				    || v[0] >= 100.0 || v[1] <= 0.0
+				    || v[3] <= 0.0) {
+					fprintf(stderr,
+						"%s: illegal search "
+						"parameter %s\n",
+						prog_name, optarg);
+					exit(1);
+				}
+				param.search.pct = v[0] / 100;
+				param.search.max_latency = v[1] / 1e3;
+				param.search.max_errors = v[2] / 100;
+				param.search.interval = v[3];
+			} else if (flag == &param.uri_stats) {
+				param.uri_stats = 10;
+				if (optarg) {
+					errno = 0;
+					param.uri_stats =
+					    strtoul(optarg, &end, 10);
+					if (errno == ERANGE || end == optarg
+					    || *end || param.uri_stats < 1) {
+						fprintf(stderr,
+							"%s: illegal number of "
+							"URIs %s\n",
+							prog_name, optarg);
+						exit(1);
+					}
+				}
+			} else if (flag == &param.busy_poll) {
+				param.busy_poll = 50;
+				if (optarg) {
+					errno = 0;
+					param.busy_poll =
+					    strtoul(optarg, &end, 10);
+					if (errno == ERANGE || end == optarg
+					    || *end || param.busy_poll < 1) {
+						fprintf(stderr,
+							"%s: illegal busy poll "
+							"time %s\n",
+							prog_name, optarg);
+						exit(1);
+					}
+				}
+			} else if (flag == &param.unix_socket) {
+				param.unix_socket = optarg;
+				if (!*optarg || strlen(optarg) >=
+				    sizeof(((struct sockaddr_un *) 0)->sun_path)) {
+					fprintf(stderr,
+						"%s: illegal Unix socket path "
+						"%s\n", prog_name, optarg);
+					exit(1);
+				}
+			} else if (flag == &param.cpus) {
+				param.cpus = optarg;
+				if (worker_set_cpus(optarg) < 0) {
+					fprintf(stderr,
+						"%s: illegal CPU list %s (or "
+						"CPU not available)\n",
+						prog_name, optarg);
+					exit(1);
+				}
+			} else if (flag == &param.dns_refresh) {
+				param.dns_refresh = 60.0;
+				if (optarg) {
+					errno = 0;
+					param.dns_refresh =
+					    strtod(optarg, &end);
+					if (errno == ERANGE || end == optarg
+					    || *end
+					    || param.dns_refresh < 1.0) {
+						fprintf(stderr,
+							"%s: illegal DNS "
+							"refresh interval %s\n",
+							prog_name, optarg);
+						exit(1);
+					}
+				}
 			} else if (flag == &param.runtime) {
 				errno = 0;
 				param.runtime = strtod(optarg, &end);
@@ -722,9 +1209,40 @@ main(int argc, char **argv)
 				gen[1] = &uri_wlog;	/* XXX fix
 							 * me---somehow */
 
-				param.wlog.do_loop = (*optarg == 'y')
-				    || (*optarg == 'Y');
-				param.wlog.file = optarg + 2;
+				for (; *optarg && *optarg != ','; ++optarg)
+					switch (tolower(*optarg)) {
+					case 'y':
+						param.wlog.do_loop = 1;
+						break;
+					case 'n':
+						param.wlog.do_loop = 0;
+						break;
+					case 'r':
+						param.wlog.random = 1;
+						break;
+					case 't':
+						param.wlog.timed = 1;
+						break;
+					default:
+						fprintf(stderr, "%s: illegal --wlog "
+							"mode '%c'\n", prog_name,
+							*optarg);
+						exit(1);
+					}
+				if (*optarg != ',') {
+					fprintf(stderr, "%s: --wlog needs a file "
+						"name\n", prog_name);
+					exit(1);
+				}
+				if (param.wlog.random && param.wlog.timed) {
+					fprintf(stderr, "%s: --wlog can't replay "
+						"at random and at the recorded "
+						"times\n", prog_name);
+					exit(1);
+				}
+				param.wlog.file = optarg + 1;
+			} else if (flag == &param.wlog.compile) {
+				param.wlog.compile = optarg;
 			} else if (flag == &param.wsess) {
 				num_gen = 2;	/* XXX fix me---somehow */
 				gen[0] = &wsess;
@@ -882,7 +1400,9 @@ main(int argc, char **argv)
 					exit(1);
 				}
 				session_workload = 1;
-			} else if (flag == &param.wset) {
+			} else if (flag == &param.wsesslog.compile)
+				param.wsesslog.compile = optarg;
+			else if (flag == &param.wset) {
 				gen[1] = &uri_wset;	/* XXX fix
 							 * me---somehow */
 
@@ -917,6 +1437,51 @@ main(int argc, char **argv)
 					fputc('\n', stderr);
 					exit(1);
 				}
+			} else if (flag == &param.popularity) {
+				gen[1] = &uri_zipf;
+
+				errno = 0;
+				if (strncmp(optarg, "weights,", 8) == 0) {
+					param.popularity.file = optarg + 8;
+					break;
+				}
+				name = "expected zipf,N,S or weights,F";
+				end = optarg;
+				if (strncmp(optarg, "zipf,", 5) != 0)
+					goto bad_popularity_param;
+				optarg += 5;
+
+				name = "bad number of files";
+				param.popularity.num_files =
+				    strtoul(optarg, &end, 0);
+				if (end == optarg || errno == ERANGE
+				    || param.popularity.num_files == 0)
+					goto bad_popularity_param;
+
+				name = "bad Zipf exponent";
+				if (*end != ',')
+					goto bad_popularity_param;
+				optarg = end + 1;
+
+				param.popularity.exponent =
+				    strtod(optarg, &end);
+				if (end == optarg || errno == ERANGE
+				    || param.popularity.exponent < 0.0)
+					goto bad_popularity_param;
+
+				name = "extraneous parameter";
+				if (*end) {
+				      bad_popularity_param:
+					fprintf(stderr,
+						"%s: %s in --popularity arg "
+						"(rest: `%s')", prog_name,
+						name, end);
+					if (errno)
+						fprintf(stderr, ": %s",
+							strerror(errno));
+					fputc('\n', stderr);
+					exit(1);
+				}
 			}
 			break;
 
@@ -946,11 +1511,7 @@ main(int argc, char **argv)
 #ifndef DEBUG
 			       "out"
 #endif
-			       " DEBUG with"
-#ifndef TIME_SYSCALLS
-			       "out"
-#endif
-			       " TIME_SYSCALLS.\n", prog_name);
+			       " DEBUG.\n", prog_name);
 			exit(0);
 
 		case 'n':
@@ -984,6 +1545,9 @@ main(int argc, char **argv)
 		}
 	}
 
+	if (param.agent)
+		agent_serve(argv[0], param.agent);
+
 	if (param.server != NULL && param.servers != NULL) {
 		fprintf(stderr,
 			"%s: --server S or --servers file\n",
@@ -994,6 +1558,36 @@ main(int argc, char **argv)
 	if (param.server == NULL && param.servers == NULL)
 		param.server = "localhost";
 
+	if (param.unix_socket && param.tfo) {
+		fprintf(stderr, "%s: --tfo cannot be combined with "
+			"--unix-socket\n", prog_name);
+		exit(1);
+	}
+
+	if (param.bench)
+		bench_run(argv[0], param.bench);
+
+	if (param.wsesslog.compile) {
+		if (!param.wsesslog.file) {
+			fprintf(stderr, "%s: --wsesslog-compile needs the "
+				"session log given with --wsesslog\n",
+				prog_name);
+			exit(1);
+		}
+		wsesslog_compile(param.wsesslog.compile);
+		exit(0);
+	}
+
+	if (param.wlog.compile) {
+		if (!param.wlog.file) {
+			fprintf(stderr, "%s: --wlog-compile needs the "
+				"requests given with --wlog\n", prog_name);
+			exit(1);
+		}
+		wlog_compile(param.wlog.compile);
+		exit(0);
+	}
+
 #ifdef HAVE_SSL
 	if (param.use_ssl) {
 		char            buf[1024];
@@ -1001,16 +1595,26 @@ main(int argc, char **argv)
 		if (param.port < 0)
 			param.port = 443;
 
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS
+		    | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL);
+#else
                 SSL_library_init ();
 		SSL_load_error_strings ();
                 SSLeay_add_all_algorithms ();
 		SSLeay_add_ssl_algorithms ();
+#endif
 
 		switch (param.ssl_protocol)
                 {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+                    /* 0/auto for the best version both sides support */
+                    case 0: ssl_ctx = SSL_CTX_new (TLS_client_method ()); break;
+#else
                     /* 0/auto for SSLv23 */
                     case 0: ssl_ctx = SSL_CTX_new (SSLv23_client_method ()); break;
-#ifndef OPENSSL_NO_SSL2
+#endif
+#if !defined(OPENSSL_NO_SSL2) && OPENSSL_VERSION_NUMBER < 0x10100000L
                     /* 2/SSLv2 */
                     case 2: ssl_ctx = SSL_CTX_new (SSLv2_client_method ()); break;
 #endif
@@ -1019,7 +1623,18 @@ main(int argc, char **argv)
                     case 3: ssl_ctx = SSL_CTX_new (SSLv3_client_method ()); break;
 #endif
                     /* 4/TLSv1 */
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+                    case 4:
+                        ssl_ctx = SSL_CTX_new (TLS_client_method ());
+                        if (ssl_ctx)
+                          {
+                            SSL_CTX_set_min_proto_version (ssl_ctx, TLS1_VERSION);
+                            SSL_CTX_set_max_proto_version (ssl_ctx, TLS1_VERSION);
+                          }
+                        break;
+#else
                     case 4: ssl_ctx = SSL_CTX_new (TLSv1_client_method ()); break;
+#endif
                 }
       
 		if (!ssl_ctx) {
@@ -1029,6 +1644,32 @@ main(int argc, char **argv)
 
 		memset(buf, 0, sizeof(buf));
 		RAND_seed(buf, sizeof(buf));
+
+		/*
+		 * SSL_writev() may hand over a different buffer when it
+		 * retries a write (see lib/ssl_writev.c).
+		 */
+		SSL_CTX_set_mode(ssl_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE
+		    | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+		/*
+		 * Offer HTTP/2 but take HTTP/1.1 if that's all the server
+		 * speaks (see core_ssl_connect()).
+		 */
+		if (param.http2)
+			SSL_CTX_set_alpn_protos(ssl_ctx,
+			    (const u_char *) "\x02h2\x08http/1.1", 12);
+
+		if (param.ssl_ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+			SSL_CTX_set_options(ssl_ctx, SSL_OP_ENABLE_KTLS);
+#else
+			fprintf(stderr, "%s: warning: this OpenSSL has no "
+			    "kernel TLS support; ignoring --ssl-ktls\n",
+			    prog_name);
+			param.ssl_ktls = 0;
+#endif
+		}
                 
                 /* set server certificate verification */
                 if (param.ssl_verify == 1)
@@ -1090,6 +1731,85 @@ main(int argc, char **argv)
 
 	if (param.print_reply || param.print_request)
 		stat[num_stats++] = &stats_print_reply;
+	if (param.series.file)
+		stat[num_stats++] = &stats_series;
+	if (param.uri_stats)
+		stat[num_stats++] = &stats_uri;
+	if (param.verify.file)
+		stat[num_stats++] = &stats_verify;
+	if (param.encoding.accept || param.encoding.decode)
+		stat[num_stats++] = &stats_encoding;
+	if (param.capture.file)
+		stat[num_stats++] = &stats_capture;
+	if (param.live_stats)
+		stat[num_stats++] = &stats_live;
+	if (param.search.pct > 0.0) {
+		if (param.rate.rate_param <= 0.0
+		    || (param.rate.dist != DETERMINISTIC
+			&& param.rate.dist != EXPONENTIAL
+			&& param.rate.dist != UNIFORM)) {
+			fprintf(stderr, "%s: --search needs a starting --rate "
+			    "or a deterministic, exponential or uniform "
+			    "--period\n", prog_name);
+			exit(1);
+		}
+		if (param.workers > 1 || param.agents) {
+			fprintf(stderr, "%s: --search works with a single "
+			    "worker only\n", prog_name);
+			exit(1);
+		}
+		if (param.warmup.mode) {
+			fprintf(stderr, "%s: --search cannot be combined with "
+			    "--warmup\n", prog_name);
+			exit(1);
+		}
+		stat[num_stats++] = &stats_search;
+	}
+	stat[num_stats++] = &stats_self;
+
+	if (param.concurrency.num_conns) {
+		if (session_workload || param.rate.rate_param > 0.0) {
+			fprintf(stderr, "%s: --concurrency cannot be combined "
+			    "with --rate, --period or session workloads\n",
+			    prog_name);
+			exit(1);
+		}
+		gen[0] = &conn_fixed;	/* replaces call_seq and conn_rate */
+		num_gen = 2;
+	}
+
+	if (param.websocket.num_msgs) {
+		if (session_workload || param.concurrency.num_conns
+		    || param.http2) {
+			fprintf(stderr, "%s: --websocket cannot be combined "
+			    "with --concurrency, --http2 or session "
+			    "workloads\n", prog_name);
+			exit(1);
+		}
+		gen[0] = &ws_echo;	/* replaces call_seq */
+		stat[num_stats++] = &stats_ws;
+	}
+
+	/*
+	 * The pre-connected connections wait in the idle pool, which has to
+	 * be able to hold them all.
+	 */
+	if (param.preconnect.num_conns) {
+#ifdef HAVE_IO_URING
+		if (param.use_io_uring) {
+			fprintf(stderr, "%s: --preconnect cannot be combined "
+			    "with --io-uring\n", prog_name);
+			exit(1);
+		}
+#endif
+		if (param.http2 || param.websocket.num_msgs) {
+			fprintf(stderr, "%s: --preconnect cannot be combined "
+			    "with --http2 or --websocket\n", prog_name);
+			exit(1);
+		}
+		if (param.conn_pool.max_idle < param.preconnect.num_conns)
+			param.conn_pool.max_idle = param.preconnect.num_conns;
+	}
 
 	if (param.session_cookies) {
 		if (!session_workload) {
@@ -1102,7 +1822,7 @@ main(int argc, char **argv)
 	}
 
 	if (param.additional_header || param.additional_header_file ||
-	    param.method)
+	    param.method || param.encoding.accept)
 		gen[num_gen++] = &misc;
 
 	/*
@@ -1139,14 +1859,42 @@ main(int argc, char **argv)
 	}
 	if (param.hog)
 		printf(" --hog");
+	if (param.tfo)
+		printf(" --tfo");
+	if (param.cpus)
+		printf(" --cpus=%s", param.cpus);
+	if (param.busy_poll)
+		printf(" --busy-poll=%u", param.busy_poll);
+#ifdef HAVE_IO_URING
+	if (param.use_io_uring)
+		printf(" --io-uring");
+#endif
 	if (param.close_with_reset)
 		printf(" --close-with-reset");
+	if (param.conn_pool.max_idle)
+		printf(" --conn-pool=%u,%g", param.conn_pool.max_idle,
+		       param.conn_pool.idle_timeout);
+	if (param.prealloc.num_conns || param.prealloc.num_calls
+	    || param.prealloc.num_sessions)
+		printf(" --prealloc=%u,%u,%u", param.prealloc.num_conns,
+		       param.prealloc.num_calls, param.prealloc.num_sessions);
+	if (param.preconnect.num_conns)
+		printf(" --preconnect=%u,%g", param.preconnect.num_conns,
+		       param.preconnect.rate);
 	if (param.think_timeout > 0)
 		printf(" --think-timeout=%g", param.think_timeout);
 	if (param.timeout > 0)
 		printf(" --timeout=%g", param.timeout);
 	if (param.runtime > 0)
 		printf(" --runtime=%g", param.runtime);
+	if (param.dns_refresh > 0)
+		printf(" --dns-refresh=%g", param.dns_refresh);
+	if (param.concurrency.num_conns)
+		printf(" --concurrency=%u,%u", param.concurrency.num_conns,
+		       param.concurrency.depth);
+	if (param.websocket.num_msgs)
+		printf(" --websocket=%lu,%g,%u", param.websocket.num_msgs,
+		       param.websocket.rate, param.websocket.msg_size);
 	printf(" --client=%u/%u", param.client.id, param.client.num_clients);
 	if (param.server)
 		printf(" --server=%s", param.server);
@@ -1156,6 +1904,8 @@ main(int argc, char **argv)
 		printf(" --servers=%s", param.servers);
 	if (param.port)
 		printf(" --port=%d", param.port);
+	if (param.unix_socket)
+		printf(" --unix-socket=%s", param.unix_socket);
 	if (param.uri)
 		printf(" --uri=%s", param.uri);
 	if (param.failure_status)
@@ -1163,6 +1913,8 @@ main(int argc, char **argv)
 	if (param.http_version != 0x10001)
 		printf(" --http-version=%u.%u", param.http_version >> 16,
 		       param.http_version & 0xffff);
+	if (param.http2)
+		printf(" --http2");
 	if (param.max_conns)
 		printf(" --max-connections=%lu", param.max_conns);
 	if (param.max_piped)
@@ -1199,6 +1951,11 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case TRACE:
+			if (param.rate.trace_file)
+				printf(" --period=t%s", param.rate.trace_file);
+			break;
+
 		default:
 			printf("--period=??");
 			break;
@@ -1225,7 +1982,7 @@ main(int argc, char **argv)
         switch (param.ssl_protocol)
         {
             case 0: printf (" --ssl-protocol=auto");  break;
-#ifndef OPENSSL_NO_SSL2
+#if !defined(OPENSSL_NO_SSL2) && OPENSSL_VERSION_NUMBER < 0x10100000L
             case 2: printf (" --ssl-protocol=SSLv2"); break;
 #endif
 #ifndef OPENSSL_NO_SSL3
@@ -1233,6 +1990,8 @@ main(int argc, char **argv)
 #endif
             case 4: printf (" --ssl-protocol=TLSv1"); break;
         }
+	if (param.ssl_ktls)
+		printf(" --ssl-ktls");
 #endif
 	if (param.additional_header)
 		printf(" --add-header='%s'", param.additional_header);
@@ -1242,6 +2001,17 @@ main(int argc, char **argv)
 		printf(" --method=%s", param.method);
 	if (param.use_timer_cache)
 		printf(" --use-timer-cache");
+	switch (param.clock) {
+	case TIMER_CLOCK_GETTIMEOFDAY:
+		printf(" --clock=gettimeofday");
+		break;
+	case TIMER_CLOCK_COARSE:
+		printf(" --clock=coarse");
+		break;
+	case TIMER_CLOCK_TSC:
+		printf(" --clock=tsc");
+		break;
+	}
 	if (param.wsesslog.num_sessions) {
 		/*
 		 * This overrides any --wsess, --num-conns, --num-calls,
@@ -1268,11 +2038,73 @@ main(int argc, char **argv)
 			printf(" --wset=%u,%.3f",
 			       param.wset.num_files,
 			       param.wset.target_miss_rate);
+		if (param.popularity.file)
+			printf(" --popularity=weights,%s",
+			       param.popularity.file);
+		else if (param.popularity.num_files)
+			printf(" --popularity=zipf,%u,%g",
+			       param.popularity.num_files,
+			       param.popularity.exponent);
 	}
 	if (periodic_stats)
 		printf(" --periodic-stats");
+	if (param.series.file)
+		printf(" --series=%s,%s", param.series.file,
+		       param.series.json ? "json" : "csv");
+	if (param.uri_stats)
+		printf(" --uri-stats=%u", param.uri_stats);
+	if (param.verify.file)
+		printf(" --verify=%s,%g", param.verify.file,
+		       param.verify.fraction);
+	if (param.encoding.accept)
+		printf(" --accept-encoding='%s'", param.encoding.accept);
+	if (param.encoding.decode)
+		printf(" --decode");
+	if (param.capture.file) {
+		printf(" --capture=%s,", param.capture.file);
+		if (param.capture.sample)
+			printf("%u", param.capture.sample);
+		else
+			printf("errors");
+		printf(",%u,%llu", param.capture.header_len,
+		       (unsigned long long) (param.capture.size >> 20));
+	}
+	if (param.warmup.mode == WARMUP_TIME)
+		printf(" --warmup=time,%g", param.warmup.time);
+	else if (param.warmup.mode == WARMUP_REPLIES)
+		printf(" --warmup=replies,%lu", param.warmup.replies);
+	else if (param.warmup.mode == WARMUP_AUTO)
+		printf(" --warmup=auto,%g", param.warmup.time);
+	if (param.search.pct > 0.0)
+		printf(" --search=%g,%g,%g,%g", 100 * param.search.pct,
+		       1e3 * param.search.max_latency,
+		       100 * param.search.max_errors, param.search.interval);
+	if (param.self_stats)
+		printf(" --self-stats");
+	if (param.live_stats)
+		printf(" --live-stats=%s", param.live_stats);
+	if (param.control)
+		printf(" --control=%s", param.control);
+	if (param.workers > 1)
+		printf(" --workers=%d", param.workers);
+	if (param.agents)
+		printf(" --agents=%s", param.agents);
 	printf("\n");
 
+	/*
+	 * Calibrate the clock before forking, so all workers share its
+	 * time scale.
+	 */
+	if (!timer_clock_init(param.clock)) {
+		fprintf(stderr, "%s: the selected --clock is not available "
+			"on this system\n", prog_name);
+		exit(1);
+	}
+
+	agent_init();
+	if (!param.agents)
+		worker_start();
+
 	if (timer_init() == false) {
 		fprintf(stderr,
 			"%s: timer_init(): failed initialization (%d)\n",
@@ -1287,6 +2119,38 @@ main(int argc, char **argv)
 		(*stat[i]->init) ();
 	for (i = 0; i < num_gen; ++i)
 		(*gen[i]->init) ();
+	if (!param.agents) {
+		warmup_init(stat, num_stats);
+		control_init(stat, num_stats);
+	}
+
+	/*
+	 * All modules have reserved their private object data by now, so the
+	 * objects can be laid out ahead of the test.  Every connection and
+	 * session may have a timer pending.
+	 */
+	if (object_prealloc(OBJ_CONN, param.prealloc.num_conns) < 0
+	    || object_prealloc(OBJ_CALL, param.prealloc.num_calls) < 0
+	    || object_prealloc(OBJ_SESS, param.prealloc.num_sessions) < 0
+	    || !timer_prealloc((u_long) param.prealloc.num_conns
+		+ param.prealloc.num_sessions)) {
+		fprintf(stderr, "%s: failed to preallocate objects: %s\n",
+			prog_name, strerror(errno));
+		exit(1);
+	}
+
+	/*
+	 * Get the handshakes out of the way before the test, and forget
+	 * about the work they took.
+	 */
+	if (!param.agents && param.preconnect.num_conns) {
+		core_preconnect();
+		for (i = 0; i < num_stats; ++i)
+			if (stat[i]->reset)
+				(*stat[i]->reset) ();
+	}
+
+	agent_start();
 
 	/*
 	 * Update `now'.  This is to keep things accurate even when some of
@@ -1295,28 +2159,56 @@ main(int argc, char **argv)
 	timer_now_forced();
 
 	/*
-	 * ensure that clients sample rates at different times: 
+	 * ensure that clients sample rates at different times (but the
+	 * workers of one client all at the same time, so that their samples
+	 * can be added up): 
+	 */
+	t = (param.client.id / param.workers + 1.0) * RATE_INTERVAL
+	    / (param.client.num_clients / param.workers);
+	/*
+	 * ...and agents, which start together, all at the same time too.
 	 */
-	t = (param.client.id + 1.0) * RATE_INTERVAL / param.client.num_clients;
+	if (agent_mode)
+		t = RATE_INTERVAL;
 	arg.l = 0;
 	timer_schedule(perf_sample, arg, t);
 	perf_sample_start = timer_now();
 
-	for (i = 0; i < num_gen; ++i)
-		(*gen[i]->start) ();
-	for (i = 0; i < num_stats; ++i)
-		(*stat[i]->start) ();
-
-	getrusage(RUSAGE_SELF, &test_rusage_start);
-	test_time_start = timer_now();
-	core_loop();
-	test_time_stop = timer_now();
-	getrusage(RUSAGE_SELF, &test_rusage_stop);
+	if (param.agents) {
+		/*
+		 * The agents generate the load; all we see of the test
+		 * are their results.
+		 */
+		for (i = 0; i < num_stats; ++i)
+			(*stat[i]->start) ();
+		getrusage(RUSAGE_SELF, &test_rusage_start);
+		test_rusage_stop = test_rusage_start;
+		test_time_start = test_time_stop = timer_now();
+		agent_control(stat, num_stats);
+	} else {
+		for (i = 0; i < num_gen; ++i)
+			(*gen[i]->start) ();
+		for (i = 0; i < num_stats; ++i)
+			(*stat[i]->start) ();
+
+		getrusage(RUSAGE_SELF, &test_rusage_start);
+		test_time_start = timer_now();
+		warmup_start();
+		core_loop();
+		test_time_stop = timer_now();
+		getrusage(RUSAGE_SELF, &test_rusage_stop);
+		control_stop();
+	}
 
 	for (i = 0; i < num_stats; ++i)
 		(*stat[i]->stop) ();
 	for (i = 0; i < num_gen; ++i)
 		(*gen[i]->stop) ();
+
+	worker_collect(stat, num_stats);
+	agent_report(stat, num_stats);
+
+	warmup_report();
 	for (i = 0; i < num_stats; ++i)
 		(*stat[i]->dump) ();
 
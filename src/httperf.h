@@ -46,7 +46,8 @@ typedef enum Dist_Type
     DETERMINISTIC,	/* also called fixed-rate */
     UNIFORM,		/* over interval [min_iat,max_iat) */
     VARIABLE,           /* allows varying input load */
-    EXPONENTIAL		/* with mean mean_iat */
+    EXPONENTIAL,	/* with mean mean_iat */
+    TRACE		/* as recorded in the --wlog trace */
   }
 Dist_Type;
 
@@ -69,6 +70,15 @@ typedef struct Stat_Collector
     void (*start) (void);
     void (*stop) (void);
     void (*dump) (void);
+    /* Optional, used to combine the results of several worker
+       processes (see --workers).  EXPORT returns the collector's state
+       as a block of *LEN bytes; MERGE folds such a block, exported by
+       another process, into the local state.  */
+    const void *(*export) (size_t *len);
+    void (*merge) (const void *buf, size_t len);
+    /* Optional, called when the warm-up is over (see --warmup) to
+       forget what was collected during it.  */
+    void (*reset) (void);
   }
 Stat_Collector;
 
@@ -82,31 +92,45 @@ typedef struct Rate_Info
     int numRates;               /* number of rates we want to use */
     Time iat[NUM_RATES];
     Time duration[NUM_RATES];
+    Time phase;			/* delay of first arrival (for --workers) */
+    const char *trace_file;	/* arrival times (for TRACE, or 0) */
   }
 Rate_Info;
 
 #define PRINT_HEADER	(1 << 0)
 #define PRINT_BODY	(1 << 1)
 
+#define WARMUP_TIME	1	/* warm up for a given time */
+#define WARMUP_REPLIES	2	/* ...for a given number of replies */
+#define WARMUP_AUTO	3	/* ...until the load is steady */
+
 typedef struct Cmdline_Params
   {
     int http_version;	/* (default) HTTP protocol version */
+    int http2;		/* speak HTTP/2 (with --ssl, if the server agrees) */
     const char *server;	/* (default) hostname */
     const char *server_name; /* fully qualified server name */
     const char *servers;
     int port;		/* (default) server port */
+    const char *unix_socket;	/* connect to this Unix socket (or 0) */
     const char *uri;	/* (default) uri */
     const char *myaddr;
+    const char *agent;	/* [ADDR:]PORT to wait for controllers on */
+    const char *agents;	/* HOST:PORT,... of the agents to run the test */
     Rate_Info rate;
     Time timeout;	/* watchdog timeout */
     Time think_timeout;	/* timeout for server think time */
     Time runtime;	/* how long to run the test */
+    Time dns_refresh;	/* look servers up again this often (0 = never) */
     u_long num_conns;	/* # of connections to generate */
     u_long num_calls;	/* # of calls to generate per connection */
     u_long burst_len;	/* # of calls to burst back-to-back */
     u_long max_piped;	/* max # of piped calls per connection */
     u_long max_conns;	/* max # of connections per session */
     int hog;		/* client may hog as much resources as possible */
+    int tfo;		/* connect with TCP Fast Open */
+    const char *cpus;	/* CPUs to pin the event loops to (or 0) */
+    u_int busy_poll;	/* SO_BUSY_POLL time in microseconds (0 = off) */
     u_long send_buffer_size;
     u_long recv_buffer_size;
     int failure_status;	/* status code that should be considered failure */
@@ -116,6 +140,15 @@ typedef struct Cmdline_Params
     int print_reply;	/* bit 0: print repl headers, bit 1: print repl body */
     int session_cookies; /* handle set-cookies? (at the session level) */
     int no_host_hdr;	/* don't send Host: header in request */
+    int workers;	/* # of worker processes */
+    u_int uri_stats;	/* # of URIs to report per-URI statistics for */
+    int self_stats;	/* report on httperf's own performance */
+    int bench;		/* benchmarks to run instead of a test */
+    const char *live_stats;	/* file to keep live statistics in (or 0) */
+    const char *control;	/* Unix socket to take commands on (or 0) */
+#ifdef HAVE_IO_URING
+    int use_io_uring;	/* do I/O through io_uring instead of readiness */
+#endif
 #ifdef HAVE_SSL
     int use_ssl;	/* connect via SSL */
     int ssl_reuse;	/* reuse SSL Session ID */
@@ -126,8 +159,10 @@ typedef struct Cmdline_Params
     const char *ssl_key; /* client key file name */
     const char *ssl_ca_file; /* certificate authority file */
     const char *ssl_ca_path; /* certificate authority path */
+    int ssl_ktls;	/* let the kernel do the TLS record layer */
 #endif
     int use_timer_cache;
+    int clock;		/* clock source (TIMER_CLOCK_*) */
     const char *additional_header;	/* additional request header(s) */
     const char *additional_header_file;
     const char *method;	/* default call method */
@@ -141,6 +176,9 @@ typedef struct Cmdline_Params
       {
 	char *file;	/* name of the file where entries are */
 	char do_loop;	/* boolean indicating if we want to loop on entries */
+	char random;	/* pick entries at random (traces only) */
+	char timed;	/* replay at the recorded times (traces only) */
+	char *compile;	/* file to write the compiled trace to */
       }
     wlog;
     struct
@@ -162,6 +200,7 @@ typedef struct Cmdline_Params
 	u_int num_sessions;	/* # of user-sessions */
 	Time think_time;	/* user think time between calls */
 	char *file;		/* name of the file where session defs are */
+	char *compile;		/* file to write the compiled sessions to */
       }
     wsesslog;
     struct
@@ -170,6 +209,86 @@ typedef struct Cmdline_Params
 	double target_miss_rate;
       }
     wset;
+    struct
+      {
+	u_int num_files;	/* # of files to pick from */
+	double exponent;	/* of the Zipf distribution */
+	const char *file;	/* file with the files' weights (or 0) */
+      }
+    popularity;
+    struct
+      {
+	u_int max_idle;		/* max. # of idle connections per server */
+	Time idle_timeout;	/* how long a connection may stay idle */
+      }
+    conn_pool;
+    struct
+      {
+	u_int num_conns;	/* # of connections to open before the test */
+	double rate;		/* # opened per second (0 = all at once) */
+      }
+    preconnect;
+    struct
+      {
+	u_int num_conns;	/* # of connection objects to preallocate */
+	u_int num_calls;	/* # of call objects to preallocate */
+	u_int num_sessions;	/* # of session objects to preallocate */
+      }
+    prealloc;
+    struct
+      {
+	const char *file;	/* where to write the time series (or 0) */
+	int json;		/* write JSON rather than CSV records? */
+      }
+    series;
+    struct
+      {
+	double pct;		/* latency percentile to bound (0 = no search) */
+	Time max_latency;	/* bound on that percentile */
+	double max_errors;	/* max. fraction of failed requests */
+	Time interval;		/* measurement interval */
+      }
+    search;
+    struct
+      {
+	int mode;		/* WARMUP_* (0 = no warm-up) */
+	Time time;		/* how long (the limit for WARMUP_AUTO) */
+	u_long replies;		/* # of replies (for WARMUP_REPLIES) */
+      }
+    warmup;
+    struct
+      {
+	u_int num_conns;	/* # of connections to keep busy (0 = off) */
+	u_int depth;		/* # of calls outstanding per connection */
+      }
+    concurrency;
+    struct
+      {
+	const char *file;	/* expected lengths and CRC32Cs (or 0) */
+	double fraction;	/* fraction of the replies to check */
+      }
+    verify;
+    struct
+      {
+	const char *accept;	/* Accept-Encoding to send (or 0) */
+	int decode;		/* decode compressed replies? */
+      }
+    encoding;
+    struct
+      {
+	const char *file;	/* where to record the calls (or 0) */
+	u_int sample;		/* record 1 in SAMPLE calls (0 = failed ones) */
+	u_int header_len;	/* # of reply header bytes to record */
+	u_wide size;		/* bytes of the file per worker */
+      }
+    capture;
+    struct
+      {
+	u_long num_msgs;	/* # of messages per connection (0 = off) */
+	double rate;		/* messages/s per connection (0 = on echo) */
+	u_int msg_size;		/* payload bytes per message */
+      }
+    websocket;
   }
 Cmdline_Params;
 
@@ -178,6 +297,7 @@ extern int verbose;
 extern int periodic_stats;
 extern Cmdline_Params param;
 extern Time test_time_start;
+extern u_int test_epoch;
 extern Time test_time_stop;
 extern struct rusage test_rusage_start;
 extern struct rusage test_rusage_stop;
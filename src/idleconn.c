@@ -30,6 +30,24 @@
 
 #include "config.h"
 
+/*
+ * idleconn opens a given number of connections to a server and keeps them
+ * open, to see how the server copes with many mostly idle clients (such as
+ * long-polling or mobile clients).  A connection that the server closes is
+ * opened again.
+ *
+ * Each worker thread runs its own libevent loop over its share of the
+ * connections.  A connection is described by a small record in an array
+ * rather than a malloc'ed event structure: on Linux, the sockets of a
+ * worker sit in an epoll instance of their own that libevent watches as
+ * a single descriptor, so a record is no more than the socket, the
+ * source address and a state.  Optionally, every connection writes a few
+ * bytes now and then to emulate keep-alive traffic.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>		/* For strrchr() */
@@ -40,195 +58,508 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include <generic_types.h>
 #include <event.h>
-#include <evdns.h>
 
-#include <list.h>
+#define NELEMS(a)	((sizeof (a)) / sizeof ((a)[0]))
+
+#define TICK_USEC	10000	/* how often a worker opens and pings */
+#define OPEN_BATCH	1024	/* max. connections opened per worker and tick */
+#define MAX_WORKERS	256
+
+enum {
+	IDLE_CLOSED,
+	IDLE_CONNECTING,
+	IDLE_OPEN
+};
 
 /*
- * Events allocated onto the heap
+ * One connection.  There may be millions of these, so keep it small.
  */
-static struct List *active_events = NULL;
+struct idle {
+#ifndef HAVE_SYS_EPOLL_H
+	struct event    ev;
+#endif
+	int             sd;
+	u_short         source;	/* index into sources[] */
+	u_char          state;
+};
+
+struct worker {
+	struct event_base *base;
+	struct event    tick;
+#ifdef HAVE_SYS_EPOLL_H
+	int             epfd;
+	struct event    ready;	/* epfd is readable */
+#endif
+	struct idle    *conns;
+	u_int           num_conns;
+	u_int          *closed;	/* stack of closed connections */
+	u_int           num_closed;
+	u_int           next_source;
+	u_int           next_ping;
+	double          ping_credit;
+	char            buf[4096];	/* for whatever the server sends */
+
+	u_long          num_open;
+	u_long          num_created;	/* # of connections established */
+	u_long          num_lost;	/* # closed by the server */
+	u_long          num_failed;	/* # of failed connects */
+	u_long          num_pings;
+	u_wide          bytes_received;
+};
 
 static const char *prog_name = NULL;
-static unsigned long num_conn = 0, num_closed = 0;
 static struct timeval start_time;
-static struct sockaddr_in server_addr;
+static struct sockaddr_storage server_addr;
+static socklen_t server_addr_len;
+static struct sockaddr_storage *sources;	/* from -a */
+static socklen_t *source_len;
+static int      num_sources;
 
 static char    *server = NULL;
 static int      desired = 0;	/* Number of desired connections */
-static int      port = 0;
+static char    *port = NULL;
+static int      num_workers = 1;
+static struct worker workers[MAX_WORKERS];
+static double   ping_interval;	/* seconds between pings (0 = off) */
+static char     ping_data[256] = "\r\n";
+static size_t   ping_len = 2;
+static size_t   rss_start;
+static int      reported;	/* memory use after opening reported? */
 
 /*
- * Frees the linked list of active event structures
+ * Resident memory of the process, in bytes.
  */
-static void
-cleanup()
+static size_t
+rss(void)
 {
-	if (active_events != NULL) {
-		while (!is_list_empty(active_events)) {
-			Any_Type        a = list_pop(active_events);
-			struct event   *evsock = (struct event *) a.vp;
-			event_del(evsock);
-			free(a.vp);
+	struct rusage   ru;
+	u_long          size, resident;
+	FILE           *f;
+
+	f = fopen("/proc/self/statm", "r");
+	if (f) {
+		if (fscanf(f, "%lu %lu", &size, &resident) == 2) {
+			fclose(f);
+			return resident * sysconf(_SC_PAGESIZE);
 		}
-		list_free(active_events);
+		fclose(f);
 	}
+	/*
+	 * The peak rather than the current size, in kilobytes.
+	 */
+	getrusage(RUSAGE_SELF, &ru);
+	return (size_t) ru.ru_maxrss * 1024;
+}
+
+static void
+report_memory(u_long num_open)
+{
+	size_t          used = rss() - rss_start;
+
+	printf("%s: %lu connections open; client memory %.1f MB, "
+	       "%.0f bytes per connection\n", prog_name, num_open,
+	       used / 1048576.0, num_open ? (double) used / num_open : 0.0);
+	fflush(stdout);
 }
 
 /*
  * Signal handler callback to be executed by event_dispatch upon receipt of
  * SIGINT (usually Control-C
  */
-void
+static void
 sigint_exit(int fd, short event, void *arg)
 {
-	struct event   *signal_int = arg;
 	struct timeval  stop_time;
 	double          delta_t = 0;
+	u_long          num_conn = 0, num_closed = 0, num_open = 0,
+	                num_failed = 0, num_pings = 0;
+	u_wide          bytes = 0;
+	int             i;
 
 	gettimeofday(&stop_time, NULL);
 
 	delta_t = ((stop_time.tv_sec - start_time.tv_sec)
 		   + 1e-6 * (stop_time.tv_usec - start_time.tv_usec));
 
+	/*
+	 * The other workers keep running; their counters are only read.
+	 */
+	for (i = 0; i < num_workers; ++i) {
+		num_conn += workers[i].num_created;
+		num_closed += workers[i].num_lost;
+		num_open += workers[i].num_open;
+		num_failed += workers[i].num_failed;
+		num_pings += workers[i].num_pings;
+		bytes += workers[i].bytes_received;
+	}
+
 	printf("%s: Total conns created = %lu; close() rate = %g conn/sec\n",
 	       prog_name, num_conn, num_closed / delta_t);
+	printf("%s: failed connects = %lu; pings sent = %lu; "
+	       "bytes received = %llu\n", prog_name, num_failed, num_pings,
+	       (unsigned long long) bytes);
+	report_memory(num_open);
 
 #ifdef DEBUG
 	printf("%s: caught SIGINT... Exiting.\n", __func__);
 #endif /* DEBUG */
 
-	evdns_shutdown(0);
-	event_del(signal_int);
-
-	cleanup();
+	exit(EXIT_SUCCESS);
 }
 
+static void     idle_ready(struct worker *w, struct idle *c, int writable);
+
+#ifdef HAVE_SYS_EPOLL_H
+
 /*
- * Connection disconnect handler.  Once a connection is dropped by the remote
- * host, this function is executed and a new connection is established.
- *
- * Note, that this re-uses the event structure originally allocated in 
- * dns_lookup_callback
+ * Make worker W wait for connection C to become writable (while it is
+ * connecting) or readable.  OP is WATCH_ADD for a new socket, WATCH_MOD
+ * otherwise.
  */
-void
-reconnect(int sd, short event, void *arg)
+static int
+idle_watch(struct worker *w, struct idle *c, int op)
 {
-	struct sockaddr_in sin = server_addr;
-	struct event   *evsock = (struct event *) arg;
+	struct epoll_event ev;
 
-	close(sd);
-	num_closed++;
+	ev.events = c->state == IDLE_CONNECTING ? EPOLLOUT : EPOLLIN;
+	ev.data.u32 = c - w->conns;
+	return epoll_ctl(w->epfd, op, c->sd, &ev);
+}
+
+#define WATCH_ADD	EPOLL_CTL_ADD
+#define WATCH_MOD	EPOLL_CTL_MOD
+#define idle_unwatch(w, c)	/* close() takes the socket out of epfd */
+
+static void
+worker_ready(int fd, short event, void *arg)
+{
+	struct worker  *w = arg;
+	struct epoll_event ev[256];
+	int             i, n;
+
+	n = epoll_wait(w->epfd, ev, NELEMS(ev), 0);
+	for (i = 0; i < n; ++i)
+		idle_ready(w, &w->conns[ev[i].data.u32],
+		    (ev[i].events & EPOLLOUT) != 0);
+}
+
+#else
+
+static struct worker *
+worker_of(struct idle *c)
+{
+	int             i;
+
+	for (i = 0; i < num_workers; ++i)
+		if (c >= workers[i].conns
+		    && c < workers[i].conns + workers[i].num_conns)
+			return &workers[i];
+	abort();
+}
+
+static void
+idle_event(int sd, short event, void *arg)
+{
+	struct idle    *c = arg;
+
+	idle_ready(worker_of(c), c, (event & EV_WRITE) != 0);
+}
+
+static int
+idle_watch(struct worker *w, struct idle *c, int op)
+{
+	if (op == WATCH_MOD)
+		event_del(&c->ev);
+	if (c->state == IDLE_CONNECTING)
+		event_set(&c->ev, c->sd, EV_WRITE, idle_event, c);
+	else
+		event_set(&c->ev, c->sd, EV_READ | EV_PERSIST, idle_event, c);
+	event_base_set(w->base, &c->ev);
+	return event_add(&c->ev, NULL);
+}
+
+#define WATCH_ADD	0
+#define WATCH_MOD	1
+#define idle_unwatch(w, c)	event_del(&(c)->ev)
+
+#endif /* HAVE_SYS_EPOLL_H */
+
+/*
+ * Close connection C; the next tick of its worker opens it again.
+ */
+static void
+idle_close(struct worker *w, struct idle *c)
+{
+	if (c->state == IDLE_OPEN)
+		--w->num_open;
+	idle_unwatch(w, c);
+	close(c->sd);
+	c->sd = -1;
+	c->state = IDLE_CLOSED;
+	w->closed[w->num_closed++] = c - w->conns;
+}
 
-	sd = socket(AF_INET, SOCK_STREAM, 0);
+static void
+idle_open(struct worker *w, struct idle *c)
+{
+	int             sd, optval;
 
+	sd = socket(server_addr.ss_family, SOCK_STREAM, 0);
 	if (sd == -1) {
 		perror("socket");
 		exit(EXIT_FAILURE);
 	}
+	fcntl(sd, F_SETFL, O_NONBLOCK);
+	c->sd = sd;
+	c->state = IDLE_CONNECTING;
+
+	if (num_sources > 0) {
+		c->source = w->next_source++ % num_sources;
+#ifdef IP_BIND_ADDRESS_NO_PORT
+		/*
+		 * Let connect() pick the port, so that a port is only taken
+		 * for this server rather than for good.
+		 */
+		optval = 1;
+		setsockopt(sd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &optval,
+		    sizeof(optval));
+#endif
+		if (bind(sd, (struct sockaddr *) &sources[c->source],
+			source_len[c->source]) < 0)
+			goto failure;
+	}
 
-	if (connect(sd, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
-		perror("connect");
-		cleanup();
+	if (connect(sd, (struct sockaddr *) &server_addr,
+		server_addr_len) < 0 && errno != EINPROGRESS)
+		goto failure;
+	if (idle_watch(w, c, WATCH_ADD) < 0) {
+		perror("idle_watch");
 		exit(EXIT_FAILURE);
 	}
+	return;
 
-	event_set(evsock, sd, EV_READ, reconnect, evsock);
-	event_add(evsock, NULL);
-	num_conn++;
-
+failure:
+	++w->num_failed;
+	close(sd);
+	c->sd = -1;
+	c->state = IDLE_CLOSED;
+	w->closed[w->num_closed++] = c - w->conns;
 }
 
 /*
- * For the explanation of these parameters, please refer to the libevent evdns
- * callback API
- *
- * Upon receipt of a valid dns lookup result, attempts to open `desired`
- * connections and allocates memory for the associated event structures
+ * Connection C of worker W has become readable or, if WRITABLE is set
+ * (while connecting), writable.
  */
-void
-dns_lookup_callback(int result, char type, int count, int ttl, void *addresses,
-		    void *arg)
+static void
+idle_ready(struct worker *w, struct idle *c, int writable)
 {
-	uint32_t        i;
-	uint8_t         oct[4];
-	struct in_addr *address_list = (struct in_addr *) addresses;
-
-	if (result != DNS_ERR_NONE) {
-		printf("DNS Lookup: result(%s)\n",
-		       evdns_err_to_string(result));
-		exit(EXIT_FAILURE);
+	socklen_t       len;
+	ssize_t         n;
+	int             err;
+
+	if (c->state == IDLE_CLOSED)
+		return;
+
+	if (c->state == IDLE_CONNECTING) {
+		len = sizeof(err);
+		if (getsockopt(c->sd, SOL_SOCKET, SO_ERROR, &err, &len) < 0
+		    || err) {
+			++w->num_failed;
+			idle_close(w, c);
+			return;
+		}
+		c->state = IDLE_OPEN;
+		++w->num_open;
+		++w->num_created;
+		idle_watch(w, c, WATCH_MOD);
+		return;
 	}
 
-	memset(&server_addr, 0, sizeof(server_addr));
-	server_addr.sin_family = AF_INET;
-	server_addr.sin_port = htons(port);
-	server_addr.sin_addr = address_list[0];
-
 	/*
-	 * Echo the resolved address 
+	 * Drop whatever the server sends (such as replies to the pings);
+	 * reconnect when it closes the connection.
 	 */
-	printf("Resolved %s\n\t(%s)\n", server, inet_ntoa(address_list[0]));
+	while ((n = recv(c->sd, w->buf, sizeof(w->buf), 0)) > 0)
+		w->bytes_received += n;
+	if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		++w->num_lost;
+		idle_close(w, c);
+	}
+}
 
-	/*
-	 * Open the number of `desired` connections 
-	 */
-	for (i = 0; i < desired; i++) {
-		struct sockaddr_in sin;
-		int             sd = socket(AF_INET, SOCK_STREAM, 0);
+static void
+idle_ping(struct worker *w, struct idle *c)
+{
+	if (send(c->sd, ping_data, ping_len, 0) < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			++w->num_lost;
+			idle_close(w, c);
+		}
+		return;
+	}
+	++w->num_pings;
+}
 
-		struct event   *evsock = NULL;
+/*
+ * Runs every TICK_USEC: (re)opens closed connections, a batch at a time so
+ * the loop stays responsive, and pings the connections whose turn it is,
+ * spread evenly over the ping interval.
+ */
+static void
+worker_tick(int fd, short event, void *arg)
+{
+	struct timeval  tv = {0, TICK_USEC};
+	struct worker  *w = arg;
+	struct idle    *c;
+	u_long          num_open;
+	int             i;
+
+	for (i = 0; i < OPEN_BATCH && w->num_closed > 0; ++i)
+		idle_open(w, &w->conns[w->closed[--w->num_closed]]);
+
+	if (ping_interval > 0) {
+		w->ping_credit += w->num_conns * (TICK_USEC / 1e6) /
+		    ping_interval;
+		for (; w->ping_credit >= 1.0; w->ping_credit -= 1.0) {
+			c = &w->conns[w->next_ping];
+			if (++w->next_ping == w->num_conns)
+				w->next_ping = 0;
+			if (c->state == IDLE_OPEN)
+				idle_ping(w, c);
+		}
+	}
 
-		if (sd == -1) {
-			perror("socket");
-			continue;
+	if (w == &workers[0] && !reported) {
+		for (num_open = 0, i = 0; i < num_workers; ++i)
+			num_open += workers[i].num_open;
+		if (num_open >= (u_long) desired) {
+			report_memory(num_open);
+			reported = 1;
 		}
+	}
 
-		sin = server_addr;
+	evtimer_add(&w->tick, &tv);
+}
 
-		if (connect(sd, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
-			perror("connect");
-			cleanup();
-			exit(EXIT_FAILURE);
-		}
+static void
+worker_init(struct worker *w, u_int num_conns)
+{
+	struct timeval  tv = {0, TICK_USEC};
+	u_int           i;
+
+	w->base = event_base_new();
+	w->num_conns = num_conns;
+	w->conns = calloc(num_conns ? num_conns : 1, sizeof(w->conns[0]));
+	w->closed = malloc((num_conns ? num_conns : 1) * sizeof(w->closed[0]));
+	if (!w->base || !w->conns || !w->closed) {
+		fprintf(stderr, "%s: out of memory\n", prog_name);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < num_conns; ++i) {
+		w->conns[i].sd = -1;
+		w->closed[i] = num_conns - 1 - i;
+	}
+	w->num_closed = num_conns;
 
-		evsock = (struct event *) malloc(sizeof(struct event));
+#ifdef HAVE_SYS_EPOLL_H
+	w->epfd = epoll_create(1024);
+	if (w->epfd < 0) {
+		perror("epoll_create");
+		exit(EXIT_FAILURE);
+	}
+	event_set(&w->ready, w->epfd, EV_READ | EV_PERSIST, worker_ready, w);
+	event_base_set(w->base, &w->ready);
+	event_add(&w->ready, NULL);
+#endif
+
+	evtimer_set(&w->tick, worker_tick, w);
+	event_base_set(w->base, &w->tick);
+	evtimer_add(&w->tick, &tv);
+}
 
-		if (evsock == NULL) {
-			cleanup();
-			exit(EXIT_FAILURE);
-		}
+static void    *
+worker_run(void *arg)
+{
+	struct worker  *w = arg;
 
-		event_set(evsock, sd, EV_READ, reconnect, evsock);
-		list_push(active_events, (Any_Type) (void *) evsock);
-		num_conn++;
+	event_base_dispatch(w->base);
+	return NULL;
+}
 
-		event_add(evsock, NULL);
+/*
+ * Look up NAME (and SERVICE, if not null) into *ADDR.
+ */
+static socklen_t
+lookup(const char *name, const char *service, int family,
+       struct sockaddr_storage *addr)
+{
+	struct addrinfo hints, *res;
+	socklen_t       len;
+	int             err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = family;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo(name, service, &hints, &res);
+	if (err) {
+		fprintf(stderr, "%s: can't resolve %s: %s\n", prog_name,
+			name, gai_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+	len = res->ai_addrlen;
+	memcpy(addr, res->ai_addr, len);
+	freeaddrinfo(res);
+	return len;
+}
 
+/*
+ * Copy the -d argument ARG to ping_data, translating \r, \n and \\.
+ */
+static void
+set_ping_data(const char *arg)
+{
+	ping_len = 0;
+	for (; *arg && ping_len < sizeof(ping_data); ++arg) {
+		if (*arg == '\\' && arg[1]) {
+			++arg;
+			if (*arg == 'r')
+				ping_data[ping_len++] = '\r';
+			else if (*arg == 'n')
+				ping_data[ping_len++] = '\n';
+			else
+				ping_data[ping_len++] = *arg;
+		} else
+			ping_data[ping_len++] = *arg;
 	}
 }
 
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: `%s [-a addr]... [-t threads] "
+		"[-p interval [-d data]] server port numidle'\n", prog_name);
+	exit(EXIT_FAILURE);
+}
+
 int
 main(int argc, char *argv[])
 {
 	struct event    signal_int;
-
-	active_events = list_create();
-	if (active_events == NULL)
-		goto init_failure;
-
-	event_init();
-	evdns_init();
-
-	/*
-	 * Initalize one event 
-	 */
-	event_set(&signal_int, SIGINT, EV_SIGNAL, sigint_exit, &signal_int);
-
-	event_add(&signal_int, NULL);
+	char            host[NI_MAXHOST], *end;
+	int             ch, i;
+#ifdef HAVE_PTHREAD_H
+	pthread_t       thread;
+#endif
 
 	prog_name = strrchr(argv[0], '/');
 	if (prog_name)
@@ -236,41 +567,104 @@ main(int argc, char *argv[])
 	else
 		prog_name = argv[0];
 
-	if (argc != 4) {
-		fprintf(stderr, "Usage: `%s server port numidle'\n",
-			prog_name);
-		goto init_failure;
+	while ((ch = getopt(argc, argv, "a:d:p:t:")) != -1) {
+		switch (ch) {
+		case 'a':
+			sources = realloc(sources,
+			    (num_sources + 1) * sizeof(sources[0]));
+			source_len = realloc(source_len,
+			    (num_sources + 1) * sizeof(source_len[0]));
+			if (!sources || !source_len || num_sources >= 65535) {
+				fprintf(stderr, "%s: too many addresses\n",
+					prog_name);
+				exit(EXIT_FAILURE);
+			}
+			source_len[num_sources] = lookup(optarg, NULL,
+			    AF_UNSPEC, &sources[num_sources]);
+			++num_sources;
+			break;
+		case 'd':
+			set_ping_data(optarg);
+			break;
+		case 'p':
+			ping_interval = strtod(optarg, &end);
+			if (*end || ping_interval < 0)
+				usage();
+			break;
+		case 't':
+			num_workers = strtol(optarg, &end, 10);
+			if (*end || num_workers < 1
+			    || num_workers > MAX_WORKERS)
+				usage();
+#ifndef HAVE_PTHREAD_H
+			if (num_workers > 1) {
+				fprintf(stderr, "%s: no threads on this "
+					"system\n", prog_name);
+				exit(EXIT_FAILURE);
+			}
+#endif
+			break;
+		default:
+			usage();
+		}
 	}
+	argc -= optind;
+	argv += optind;
 
-	server = argv[1];
-	port = atoi(argv[2]);
-	desired = atoi(argv[3]);
+	if (argc != 3)
+		usage();
 
-	printf("%s: Using libevent-%s for %s event notification system.\n"
-	       "Control-c to exit\n\n", prog_name, event_get_version(),
-	       event_get_method());
+	server = argv[0];
+	port = argv[1];
+	desired = atoi(argv[2]);
+
+	server_addr_len = lookup(server, port, AF_UNSPEC, &server_addr);
+	for (i = 0; i < num_sources; ++i)
+		if (sources[i].ss_family != server_addr.ss_family) {
+			fprintf(stderr, "%s: source and server addresses "
+				"are of different families\n", prog_name);
+			exit(EXIT_FAILURE);
+		}
+
+	/*
+	 * Echo the resolved address 
+	 */
+	getnameinfo((struct sockaddr *) &server_addr, server_addr_len,
+	    host, sizeof(host), NULL, 0, NI_NUMERICHOST);
 
+	signal(SIGPIPE, SIG_IGN);
 	gettimeofday(&start_time, NULL);
 
-	evdns_resolve_ipv4(server, 0, dns_lookup_callback, NULL);
+	for (i = 0; i < num_workers; ++i)
+		worker_init(&workers[i], desired / num_workers
+		    + (i < desired % num_workers));
+	rss_start = rss();	/* the records are only touched from now on */
 
-	event_dispatch();
+	printf("%s: Using libevent-%s for %s event notification system.\n"
+	       "Control-c to exit\n\n", prog_name, event_get_version(),
+	       event_base_get_method(workers[0].base));
+	printf("Resolved %s\n\t(%s)\n", server, host);
+	fflush(stdout);
 
 	/*
-	 * Event loop will only exit upon receiving SIGINT.  Make sure we pass
-	 * this on to the parent process 
+	 * The first worker runs in this thread and handles SIGINT.
 	 */
-	if (signal(SIGINT, SIG_DFL) < 0)
-		perror("signal");
-	else
-		kill(getpid(), SIGINT);
+	event_set(&signal_int, SIGINT, EV_SIGNAL, sigint_exit, &signal_int);
+	event_base_set(workers[0].base, &signal_int);
+	event_add(&signal_int, NULL);
 
-      init_failure:
-	cleanup();
-	exit(EXIT_FAILURE);
+#ifdef HAVE_PTHREAD_H
+	for (i = 1; i < num_workers; ++i)
+		if (pthread_create(&thread, NULL, worker_run, &workers[i])) {
+			fprintf(stderr, "%s: failed to start thread %d\n",
+				prog_name, i);
+			exit(EXIT_FAILURE);
+		}
+#endif
+	worker_run(&workers[0]);
 
 	/*
 	 * Should never reach here 
 	 */
-	return 0;
+	return EXIT_FAILURE;
 }
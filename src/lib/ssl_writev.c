@@ -32,78 +32,94 @@
     02110-1301, USA
 */
 
-/* This code is based on the generic writev() implementation of GNU
-   libc.  It implements writev() simply in terms of write().  No
-   atomicity guarantees and performance isn't great either, but its
-   good enough for SSL purposes.  */
+/* SSL has no scatter/gather write, so the pieces are collected into
+   one buffer and handed to SSL_write() in one go, which keeps small
+   requests in a single TLS record.  The buffer is kept around between
+   calls and only grows.  Since the caller gathers the very same bytes
+   again when a write has to be retried, the SSL context must have
+   SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER set.  */
 
 #include "config.h"
 
 #ifdef HAVE_OPENSSL_SSL_H
 
-/* AIX requires this to be the first thing in the file.  */
-#ifndef __GNUC__
-# if HAVE_ALLOCA_H
-#  include <alloca.h>
-# else
-#  ifdef _AIX
-#pragma alloca
-#  else
-#   ifndef alloca /* predefined by HP cc +Olibcalls */
-char *alloca ();
-#   endif
-#  endif
-# endif
-#else
-/* stdlib.h provides the alloca functionality. */
+#include <errno.h>
 #include <stdlib.h>
-#endif
-
 #include <string.h>
 
 #include <generic_types.h>
 #include <sys/uio.h>
 
-#include <openssl/rsa.h>
-#include <openssl/crypto.h>
-#include <openssl/x509.h>
-#include <openssl/pem.h>
 #include <openssl/ssl.h>
-#include <openssl/err.h>
 
 ssize_t
 SSL_writev (SSL *ssl, const struct iovec *vector, int count)
 {
-  char *buffer;
-  register char *bp;
-  size_t bytes, to_copy;
-  int i;
+  static char *buffer;
+  static size_t buffer_size;
+  const void *data;
+  size_t bytes, written;
+  char *bp;
+  int i, ret;
 
   /* Find the total number of bytes to be written.  */
   bytes = 0;
   for (i = 0; i < count; ++i)
     bytes += vector[i].iov_len;
 
-  /* Allocate a temporary buffer to hold the data.  */
-  buffer = (char *) alloca (bytes);
-
-  /* Copy the data into BUFFER.  */
-  to_copy = bytes;
-  bp = buffer;
-  for (i = 0; i < count; ++i)
+  if (count == 1)
+    data = vector[0].iov_base;	/* nothing to collect */
+  else
     {
-#     define min(a, b)		((a) > (b) ? (b) : (a))
-      size_t copy = min (vector[i].iov_len, to_copy);
+      if (bytes > buffer_size)
+	{
+	  bp = realloc (buffer, bytes);
+	  if (!bp)
+	    {
+	      errno = ENOMEM;
+	      return -1;
+	    }
+	  buffer = bp;
+	  buffer_size = bytes;
+	}
+
+      /* Copy the data into BUFFER.  */
+      bp = buffer;
+      for (i = 0; i < count; ++i)
+	{
+	  memcpy (bp, vector[i].iov_base, vector[i].iov_len);
+	  bp += vector[i].iov_len;
+	}
+      data = buffer;
+    }
 
-      memcpy ((void *) bp, (void *) vector[i].iov_base, copy);
-      bp += copy;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  ret = SSL_write_ex (ssl, data, bytes, &written);
+#else
+  ret = SSL_write (ssl, data, bytes);
+  written = ret;
+#endif
+  if (ret > 0)
+    return written;
 
-      to_copy -= copy;
-      if (to_copy == 0)
-        break;
+  /* Let the caller tell a full socket buffer from a real error.  */
+  switch (SSL_get_error (ssl, ret))
+    {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+      errno = EAGAIN;
+      break;
+
+    case SSL_ERROR_SYSCALL:
+      if (errno == 0)
+	errno = EPIPE;
+      break;
+
+    default:
+      errno = EPROTO;
+      break;
     }
-
-  return SSL_write (ssl, buffer, bytes);
+  return -1;
 }
 
 #endif /* HAVE_OPENSSL_SSL_H */
@@ -35,16 +35,19 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <generic_types.h>
 #include <object.h>
 #include <httperf.h>
 #include <localevent.h>
 
-#define MAX_NUM_OPS	4
+/* event_mask has one bit per event type: */
+typedef char event_mask_too_small[EV_NUM_EVENT_TYPES <= 32 ? 1 : -1];
 
 static const char * const event_name[EV_NUM_EVENT_TYPES] =
   {
+    "EV_NULL",
     "EV_PERF_SAMPLE",
     "EV_HOSTNAME_LOOKUP_START",
     "EV_HOSTNAME_LOOKUP_STOP",
@@ -67,11 +70,16 @@ static const char * const event_name[EV_NUM_EVENT_TYPES] =
     "EV_CALL_RECV_HDR",
     "EV_CALL_RECV_RAW_DATA",
     "EV_CALL_RECV_DATA",
+    "EV_CALL_RECV_SAMPLE",
     "EV_CALL_RECV_FOOTER",
     "EV_CALL_RECV_STOP",
-    "EV_CALL_DESTROYED"
+    "EV_CALL_DESTROYED",
+    "EV_WS_SEND",
+    "EV_WS_ECHO"
   };
 
+/* Handlers and counters are registered while the modules get
+   initialized, so the arrays simply grow one element at a time.  */
 typedef struct Event_Action
   {
     int num_ops;
@@ -80,36 +88,57 @@ typedef struct Event_Action
 	Event_Handler op;
 	Any_Type arg;
       }
-    closure[MAX_NUM_OPS];
+    *closure;
+    int num_counters;
+    u_long **counter;
   }
 Event_Action;
 
-static Event_Action action[EV_NUM_EVENT_TYPES] = {{0, }};
+u_int event_mask;
+
+static Event_Action action[EV_NUM_EVENT_TYPES];
+
+static void *
+grow (void *array, int num_elems, size_t elem_size)
+{
+  array = realloc (array, (num_elems + 1) * elem_size);
+  if (!array)
+    {
+      fprintf (stderr, "%s.event_register: out of memory\n", prog_name);
+      exit (1);
+    }
+  return array;
+}
 
 void
 event_register_handler (Event_Type et, Event_Handler handler, Any_Type arg)
 {
+  Event_Action *act = action + et;
   struct closure *c;
-  int n;
 
-  n = action[et].num_ops;
-  if (n >= MAX_NUM_OPS)
-    {
-      fprintf (stderr, "event_register_handler: sorry, attempted to register "
-	       "more than %d handlers\n", MAX_NUM_OPS);
-      exit (1);
-    }
-  c = action[et].closure + n;
+  act->closure = grow (act->closure, act->num_ops, sizeof (*act->closure));
+  c = act->closure + act->num_ops++;
   c->op = handler;
   c->arg = arg;
-  action[et].num_ops = n + 1;
+  event_mask |= EVENT_BIT (et);
+}
+
+void
+event_register_counter (Event_Type et, u_long *counter)
+{
+  Event_Action *act = action + et;
+
+  act->counter = grow (act->counter, act->num_counters,
+		       sizeof (*act->counter));
+  act->counter[act->num_counters++] = counter;
+  event_mask |= EVENT_BIT (et);
 }
 
 void
-event_signal (Event_Type type, Object *obj, Any_Type arg)
+event_dispatch (Event_Type type, Object *obj, Any_Type arg)
 {
   Event_Action *act = action + type;
-  struct closure *c, *end;
+  int i;
 
   if (DBG > 1)
     {
@@ -118,7 +147,13 @@ event_signal (Event_Type type, Object *obj, Any_Type arg)
 	       event_name[type], obj, arg.l);
     }
 
-  end = &act->closure[act->num_ops];
-  for (c = &act->closure[0]; c < end; ++c)
-    (*c->op) (type, obj, c->arg, arg);
+  /* event_mask may be cleared to hold all events back for a while: */
+  if (!event_has_handler (type))
+    return;
+
+  for (i = 0; i < act->num_counters; ++i)
+    ++*act->counter[i];
+
+  for (i = 0; i < act->num_ops; ++i)
+    (*act->closure[i].op) (type, obj, act->closure[i].arg, arg);
 }
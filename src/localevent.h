@@ -63,10 +63,14 @@ typedef enum Event_Type
     EV_CALL_RECV_HDR,
     EV_CALL_RECV_RAW_DATA,
     EV_CALL_RECV_DATA,
+    EV_CALL_RECV_SAMPLE,	/* reply data of a call with reply.sampled set */
     EV_CALL_RECV_FOOTER,
     EV_CALL_RECV_STOP,
     EV_CALL_DESTROYED,
 
+    EV_WS_SEND,			/* WebSocket message queued */
+    EV_WS_ECHO,			/* its echo arrived (arg.d = echo time) */
+
     EV_NUM_EVENT_TYPES
   }
 Event_Type;
@@ -85,6 +89,35 @@ typedef void (*Event_Handler) (Event_Type type, Object *obj,
 
 extern void event_register_handler (Event_Type et, Event_Handler handler,
 				    Any_Type arg);
-extern void event_signal (Event_Type type, Object *obj, Any_Type arg);
+
+/* Subscribes to event type ET in aggregate: instead of calling a
+   handler, signalling ET just increments *COUNTER.  Collectors that
+   only need to know how often something happened can read the counter
+   whenever they need it (e.g., on EV_PERF_SAMPLE).  */
+extern void event_register_counter (Event_Type et, u_long *counter);
+
+/* Bit ET of EVENT_MASK is set if anybody subscribed to event type ET,
+   so event_signal() costs a single test for events nobody wants.  */
+extern u_int event_mask;
+
+#define EVENT_BIT(et)		(1u << (et))
+
+/* Returns non-zero if anybody subscribed to event type ET.  */
+#define event_has_handler(et)	((event_mask & EVENT_BIT (et)) != 0)
+
+extern void event_dispatch (Event_Type type, Object *obj, Any_Type arg);
+
+#ifdef DEBUG
+  /* trace every event, wanted or not: */
+# define event_signal(type, obj, arg)	event_dispatch (type, obj, arg)
+#else
+# define event_signal(type, obj, arg)			\
+  do							\
+    {							\
+      if (event_has_handler (type))			\
+	event_dispatch (type, obj, arg);		\
+    }							\
+  while (0)
+#endif
 
 #endif /* localevent_h */
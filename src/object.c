@@ -63,7 +63,42 @@ struct free_list_el
     struct free_list_el *next;
   };
 
+/* Objects are carved out of slabs of this many objects at a time
+   when the free list runs dry.  */
+#define SLAB_OBJECTS	64
+
 static struct free_list_el *free_list[OBJ_NUM_TYPES];
+static u_int num_free[OBJ_NUM_TYPES];
+static int sizes_fixed;		/* no more object_expand() calls allowed */
+
+/* Add a slab of COUNT objects of type TYPE to the free list.  The
+   memory is touched right away so the page faults happen now rather
+   than when the objects get used.  */
+static int
+object_grow (Object_Type type, u_int count)
+{
+  struct free_list_el *el;
+  size_t obj_size;
+  char *slab;
+  u_int i;
+
+  sizes_fixed = 1;
+  obj_size = type_size[type];
+  slab = malloc ((size_t) count * obj_size);
+  if (!slab)
+    return -1;
+  memset (slab, 0, (size_t) count * obj_size);
+
+  /* hand out the objects in address order */
+  for (i = count; i-- > 0; )
+    {
+      el = (struct free_list_el *) (slab + i * obj_size);
+      el->next = free_list[type];
+      free_list[type] = el;
+    }
+  num_free[type] += count;
+  return 0;
+}
 
 static void
 object_destroy (Object *obj)
@@ -103,16 +138,27 @@ object_destroy (Object *obj)
   el = (struct free_list_el *) obj;
   el->next = free_list[type];
   free_list[type] = el;
+  ++num_free[type];
 }
 
 size_t
 object_expand (Object_Type type, size_t size)
 {
   size_t offset = type_size[type];
+
+  assert (!sizes_fixed);
   type_size[type] += ALIGN (size);
   return offset;
 }
 
+int
+object_prealloc (Object_Type type, u_int count)
+{
+  if (count <= num_free[type])
+    return 0;
+  return object_grow (type, count - num_free[type]);
+}
+
 Object *
 object_new (Object_Type type)
 {
@@ -124,21 +170,15 @@ object_new (Object_Type type)
 
   obj_size = type_size[type];
 
-  if (free_list[type])
-    {
-      el = free_list[type];
-      free_list[type] = el->next;
-      obj = (Object *) el;
-    }
-  else
+  if (!free_list[type] && object_grow (type, SLAB_OBJECTS) < 0)
     {
-      obj = malloc (obj_size);
-      if (!obj)
-	{
-	  fprintf (stderr, "%s.object_new: %s\n", prog_name, strerror (errno));
-	  return 0;
-	}
+      fprintf (stderr, "%s.object_new: %s\n", prog_name, strerror (errno));
+      return 0;
     }
+  el = free_list[type];
+  free_list[type] = el->next;
+  --num_free[type];
+  obj = (Object *) el;
   memset (obj, 0, obj_size);
   obj->ref_count = 1;
   obj->type = type;
@@ -65,6 +65,11 @@ Object;
 
 extern size_t object_expand (Object_Type type, size_t size);
 
+/* Make sure that at least COUNT objects of type TYPE can be created
+   without allocating memory.  Call this once all object_expand()
+   calls have been made.  Returns -1 if out of memory.  */
+extern int object_prealloc (Object_Type type, u_int count);
+
 /* Create a new object of type TYPE.  */
 extern Object *object_new (Object_Type type);
 
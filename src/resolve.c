@@ -0,0 +1,290 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+
+/*
+ * Hostname lookups.  getaddrinfo() blocks, so lookups are queued for a
+ * small pool of threads that is started as lookups come in.  Finished
+ * lookups are put on a list that a timer empties every few milliseconds
+ * while any are outstanding, which keeps the threads out of the event loop
+ * entirely.  getaddrinfo() doesn't tell how long its answer is good for,
+ * so where the resolver library is available the record is also asked for
+ * directly, for its TTL.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#if defined(HAVE_RESOLV_H) && defined(HAVE_NS_INITPARSE)
+#include <arpa/nameser.h>
+#include <resolv.h>
+#define	HAVE_TTL_LOOKUP
+#endif
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <localevent.h>
+#include <resolve.h>
+
+#define	MAX_THREADS	8
+#define	POLL_INTERVAL	2e-3	/* how often finished lookups are collected */
+
+struct lookup {
+	struct lookup  *next;
+	const char     *name;
+	Resolve_Done	done;
+	void	       *arg;
+	Resolve_Result	res;
+};
+
+static u_int	num_pending;	/* lookups started but not yet done */
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static struct lookup *queue, **queue_tail = &queue;
+static struct lookup *done_list;
+static int	num_threads, num_idle;
+static struct Timer *poll_timer;
+#endif
+
+#ifdef HAVE_TTL_LOOKUP
+
+/*
+ * Returns the smallest TTL of the answers to a query for the records of
+ * FAMILY for NAME, or 0 if there are none.
+ */
+static Time
+lookup_ttl(const char *name, int family)
+{
+	struct __res_state rs;
+	u_char		answer[4096];
+	ns_msg		msg;
+	ns_rr		rr;
+	u_long		ttl = 0;
+	int		n, i;
+
+	memset(&rs, 0, sizeof(rs));
+	if (res_ninit(&rs) < 0)
+		return 0;
+	n = res_nquery(&rs, name, ns_c_in,
+	    family == AF_INET6 ? ns_t_aaaa : ns_t_a, answer, sizeof(answer));
+	res_nclose(&rs);
+	if (n < 0 || ns_initparse(answer, n, &msg) < 0)
+		return 0;
+
+	for (i = 0; i < ns_msg_count(msg, ns_s_an); ++i) {
+		if (ns_parserr(&msg, ns_s_an, i, &rr) < 0)
+			return 0;
+		if (ttl == 0 || ns_rr_ttl(rr) < ttl)
+			ttl = ns_rr_ttl(rr);
+	}
+	return ttl;
+}
+
+#endif /* HAVE_TTL_LOOKUP */
+
+static void
+lookup(struct lookup *l)
+{
+	struct addrinfo	hints, *ai;
+	Resolve_Result *res = &l->res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICHOST;
+	res->err = getaddrinfo(l->name, NULL, &hints, &ai);
+	if (res->err == 0)
+		res->numeric = 1;
+	else {
+		hints.ai_flags = 0;
+		res->err = getaddrinfo(l->name, NULL, &hints, &ai);
+		if (res->err != 0)
+			return;
+	}
+
+	memcpy(&res->addr, ai->ai_addr, ai->ai_addrlen);
+	res->addr_len = ai->ai_addrlen;
+	freeaddrinfo(ai);
+#ifdef HAVE_TTL_LOOKUP
+	if (!res->numeric)
+		res->ttl = lookup_ttl(l->name, res->addr.ss_family);
+#endif
+}
+
+static void
+deliver(struct lookup *list)
+{
+	struct lookup  *l;
+	Any_Type	arg;
+
+	while ((l = list) != NULL) {
+		list = l->next;
+		--num_pending;
+		arg.cvp = l->name;
+		event_signal(EV_HOSTNAME_LOOKUP_STOP, 0, arg);
+		(*l->done) (l->arg, l->name, &l->res);
+		free(l);
+	}
+}
+
+#ifdef HAVE_PTHREAD_H
+
+static void    *
+lookup_main(void *arg)
+{
+	struct lookup  *l;
+
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (!queue) {
+			++num_idle;
+			pthread_cond_wait(&queue_cond, &lock);
+			--num_idle;
+		}
+		l = queue;
+		queue = l->next;
+		if (!queue)
+			queue_tail = &queue;
+		pthread_mutex_unlock(&lock);
+
+		lookup(l);
+
+		pthread_mutex_lock(&lock);
+		l->next = done_list;
+		done_list = l;
+		pthread_cond_signal(&done_cond);
+	}
+	return NULL;
+}
+
+static struct lookup *
+take_done(void)
+{
+	struct lookup  *list;
+
+	pthread_mutex_lock(&lock);
+	list = done_list;
+	done_list = NULL;
+	pthread_mutex_unlock(&lock);
+	return list;
+}
+
+static void
+poll_done(struct Timer *t, Any_Type arg)
+{
+	poll_timer = NULL;
+	deliver(take_done());
+	if (num_pending > 0 && !poll_timer)
+		poll_timer = timer_schedule(poll_done, arg, POLL_INTERVAL);
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+void
+resolve_start(const char *name, Resolve_Done done, void *arg)
+{
+	struct lookup  *l;
+	Any_Type	a;
+
+	l = calloc(1, sizeof(*l));
+	if (!l) {
+		fprintf(stderr, "%s: out of memory looking up %s\n",
+		    prog_name, name);
+		exit(1);
+	}
+	l->name = name;
+	l->done = done;
+	l->arg = arg;
+
+	++num_pending;
+	a.cvp = name;
+	event_signal(EV_HOSTNAME_LOOKUP_START, 0, a);
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&lock);
+	*queue_tail = l;
+	queue_tail = &l->next;
+	if (num_idle == 0 && num_threads < MAX_THREADS) {
+		pthread_t	thread;
+
+		if (pthread_create(&thread, NULL, lookup_main, NULL) == 0) {
+			pthread_detach(thread);
+			++num_threads;
+		} else if (num_threads == 0) {
+			fprintf(stderr, "%s: can't start a lookup thread\n",
+			    prog_name);
+			exit(1);
+		}
+	} else
+		pthread_cond_signal(&queue_cond);
+	pthread_mutex_unlock(&lock);
+
+	if (!poll_timer) {
+		a.l = 0;
+		poll_timer = timer_schedule(poll_done, a, POLL_INTERVAL);
+	}
+#else
+	lookup(l);
+	deliver(l);
+#endif
+}
+
+void
+resolve_wait(void)
+{
+#ifdef HAVE_PTHREAD_H
+	struct lookup  *list;
+
+	while (num_pending > 0) {
+		pthread_mutex_lock(&lock);
+		while (!done_list)
+			pthread_cond_wait(&done_cond, &lock);
+		list = done_list;
+		done_list = NULL;
+		pthread_mutex_unlock(&lock);
+		deliver(list);
+	}
+#endif
+}
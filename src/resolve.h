@@ -0,0 +1,64 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+
+#ifndef resolve_h
+#define resolve_h
+
+#include <sys/socket.h>
+
+/*
+ * Hostname lookups that don't hold up the event loop.  The lookups are done
+ * by a few threads; their results are handed back from a timer, so the
+ * DONE functions run in the event loop like everything else.
+ */
+
+typedef struct Resolve_Result {
+	int		err;		/* 0 or an EAI_* error */
+	int		numeric;	/* the name was an address */
+	struct sockaddr_storage addr;	/* port not set */
+	socklen_t	addr_len;
+	Time		ttl;		/* how long the address is good for,
+					 * or 0 if unknown */
+} Resolve_Result;
+
+typedef void	(*Resolve_Done) (void *arg, const char *name,
+		    const Resolve_Result * res);
+
+/*
+ * Look up NAME, an IPv4 or IPv6 address or a hostname, and call DONE with
+ * ARG and the result.  NAME must stay around until then.
+ */
+extern void	resolve_start(const char *name, Resolve_Done done, void *arg);
+
+/*
+ * Wait for all lookups started so far to complete.
+ */
+extern void	resolve_wait(void);
+
+#endif /* resolve_h */
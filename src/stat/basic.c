@@ -39,6 +39,7 @@
 #include <errno.h>
 #include <float.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <generic_types.h>
 #include <sys/resource.h>
@@ -49,16 +50,11 @@
 #include <call.h>
 #include <conn.h>
 #include <localevent.h>
+#include <rate.h>
 #include <stats.h>
+#include <hist.h>
 
-/*
- * Increase this if it does not cover at least 50% of all response times.  
- */
-#define MAX_LIFETIME	100.0	/* max. conn. lifetime in seconds */
-#define BIN_WIDTH	1e-3
-#define NUM_BINS	((u_int) (MAX_LIFETIME / BIN_WIDTH))
-
-static struct {
+static struct basic_stats {
 	u_long           num_conns_issued;	/* total # of connections * issued */
 	u_long           num_replies[6];	/* completion count per status class */
 	u_long           num_200;		/* total # of 200 responses */
@@ -71,8 +67,13 @@ static struct {
 	u_long           num_sock_reset;	/* # of ECONNRESET */
 	u_long           num_sock_timeouts;	/* # of ETIMEDOUT */
 	u_long           num_sock_addrunavail;	/* # of EADDRNOTAVAIL */
+	u_long           num_sock_backlog;	/* # of EAGAIN (full Unix
+						 * socket backlog) */
 	u_long           num_other_errors;	/* # of other errors */
+	u_long           num_integrity;	/* # of replies that failed --verify */
 	u_long           max_conns;	/* max # of concurrent connections */
+	u_long           num_tfo;	/* # of connections that tried TFO */
+	u_long           num_tfo_accepted;	/* # whose SYN data was acked */
 
 	u_long           num_lifetimes;
 	Time            conn_lifetime_sum;	/* sum of connection lifetimes */
@@ -86,14 +87,23 @@ static struct {
 	Time            reply_rate_sum2;
 	Time            reply_rate_min;
 	Time            reply_rate_max;
+	Time            reply_rate[MAX_RATE_SAMPLES];	/* the samples */
 
 	u_long           num_connects;	/* # of completed connect()s */
 	Time            conn_connect_sum;	/* sum of connect times */
+	Hist            conn_connect_hist;	/* histogram of connect times */
 
 	u_long           num_responses;
 	Time            call_response_sum;	/* sum of response times */
+	Hist            call_response_hist;	/* histogram of response
+						 * (first byte) times */
+	Time            call_corrected_sum;	/* sum of response times
+						 * measured from the intended
+						 * issue times */
+	Hist            call_corrected_hist;
 
 	Time            call_xfer_sum;	/* sum of response times */
+	Hist            call_xfer_hist;	/* histogram of transfer times */
 
 	u_long           num_sent;	/* # of requests sent */
 	size_t          req_bytes_sent;
@@ -103,8 +113,8 @@ static struct {
 	u_wide          reply_bytes_received;	/* sum of all data bytes */
 	u_wide          footer_bytes_received;	/* sum of all footer bytes */
 
-	u_int           conn_lifetime_hist[NUM_BINS];	/* histogram of
-													 * connection lifetimes */
+	Hist            conn_lifetime_hist;	/* histogram of connection
+						 * lifetimes */
 } basic;
 
 static u_long    num_active_conns;
@@ -129,6 +139,8 @@ perf_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 		basic.reply_rate_min = rate;
 	if (rate > basic.reply_rate_max)
 		basic.reply_rate_max = rate;
+	if (basic.num_reply_rates < MAX_RATE_SAMPLES)
+		basic.reply_rate[basic.num_reply_rates] = rate;
 	++basic.num_reply_rates;
 
 	/*
@@ -137,14 +149,6 @@ perf_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 	num_replies = 0;
 }
 
-static void
-conn_timeout(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
-{
-	assert(et == EV_CONN_TIMEOUT);
-
-	++basic.num_client_timeouts;
-}
-
 static void
 conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 {
@@ -176,7 +180,23 @@ conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 		++basic.num_sock_reset;
 		break;
 
+	case EADDRNOTAVAIL:
+		++basic.num_sock_addrunavail;
+		break;
+
 	default:
+		/*
+		 * As in stats_error_class(): these mean something else over
+		 * TCP.
+		 */
+		if (param.unix_socket && err == ENOENT) {
+			++basic.num_sock_refused;
+			break;
+		}
+		if (param.unix_socket && err == EAGAIN) {
+			++basic.num_sock_backlog;
+			break;
+		}
 		if (first_time) {
 			first_time = 0;
 			fprintf(stderr,
@@ -188,9 +208,24 @@ conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 	}
 }
 
+/*
+ * Returns the time at which an object created now was meant to be
+ * created.  For open-loop rates, this is the scheduled arrival time even
+ * if the rate generator fell behind, so that the delay is not omitted
+ * from the corrected response times.
+ */
+static Time
+intended_time(void)
+{
+	return rate_intended_time > 0 ? rate_intended_time : timer_now();
+}
+
 static void
 conn_created(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type c_arg)
 {
+	Conn           *s = (Conn *) obj;
+
+	s->basic.time_intended = intended_time();
 	++num_active_conns;
 	if (num_active_conns > basic.max_conns)
 		basic.max_conns = num_active_conns;
@@ -213,8 +248,12 @@ conn_connected(Event_Type et, Object * obj, Any_Type reg_arg,
 {
 	Conn           *s = (Conn *) obj;
 
+	Time            connect_time;
+
 	assert(et == EV_CONN_CONNECTED && object_is_conn(s));
-	basic.conn_connect_sum += timer_now() - s->basic.time_connect_start;
+	connect_time = timer_now() - s->basic.time_connect_start;
+	basic.conn_connect_sum += connect_time;
+	hist_record(&basic.conn_connect_hist, connect_time);
 	++basic.num_connects;
 }
 
@@ -223,7 +262,6 @@ conn_destroyed(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type c_arg)
 {
 	Conn           *s = (Conn *) obj;
 	Time            lifetime;
-	u_int           bin;
 
 	assert(et == EV_CONN_DESTROYED && object_is_conn(s)
 		   && num_active_conns > 0);
@@ -237,23 +275,45 @@ conn_destroyed(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type c_arg)
 		if (lifetime > basic.conn_lifetime_max)
 			basic.conn_lifetime_max = lifetime;
 		++basic.num_lifetimes;
-
-		bin = lifetime * NUM_BINS / MAX_LIFETIME;
-		if (bin >= NUM_BINS)
-			bin = NUM_BINS;
-		++basic.conn_lifetime_hist[bin];
+		hist_record(&basic.conn_lifetime_hist, lifetime);
+	}
+	if (s->tfo) {
+		++basic.num_tfo;
+		if (s->tfo_accepted)
+			++basic.num_tfo_accepted;
 	}
 	--num_active_conns;
 }
 
+static void
+call_created(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type c_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_NEW && object_is_call(c));
+
+	c->basic.time_intended = intended_time();
+}
+
 static void
 send_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 {
 	Call           *c = (Call *) obj;
+	Conn           *s = c->conn;
 
 	assert(et == EV_CALL_SEND_START && object_is_call(c));
 
 	c->basic.time_send_start = timer_now();
+	c->basic.epoch = test_epoch;
+	/*
+	 * The first call on a connection was due when the connection was;
+	 * it's often created only once the connection is established.
+	 */
+	if (s->basic.time_intended > 0) {
+		if (s->basic.time_intended < c->basic.time_intended)
+			c->basic.time_intended = s->basic.time_intended;
+		s->basic.time_intended = 0;
+	}
 }
 
 static void
@@ -263,6 +323,8 @@ send_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 
 	assert(et == EV_CALL_SEND_STOP && object_is_call(c));
 
+	if (c->basic.epoch != test_epoch)
+		return;		/* sent before the last epoch began */
 	basic.req_bytes_sent += c->req.size;
 	++basic.num_sent;
 }
@@ -271,14 +333,21 @@ static void
 recv_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 {
 	Call           *c = (Call *) obj;
-	Time            now;
+	Time            now, response_time;
 
 	assert(et == EV_CALL_RECV_START && object_is_call(c));
 
 	now = timer_now();
-
-	basic.call_response_sum += now - c->basic.time_send_start;
 	c->basic.time_recv_start = now;
+	if (c->basic.epoch != test_epoch)
+		return;
+
+	response_time = now - c->basic.time_send_start;
+	basic.call_response_sum += response_time;
+	hist_record(&basic.call_response_hist, response_time);
+	response_time = now - c->basic.time_intended;
+	basic.call_corrected_sum += response_time;
+	hist_record(&basic.call_corrected_hist, response_time);
 	++basic.num_responses;
 
 	if (periodic_stats) {
@@ -294,12 +363,19 @@ static void
 recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 {
 	Call           *c = (Call *) obj;
+	Time            xfer_time;
 	int             index;
 
 	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
 	assert(c->basic.time_recv_start > 0);
 
-	basic.call_xfer_sum += timer_now() - c->basic.time_recv_start;
+	++c->conn->basic.num_calls_completed;
+	if (c->basic.epoch != test_epoch)
+		return;
+
+	xfer_time = timer_now() - c->basic.time_recv_start;
+	basic.call_xfer_sum += xfer_time;
+	hist_record(&basic.call_xfer_hist, xfer_time);
 
 	basic.hdr_bytes_received += c->reply.header_bytes;
 	basic.reply_bytes_received += c->reply.content_bytes;
@@ -309,8 +385,26 @@ recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
 	assert((unsigned) index < NELEMS(basic.num_replies));
 	++basic.num_replies[index];
 	++num_replies;
+}
 
-	++c->conn->basic.num_calls_completed;
+/*
+ * The --verify checks are done by the time the call goes away.  A call
+ * whose HTTP/2 stream was reset counts as a reset connection would.
+ */
+static void
+call_destroyed(Event_Type et, Object * obj, Any_Type reg_arg,
+			   Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_DESTROYED && object_is_call(c));
+
+	if (c->basic.epoch != test_epoch)
+		return;
+	if (c->reply.corrupt)
+		++basic.num_integrity;
+	if (c->reply.reset)
+		++basic.num_sock_reset;
 }
 
 static void
@@ -330,36 +424,66 @@ one_second_timer(struct Timer *t, Any_Type arg)
 	timer_schedule(one_second_timer, arg, 1);
 }
 
+static void
+reset(void)
+{
+	memset(&basic, 0, sizeof(basic));
+	basic.conn_lifetime_min = DBL_MAX;
+	basic.reply_rate_min = DBL_MAX;
+	hist_init(&basic.conn_lifetime_hist);
+	hist_init(&basic.conn_connect_hist);
+	hist_init(&basic.call_response_hist);
+	hist_init(&basic.call_corrected_hist);
+	hist_init(&basic.call_xfer_hist);
+	/* the connections still open are the concurrency so far */
+	basic.max_conns = num_active_conns;
+}
+
 static void
 init(void)
 {
 	Any_Type        arg;
 
-	basic.conn_lifetime_min = DBL_MAX;
-	basic.reply_rate_min = DBL_MAX;
+	reset();
 
 	arg.l = 0;
 	event_register_handler(EV_PERF_SAMPLE, perf_sample, arg);
 	event_register_handler(EV_CONN_FAILED, conn_fail, arg);
-	event_register_handler(EV_CONN_TIMEOUT, conn_timeout, arg);
+	event_register_counter(EV_CONN_TIMEOUT, &basic.num_client_timeouts);
 	event_register_handler(EV_CONN_NEW, conn_created, arg);
 	event_register_handler(EV_CONN_CONNECTING, conn_connecting, arg);
 	event_register_handler(EV_CONN_CONNECTED, conn_connected, arg);
 	event_register_handler(EV_CONN_DESTROYED, conn_destroyed, arg);
+	event_register_handler(EV_CALL_NEW, call_created, arg);
 	event_register_handler(EV_CALL_SEND_START, send_start, arg);
 	event_register_handler(EV_CALL_SEND_STOP, send_stop, arg);
 	event_register_handler(EV_CALL_RECV_START, recv_start, arg);
 	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+	if (param.verify.file || param.http2)
+		event_register_handler(EV_CALL_DESTROYED, call_destroyed, arg);
 
 	if (periodic_stats)
 		timer_schedule(one_second_timer, arg, 1);
 }
 
+/*
+ * Prints the tail percentiles of histogram H, in milliseconds.
+ */
+static void
+print_percentiles(const char *label, const Hist *h)
+{
+	printf("%s p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n", label,
+	       1e3 * hist_percentile(h, 0.5), 1e3 * hist_percentile(h, 0.9),
+	       1e3 * hist_percentile(h, 0.99), 1e3 * hist_percentile(h, 0.999),
+	       1e3 * hist_percentile(h, 1.0));
+}
+
 static void
 dump(void)
 {
 	Time            conn_period = 0.0, call_period = 0.0;
 	Time            conn_time = 0.0, resp_time = 0.0, xfer_time = 0.0;
+	Time            corrected_time = 0.0;
 	Time            call_size = 0.0, hdr_size = 0.0, reply_size =
 		0.0, footer_size = 0.0;
 	Time            lifetime_avg = 0.0, lifetime_stddev =
@@ -370,7 +494,7 @@ dump(void)
 	Time            delta, user, sys;
 	u_wide          total_size;
 	Time            time;
-	u_int           n;
+	u_int           bin, prev;
 
 	for (i = 1; i < NELEMS(basic.num_replies); ++i)
 		total_replies += basic.num_replies[i];
@@ -379,14 +503,17 @@ dump(void)
 
 	if (verbose > 1) {
 		printf("\nConnection lifetime histogram (time in ms):\n");
-		for (i = 0; i < NUM_BINS; ++i)
-			if (basic.conn_lifetime_hist[i]) {
-				if (i > 0 && basic.conn_lifetime_hist[i - 1] == 0)
-					printf("%14c\n", ':');
-				time = (i + 0.5) * BIN_WIDTH;
-				printf("%16.1f %u\n", 1e3 * time,
-					   basic.conn_lifetime_hist[i]);
-			}
+		prev = HIST_NUM_BINS;
+		for (bin = hist_next_bin(&basic.conn_lifetime_hist, 0, &time);
+		     bin < HIST_NUM_BINS;
+		     bin = hist_next_bin(&basic.conn_lifetime_hist, bin + 1,
+					 &time)) {
+			if (bin > 0 && prev != bin - 1)
+				printf("%14c\n", ':');
+			printf("%16.4f %u\n", 1e3 * time,
+			       basic.conn_lifetime_hist.bin[bin]);
+			prev = bin;
+		}
 	}
 
 	printf("\nTotal: connections %lu requests %lu replies %lu "
@@ -408,14 +535,8 @@ dump(void)
 			lifetime_stddev = STDDEV(basic.conn_lifetime_sum,
 									 basic.conn_lifetime_sum2,
 									 basic.num_lifetimes);
-		n = 0;
-		for (i = 0; i < NUM_BINS; ++i) {
-			n += basic.conn_lifetime_hist[i];
-			if (n >= 0.5 * basic.num_lifetimes) {
-				lifetime_median = (i + 0.5) * BIN_WIDTH;
-				break;
-			}
-		}
+		lifetime_median = hist_percentile(&basic.conn_lifetime_hist,
+						  0.5);
 	}
 	printf("Connection time [ms]: min %.1f avg %.1f max %.1f median %.1f "
 		   "stddev %.1f\n",
@@ -426,9 +547,14 @@ dump(void)
 	if (basic.num_connects > 0)
 		conn_time = basic.conn_connect_sum / basic.num_connects;
 	printf("Connection time [ms]: connect %.1f\n", 1e3 * conn_time);
+	print_percentiles("Connection time [ms]: connect",
+			  &basic.conn_connect_hist);
 	printf("Connection length [replies/conn]: %.3f\n",
 		   basic.num_lifetimes > 0
 		   ? total_replies / (double) basic.num_lifetimes : 0.0);
+	if (basic.num_tfo > 0)
+		printf("Connection TFO: attempted %lu accepted %lu\n",
+		       basic.num_tfo, basic.num_tfo_accepted);
 	putchar('\n');
 
 	if (basic.num_sent > 0)
@@ -456,12 +582,19 @@ dump(void)
 		 reply_rate_avg, basic.reply_rate_max, reply_rate_stddev,
 		 basic.num_reply_rates);
 
-	if (basic.num_responses > 0)
+	if (basic.num_responses > 0) {
 		resp_time = basic.call_response_sum / basic.num_responses;
+		corrected_time = basic.call_corrected_sum / basic.num_responses;
+	}
 	if (total_replies > 0)
 		xfer_time = basic.call_xfer_sum / total_replies;
-	printf("Reply time [ms]: response %.1f transfer %.1f\n",
-		   1e3 * resp_time, 1e3 * xfer_time);
+	printf("Reply time [ms]: response %.1f transfer %.1f corrected %.1f\n",
+	       1e3 * resp_time, 1e3 * xfer_time, 1e3 * corrected_time);
+	print_percentiles("Reply time [ms]: service",
+			  &basic.call_response_hist);
+	print_percentiles("Reply time [ms]: corrected",
+			  &basic.call_corrected_hist);
+	print_percentiles("Reply time [ms]: transfer", &basic.call_xfer_hist);
 
 	if (total_replies) {
 		hdr_size = basic.hdr_bytes_received / total_replies;
@@ -501,15 +634,121 @@ dump(void)
 
 	printf("Errors: total %lu client-timo %lu socket-timo %lu "
 		   "connrefused %lu connreset %lu\n"
-		   "Errors: fd-unavail %lu addrunavail %lu ftab-full %lu other %lu\n",
+		   "Errors: fd-unavail %lu addrunavail %lu ftab-full %lu other %lu",
 		   (basic.num_client_timeouts + basic.num_sock_timeouts
 			+ basic.num_sock_fdunavail + basic.num_sock_ftabfull
 			+ basic.num_sock_refused + basic.num_sock_reset
-			+ basic.num_sock_addrunavail + basic.num_other_errors),
+			+ basic.num_sock_addrunavail + basic.num_sock_backlog
+			+ basic.num_other_errors + basic.num_integrity),
 		   basic.num_client_timeouts, basic.num_sock_timeouts,
 		   basic.num_sock_refused, basic.num_sock_reset,
 		   basic.num_sock_fdunavail, basic.num_sock_addrunavail,
 		   basic.num_sock_ftabfull, basic.num_other_errors);
+	if (param.unix_socket)
+		printf(" backlog-full %lu", basic.num_sock_backlog);
+	if (param.verify.file)
+		printf(" integrity %lu", basic.num_integrity);
+	putchar('\n');
+}
+
+static const void *
+export(size_t *len)
+{
+	*len = sizeof(basic);
+	return &basic;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const struct basic_stats *o = buf;
+	u_long          i, n;
+	Time            rate;
+
+	assert(len == sizeof(basic));
+
+	basic.num_conns_issued += o->num_conns_issued;
+	for (i = 0; i < NELEMS(basic.num_replies); ++i)
+		basic.num_replies[i] += o->num_replies[i];
+	basic.num_200 += o->num_200;
+	basic.num_302 += o->num_302;
+	basic.num_client_timeouts += o->num_client_timeouts;
+	basic.num_sock_fdunavail += o->num_sock_fdunavail;
+	basic.num_sock_ftabfull += o->num_sock_ftabfull;
+	basic.num_sock_refused += o->num_sock_refused;
+	basic.num_sock_reset += o->num_sock_reset;
+	basic.num_sock_timeouts += o->num_sock_timeouts;
+	basic.num_sock_addrunavail += o->num_sock_addrunavail;
+	basic.num_sock_backlog += o->num_sock_backlog;
+	basic.num_other_errors += o->num_other_errors;
+	basic.num_integrity += o->num_integrity;
+	basic.num_tfo += o->num_tfo;
+	basic.num_tfo_accepted += o->num_tfo_accepted;
+	/*
+	 * The workers did not necessarily peak at the same time, so this is
+	 * an upper bound: 
+	 */
+	basic.max_conns += o->max_conns;
+
+	basic.num_lifetimes += o->num_lifetimes;
+	basic.conn_lifetime_sum += o->conn_lifetime_sum;
+	basic.conn_lifetime_sum2 += o->conn_lifetime_sum2;
+	if (o->conn_lifetime_min < basic.conn_lifetime_min)
+		basic.conn_lifetime_min = o->conn_lifetime_min;
+	if (o->conn_lifetime_max > basic.conn_lifetime_max)
+		basic.conn_lifetime_max = o->conn_lifetime_max;
+	hist_merge(&basic.conn_lifetime_hist, &o->conn_lifetime_hist);
+
+	/*
+	 * All workers sample their reply rate at the same time, so the
+	 * aggregate rate of an interval is the sum of the workers' rates.
+	 */
+	if (basic.num_reply_rates <= MAX_RATE_SAMPLES
+	    && o->num_reply_rates <= MAX_RATE_SAMPLES) {
+		n = o->num_reply_rates;
+		if (basic.num_reply_rates > n)
+			n = basic.num_reply_rates;
+		for (i = 0; i < o->num_reply_rates; ++i)
+			basic.reply_rate[i] += o->reply_rate[i];
+		basic.num_reply_rates = n;
+		basic.reply_rate_sum = basic.reply_rate_sum2 = 0.0;
+		basic.reply_rate_min = DBL_MAX;
+		basic.reply_rate_max = 0.0;
+		for (i = 0; i < n; ++i) {
+			rate = basic.reply_rate[i];
+			basic.reply_rate_sum += rate;
+			basic.reply_rate_sum2 += SQUARE(rate);
+			if (rate < basic.reply_rate_min)
+				basic.reply_rate_min = rate;
+			if (rate > basic.reply_rate_max)
+				basic.reply_rate_max = rate;
+		}
+	} else {
+		basic.num_reply_rates += o->num_reply_rates;
+		basic.reply_rate_sum += o->reply_rate_sum;
+		basic.reply_rate_sum2 += o->reply_rate_sum2;
+		if (o->reply_rate_min < basic.reply_rate_min)
+			basic.reply_rate_min = o->reply_rate_min;
+		if (o->reply_rate_max > basic.reply_rate_max)
+			basic.reply_rate_max = o->reply_rate_max;
+	}
+
+	basic.num_connects += o->num_connects;
+	basic.conn_connect_sum += o->conn_connect_sum;
+	hist_merge(&basic.conn_connect_hist, &o->conn_connect_hist);
+	basic.num_responses += o->num_responses;
+	basic.call_response_sum += o->call_response_sum;
+	hist_merge(&basic.call_response_hist, &o->call_response_hist);
+	basic.call_corrected_sum += o->call_corrected_sum;
+	hist_merge(&basic.call_corrected_hist, &o->call_corrected_hist);
+	basic.call_xfer_sum += o->call_xfer_sum;
+	hist_merge(&basic.call_xfer_hist, &o->call_xfer_hist);
+	basic.num_sent += o->num_sent;
+	basic.req_bytes_sent += o->req_bytes_sent;
+	basic.num_received += o->num_received;
+	basic.hdr_bytes_received += o->hdr_bytes_received;
+	basic.reply_bytes_received += o->reply_bytes_received;
+	basic.footer_bytes_received += o->footer_bytes_received;
 }
 
 Stat_Collector  stats_basic = {
@@ -517,5 +756,8 @@ Stat_Collector  stats_basic = {
 	init,
 	no_op,
 	no_op,
-	dump
+	dump,
+	export,
+	merge,
+	reset
 };
@@ -0,0 +1,387 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Call capture (--capture).  Every call, one in N calls or only the calls
+ * that failed are recorded in a file for capdump to decode after the test:
+ * their times, connection and call, status, sizes and, optionally, the
+ * start of the reply header.  Unlike --print-reply, this is meant to stay
+ * on at full load: the records have a fixed size and go straight into a
+ * ring in a file that is mapped (and its disk space allocated) before the
+ * test, and the header bytes are collected in the call object itself, so
+ * there is no allocation, formatting or system call per call.  See
+ * capture.h for the layout of the file.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <localevent.h>
+#include <stats.h>
+#include <capture.h>
+#include <worker.h>
+
+typedef struct Conn_Private_Data {
+	u_wide          number;
+} Conn_Private_Data;
+
+typedef struct Call_Private_Data {
+	Time            issued;
+	Time            done;
+	u_wide          conn;
+	u_short         flags;
+	u_short         error;
+	u_short         capture;	/* record the call? */
+	u_short         header_len;
+	char            header[];	/* param.capture.header_len bytes */
+} Call_Private_Data;
+
+#define CONN_PRIVATE_DATA(c)						\
+  ((Conn_Private_Data *) ((char *)(c) + conn_private_data_offset))
+#define CALL_PRIVATE_DATA(c)						\
+  ((Call_Private_Data *) ((char *)(c) + call_private_data_offset))
+
+static size_t   conn_private_data_offset;
+static size_t   call_private_data_offset;
+static Capture_Region *region;
+static char    *slots;
+static u_int    record_size;
+static u_wide   num_conns;
+static u_long   num_issued;
+static Time     time_base;	/* timer_now() at Capture_Region.start */
+
+static struct capture_stats {
+	u_wide          captured;	/* # of calls recorded */
+	u_wide          kept;		/* # of those still in the file */
+} st;
+
+static void
+conn_created(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	assert(et == EV_CONN_NEW && object_is_conn(obj));
+
+	CONN_PRIVATE_DATA(obj)->number = num_conns++;
+}
+
+/*
+ * Marks the calls of a connection that failed or timed out.
+ */
+static void
+conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Conn           *s = (Conn *) obj;
+	Call_Private_Data *priv;
+	Call           *c;
+	int             pass;
+
+	assert((et == EV_CONN_FAILED || et == EV_CONN_TIMEOUT)
+	    && object_is_conn(s));
+
+	for (pass = 0; pass < 2; ++pass)
+		for (c = pass ? s->recvq : s->sendq; c;
+		    c = pass ? c->recvq_next : c->sendq_next) {
+			priv = CALL_PRIVATE_DATA(c);
+			if (et == EV_CONN_TIMEOUT)
+				priv->flags |= CAPTURE_TIMEOUT;
+			else {
+				priv->flags |= CAPTURE_FAILED;
+				priv->error = call_arg.l;
+			}
+		}
+}
+
+static void
+call_issue(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Call_Private_Data *priv;
+
+	assert(et == EV_CALL_ISSUE && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	priv->issued = timer_now();
+	priv->conn = CONN_PRIVATE_DATA(c->conn)->number;
+	if (param.capture.sample && num_issued++ % param.capture.sample == 0)
+		priv->capture = 1;
+}
+
+static void
+recv_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_RECV_START && object_is_call(c));
+
+	/* only the headers of failed replies are of interest then */
+	if (!param.capture.sample && (c->reply.status >= 400
+		|| c->reply.status == param.failure_status))
+		CALL_PRIVATE_DATA(c)->capture = 1;
+}
+
+static void
+recv_hdr(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	const struct iovec *line = call_arg.vp;
+	Call_Private_Data *priv;
+	size_t          n, room;
+
+	assert(et == EV_CALL_RECV_HDR && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	if (!priv->capture || (priv->flags & CAPTURE_TRUNCATED))
+		return;
+	room = param.capture.header_len - priv->header_len;
+	n = line->iov_len + 1;
+	if (n > room) {
+		n = room;
+		priv->flags |= CAPTURE_TRUNCATED;
+	}
+	memcpy(priv->header + priv->header_len, line->iov_base,
+	    n <= line->iov_len ? n : line->iov_len);
+	if (n > line->iov_len)
+		priv->header[priv->header_len + line->iov_len] = '\n';
+	priv->header_len += n;
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Call_Private_Data *priv;
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	priv->done = timer_now();
+	priv->flags |= CAPTURE_REPLIED;
+}
+
+static u_int
+usec(Time t)
+{
+	return t <= 0 ? 0 : t >= 4294.967295 ? ~0u : (u_int) (1e6 * t);
+}
+
+static void
+call_destroyed(Event_Type et, Object * obj, Any_Type reg_arg,
+    Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Call_Private_Data *priv;
+	Capture_Record *r;
+	int             failed;
+
+	assert(et == EV_CALL_DESTROYED && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	if (priv->issued == 0)
+		return;		/* never got anywhere */
+	if (c->reply.corrupt)
+		priv->flags |= CAPTURE_CORRUPT;
+	if (!param.capture.sample) {
+		failed = !(priv->flags & CAPTURE_REPLIED)
+		    || (priv->flags & CAPTURE_CORRUPT)
+		    || c->reply.status >= 400
+		    || c->reply.status == param.failure_status;
+		if (!failed)
+			return;
+	} else if (!priv->capture)
+		return;
+
+	r = (Capture_Record *) (slots
+	    + (region->count % region->num_slots) * record_size);
+	r->time = 1e9 * (priv->issued - time_base);
+	r->conn = priv->conn;
+	r->call = c->id;
+	r->body_bytes = c->reply.content_bytes;
+	r->request_bytes = c->req.size;
+	r->header_bytes = c->reply.header_bytes;
+	r->response = r->transfer = 0;
+	if (c->basic.time_recv_start > 0) {
+		r->response = usec(c->basic.time_recv_start
+		    - c->basic.time_send_start);
+		if (priv->done > 0)
+			r->transfer = usec(priv->done
+			    - c->basic.time_recv_start);
+	}
+	r->status = c->reply.status;
+	r->flags = priv->flags;
+	r->error = priv->error;
+	r->header_len = priv->header_len;
+	memcpy(r + 1, priv->header, priv->header_len);
+	++region->count;
+}
+
+static void
+init(void)
+{
+	Capture_Header *hdr;
+	size_t          header_size;
+	u_wide          region_size, size;
+	char           *base;
+	Any_Type        arg;
+	int             fd;
+
+	record_size = (sizeof(Capture_Record) + param.capture.header_len + 7)
+	    & ~7u;
+	header_size = CAPTURE_ROUND(sizeof(Capture_Header));
+	region_size = CAPTURE_ROUND(param.capture.size);
+	size = header_size + param.workers * region_size;
+
+	/*
+	 * Like the live statistics file, the file is shared by all workers,
+	 * each of which writes to its own region only.
+	 */
+	fd = open(param.capture.file, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, size) < 0
+#ifdef HAVE_POSIX_FALLOCATE
+	    || (errno = posix_fallocate(fd, 0, size)) != 0
+#endif
+	    || (base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "%s: can't set up the capture file %s: %s\n",
+		    prog_name, param.capture.file, strerror(errno));
+		exit(1);
+	}
+	close(fd);
+
+	hdr = (Capture_Header *) base;
+	hdr->version = CAPTURE_VERSION;
+	hdr->header_size = header_size;
+	hdr->num_regions = param.workers;
+	hdr->region_size = region_size;
+	hdr->record_size = record_size;
+	hdr->max_header_len = param.capture.header_len;
+	hdr->sample = param.capture.sample;
+	hdr->magic = CAPTURE_MAGIC;
+
+	region = (Capture_Region *) (base + header_size
+	    + worker_id * region_size);
+	slots = (char *) region + CAPTURE_ROUND(sizeof(Capture_Region));
+	memset(region, 0, sizeof(*region));
+	region->num_slots = (region_size
+	    - CAPTURE_ROUND(sizeof(Capture_Region))) / record_size;
+	region->pid = getpid();
+	region->worker = worker_id;
+	if (region->num_slots == 0) {
+		fprintf(stderr, "%s: capture file regions of %llu bytes "
+		    "are too small\n", prog_name,
+		    (unsigned long long) region_size);
+		exit(1);
+	}
+	/* fault the ring in now rather than during the test */
+	memset(slots, 0, region->num_slots * record_size);
+
+	conn_private_data_offset = object_expand(OBJ_CONN,
+	    sizeof(Conn_Private_Data));
+	call_private_data_offset = object_expand(OBJ_CALL,
+	    sizeof(Call_Private_Data) + param.capture.header_len);
+
+	arg.l = 0;
+	event_register_handler(EV_CONN_NEW, conn_created, arg);
+	event_register_handler(EV_CONN_FAILED, conn_fail, arg);
+	event_register_handler(EV_CONN_TIMEOUT, conn_fail, arg);
+	event_register_handler(EV_CALL_ISSUE, call_issue, arg);
+	if (param.capture.header_len > 0) {
+		event_register_handler(EV_CALL_RECV_START, recv_start, arg);
+		event_register_handler(EV_CALL_RECV_HDR, recv_hdr, arg);
+	}
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+	event_register_handler(EV_CALL_DESTROYED, call_destroyed, arg);
+}
+
+static void
+start(void)
+{
+	struct timeval  tv;
+
+	gettimeofday(&tv, NULL);
+	time_base = timer_now();
+	region->start = tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static void
+stop(void)
+{
+	st.captured = region->count;
+	st.kept = st.captured < region->num_slots ? st.captured
+	    : region->num_slots;
+}
+
+static void
+dump(void)
+{
+	printf("\nCapture: %llu calls recorded, %llu kept in %s\n",
+	    (unsigned long long) st.captured, (unsigned long long) st.kept,
+	    param.capture.file);
+}
+
+static const void *
+export(size_t *len)
+{
+	*len = sizeof(st);
+	return &st;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const struct capture_stats *o = buf;
+
+	assert(len == sizeof(st));
+	st.captured += o->captured;
+	st.kept += o->kept;
+}
+
+Stat_Collector  stats_capture = {
+	"Call capture",
+	init,
+	start,
+	stop,
+	dump,
+	export,
+	merge
+};
@@ -0,0 +1,95 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef capture_h
+#define capture_h
+
+/*
+ * Layout of the call capture file (--capture), as read by capdump.  The
+ * file starts with a Capture_Header followed by NUM_REGIONS regions of
+ * REGION_SIZE bytes, one per worker process.  A region starts with a
+ * Capture_Region and continues with NUM_SLOTS records of RECORD_SIZE
+ * bytes that are used as a ring: the N'th record a worker captures goes
+ * to slot N % NUM_SLOTS, so once the ring is full, each record replaces
+ * the oldest one.  COUNT tells how many records the worker has written in
+ * all.  Numbers are in the byte order of the machine running httperf.
+ *
+ * A record is a Capture_Record followed by the first HEADER_LEN bytes of
+ * the reply header, at most MAX_HEADER_LEN bytes in all (see --capture).
+ * The header lines are separated by line feeds.
+ */
+#define	CAPTURE_MAGIC	0x63617074	/* "capt" */
+#define	CAPTURE_VERSION	1
+#define	CAPTURE_ROUND(n)	(((n) + 63) & ~(size_t) 63)
+
+/* Capture_Record.flags: */
+#define	CAPTURE_REPLIED		0x01	/* the reply was received in full */
+#define	CAPTURE_TIMEOUT		0x02	/* the connection timed out */
+#define	CAPTURE_FAILED		0x04	/* the connection failed with ERROR */
+#define	CAPTURE_CORRUPT		0x08	/* the reply failed --verify */
+#define	CAPTURE_TRUNCATED	0x10	/* the reply header was cut short */
+
+typedef struct Capture_Header {
+	u_int           magic;
+	u_int           version;
+	u_int           header_size;
+	u_int           num_regions;	/* # of workers */
+	u_wide          region_size;
+	u_int           record_size;
+	u_int           max_header_len;
+	u_int           sample;	/* 1 in SAMPLE calls (0 = failed calls) */
+	u_int           pad;
+} Capture_Header;
+
+typedef struct Capture_Region {
+	u_wide          count;	/* # of records written */
+	u_wide          num_slots;
+	double          start;	/* time of day the records' times count
+				 * from */
+	u_int           pid;
+	u_int           worker;
+} Capture_Region;
+
+typedef struct Capture_Record {
+	u_wide          time;	/* when the call was issued, in ns since
+				 * Capture_Region.start */
+	u_wide          conn;	/* the connection's number in the worker */
+	u_wide          call;	/* the call's id */
+	u_wide          body_bytes;
+	u_int           request_bytes;
+	u_int           header_bytes;
+	u_int           response;	/* us from sending the request to the
+					 * first byte of the reply */
+	u_int           transfer;	/* us from that to the end of it */
+	u_short         status;
+	u_short         flags;
+	u_short         error;	/* errno, with CAPTURE_FAILED */
+	u_short         header_len;
+} Capture_Record;
+
+#endif /* capture_h */
@@ -0,0 +1,713 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Statistics by Content-Encoding (--accept-encoding, --decode).  Replies
+ * are counted per encoding along with their body bytes as received and
+ * their response and transfer times.  None of this needs the body itself,
+ * so unless --decode is given the bodies are still drained unparsed.
+ *
+ * With --decode, the body of each gzip, deflate or br reply is also
+ * decompressed to measure its decoded size.  That is done by a helper
+ * thread so that it takes no time from the event loop: the loop copies
+ * the body into a single-producer, single-consumer ring and never waits
+ * for the decoder.  Should the ring fill up, the replies that don't fit
+ * are skipped and counted as such rather than slowing the test down.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define HAVE_ZLIB
+#endif
+#if defined(HAVE_LIBBROTLIDEC) && defined(HAVE_BROTLI_DECODE_H)
+#include <brotli/decode.h>
+#define HAVE_BROTLI
+#endif
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <localevent.h>
+#include <stats.h>
+
+enum {
+	ENC_IDENTITY,
+	ENC_GZIP,
+	ENC_DEFLATE,
+	ENC_BR,
+	ENC_ZSTD,
+	ENC_OTHER,
+	NUM_ENCODINGS
+};
+
+static const char *const enc_name[NUM_ENCODINGS] = {
+	"identity", "gzip", "deflate", "br", "zstd", "other"
+};
+
+typedef struct Call_Private_Data {
+	u_int           enc;
+	u_int           open;	/* the decoder has a stream for this call */
+	u_int           truncated;	/* some of its body didn't fit the
+					 * ring */
+} Call_Private_Data;
+
+#define CALL_PRIVATE_DATA(c)						\
+  ((Call_Private_Data *) ((char *)(c) + call_private_data_offset))
+
+static struct encoding_stats {
+	struct {
+		u_long          replies;
+		u_wide          wire_bytes;	/* body bytes as received */
+		Time            response_time;	/* sum of */
+		Time            transfer_time;	/* sum of */
+		u_long          decoded;	/* # decoded successfully */
+		u_long          errors;		/* # that failed to decode */
+		u_long          skipped;	/* # not decoded (ring full) */
+		u_wide          decoded_bytes;
+		u_wide          decoded_wire_bytes;	/* input of those */
+	}               e[NUM_ENCODINGS];
+	double          decode_cpu;	/* CPU time of the decoder(s) */
+} st;
+
+static size_t   call_private_data_offset;
+
+#ifdef HAVE_PTHREAD_H
+
+#define	RING_SIZE	(16 << 20)
+#define	RING_MASK	(RING_SIZE - 1)
+#define	REC_LEN(n)	(sizeof(struct rec) + (((n) + 15) & ~(size_t) 15))
+
+/*
+ * A record in the ring, followed by LEN bytes of data and padded to a
+ * multiple of 16 bytes.  Records are never split across the end of the
+ * ring: a REC_PAD record skips what is left of it instead.
+ */
+struct rec {
+	uint64_t        id;	/* the call's */
+	uint16_t        type;
+	uint16_t        enc;
+	uint32_t        len;
+};
+
+enum {
+	REC_START,		/* a reply with encoding ENC begins */
+	REC_DATA,		/* LEN bytes of its body */
+	REC_END,		/* the reply is complete */
+	REC_ABORT,		/* the reply won't be complete */
+	REC_PAD
+};
+
+static struct {
+	char           *buf;
+	/* written by the event loop only: */
+	size_t          head __attribute__((aligned(64)));
+	u_int           num_open;	/* # of started but unfinished
+					 * streams */
+	int             done;
+	u_int           resets;	/* # of times the counts were reset */
+	/* written by the decoder only: */
+	size_t          tail __attribute__((aligned(64)));
+} ring;
+
+/*
+ * What the decoder thread found.  It alone updates these; the event loop
+ * adds them to its statistics once the thread has been joined.
+ */
+static struct {
+	u_long          decoded, errors, skipped;
+	u_wide          decoded_bytes, decoded_wire_bytes;
+}               dec[NUM_ENCODINGS];
+static double   dec_cpu;
+static double   dec_cpu_base;	/* at the last reset */
+
+static pthread_t decoder_thread;
+static int      decoding;
+
+/*
+ * Appends a record with the LEN bytes at DATA to the ring, leaving at
+ * least RESERVE bytes free.  Returns -1 if there is not enough room.
+ */
+static int
+ring_put(uint64_t id, int type, int enc, const void *data, size_t len,
+    size_t reserve)
+{
+	size_t          head = ring.head, need = REC_LEN(len), room, pad;
+	struct rec     *r;
+
+	room = RING_SIZE - (head - __atomic_load_n(&ring.tail,
+		__ATOMIC_ACQUIRE));
+	pad = RING_SIZE - (head & RING_MASK);
+	if (pad >= need)
+		pad = 0;
+	if (pad + need + reserve > room)
+		return -1;
+	if (pad) {
+		r = (struct rec *) (ring.buf + (head & RING_MASK));
+		r->type = REC_PAD;
+		head += pad;
+	}
+	r = (struct rec *) (ring.buf + (head & RING_MASK));
+	r->id = id;
+	r->type = type;
+	r->enc = enc;
+	r->len = len;
+	if (len)
+		memcpy(r + 1, data, len);
+	__atomic_store_n(&ring.head, head + need, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*
+ * The decoder thread's view of a reply.
+ */
+struct stream {
+	struct stream  *next;
+	uint64_t        id;
+	int             enc;
+	int             failed;
+	int             finished;
+	u_wide          in, out;
+#ifdef HAVE_ZLIB
+	z_stream        z;
+#endif
+#ifdef HAVE_BROTLI
+	BrotliDecoderState *br;
+#endif
+};
+
+#define	NUM_BUCKETS	4096
+
+static struct stream *bucket[NUM_BUCKETS];
+static struct stream *free_streams;
+static u_char   scratch[65536];	/* decoded data goes here, unlooked at */
+
+static struct stream **
+find(uint64_t id)
+{
+	struct stream **sp;
+
+	for (sp = &bucket[id % NUM_BUCKETS]; *sp; sp = &(*sp)->next)
+		if ((*sp)->id == id)
+			break;
+	return sp;
+}
+
+static void
+stream_start(uint64_t id, int enc)
+{
+	struct stream  *s, **sp;
+
+	s = free_streams;
+	if (s)
+		free_streams = s->next;
+	else if (!(s = malloc(sizeof(*s))))
+		panic("%s: out of memory for decoder streams\n", prog_name);
+	memset(s, 0, sizeof(*s));
+	s->id = id;
+	s->enc = enc;
+	switch (enc) {
+#ifdef HAVE_ZLIB
+	case ENC_GZIP:
+	case ENC_DEFLATE:
+		/* gzip or zlib wrapper, whichever it is */
+		if (inflateInit2(&s->z, 15 + 32) != Z_OK)
+			s->failed = 1;
+		break;
+#endif
+#ifdef HAVE_BROTLI
+	case ENC_BR:
+		s->br = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+		if (!s->br)
+			s->failed = 1;
+		break;
+#endif
+	default:
+		s->failed = 1;
+		break;
+	}
+	sp = find(id);
+	s->next = *sp;
+	*sp = s;
+}
+
+static void
+stream_data(struct stream *s, const u_char * data, size_t len)
+{
+	s->in += len;
+	if (s->failed || s->finished)
+		return;
+	switch (s->enc) {
+#ifdef HAVE_ZLIB
+	case ENC_GZIP:
+	case ENC_DEFLATE: {
+			int             rc;
+
+			s->z.next_in = (u_char *) data;
+			s->z.avail_in = len;
+			do {
+				s->z.next_out = scratch;
+				s->z.avail_out = sizeof(scratch);
+				rc = inflate(&s->z, Z_NO_FLUSH);
+				s->out += sizeof(scratch) - s->z.avail_out;
+			} while (rc == Z_OK && (s->z.avail_in > 0
+				|| s->z.avail_out == 0));
+			if (rc == Z_STREAM_END)
+				s->finished = 1;
+			else if (rc != Z_OK && rc != Z_BUF_ERROR)
+				s->failed = 1;
+			break;
+		}
+#endif
+#ifdef HAVE_BROTLI
+	case ENC_BR: {
+			BrotliDecoderResult rc;
+			size_t          avail_out;
+			u_char         *next_out;
+
+			do {
+				next_out = scratch;
+				avail_out = sizeof(scratch);
+				rc = BrotliDecoderDecompressStream(s->br, &len,
+				    &data, &avail_out, &next_out, NULL);
+				s->out += sizeof(scratch) - avail_out;
+			} while (rc == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+			if (rc == BROTLI_DECODER_RESULT_SUCCESS)
+				s->finished = 1;
+			else if (rc == BROTLI_DECODER_RESULT_ERROR)
+				s->failed = 1;
+			break;
+		}
+#endif
+	default:
+		break;
+	}
+}
+
+static void
+stream_end(struct stream **sp, int complete)
+{
+	struct stream  *s = *sp;
+
+	if (!complete)
+		++dec[s->enc].skipped;
+	else if (s->in == 0)
+		;		/* no body at all (HEAD, 304, ...) */
+	else if (s->failed || !s->finished)
+		++dec[s->enc].errors;
+	else {
+		++dec[s->enc].decoded;
+		dec[s->enc].decoded_bytes += s->out;
+		dec[s->enc].decoded_wire_bytes += s->in;
+	}
+#ifdef HAVE_ZLIB
+	if (s->enc == ENC_GZIP || s->enc == ENC_DEFLATE)
+		inflateEnd(&s->z);
+#endif
+#ifdef HAVE_BROTLI
+	if (s->br)
+		BrotliDecoderDestroyInstance(s->br);
+#endif
+	*sp = s->next;
+	s->next = free_streams;
+	free_streams = s;
+}
+
+/*
+ * The decoder thread.  It naps for 200 microseconds whenever it runs out
+ * of work, so that the event loop never has to wake it up.
+ */
+static void    *
+decoder(void *arg)
+{
+	const struct timespec nap = {0, 200000};
+	struct timespec ts;
+	struct stream **sp;
+	struct rec     *r;
+	size_t          head, tail = 0;
+	u_int           resets = 0;
+	int             done;
+
+	for (;;) {
+		if (__atomic_load_n(&ring.resets, __ATOMIC_ACQUIRE) != resets) {
+			++resets;
+			memset(dec, 0, sizeof(dec));
+			if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+				dec_cpu_base = ts.tv_sec + 1e-9 * ts.tv_nsec;
+		}
+		done = __atomic_load_n(&ring.done, __ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+		if (tail == head) {
+			if (done)
+				break;
+			nanosleep(&nap, NULL);
+			continue;
+		}
+		while (tail != head) {
+			r = (struct rec *) (ring.buf + (tail & RING_MASK));
+			if (r->type == REC_PAD) {
+				tail += RING_SIZE - (tail & RING_MASK);
+				continue;
+			}
+			if (r->type == REC_START)
+				stream_start(r->id, r->enc);
+			else if (*(sp = find(r->id))) {
+				if (r->type == REC_DATA)
+					stream_data(*sp, (u_char *) (r + 1),
+					    r->len);
+				else
+					stream_end(sp, r->type == REC_END);
+			}
+			tail += REC_LEN(r->len);
+		}
+		__atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+	}
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		dec_cpu = ts.tv_sec + 1e-9 * ts.tv_nsec - dec_cpu_base;
+	return NULL;
+}
+
+/*
+ * Has the decoder thread work through what is left in the ring and waits
+ * for it to exit.
+ */
+static void
+finish(void)
+{
+	int             i;
+
+	if (!decoding)
+		return;
+	__atomic_store_n(&ring.done, 1, __ATOMIC_RELEASE);
+	pthread_join(decoder_thread, NULL);
+	decoding = 0;
+
+	for (i = 0; i < NUM_ENCODINGS; ++i) {
+		st.e[i].decoded += dec[i].decoded;
+		st.e[i].errors += dec[i].errors;
+		st.e[i].skipped += dec[i].skipped;
+		st.e[i].decoded_bytes += dec[i].decoded_bytes;
+		st.e[i].decoded_wire_bytes += dec[i].decoded_wire_bytes;
+	}
+	st.decode_cpu += dec_cpu;
+}
+
+static void
+recv_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	const struct iovec *iov = call_arg.vp;
+	Call_Private_Data *priv;
+
+	assert(et == EV_CALL_RECV_SAMPLE && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	if (!priv->open || priv->truncated)
+		return;
+	/* leave room for the END of every open stream */
+	if (ring_put(c->id, REC_DATA, priv->enc, iov->iov_base, iov->iov_len,
+		ring.num_open * sizeof(struct rec)) < 0)
+		priv->truncated = 1;
+}
+
+static void
+close_stream(Call * c, int type)
+{
+	Call_Private_Data *priv = CALL_PRIVATE_DATA(c);
+	int             rc;
+
+	if (!priv->open)
+		return;
+	if (priv->truncated)
+		type = REC_ABORT;
+	rc = ring_put(c->id, type, priv->enc, NULL, 0, 0);
+	assert(rc == 0);
+	(void) rc;
+	priv->open = 0;
+	--ring.num_open;
+}
+
+static void
+call_destroyed(Event_Type et, Object * obj, Any_Type reg_arg,
+    Any_Type call_arg)
+{
+	assert(et == EV_CALL_DESTROYED && object_is_call(obj));
+
+	/* a call that failed part way through its reply */
+	close_stream((Call *) obj, REC_ABORT);
+}
+
+#endif				/* HAVE_PTHREAD_H */
+
+static int
+parse_encoding(const char *cp, const char *end)
+{
+	static const struct {
+		const char     *name;
+		size_t          len;
+		int             enc;
+	}               known[] = {
+		{"identity", 8, ENC_IDENTITY},
+		{"gzip", 4, ENC_GZIP},
+		{"x-gzip", 6, ENC_GZIP},
+		{"deflate", 7, ENC_DEFLATE},
+		{"br", 2, ENC_BR},
+		{"zstd", 4, ENC_ZSTD}
+	};
+	size_t          i, len;
+
+	while (cp < end && (*cp == ' ' || *cp == '\t'))
+		++cp;
+	while (end > cp && (end[-1] == ' ' || end[-1] == '\t'))
+		--end;
+	len = end - cp;
+	for (i = 0; i < NELEMS(known); ++i)
+		if (len == known[i].len
+		    && strncasecmp(cp, known[i].name, len) == 0)
+			return known[i].enc;
+	return ENC_OTHER;	/* including several codings in a row */
+}
+
+static void
+recv_hdr(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	const struct iovec *line = call_arg.vp;
+	Call_Private_Data *priv;
+	const char     *cp;
+
+	assert(et == EV_CALL_RECV_HDR && object_is_call(c));
+
+	if (line->iov_len < 17
+	    || strncasecmp(line->iov_base, "content-encoding:", 17) != 0)
+		return;
+	cp = line->iov_base;
+	priv = CALL_PRIVATE_DATA(c);
+	priv->enc = parse_encoding(cp + 17, cp + line->iov_len);
+
+#ifdef HAVE_PTHREAD_H
+	if (!decoding || priv->open)
+		return;
+	switch (priv->enc) {
+#ifdef HAVE_ZLIB
+	case ENC_GZIP:
+	case ENC_DEFLATE:
+#endif
+#ifdef HAVE_BROTLI
+	case ENC_BR:
+#endif
+		if (ring_put(c->id, REC_START, priv->enc, NULL, 0,
+			(ring.num_open + 1) * sizeof(struct rec)) < 0) {
+			++st.e[priv->enc].skipped;
+			break;
+		}
+		priv->open = 1;
+		++ring.num_open;
+		c->reply.sampled = 1;
+		break;
+
+	default:
+		break;
+	}
+#endif
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Call_Private_Data *priv;
+	Time            now = timer_now();
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	if (c->basic.epoch == test_epoch) {
+		++st.e[priv->enc].replies;
+		st.e[priv->enc].wire_bytes += c->reply.content_bytes;
+		st.e[priv->enc].response_time +=
+		    c->basic.time_recv_start - c->basic.time_send_start;
+		st.e[priv->enc].transfer_time +=
+		    now - c->basic.time_recv_start;
+	}
+#ifdef HAVE_PTHREAD_H
+	close_stream(c, REC_END);
+#endif
+}
+
+static void
+init(void)
+{
+	Any_Type        arg;
+
+	call_private_data_offset = object_expand(OBJ_CALL,
+	    sizeof(Call_Private_Data));
+	arg.l = 0;
+	event_register_handler(EV_CALL_RECV_HDR, recv_hdr, arg);
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+
+	if (!param.encoding.decode)
+		return;
+#ifdef HAVE_PTHREAD_H
+	ring.buf = malloc(RING_SIZE);
+	if (!ring.buf) {
+		fprintf(stderr, "%s: out of memory for the decoder ring\n",
+		    prog_name);
+		exit(1);
+	}
+	errno = pthread_create(&decoder_thread, NULL, decoder, NULL);
+	if (errno) {
+		fprintf(stderr, "%s: failed to start the decoder thread: "
+		    "%s\n", prog_name, strerror(errno));
+		exit(1);
+	}
+	decoding = 1;
+	event_register_handler(EV_CALL_RECV_SAMPLE, recv_sample, arg);
+	event_register_handler(EV_CALL_DESTROYED, call_destroyed, arg);
+#else
+	fprintf(stderr, "%s: --decode needs thread support\n", prog_name);
+	exit(1);
+#endif
+}
+
+/*
+ * The decoder thread forgets its counts when it next looks at the ring,
+ * so replies it is still working on when the warm-up ends are counted
+ * as decoded after it.
+ */
+static void
+reset(void)
+{
+	memset(&st, 0, sizeof(st));
+#ifdef HAVE_PTHREAD_H
+	if (decoding)
+		__atomic_add_fetch(&ring.resets, 1, __ATOMIC_RELEASE);
+#endif
+}
+
+static void
+stop(void)
+{
+#ifdef HAVE_PTHREAD_H
+	finish();
+#endif
+}
+
+static void
+dump(void)
+{
+	double          delta = test_time_stop - test_time_start;
+	u_long          n;
+	int             i;
+
+	printf("\nEncoding:");
+	for (i = 0; i < NUM_ENCODINGS; ++i) {
+		n = st.e[i].replies;
+		if (n == 0 && st.e[i].skipped == 0)
+			continue;
+		printf("\n  %-8s replies %lu wire %.1f MB (%.0f B/reply) "
+		    "response %.1f ms transfer %.1f ms", enc_name[i], n,
+		    st.e[i].wire_bytes / 1048576.0,
+		    n ? (double) st.e[i].wire_bytes / n : 0.0,
+		    n ? 1e3 * st.e[i].response_time / n : 0.0,
+		    n ? 1e3 * st.e[i].transfer_time / n : 0.0);
+		if (!param.encoding.decode || i == ENC_IDENTITY)
+			continue;
+		n = st.e[i].decoded;
+		printf("\n           decoded %lu (%.1f MB, %.0f B/reply, "
+		    "ratio %.2f, %.1f MB/s) errors %lu skipped %lu", n,
+		    st.e[i].decoded_bytes / 1048576.0,
+		    n ? (double) st.e[i].decoded_bytes / n : 0.0,
+		    st.e[i].decoded_wire_bytes ? (double) st.e[i].decoded_bytes
+		    / st.e[i].decoded_wire_bytes : 0.0,
+		    delta > 0 ? st.e[i].decoded_bytes / 1048576.0 / delta
+		    : 0.0, st.e[i].errors, st.e[i].skipped);
+	}
+	printf("\n");
+#ifdef HAVE_PTHREAD_H
+	if (decoding)
+		printf("Encoding: the decoded counts come at the end of the "
+		    "test\n");
+	else
+#endif
+	if (param.encoding.decode)
+		printf("Encoding decode CPU: %.3f s\n", st.decode_cpu);
+}
+
+static const void *
+export(size_t *len)
+{
+	*len = sizeof(st);
+	return &st;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const struct encoding_stats *o = buf;
+	int             i;
+
+	assert(len == sizeof(st));
+	for (i = 0; i < NUM_ENCODINGS; ++i) {
+		st.e[i].replies += o->e[i].replies;
+		st.e[i].wire_bytes += o->e[i].wire_bytes;
+		st.e[i].response_time += o->e[i].response_time;
+		st.e[i].transfer_time += o->e[i].transfer_time;
+		st.e[i].decoded += o->e[i].decoded;
+		st.e[i].errors += o->e[i].errors;
+		st.e[i].skipped += o->e[i].skipped;
+		st.e[i].decoded_bytes += o->e[i].decoded_bytes;
+		st.e[i].decoded_wire_bytes += o->e[i].decoded_wire_bytes;
+	}
+	st.decode_cpu += o->decode_cpu;
+}
+
+Stat_Collector  stats_encoding = {
+	"Content-Encoding statistics",
+	init,
+	no_op,
+	stop,
+	dump,
+	export,
+	merge,
+	reset
+};
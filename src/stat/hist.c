@@ -0,0 +1,232 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Log-linear latency histograms.
+ *
+ * With H = 2^(SUB_BITS - 1) bins per power of two, bins 0 to 2H - 1 hold
+ * the values 0 to 2H - 1 exactly.  After that, every power of two
+ * [2^k, 2^(k+1)) gets H bins that are 2^(k - SUB_BITS + 1) wide.  The
+ * index of a value is found from its most significant bit, so recording
+ * takes constant time.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <generic_types.h>
+
+#include <hist.h>
+
+#define	HIST_LIMIT	(((u_wide) 1 << HIST_MAX_BITS) - 1)
+
+static u_int
+msb(u_wide v)
+{
+#ifdef __GNUC__
+	return 63 - __builtin_clzll(v);
+#else
+	u_int           n = 0;
+
+	while (v >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+static u_int
+bin_index(u_int sub_bits, u_wide v)
+{
+	u_int           half = 1 << (sub_bits - 1), shift;
+
+	if (v < 2 * half)
+		return v;
+	shift = msb(v) - sub_bits + 1;
+	return shift * half + (u_int) (v >> shift);
+}
+
+/*
+ * Stores the smallest value of bin I in *LO and returns the width of
+ * the bin.
+ */
+static u_wide
+bin_range(u_int sub_bits, u_int i, u_wide *lo)
+{
+	u_int           half = 1 << (sub_bits - 1), shift;
+
+	if (i < 2 * half) {
+		*lo = i;
+		return 1;
+	}
+	shift = i / half - 1;
+	*lo = (u_wide) (i - shift * half) << shift;
+	return (u_wide) 1 << shift;
+}
+
+static void
+init(Hist_Summary *s, u_int *bin, u_int num_bins)
+{
+	memset(s, 0, sizeof(*s));
+	s->min = HIST_LIMIT;
+	memset(bin, 0, num_bins * sizeof(*bin));
+}
+
+static void
+record(u_int sub_bits, Hist_Summary *s, u_int *bin, Time t)
+{
+	u_wide          v;
+
+	if (t <= 0.0)
+		v = 0;
+	else if (t * 1e6 >= HIST_LIMIT)
+		v = HIST_LIMIT;
+	else
+		v = (u_wide) (t * 1e6 + 0.5);
+
+	++bin[bin_index(sub_bits, v)];
+	++s->count;
+	if (v < s->min)
+		s->min = v;
+	if (v > s->max)
+		s->max = v;
+}
+
+static void
+merge(Hist_Summary *s, u_int *bin, const Hist_Summary *os,
+    const u_int *obin, u_int num_bins)
+{
+	u_int           i;
+
+	if (os->count == 0)
+		return;
+	for (i = 0; i < num_bins; ++i)
+		bin[i] += obin[i];
+	s->count += os->count;
+	if (os->min < s->min)
+		s->min = os->min;
+	if (os->max > s->max)
+		s->max = os->max;
+}
+
+static Time
+percentile(u_int sub_bits, const Hist_Summary *s, const u_int *bin,
+    u_int num_bins, double p)
+{
+	u_wide          rank, n = 0, lo, width, v;
+	u_int           i;
+
+	if (s->count == 0)
+		return 0.0;
+	rank = (u_wide) (p * s->count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank >= s->count)
+		return 1e-6 * s->max;
+
+	for (i = 0; i < num_bins; ++i) {
+		n += bin[i];
+		if (n >= rank)
+			break;
+	}
+	/*
+	 * Report the highest value that falls into the bin (but don't go
+	 * beyond what was actually seen).
+	 */
+	width = bin_range(sub_bits, i, &lo);
+	v = lo + width - 1;
+	if (v > s->max)
+		v = s->max;
+	if (v < s->min)
+		v = s->min;
+	return 1e-6 * v;
+}
+
+void
+hist_init(Hist *h)
+{
+	init(&h->s, h->bin, HIST_NUM_BINS);
+}
+
+void
+hist_record(Hist *h, Time t)
+{
+	record(HIST_SUB_BITS, &h->s, h->bin, t);
+}
+
+void
+hist_merge(Hist *h, const Hist *o)
+{
+	merge(&h->s, h->bin, &o->s, o->bin, HIST_NUM_BINS);
+}
+
+Time
+hist_percentile(const Hist *h, double p)
+{
+	return percentile(HIST_SUB_BITS, &h->s, h->bin, HIST_NUM_BINS, p);
+}
+
+u_int
+hist_next_bin(const Hist *h, u_int i, Time *t)
+{
+	u_wide          lo, width;
+
+	for (; i < HIST_NUM_BINS; ++i)
+		if (h->bin[i]) {
+			width = bin_range(HIST_SUB_BITS, i, &lo);
+			*t = 1e-6 * (lo + 0.5 * width);
+			break;
+		}
+	return i;
+}
+
+void
+hist_small_init(Hist_Small *h)
+{
+	init(&h->s, h->bin, HIST_SMALL_NUM_BINS);
+}
+
+void
+hist_small_record(Hist_Small *h, Time t)
+{
+	record(HIST_SMALL_SUB_BITS, &h->s, h->bin, t);
+}
+
+void
+hist_small_merge(Hist_Small *h, const Hist_Small *o)
+{
+	merge(&h->s, h->bin, &o->s, o->bin, HIST_SMALL_NUM_BINS);
+}
+
+Time
+hist_small_percentile(const Hist_Small *h, double p)
+{
+	return percentile(HIST_SMALL_SUB_BITS, &h->s, h->bin,
+	    HIST_SMALL_NUM_BINS, p);
+}
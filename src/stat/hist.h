@@ -0,0 +1,95 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef hist_h
+#define hist_h
+
+/*
+ * Log-linear ("HDR") histograms of times.  Values are kept in
+ * microseconds; every power of two is split into 2^(SUB_BITS - 1)
+ * equally wide bins, so a recorded value is off by less than
+ * 2^(1 - SUB_BITS) of itself no matter how large it is.  Values up to
+ * 2^HIST_MAX_BITS microseconds (about 19 hours) are recorded, larger
+ * ones end up in the last bin.
+ *
+ * A histogram is a flat structure without pointers, so the histograms
+ * of several processes can be shipped around as plain bytes and merged
+ * without losing anything.
+ *
+ * Hist is precise to 0.2%.  Hist_Small is meant for keeping many
+ * histograms (one per URI, say) and is precise to 12.5%.
+ */
+#define	HIST_MAX_BITS	36
+#define	HIST_BINS(sub_bits)	\
+	((HIST_MAX_BITS - (sub_bits) + 2) << ((sub_bits) - 1))
+
+#define	HIST_SUB_BITS	10
+#define	HIST_NUM_BINS	HIST_BINS(HIST_SUB_BITS)
+
+#define	HIST_SMALL_SUB_BITS	4
+#define	HIST_SMALL_NUM_BINS	HIST_BINS(HIST_SMALL_SUB_BITS)
+
+typedef struct Hist_Summary {
+	u_wide          count;	/* # of recorded values */
+	u_wide          min;	/* smallest value [us] */
+	u_wide          max;	/* largest value [us] */
+} Hist_Summary;
+
+typedef struct Hist {
+	Hist_Summary    s;
+	u_int           bin[HIST_NUM_BINS];
+} Hist;
+
+typedef struct Hist_Small {
+	Hist_Summary    s;
+	u_int           bin[HIST_SMALL_NUM_BINS];
+} Hist_Small;
+
+extern void	hist_init(Hist *h);
+extern void	hist_record(Hist *h, Time t);
+extern void	hist_merge(Hist *h, const Hist *o);
+
+/*
+ * Returns the value below which fraction P (0 <= P <= 1) of all recorded
+ * values lie, in seconds.
+ */
+extern Time	hist_percentile(const Hist *h, double p);
+
+/*
+ * Iterates over the non-empty bins: returns the index of the first one
+ * at or after I (or HIST_NUM_BINS if there is none) and stores the
+ * midpoint of that bin (in seconds) in *T.  
+ */
+extern u_int	hist_next_bin(const Hist *h, u_int i, Time *t);
+
+extern void	hist_small_init(Hist_Small *h);
+extern void	hist_small_record(Hist_Small *h, Time t);
+extern void	hist_small_merge(Hist_Small *h, const Hist_Small *o);
+extern Time	hist_small_percentile(const Hist_Small *h, double p);
+
+#endif /* hist_h */
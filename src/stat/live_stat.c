@@ -0,0 +1,193 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Live statistics collector (--live-stats).  Keeps a few counters in a
+ * file mapped into memory, so that another program can follow a running
+ * test by just reading the file.  The counters are updated with plain
+ * increments right where they change (most of them are event counters
+ * pointing into the file), which costs the event loop no more than the
+ * other collectors do.  The layout is in live_stat.h.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <localevent.h>
+#include <worker.h>
+#include <stats.h>
+#include <live_stat.h>
+
+/*
+ * Slots are cache-line aligned so that the workers don't slow each other
+ * down.
+ */
+#define	LIVE_ALIGN		128
+#define	LIVE_ROUND(n)		(((n) + LIVE_ALIGN - 1) & ~(LIVE_ALIGN - 1))
+
+static Live_Slot *slot;
+static Time     start_time;
+
+static void
+heartbeat(struct Timer *t, Any_Type arg)
+{
+	slot->time = timer_now() - start_time;
+	timer_schedule(heartbeat, arg, 1.0);
+}
+
+static void
+conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	assert(et == EV_CONN_FAILED);
+
+	++slot->errors[stats_error_class(call_arg.i)];
+}
+
+static void
+send_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_SEND_STOP && object_is_call(c));
+
+	++slot->requests;
+	slot->request_bytes += c->req.size;
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	u_int           index;
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	index = c->reply.status / 100;
+	assert(index < NELEMS(slot->replies));
+	++slot->replies[index];
+	slot->reply_header_bytes += c->reply.header_bytes;
+	slot->reply_body_bytes += c->reply.content_bytes
+	    + c->reply.footer_bytes;
+}
+
+static void
+init(void)
+{
+	Live_Header    *hdr;
+	struct timeval  tv;
+	size_t          header_size, slot_size, size;
+	char           *base;
+	Any_Type        arg;
+	int             fd;
+
+	header_size = LIVE_ROUND(sizeof(Live_Header));
+	slot_size = LIVE_ROUND(sizeof(Live_Slot));
+	size = header_size + param.workers * slot_size;
+
+	/*
+	 * All workers map the same file and only touch their own slot (the
+	 * header is the same for all of them).
+	 */
+	fd = open(param.live_stats, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, size) < 0
+	    || (base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "%s: can't set up live statistics in %s: %s\n",
+		    prog_name, param.live_stats, strerror(errno));
+		exit(1);
+	}
+	close(fd);
+
+	gettimeofday(&tv, NULL);
+	hdr = (Live_Header *) base;
+	hdr->version = LIVE_VERSION;
+	hdr->header_size = header_size;
+	hdr->slot_size = slot_size;
+	hdr->num_slots = param.workers;
+	hdr->start = tv.tv_sec + 1e-6 * tv.tv_usec;
+	hdr->magic = LIVE_MAGIC;
+
+	slot = (Live_Slot *) (base + header_size + worker_id * slot_size);
+	memset(slot, 0, slot_size);
+	slot->state = LIVE_STARTING;
+	slot->pid = getpid();
+
+	arg.l = 0;
+	event_register_counter(EV_CONN_NEW, &slot->conns_new);
+	event_register_counter(EV_CONN_CONNECTED, &slot->conns_connected);
+	event_register_counter(EV_CONN_DESTROYED, &slot->conns_destroyed);
+	event_register_counter(EV_CONN_TIMEOUT,
+	    &slot->errors[ERR_CLIENT_TIMO]);
+	event_register_handler(EV_CONN_FAILED, conn_fail, arg);
+	event_register_handler(EV_CALL_SEND_STOP, send_stop, arg);
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+	event_register_counter(EV_SESS_NEW, &slot->sessions_new);
+	event_register_counter(EV_SESS_FAILED, &slot->sessions_failed);
+	event_register_counter(EV_SESS_DESTROYED, &slot->sessions_destroyed);
+}
+
+static void
+start(void)
+{
+	Any_Type        arg;
+
+	start_time = timer_now();
+	slot->state = LIVE_RUNNING;
+	arg.l = 0;
+	timer_schedule(heartbeat, arg, 1.0);
+}
+
+static void
+stop(void)
+{
+	slot->time = timer_now() - start_time;
+	slot->state = LIVE_DONE;
+}
+
+Stat_Collector  stats_live = {
+	"Live statistics",
+	init,
+	start,
+	stop,
+	no_op
+};
@@ -0,0 +1,87 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef live_stat_h
+#define live_stat_h
+
+#include <stats.h>
+
+/*
+ * Layout of the live statistics file (--live-stats).  The file starts
+ * with a Live_Header followed by NUM_SLOTS slots of SLOT_SIZE bytes, one
+ * per worker process.  Each slot is written only by its worker, with
+ * plain stores and without any locking, so a reader may see a counter
+ * that is a moment ahead of another; it should add up the slots of all
+ * workers.  Counters are unsigned longs and times doubles, in the byte
+ * order of the machine running httperf.
+ *
+ * A reader must check MAGIC and VERSION.  Fields are only ever added at
+ * the end of the header or of a slot, which doesn't change the version;
+ * HEADER_SIZE and SLOT_SIZE tell where the slots and their successors
+ * start.
+ */
+#define	LIVE_MAGIC	0x6c697665	/* "live" */
+#define	LIVE_VERSION	2	/* 2: errors[] gained ERR_BACKLOG */
+
+enum Live_State {
+	LIVE_STARTING,		/* not running yet */
+	LIVE_RUNNING,
+	LIVE_DONE		/* the test is over */
+};
+
+typedef struct Live_Header {
+	u_int           magic;
+	u_int           version;
+	u_int           header_size;
+	u_int           slot_size;
+	u_int           num_slots;	/* # of workers */
+	u_int           pad;
+	double          start;	/* when the file was set up (time of day) */
+} Live_Header;
+
+typedef struct Live_Slot {
+	u_long          state;	/* enum Live_State */
+	u_long          pid;
+	double          time;	/* since the test started, once a second */
+
+	u_long          conns_new;	/* connections created */
+	u_long          conns_connected;	/* ...that got connected */
+	u_long          conns_destroyed;	/* ...that are gone again */
+	u_long          requests;	/* requests sent */
+	u_long          replies[6];	/* replies by status class 0xx..5xx */
+	u_long          request_bytes;	/* bytes of the requests sent */
+	u_long          reply_header_bytes;	/* bytes of headers received */
+	u_long          reply_body_bytes;	/* bytes of bodies and footers */
+	u_long          errors[NUM_ERRS];	/* see enum in stats.h */
+
+	u_long          sessions_new;	/* with a session workload */
+	u_long          sessions_failed;
+	u_long          sessions_destroyed;
+} Live_Slot;
+
+#endif /* live_stat_h */
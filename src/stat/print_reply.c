@@ -226,6 +226,35 @@ recv_raw_data (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
   print_reply_hdr (call, iov->iov_base, iov->iov_len);
 }
 
+/* An HTTP/2 reply has no raw header to print, so its header fields
+   are printed as they are decoded instead.  */
+static void
+recv_start (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
+{
+  Call *call;
+
+  assert (et == EV_CALL_RECV_START && object_is_call (obj));
+  call = (Call *) obj;
+
+  if (call->reply.version == 0x20000)
+    printf ("RH%ld::status: %d\n", call->id, call->reply.status);
+}
+
+static void
+recv_hdr (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
+{
+  struct iovec *line;
+  Call *call;
+
+  assert (et == EV_CALL_RECV_HDR && object_is_call (obj));
+  call = (Call *) obj;
+  line = callarg.vp;
+
+  if (call->reply.version == 0x20000)
+    printf ("RH%ld:%.*s\n", call->id, (int) line->iov_len,
+	    (char *) line->iov_base);
+}
+
 static void
 recv_data (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
 {
@@ -265,7 +294,11 @@ init (void)
   if ((param.print_request & (PRINT_HEADER | PRINT_BODY)) != 0)
     event_register_handler (EV_CALL_SEND_RAW_DATA, send_raw_data, arg);
   if ((param.print_reply & PRINT_HEADER) != 0)
-    event_register_handler (EV_CALL_RECV_RAW_DATA, recv_raw_data, arg);
+    {
+      event_register_handler (EV_CALL_RECV_RAW_DATA, recv_raw_data, arg);
+      event_register_handler (EV_CALL_RECV_START, recv_start, arg);
+      event_register_handler (EV_CALL_RECV_HDR, recv_hdr, arg);
+    }
   if ((param.print_reply & PRINT_BODY) != 0)
     event_register_handler (EV_CALL_RECV_DATA, recv_data, arg);
   if ((param.print_reply & (PRINT_HEADER | PRINT_BODY)) != 0)
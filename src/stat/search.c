@@ -0,0 +1,328 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Saturation search (--search).  Drives the offered rate while the test
+ * runs: the rate is doubled as long as the latency percentile and the
+ * error ratio stay within their bounds, then bisected between the highest
+ * rate that stayed within them and the lowest one that didn't, until the
+ * two are within SEARCH_PRECISION of each other.  Each rate is held until
+ * its latency percentile settles from one measurement interval to the
+ * next.  Latencies are response times corrected for coordinated omission
+ * (measured from when the schedule called for the request).  Between
+ * levels, no new requests are issued until those of the previous level are
+ * done; replies to them and failures of connections opened before a level
+ * began don't count toward it.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <conn.h>
+#include <call.h>
+#include <core.h>
+#include <localevent.h>
+#include <rate.h>
+#include <hist.h>
+
+#define	SEARCH_PRECISION	0.05	/* relative width of the final range */
+#define	SEARCH_SETTLED		0.1	/* relative change of a settled level */
+#define	SEARCH_MIN_INTERVALS	3	/* per level; the first is discarded */
+#define	SEARCH_MAX_INTERVALS	10
+#define	SEARCH_MAX_LEVELS	64
+
+struct level {
+	double          rate;		/* offered rate */
+	double          reply_rate;
+	Time            latency;	/* the percentile */
+	double          errors;		/* fraction of failed requests */
+	int             ok;		/* within bounds? */
+	int             settled;
+};
+
+static struct level level[SEARCH_MAX_LEVELS];
+static u_int    num_levels;
+
+static Hist     interval_hist, level_hist;
+static u_long   interval_replies, interval_errors;
+static u_long   level_replies, level_errors;
+static u_int    num_intervals;	/* of the current level */
+static Time     level_start;
+static u_long   in_flight;	/* calls that exist */
+static int      draining;	/* waiting for the previous level's calls */
+static Time     prev_latency;
+
+static double   lo;		/* highest rate within bounds (or 0) */
+static double   hi;		/* lowest rate out of bounds (or 0) */
+static int      done;
+
+static void
+start_level(void)
+{
+	hist_init(&interval_hist);
+	hist_init(&level_hist);
+	interval_replies = interval_errors = 0;
+	level_replies = level_errors = 0;
+	num_intervals = 0;
+	level_start = timer_now();
+}
+
+static void
+end_drain(void)
+{
+	draining = 0;
+	rate_generators_pause(0);
+	start_level();
+}
+
+static void
+end_level(int settled)
+{
+	struct level   *l = &level[num_levels++];
+	u_long          n;
+
+	l->rate = param.rate.rate_param;
+	l->reply_rate = level_replies
+	    / ((num_intervals - 1) * param.search.interval);
+	l->latency = hist_percentile(&level_hist, param.search.pct);
+	n = level_replies + level_errors;
+	l->errors = n > 0 ? (double) level_errors / n : 0.0;
+	l->ok = level_replies > 0 && l->latency <= param.search.max_latency
+	    && l->errors <= param.search.max_errors;
+	l->settled = settled;
+
+	if (verbose)
+		printf("%s: rate %.1f/s: p%g %.3f ms, errors %.2f%%: %s\n",
+		    prog_name, l->rate, 100 * param.search.pct,
+		    1e3 * l->latency, 100 * l->errors,
+		    l->ok ? "ok" : "out of bounds");
+
+	if (l->ok)
+		lo = l->rate;
+	else
+		hi = l->rate;
+
+	if ((lo > 0.0 && hi > 0.0 && hi - lo <= SEARCH_PRECISION * lo)
+	    || num_levels >= SEARCH_MAX_LEVELS
+	    || (lo == 0.0 && hi < 1e-3)) {
+		done = 1;
+		core_exit();
+		return;
+	}
+	if (hi == 0.0)
+		rate_set(&param.rate, 2 * lo);
+	else if (lo == 0.0)
+		rate_set(&param.rate, hi / 2);
+	else
+		rate_set(&param.rate, (lo + hi) / 2);
+
+	/*
+	 * Calls of this level would queue up ahead of those of the next one
+	 * (an overloaded server may hold seconds' worth), so hold off the
+	 * next level until they are done.
+	 */
+	if (in_flight > 0) {
+		draining = 1;
+		num_intervals = 0;
+		rate_generators_pause(1);
+	} else
+		start_level();
+}
+
+static void
+end_interval(struct Timer *t, Any_Type arg)
+{
+	Time            latency;
+	int             settled;
+
+	if (draining) {
+		/*
+		 * Calls still stuck after this long are left to time out.
+		 */
+		if (++num_intervals >= SEARCH_MAX_INTERVALS)
+			end_drain();
+		timer_schedule(end_interval, arg, param.search.interval);
+		return;
+	}
+
+	latency = hist_percentile(&interval_hist, param.search.pct);
+
+	/*
+	 * The first interval of a level is usually cut short by draining and
+	 * the server's queues still adjust to the new rate; it is discarded.
+	 */
+	if (num_intervals++ > 0) {
+		hist_merge(&level_hist, &interval_hist);
+		level_replies += interval_replies;
+		level_errors += interval_errors;
+	}
+	settled = num_intervals >= SEARCH_MIN_INTERVALS
+	    && fabs(latency - prev_latency)
+	    <= SEARCH_SETTLED * (latency > prev_latency ? latency : prev_latency);
+	prev_latency = latency;
+
+	hist_init(&interval_hist);
+	interval_replies = interval_errors = 0;
+
+	/*
+	 * A level that is far out of bounds need not settle.
+	 */
+	if (settled || num_intervals >= SEARCH_MAX_INTERVALS
+	    || (num_intervals > 1 && latency > 2 * param.search.max_latency))
+		end_level(settled);
+
+	if (!done)
+		timer_schedule(end_interval, arg, param.search.interval);
+}
+
+static void
+conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Conn           *s = (Conn *) obj;
+
+	/*
+	 * A connection that failed before it got to connect() (out of file
+	 * descriptors or local ports) has no start time; that happened now.
+	 */
+	if (s->basic.time_connect_start > 0.0
+	    && s->basic.time_connect_start < level_start)
+		return;
+	++interval_errors;
+}
+
+static void
+call_created(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	++in_flight;
+}
+
+static void
+call_destroyed(Event_Type et, Object * obj, Any_Type reg_arg,
+    Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	if (c->reply.reset && c->basic.time_intended >= level_start)
+		++interval_errors;	/* its HTTP/2 stream was reset */
+	if (--in_flight == 0 && draining)
+		end_drain();
+}
+
+static void
+recv_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_RECV_START && object_is_call(c));
+
+	if (c->basic.time_intended < level_start)
+		return;		/* issued for the previous level */
+	hist_record(&interval_hist, timer_now() - c->basic.time_intended);
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	if (c->basic.time_intended < level_start)
+		return;
+	if (c->reply.status >= 500)
+		++interval_errors;
+	else
+		++interval_replies;
+}
+
+static void
+init(void)
+{
+	Any_Type        arg;
+
+	hist_init(&interval_hist);
+	hist_init(&level_hist);
+
+	arg.l = 0;
+	event_register_handler(EV_CONN_FAILED, conn_fail, arg);
+	event_register_handler(EV_CONN_TIMEOUT, conn_fail, arg);
+	event_register_handler(EV_CALL_RECV_START, recv_start, arg);
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+	event_register_handler(EV_CALL_NEW, call_created, arg);
+	event_register_handler(EV_CALL_DESTROYED, call_destroyed, arg);
+}
+
+static void
+start(void)
+{
+	Any_Type        arg;
+
+	arg.l = 0;
+	timer_schedule(end_interval, arg, param.search.interval);
+}
+
+static void
+dump(void)
+{
+	u_int           i;
+
+	printf("\nSearch: p%g <= %.3f ms, errors <= %.2f%%\n",
+	    100 * param.search.pct, 1e3 * param.search.max_latency,
+	    100 * param.search.max_errors);
+	printf("Search: %10s %13s %10s %10s\n", "rate [1/s]", "replies [1/s]",
+	    "p [ms]", "errors [%]");
+	for (i = 0; i < num_levels; ++i)
+		printf("Search: %10.1f %13.1f %10.3f %10.2f  %s%s\n",
+		    level[i].rate, level[i].reply_rate, 1e3 * level[i].latency,
+		    100 * level[i].errors, level[i].ok ? "ok" : "over",
+		    level[i].settled ? "" : " (unsettled)");
+	if (lo > 0.0)
+		printf("Search: max. rate within bounds %.1f/s\n", lo);
+	else
+		printf("Search: no rate was within bounds\n");
+	if (!done)
+		printf("Search: the test ended before the search was done\n");
+}
+
+Stat_Collector  stats_search = {
+	"Saturation search",
+	init,
+	start,
+	no_op,
+	dump
+};
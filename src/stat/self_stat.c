@@ -0,0 +1,221 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Self statistics collector.  Reports how busy httperf itself was: CPU
+ * utilisation, how late its timers fired, how long each event loop
+ * iteration ran and how many events a wakeup brought in, and the time
+ * spent in each system call.  These are only printed with --self-stats,
+ * but the timer lag is always checked: if timers fire late, httperf
+ * could not keep up with the requested load and the results describe
+ * the client rather than the server, so a warning is printed.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <generic_types.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <stats.h>
+#include <self_stat.h>
+
+/*
+ * The 99th percentile of the timer lag above which the client is
+ * considered saturated.
+ */
+#define	SATURATION_LAG	10e-3
+
+Self_Stats      self_stats;
+
+static const char *const syscall_name[SC_NUM_SYSCALLS] = {
+	"bind", "connect", "read", "select", "socket", "writev",
+	"ssl_read", "ssl_writev", "kevent", "epoll_wait", "io_uring_enter",
+	"sendfile"
+};
+
+static void
+init(void)
+{
+	int             i;
+
+	for (i = 0; i < SC_NUM_SYSCALLS; ++i)
+		hist_small_init(&self_stats.syscall[i]);
+	hist_init(&self_stats.timer_lag);
+	hist_init(&self_stats.loop_busy);
+}
+
+/*
+ * The source addresses and lookups describe the setup rather than the
+ * load, so they stay.
+ */
+static void
+reset(void)
+{
+	init();
+	self_stats.num_wakeups = self_stats.num_idle_wakeups = 0;
+	self_stats.num_ready = self_stats.max_ready = 0;
+}
+
+static void
+print_percentiles(const char *label, const Hist *h)
+{
+	printf("%s p50 %.3f p90 %.3f p99 %.3f p99.9 %.3f max %.3f\n", label,
+	       1e3 * hist_percentile(h, 0.5), 1e3 * hist_percentile(h, 0.9),
+	       1e3 * hist_percentile(h, 0.99), 1e3 * hist_percentile(h, 0.999),
+	       1e3 * hist_percentile(h, 1.0));
+}
+
+static void
+dump(void)
+{
+	const Hist_Small *h;
+	Time            delta, cpu, lag;
+	int             i;
+
+	if (param.self_stats) {
+		delta = test_time_stop - test_time_start;
+		cpu = (TV_TO_SEC(test_rusage_stop.ru_utime)
+		    - TV_TO_SEC(test_rusage_start.ru_utime)
+		    + TV_TO_SEC(test_rusage_stop.ru_stime)
+		    - TV_TO_SEC(test_rusage_start.ru_stime));
+		printf("\nSelf: CPU utilisation %.1f%% per process\n",
+		       delta > 0 ? 100.0 * cpu / delta / param.workers : 0.0);
+		print_percentiles("Self: timer lag [ms]:",
+				  &self_stats.timer_lag);
+		print_percentiles("Self: loop busy [ms]:",
+				  &self_stats.loop_busy);
+		printf("Self: wakeups %llu idle %.1f%% ready events/wakeup "
+		       "avg %.2f max %llu\n",
+		       (unsigned long long) self_stats.num_wakeups,
+		       self_stats.num_wakeups > 0
+		       ? 100.0 * self_stats.num_idle_wakeups
+		       / self_stats.num_wakeups : 0.0,
+		       self_stats.num_wakeups > 0
+		       ? (double) self_stats.num_ready
+		       / self_stats.num_wakeups : 0.0,
+		       (unsigned long long) self_stats.max_ready);
+		for (i = 0; i < SC_NUM_SYSCALLS; ++i) {
+			h = &self_stats.syscall[i];
+			if (h->s.count == 0)
+				continue;
+			printf("Self: syscall [us]: %-14s calls %llu p50 %.1f "
+			       "p99 %.1f max %.1f\n", syscall_name[i],
+			       (unsigned long long) h->s.count,
+			       1e6 * hist_small_percentile(h, 0.5),
+			       1e6 * hist_small_percentile(h, 0.99),
+			       1e6 * hist_small_percentile(h, 1.0));
+		}
+		if (param.dns_refresh > 0.0)
+			printf("Self: DNS lookups %llu failed %llu "
+			       "address-changes %llu\n",
+			       (unsigned long long) self_stats.num_lookups,
+			       (unsigned long long)
+			       self_stats.num_lookup_failures,
+			       (unsigned long long)
+			       self_stats.num_addr_changes);
+		if (self_stats.num_sources > 1
+		    || self_stats.source[0].num_exhausted > 0)
+			for (i = 0; i < self_stats.num_sources; ++i)
+				printf("Self: source %-15s conns %llu "
+				       "max-open %llu out-of-ports %llu\n",
+				       inet_ntoa(self_stats.source[i].ip),
+				       (unsigned long long)
+				       self_stats.source[i].num_conns,
+				       (unsigned long long)
+				       self_stats.source[i].max_open,
+				       (unsigned long long)
+				       self_stats.source[i].num_exhausted);
+	}
+
+	lag = hist_percentile(&self_stats.timer_lag, 0.99);
+	if (lag > SATURATION_LAG)
+		printf("\nWarning: client saturated, results invalid: 1%% of "
+		       "timers fired more than %.1f ms late (max %.1f ms).\n"
+		       "Warning: use more --workers or a lower rate.\n",
+		       1e3 * lag,
+		       1e3 * hist_percentile(&self_stats.timer_lag, 1.0));
+}
+
+static const void *
+export(size_t *len)
+{
+	*len = sizeof(self_stats);
+	return &self_stats;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const Self_Stats *o = buf;
+	int             i;
+
+	assert(len == sizeof(self_stats));
+	for (i = 0; i < SC_NUM_SYSCALLS; ++i)
+		hist_small_merge(&self_stats.syscall[i], &o->syscall[i]);
+	hist_merge(&self_stats.timer_lag, &o->timer_lag);
+	hist_merge(&self_stats.loop_busy, &o->loop_busy);
+	self_stats.num_wakeups += o->num_wakeups;
+	self_stats.num_idle_wakeups += o->num_idle_wakeups;
+	self_stats.num_ready += o->num_ready;
+	if (o->max_ready > self_stats.max_ready)
+		self_stats.max_ready = o->max_ready;
+	self_stats.num_lookups += o->num_lookups;
+	self_stats.num_lookup_failures += o->num_lookup_failures;
+	self_stats.num_addr_changes += o->num_addr_changes;
+	/*
+	 * Workers use the same source addresses; those of agents on other
+	 * hosts are left out.  The peaks are added up, which bounds the
+	 * combined peak from above.
+	 */
+	for (i = 0; i < o->num_sources && i < self_stats.num_sources; ++i) {
+		if (o->source[i].ip.s_addr != self_stats.source[i].ip.s_addr)
+			continue;
+		self_stats.source[i].num_conns += o->source[i].num_conns;
+		self_stats.source[i].max_open += o->source[i].max_open;
+		self_stats.source[i].num_exhausted +=
+		    o->source[i].num_exhausted;
+	}
+}
+
+Stat_Collector  stats_self = {
+	"Self statistics",
+	init,
+	no_op,
+	no_op,
+	dump,
+	export,
+	merge,
+	reset
+};
@@ -0,0 +1,76 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef self_stat_h
+#define self_stat_h
+
+#include <netinet/in.h>
+
+#include <hist.h>
+
+/*
+ * httperf's measurements of itself.  The core and the timer code record
+ * into SELF_STATS directly; the self statistics collector initialises,
+ * merges and reports them.  Timer lag is always recorded since it costs
+ * no extra clock reads; the rest only with --self-stats.
+ */
+enum Syscalls {
+	SC_BIND, SC_CONNECT, SC_READ, SC_SELECT, SC_SOCKET, SC_WRITEV,
+	SC_SSL_READ, SC_SSL_WRITEV, SC_KEVENT, SC_EPOLL_WAIT,
+	SC_IO_URING_ENTER, SC_SENDFILE, SC_NUM_SYSCALLS
+};
+
+/*
+ * Source addresses (see --myaddr) beyond this many are used but not
+ * reported on.
+ */
+#define	SELF_MAX_SOURCES	256
+
+typedef struct Self_Stats {
+	Hist_Small      syscall[SC_NUM_SYSCALLS];	/* time per call */
+	Hist            timer_lag;	/* how late timers fired */
+	Hist            loop_busy;	/* time from wakeup to next wait */
+	u_wide          num_wakeups;	/* # of returns from waiting */
+	u_wide          num_idle_wakeups;	/* # of those with no event */
+	u_wide          num_ready;	/* # of events over all wakeups */
+	u_wide          max_ready;	/* most events in one wakeup */
+	u_wide          num_lookups;	/* # of server address lookups */
+	u_wide          num_lookup_failures;	/* # of those that failed */
+	u_wide          num_addr_changes;	/* # that found a new address */
+	u_int           num_sources;	/* # of source addresses */
+	struct {
+		struct in_addr  ip;
+		u_wide          num_conns;	/* # of sockets bound to it */
+		u_wide          max_open;	/* most of those open at once */
+		u_wide          num_exhausted;	/* # of times out of ports */
+	}               source[SELF_MAX_SOURCES];
+} Self_Stats;
+
+extern Self_Stats self_stats;
+
+#endif /* self_stat_h */
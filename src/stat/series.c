@@ -0,0 +1,404 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Time-series statistics collector (--series).  At the end of every rate
+ * sampling interval, this writes one record with the interval's reply
+ * rate, replies and errors by class, connection concurrency and response
+ * time percentiles.  The event loop just copies the record into a
+ * preallocated ring; a separate thread formats and writes it, so a slow
+ * disk never holds up the test.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <conn.h>
+#include <localevent.h>
+#include <worker.h>
+#include <stats.h>
+#include <hist.h>
+
+/*
+ * Number of records that may be waiting to be written.  If the writer
+ * falls this far behind, new records are dropped (and counted) rather
+ * than stalling the event loop.
+ */
+#define	SERIES_RING	256
+
+static const double pct[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+static const char *const pct_name[] = {"p50", "p90", "p99", "p99.9", "max"};
+
+#define	NUM_PCTS	NELEMS(pct)
+
+struct series_rec {
+	Time            time;	/* end of the interval since test start */
+	double          reply_rate;
+	u_long          num_replies[6];	/* per status class */
+	u_long          num_errors[NUM_ERRS];
+	u_long          num_conns;	/* open connections at the end */
+	u_long          max_conns;	/* max. open connections */
+	Time            service[NUM_PCTS];	/* response time percentiles */
+	Time            corrected[NUM_PCTS];
+};
+
+static FILE    *out;
+static struct series_rec cur;	/* the interval being collected */
+static Hist     service_hist, corrected_hist;
+static Time     series_start;	/* not test_time_start, which --warmup
+				 * moves */
+static Time     interval_start;
+static u_long   num_interval_replies;
+static u_long   num_dropped;
+
+static struct series_rec ring[SERIES_RING];
+static u_int    ring_head;	/* next record to fill */
+static u_int    ring_tail;	/* next record to write */
+
+#ifdef HAVE_PTHREAD_H
+static pthread_t writer;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_cond = PTHREAD_COND_INITIALIZER;
+static int      closing;
+#endif
+
+static void
+write_header(void)
+{
+	u_int           i;
+
+	if (param.series.json)
+		return;
+
+	fprintf(out, "time,reply_rate");
+	for (i = 1; i < NELEMS(cur.num_replies); ++i)
+		fprintf(out, ",replies_%uxx", i);
+	fprintf(out, ",conns,max_conns");
+	for (i = 0; i < NUM_ERRS; ++i)
+		fprintf(out, ",%s", stats_error_name[i]);
+	for (i = 0; i < NUM_PCTS; ++i)
+		fprintf(out, ",service_%s", pct_name[i]);
+	for (i = 0; i < NUM_PCTS; ++i)
+		fprintf(out, ",corrected_%s", pct_name[i]);
+	fprintf(out, "\n");
+}
+
+static void
+write_record(const struct series_rec *r)
+{
+	u_int           i;
+
+	if (!param.series.json) {
+		fprintf(out, "%.3f,%.1f", r->time, r->reply_rate);
+		for (i = 1; i < NELEMS(r->num_replies); ++i)
+			fprintf(out, ",%lu", r->num_replies[i]);
+		fprintf(out, ",%lu,%lu", r->num_conns, r->max_conns);
+		for (i = 0; i < NUM_ERRS; ++i)
+			fprintf(out, ",%lu", r->num_errors[i]);
+		for (i = 0; i < NUM_PCTS; ++i)
+			fprintf(out, ",%.3f", 1e3 * r->service[i]);
+		for (i = 0; i < NUM_PCTS; ++i)
+			fprintf(out, ",%.3f", 1e3 * r->corrected[i]);
+		fprintf(out, "\n");
+		return;
+	}
+
+	fprintf(out, "{\"time\":%.3f,\"reply_rate\":%.1f,\"replies\":{",
+	    r->time, r->reply_rate);
+	for (i = 1; i < NELEMS(r->num_replies); ++i)
+		fprintf(out, "%s\"%uxx\":%lu", i > 1 ? "," : "", i,
+		    r->num_replies[i]);
+	fprintf(out, "},\"conns\":%lu,\"max_conns\":%lu,\"errors\":{",
+	    r->num_conns, r->max_conns);
+	for (i = 0; i < NUM_ERRS; ++i)
+		fprintf(out, "%s\"%s\":%lu", i > 0 ? "," : "", stats_error_name[i],
+		    r->num_errors[i]);
+	fprintf(out, "},\"service\":{");
+	for (i = 0; i < NUM_PCTS; ++i)
+		fprintf(out, "%s\"%s\":%.3f", i > 0 ? "," : "", pct_name[i],
+		    1e3 * r->service[i]);
+	fprintf(out, "},\"corrected\":{");
+	for (i = 0; i < NUM_PCTS; ++i)
+		fprintf(out, "%s\"%s\":%.3f", i > 0 ? "," : "", pct_name[i],
+		    1e3 * r->corrected[i]);
+	fprintf(out, "}}\n");
+}
+
+#ifdef HAVE_PTHREAD_H
+
+static void    *
+writer_main(void *arg)
+{
+	struct series_rec r;
+	int             drained;
+
+	pthread_mutex_lock(&ring_lock);
+	for (;;) {
+		while (ring_tail == ring_head && !closing)
+			pthread_cond_wait(&ring_cond, &ring_lock);
+		if (ring_tail == ring_head)
+			break;
+		r = ring[ring_tail % SERIES_RING];
+		++ring_tail;
+		/*
+		 * ring_head belongs to the producer, so whether this was the
+		 * last record for now has to be decided under the lock.
+		 */
+		drained = ring_tail == ring_head;
+		pthread_mutex_unlock(&ring_lock);
+
+		write_record(&r);
+		if (drained)
+			fflush(out);
+
+		pthread_mutex_lock(&ring_lock);
+	}
+	pthread_mutex_unlock(&ring_lock);
+	return NULL;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+/*
+ * Hands record R to the writer.
+ */
+static void
+put_record(const struct series_rec *r)
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ring_lock);
+	if (ring_head - ring_tail < SERIES_RING) {
+		ring[ring_head % SERIES_RING] = *r;
+		++ring_head;
+		pthread_cond_signal(&ring_cond);
+	} else
+		++num_dropped;
+	pthread_mutex_unlock(&ring_lock);
+#else
+	write_record(r);
+	fflush(out);
+#endif
+}
+
+/*
+ * Completes the current interval (of length DELTA seconds) and starts
+ * the next one.
+ */
+static void
+end_interval(Time delta)
+{
+	u_int           i;
+
+	cur.time = timer_now() - series_start;
+	cur.reply_rate = delta > 0.0 ? num_interval_replies / delta : 0.0;
+	for (i = 0; i < NUM_PCTS; ++i) {
+		cur.service[i] = hist_percentile(&service_hist, pct[i]);
+		cur.corrected[i] = hist_percentile(&corrected_hist, pct[i]);
+	}
+	put_record(&cur);
+
+	memset(cur.num_replies, 0, sizeof(cur.num_replies));
+	memset(cur.num_errors, 0, sizeof(cur.num_errors));
+	cur.max_conns = cur.num_conns;
+	hist_init(&service_hist);
+	hist_init(&corrected_hist);
+	num_interval_replies = 0;
+	interval_start = timer_now();
+}
+
+/*
+ * A new epoch (see --warmup) ends the current interval early, so that
+ * the records from then on hold nothing from before it.
+ */
+static void
+reset(void)
+{
+	if (timer_now() > interval_start)
+		end_interval(timer_now() - interval_start);
+}
+
+static void
+perf_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	assert(et == EV_PERF_SAMPLE);
+
+	end_interval(1.0 / call_arg.d);
+}
+
+static void
+conn_created(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type c_arg)
+{
+	if (++cur.num_conns > cur.max_conns)
+		cur.max_conns = cur.num_conns;
+}
+
+static void
+conn_destroyed(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type c_arg)
+{
+	assert(et == EV_CONN_DESTROYED && cur.num_conns > 0);
+
+	--cur.num_conns;
+}
+
+static void
+conn_fail(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	assert(et == EV_CONN_FAILED);
+
+	++cur.num_errors[stats_error_class(call_arg.i)];
+}
+
+static void
+recv_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Time            now;
+
+	assert(et == EV_CALL_RECV_START && object_is_call(c));
+
+	if (c->basic.epoch != test_epoch)
+		return;		/* sent before the last epoch began */
+	now = timer_now();
+	hist_record(&service_hist, now - c->basic.time_send_start);
+	hist_record(&corrected_hist, now - c->basic.time_intended);
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	u_int           index;
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	if (c->basic.epoch != test_epoch)
+		return;
+	index = c->reply.status / 100;
+	assert(index < NELEMS(cur.num_replies));
+	++cur.num_replies[index];
+	++num_interval_replies;
+}
+
+static void
+init(void)
+{
+	char            name[1024];
+	const char     *file = param.series.file;
+	Any_Type        arg;
+
+	/*
+	 * Each worker writes its own series.
+	 */
+	if (param.workers > 1) {
+		snprintf(name, sizeof(name), "%s.%d", file, worker_id);
+		file = name;
+	}
+	out = fopen(file, "w");
+	if (!out) {
+		fprintf(stderr, "%s: can't open %s: %s\n",
+		    prog_name, file, strerror(errno));
+		exit(1);
+	}
+	write_header();
+
+	hist_init(&service_hist);
+	hist_init(&corrected_hist);
+
+	arg.l = 0;
+	event_register_handler(EV_PERF_SAMPLE, perf_sample, arg);
+	event_register_handler(EV_CONN_FAILED, conn_fail, arg);
+	event_register_counter(EV_CONN_TIMEOUT, &cur.num_errors[ERR_CLIENT_TIMO]);
+	event_register_handler(EV_CONN_NEW, conn_created, arg);
+	event_register_handler(EV_CONN_DESTROYED, conn_destroyed, arg);
+	event_register_handler(EV_CALL_RECV_START, recv_start, arg);
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+
+#ifdef HAVE_PTHREAD_H
+	if ((errno = pthread_create(&writer, NULL, writer_main, NULL)) != 0) {
+		fprintf(stderr, "%s: can't start series writer: %s\n",
+		    prog_name, strerror(errno));
+		exit(1);
+	}
+#endif
+}
+
+static void
+start(void)
+{
+	series_start = interval_start = timer_now();
+}
+
+static void
+stop(void)
+{
+	/*
+	 * Write out what was collected since the last sample and wait
+	 * for the writer to catch up.
+	 */
+	if (timer_now() > interval_start)
+		end_interval(timer_now() - interval_start);
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ring_lock);
+	closing = 1;
+	pthread_cond_signal(&ring_cond);
+	pthread_mutex_unlock(&ring_lock);
+	pthread_join(writer, NULL);
+#endif
+	if (fclose(out) != 0)
+		fprintf(stderr, "%s: error writing %s: %s\n",
+		    prog_name, param.series.file, strerror(errno));
+	if (num_dropped > 0)
+		fprintf(stderr, "%s: %lu time-series records dropped\n",
+		    prog_name, num_dropped);
+}
+
+Stat_Collector  stats_series = {
+	"Time-series statistics",
+	init,
+	start,
+	stop,
+	no_op,
+	NULL,
+	NULL,
+	reset
+};
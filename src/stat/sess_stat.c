@@ -52,7 +52,7 @@
 #include <session.h>
 #include <stats.h>
 
-static struct
+static struct sess_stats
   {
     u_int num_rate_samples;
     u_int num_completed_since_last_sample;
@@ -60,6 +60,7 @@ static struct
     Time rate_sum2;
     Time rate_min;
     Time rate_max;
+    Time rate[MAX_RATE_SAMPLES];	/* the samples */
 
     u_int num_completed;
     Time lifetime_sum;
@@ -84,6 +85,7 @@ typedef struct Sess_Private_Data
     u_int num_calls_completed;	/* how many calls completed? */
     u_int num_conns;		/* # of connections on this session */
     Time birth_time;		/* when this session got created */
+    u_int epoch;		/* test_epoch at that time */
   }
 Sess_Private_Data;
 
@@ -104,6 +106,8 @@ perf_sample (Event_Type et, Object *obj, Any_Type reg_arg, Any_Type call_arg)
   if (verbose)
     printf ("session-rate = %-8.1f\n", rate);
 
+  if (st.num_rate_samples < MAX_RATE_SAMPLES)
+    st.rate[st.num_rate_samples] = rate;
   ++st.num_rate_samples;
   st.rate_sum += rate;
   st.rate_sum2 += SQUARE (rate);
@@ -123,12 +127,35 @@ sess_created (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
   sess = (Sess *) obj;
   priv = SESS_PRIVATE_DATA (sess);
   priv->birth_time = timer_now ();
+  priv->epoch = test_epoch;
 }
 
+/* Make room in the session-length histogram for sessions of length
+   LEN.  */
 static void
-sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
+len_hist_grow (u_int len)
 {
   size_t old_size, new_size;
+
+  if (len < st.len_hist_alloced)
+    return;
+
+  old_size = st.len_hist_alloced*sizeof (st.len_hist[0]);
+  st.len_hist_alloced = len + 16;
+  new_size = st.len_hist_alloced*sizeof (st.len_hist[0]);
+
+  st.len_hist = realloc (st.len_hist, new_size);
+  if (!st.len_hist)
+    {
+      fprintf (stderr, "%s.sess_stat: Out of memory\n", prog_name);
+      exit (1);
+    }
+  memset ((char *) st.len_hist + old_size, 0, new_size - old_size);
+}
+
+static void
+sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
+{
   Sess_Private_Data *priv;
   Sess *sess;
   Time delta, now = timer_now ();
@@ -137,6 +164,10 @@ sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
   sess = (Sess *) obj;
   priv = SESS_PRIVATE_DATA (sess);
 
+  /* sessions begun before the last epoch don't count */
+  if (priv->epoch != test_epoch)
+    return;
+
   delta = (now - priv->birth_time);
   if (sess->failed)
     {
@@ -154,21 +185,7 @@ sess_destroyed (Event_Type et, Object *obj, Any_Type regarg, Any_Type callarg)
   if (priv->num_calls_completed > st.longest_session)
     {
       st.longest_session = priv->num_calls_completed;
-
-      if (st.longest_session >= st.len_hist_alloced)
-	{
-	  old_size = st.len_hist_alloced*sizeof (st.len_hist[0]);
-	  st.len_hist_alloced = st.longest_session + 16;
-	  new_size = st.len_hist_alloced*sizeof (st.len_hist[0]);
-
-	  st.len_hist = realloc (st.len_hist, new_size);
-	  if (!st.len_hist)
-	    {
-	      fprintf (stderr, "%s.sess_stat: Out of memory\n", prog_name);
-	      exit (1);
-	    }
-	  memset ((char *) st.len_hist + old_size, 0, new_size - old_size);
-	}
+      len_hist_grow (st.longest_session);
     }
   ++st.len_hist[priv->num_calls_completed];
 }
@@ -231,6 +248,19 @@ init (void)
   event_register_handler (EV_CALL_RECV_STOP, call_done, arg);
 }
 
+static void
+reset (void)
+{
+  u_int *len_hist = st.len_hist;
+  u_int len_hist_alloced = st.len_hist_alloced;
+
+  memset (&st, 0, sizeof (st));
+  st.len_hist = len_hist;
+  st.len_hist_alloced = len_hist_alloced;
+  memset (st.len_hist, 0, len_hist_alloced*sizeof (st.len_hist[0]));
+  st.rate_min = DBL_MAX;
+}
+
 static void
 dump (void)
 {
@@ -273,11 +303,94 @@ dump (void)
   putchar ('\n');
 }
 
+/* The exported state is ST followed by the session-length
+   histogram.  */
+static const void *
+export (size_t *len)
+{
+  static char *buf;
+  size_t hist_size;
+
+  hist_size = (st.longest_session + 1)*sizeof (st.len_hist[0]);
+  *len = sizeof (st) + hist_size;
+  free (buf);
+  buf = malloc (*len);
+  if (!buf)
+    {
+      fprintf (stderr, "%s.sess_stat: Out of memory\n", prog_name);
+      exit (1);
+    }
+  memcpy (buf, &st, sizeof (st));
+  memcpy (buf + sizeof (st), st.len_hist, hist_size);
+  return buf;
+}
+
+static void
+merge (const void *buf, size_t len)
+{
+  const struct sess_stats *o = buf;
+  const u_int *hist = (const u_int *) ((const char *) buf + sizeof (st));
+  u_int i, n;
+
+  assert (len == sizeof (st) + (o->longest_session + 1)*sizeof (hist[0]));
+
+  /* as in basic.c, the i-th rate samples of all workers are added */
+  if (st.num_rate_samples <= MAX_RATE_SAMPLES
+      && o->num_rate_samples <= MAX_RATE_SAMPLES)
+    {
+      for (i = 0; i < o->num_rate_samples; ++i)
+	st.rate[i] += o->rate[i];
+      n = st.num_rate_samples;
+      if (o->num_rate_samples > n)
+	n = o->num_rate_samples;
+      st.num_rate_samples = n;
+      st.rate_sum = st.rate_sum2 = 0.0;
+      st.rate_min = DBL_MAX;
+      st.rate_max = 0.0;
+      for (i = 0; i < n; ++i)
+	{
+	  st.rate_sum += st.rate[i];
+	  st.rate_sum2 += SQUARE (st.rate[i]);
+	  if (st.rate[i] < st.rate_min)
+	    st.rate_min = st.rate[i];
+	  if (st.rate[i] > st.rate_max)
+	    st.rate_max = st.rate[i];
+	}
+    }
+  else
+    {
+      st.num_rate_samples += o->num_rate_samples;
+      st.rate_sum += o->rate_sum;
+      st.rate_sum2 += o->rate_sum2;
+      if (o->rate_min < st.rate_min)
+	st.rate_min = o->rate_min;
+      if (o->rate_max > st.rate_max)
+	st.rate_max = o->rate_max;
+    }
+
+  st.num_completed += o->num_completed;
+  st.lifetime_sum += o->lifetime_sum;
+  st.num_failed += o->num_failed;
+  st.failtime_sum += o->failtime_sum;
+  st.num_conns += o->num_conns;
+
+  if (o->longest_session > st.longest_session)
+    {
+      st.longest_session = o->longest_session;
+      len_hist_grow (st.longest_session);
+    }
+  for (i = 0; i <= o->longest_session; ++i)
+    st.len_hist[i] += hist[i];
+}
+
 Stat_Collector session_stat =
   {
     "collects session-related statistics",
     init,
     no_op,
     no_op,
-    dump
+    dump,
+    export,
+    merge,
+    reset
   };
@@ -0,0 +1,79 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Helpers shared by the statistics collectors.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+
+#include <generic_types.h>
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <stats.h>
+
+const char *const stats_error_name[NUM_ERRS] = {
+	"client_timo", "socket_timo", "connrefused", "connreset",
+	"fd_unavail", "addrunavail", "ftab_full", "backlog_full", "other"
+};
+
+int
+stats_error_class(int err)
+{
+	switch (err) {
+#ifdef __linux__
+	case EINVAL:		/* Linux's way of saying "out of fds" */
+#endif
+	case EMFILE:
+		return ERR_FD_UNAVAIL;
+	case ENFILE:
+		return ERR_FTAB_FULL;
+	case ECONNREFUSED:
+		return ERR_REFUSED;
+	case ETIMEDOUT:
+		return ERR_SOCK_TIMO;
+	case EPIPE:
+	case ECONNRESET:
+		return ERR_RESET;
+	case EADDRNOTAVAIL:
+		return ERR_ADDR_UNAVAIL;
+	}
+	/*
+	 * A Unix domain socket with nothing at its path fails connect() with
+	 * ENOENT, and one whose backlog is full with EAGAIN; over TCP, EAGAIN
+	 * means we ran out of local ports.
+	 */
+	if (param.unix_socket && err == ENOENT)
+		return ERR_REFUSED;
+	if (param.unix_socket && err == EAGAIN)
+		return ERR_BACKLOG;
+	return ERR_OTHER;
+}
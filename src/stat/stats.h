@@ -40,4 +40,31 @@
 #define VAR(s,s2,n)	(((n) < 2) ? 0.0 : ((s2) - SQUARE(s)/(n)) / ((n) - 1))
 #define STDDEV(s,s2,n)	(((n) < 2) ? 0.0 : sqrt (VAR ((s), (s2), (n))))
 
+/* Number of rate samples that are remembered individually.  When the
+   results of several worker processes are merged, the i-th samples of
+   all workers are added up.  */
+#define MAX_RATE_SAMPLES	4096
+
+/* Classes of errors, as in the "Errors" lines of the basic statistics.  */
+enum
+  {
+    ERR_CLIENT_TIMO,
+    ERR_SOCK_TIMO,
+    ERR_REFUSED,
+    ERR_RESET,
+    ERR_FD_UNAVAIL,
+    ERR_ADDR_UNAVAIL,
+    ERR_FTAB_FULL,
+    ERR_BACKLOG,
+    ERR_OTHER,
+    NUM_ERRS
+  };
+
+/* Short names of the error classes (e.g., "connrefused").  */
+extern const char *const stats_error_name[NUM_ERRS];
+
+/* Returns the class of a connection that failed with errno ERR
+   (EV_CONN_FAILED).  */
+extern int stats_error_class (int err);
+
 #endif /* stats_h */
@@ -0,0 +1,344 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Per-URI statistics collector (--uri-stats).  Requests, replies by
+ * status class, bytes and a small response time histogram are kept for
+ * every URI, and the busiest URIs are reported at the end.
+ *
+ * URIs are interned once into a fixed-size table and referred to by
+ * key, so that a call whose generator knows the key costs a single
+ * array lookup.  Memory is bounded: once the table is full, any further
+ * URIs are counted under "(other)".
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <localevent.h>
+#include <stats.h>
+#include <hist.h>
+
+#define	URI_MAX_KEYS	4096		/* max. # of distinct URIs */
+#define	URI_POOL_SIZE	(256*1024)	/* room for the URI strings */
+#define	URI_HASH_SIZE	(2*URI_MAX_KEYS)	/* must be a power of two */
+
+#define	OTHER_KEY	1
+#define	OTHER_NAME	"(other)"
+
+struct uri_entry {
+	u_int           name;	/* offset of the URI in the string pool */
+	u_int           name_len;
+	u_long          num_sent;	/* # of requests sent */
+	u_long          num_replies[6];	/* # of replies per status class */
+	u_wide          reply_bytes;	/* header, content and footer bytes */
+	Hist_Small      response;	/* response (first byte) times */
+};
+
+/*
+ * The state that gets shipped between --workers: the first NUM_KEYS
+ * entries followed by the first POOL_LEN bytes of the string pool.
+ */
+struct uri_export {
+	u_int           num_keys;
+	u_int           pool_len;
+};
+
+static int      enabled;
+static u_int    num_keys = 1;	/* key 0 means "no key" */
+static struct uri_entry *entry;	/* indexed by key */
+static u_int    pool_len;
+static char    *pool;
+static u_int    hash_table[URI_HASH_SIZE];	/* keys, 0 is empty */
+
+static u_int
+hash(const char *uri, size_t len)
+{
+	u_int           h = 2166136261u;
+
+	while (len-- > 0)
+		h = (h ^ (u_char) * uri++) * 16777619u;
+	return h;
+}
+
+static u_int
+new_key(const char *uri, size_t len)
+{
+	struct uri_entry *e;
+
+	if (num_keys >= URI_MAX_KEYS || len > URI_POOL_SIZE - pool_len)
+		return 0;
+
+	e = &entry[num_keys];
+	e->name = pool_len;
+	e->name_len = len;
+	hist_small_init(&e->response);
+	memcpy(pool + pool_len, uri, len);
+	pool_len += len;
+	return num_keys++;
+}
+
+u_int
+uri_stat_key(const char *uri, size_t uri_len)
+{
+	struct uri_entry *e;
+	u_int           i, key;
+
+	if (!enabled)
+		return 0;
+
+	for (i = hash(uri, uri_len) & (URI_HASH_SIZE - 1);; i = (i + 1)
+	    & (URI_HASH_SIZE - 1)) {
+		key = hash_table[i];
+		if (key == 0)
+			break;
+		e = &entry[key];
+		if (e->name_len == uri_len
+		    && memcmp(pool + e->name, uri, uri_len) == 0)
+			return key;
+	}
+	/*
+	 * Hash table holds at most half as many keys as it has slots, so
+	 * there always is an empty one.
+	 */
+	key = new_key(uri, uri_len);
+	if (key == 0)
+		return OTHER_KEY;
+	hash_table[i] = key;
+	return key;
+}
+
+static struct uri_entry *
+call_entry(Call * c)
+{
+	if (c->uri_key == 0)
+		c->uri_key = uri_stat_key(c->req.iov[IE_URI].iov_base,
+		    c->req.iov[IE_URI].iov_len);
+	assert(c->uri_key < num_keys);
+	return &entry[c->uri_key];
+}
+
+static void
+send_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	struct uri_entry *e;
+
+	assert(et == EV_CALL_SEND_STOP && object_is_call(c));
+
+	if (c->basic.epoch != test_epoch)
+		return;		/* sent before the last epoch began */
+	e = call_entry(c);
+	++e->num_sent;
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	struct uri_entry *e;
+	u_int           index;
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	if (c->basic.epoch != test_epoch)
+		return;
+	e = call_entry(c);
+	index = c->reply.status / 100;
+	assert(index < NELEMS(e->num_replies));
+	++e->num_replies[index];
+	e->reply_bytes += (c->reply.header_bytes + c->reply.content_bytes
+	    + c->reply.footer_bytes);
+	hist_small_record(&e->response,
+	    c->basic.time_recv_start - c->basic.time_send_start);
+}
+
+static void
+init(void)
+{
+	Any_Type        arg;
+
+	entry = calloc(URI_MAX_KEYS, sizeof(*entry));
+	pool = malloc(URI_POOL_SIZE);
+	if (!entry || !pool) {
+		fprintf(stderr, "%s: out of memory for per-URI statistics\n",
+		    prog_name);
+		exit(1);
+	}
+	enabled = 1;
+	/*
+	 * The overflow bucket is not in the hash table.
+	 */
+	new_key(OTHER_NAME, strlen(OTHER_NAME));
+
+	arg.l = 0;
+	event_register_handler(EV_CALL_SEND_STOP, send_stop, arg);
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+}
+
+/*
+ * Keeps the URIs seen so far (and so their keys), but not their counts.
+ */
+static void
+reset(void)
+{
+	u_int           i;
+
+	for (i = 1; i < num_keys; ++i) {
+		entry[i].num_sent = 0;
+		memset(entry[i].num_replies, 0, sizeof(entry[i].num_replies));
+		entry[i].reply_bytes = 0;
+		hist_small_init(&entry[i].response);
+	}
+}
+
+static int
+cmp_sent(const void *a, const void *b)
+{
+	const struct uri_entry *ea = &entry[*(const u_int *) a];
+	const struct uri_entry *eb = &entry[*(const u_int *) b];
+
+	if (ea->num_sent != eb->num_sent)
+		return ea->num_sent < eb->num_sent ? 1 : -1;
+	return 0;
+}
+
+static void
+dump(void)
+{
+	struct uri_entry *e;
+	u_int          *order, i, n;
+	u_long          num_replies;
+
+	order = malloc(num_keys * sizeof(*order));
+	if (!order)
+		return;
+	n = 0;
+	for (i = OTHER_KEY; i < num_keys; ++i)
+		if (entry[i].num_sent > 0)
+			order[n++] = i;
+	qsort(order, n, sizeof(*order), cmp_sent);
+
+	printf("\nURI statistics (top %u of %u URIs by requests; "
+	    "times in ms):\n", n < param.uri_stats ? n : param.uri_stats, n);
+	printf("%9s %9s %7s %7s %7s %7s %12s %8s %8s %8s %8s  %s\n",
+	    "requests", "replies", "2xx", "3xx", "4xx", "5xx", "bytes/reply",
+	    "p50", "p90", "p99", "max", "URI");
+	for (i = 0; i < n && i < param.uri_stats; ++i) {
+		e = &entry[order[i]];
+		num_replies = (e->num_replies[1] + e->num_replies[2]
+		    + e->num_replies[3] + e->num_replies[4]
+		    + e->num_replies[5]);
+		printf("%9lu %9lu %7lu %7lu %7lu %7lu %12.1f %8.1f %8.1f "
+		    "%8.1f %8.1f  %.*s\n", e->num_sent, num_replies,
+		    e->num_replies[2], e->num_replies[3], e->num_replies[4],
+		    e->num_replies[5],
+		    num_replies > 0 ? (double) e->reply_bytes / num_replies
+		    : 0.0,
+		    1e3 * hist_small_percentile(&e->response, 0.5),
+		    1e3 * hist_small_percentile(&e->response, 0.9),
+		    1e3 * hist_small_percentile(&e->response, 0.99),
+		    1e3 * hist_small_percentile(&e->response, 1.0),
+		    (int) e->name_len, pool + e->name);
+	}
+	free(order);
+}
+
+static const void *
+export(size_t *len)
+{
+	struct uri_export *x;
+	char           *cp;
+
+	*len = (sizeof(*x) + num_keys * sizeof(*entry) + pool_len);
+	x = malloc(*len);
+	if (!x) {
+		*len = 0;
+		return NULL;
+	}
+	x->num_keys = num_keys;
+	x->pool_len = pool_len;
+	cp = (char *) (x + 1);
+	memcpy(cp, entry, num_keys * sizeof(*entry));
+	memcpy(cp + num_keys * sizeof(*entry), pool, pool_len);
+	return x;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const struct uri_export *x = buf;
+	const struct uri_entry *oentry, *o;
+	const char     *opool;
+	struct uri_entry *e;
+	u_int           i, j, key;
+
+	assert(len >= sizeof(*x));
+
+	/*
+	 * The other process numbered its URIs on its own, so go by name.
+	 */
+	oentry = (const struct uri_entry *) (x + 1);
+	opool = (const char *) (oentry + x->num_keys);
+	assert(len == sizeof(*x) + x->num_keys * sizeof(*oentry)
+	    + x->pool_len);
+	for (i = OTHER_KEY; i < x->num_keys; ++i) {
+		o = &oentry[i];
+		if (i == OTHER_KEY)
+			key = OTHER_KEY;
+		else
+			key = uri_stat_key(opool + o->name, o->name_len);
+		e = &entry[key];
+		e->num_sent += o->num_sent;
+		for (j = 0; j < NELEMS(e->num_replies); ++j)
+			e->num_replies[j] += o->num_replies[j];
+		e->reply_bytes += o->reply_bytes;
+		hist_small_merge(&e->response, &o->response);
+	}
+}
+
+Stat_Collector  stats_uri = {
+	"Per-URI statistics",
+	init,
+	no_op,
+	no_op,
+	dump,
+	export,
+	merge,
+	reset
+};
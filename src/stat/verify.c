@@ -0,0 +1,463 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Reply integrity checks (--verify).  The expected length and CRC32C of
+ * the body of each URI are read from a file with lines of the form
+ *
+ *	URI LENGTH CRC32C
+ *
+ * where the CRC32C is in hex and either value may be "-" if it is not to
+ * be checked.  A sample of the 200 replies for URIs in that file have their
+ * length compared against the file and the Content-Length header, and
+ * their body checksummed.  Replies that fail are marked corrupt in the call
+ * (see call.h) and counted as integrity errors by the basic statistics.
+ *
+ * Only sampled replies are looked at: the others still have their bodies
+ * drained without being parsed (unless another module, such as the one for
+ * --decode, samples them).  The checksum uses the CRC32 instructions
+ * of SSE 4.2 or ARMv8 where they are available.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <localevent.h>
+#include <stats.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define HAVE_CRC32C_X86
+#elif defined(__GNUC__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_CRC32C_ARM
+#endif
+
+#define	CRC32C_POLY	0x82f63b78	/* reflected Castagnoli polynomial */
+#define	NO_LENGTH	(~(u_wide) 0)
+
+struct digest {
+	u_int           uri;	/* offset of the URI in the string pool */
+	u_int           uri_len;
+	u_wide          length;	/* expected body length (or NO_LENGTH) */
+	u_int           crc;
+	u_int           has_crc;
+};
+
+typedef struct Call_Private_Data {
+	const struct digest *d;
+	u_int           crc;
+	u_wide          content_length;	/* from the header (or NO_LENGTH) */
+} Call_Private_Data;
+
+#define CALL_PRIVATE_DATA(c)						\
+  ((Call_Private_Data *) ((char *)(c) + call_private_data_offset))
+
+static struct verify_stats {
+	u_long          num_checked;	/* # of replies checked */
+	u_long          num_length;	/* # with the wrong length */
+	u_long          num_crc;	/* # with the right length but wrong
+					 * checksum */
+	u_wide          bytes_checked;
+} st;
+
+static struct digest *digest;
+static u_int    num_digests;
+static u_int   *hash;		/* digest index + 1 (0 = empty) */
+static u_int    hash_mask;
+static char    *pool;
+static size_t   pool_len;
+static size_t   call_private_data_offset;
+static u_short  xsubi[3];
+static u_int    crc_table[256];
+static u_int    (*crc_update) (u_int crc, const u_char * p, size_t len);
+
+static u_int
+crc_update_sw(u_int crc, const u_char * p, size_t len)
+{
+	while (len-- > 0)
+		crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef HAVE_CRC32C_X86
+__attribute__((target("sse4.2")))
+static u_int
+crc_update_hw(u_int crc, const u_char * p, size_t len)
+{
+#ifdef __x86_64__
+	unsigned long long c = crc, w;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w, p, 8);
+		c = _mm_crc32_u64(c, w);
+	}
+	crc = c;
+#endif
+	for (; len >= 4; p += 4, len -= 4) {
+		u_int           w4;
+
+		memcpy(&w4, p, 4);
+		crc = _mm_crc32_u32(crc, w4);
+	}
+	while (len-- > 0)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif
+
+#ifdef HAVE_CRC32C_ARM
+static u_int
+crc_update_hw(u_int crc, const u_char * p, size_t len)
+{
+	uint64_t        w;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w, p, 8);
+		crc = __crc32cd(crc, w);
+	}
+	while (len-- > 0)
+		crc = __crc32cb(crc, *p++);
+	return crc;
+}
+#endif
+
+static void
+crc_init(void)
+{
+	u_int           i, j, c;
+
+	for (i = 0; i < 256; ++i) {
+		for (c = i, j = 0; j < 8; ++j)
+			c = (c >> 1) ^ (c & 1 ? CRC32C_POLY : 0);
+		crc_table[i] = c;
+	}
+	crc_update = crc_update_sw;
+#ifdef HAVE_CRC32C_X86
+	if (__builtin_cpu_supports("sse4.2"))
+		crc_update = crc_update_hw;
+#endif
+#ifdef HAVE_CRC32C_ARM
+	crc_update = crc_update_hw;
+#endif
+}
+
+static u_int
+hash_uri(const char *uri, size_t len)
+{
+	u_int           h = 2166136261u;
+
+	while (len-- > 0)
+		h = (h ^ (u_char) * uri++) * 16777619u;
+	return h;
+}
+
+static const struct digest *
+lookup(const char *uri, size_t len)
+{
+	const struct digest *d;
+	u_int           i;
+
+	for (i = hash_uri(uri, len) & hash_mask; hash[i];
+	    i = (i + 1) & hash_mask) {
+		d = &digest[hash[i] - 1];
+		if (d->uri_len == len && memcmp(pool + d->uri, uri, len) == 0)
+			return d;
+	}
+	return NULL;
+}
+
+static void
+bad_line(const char *file, int lineno)
+{
+	fprintf(stderr, "%s: %s:%d: expected URI, length and CRC32C\n",
+	    prog_name, file, lineno);
+	exit(1);
+}
+
+/*
+ * Reads the digests from FILE.
+ */
+static void
+load(const char *file)
+{
+	char            line[8192], uri[8192], len_str[32], crc_str[32];
+	size_t          max_digests = 0, max_pool = 0, n;
+	struct digest  *d;
+	char           *end;
+	u_int           i;
+	FILE           *fp;
+	int             lineno, nf;
+
+	fp = fopen(file, "r");
+	if (!fp) {
+		fprintf(stderr, "%s: can't open %s: %s\n", prog_name, file,
+		    strerror(errno));
+		exit(1);
+	}
+	for (lineno = 1; fgets(line, sizeof(line), fp); ++lineno) {
+		if (line[0] == '#')
+			continue;
+		nf = sscanf(line, "%8191s %31s %31s", uri, len_str, crc_str);
+		if (nf == EOF || nf == 0)
+			continue;
+		if (nf != 3)
+			bad_line(file, lineno);
+
+		if (num_digests == max_digests) {
+			max_digests = max_digests ? 2 * max_digests : 1024;
+			digest = realloc(digest, max_digests * sizeof(*digest));
+		}
+		n = strlen(uri);
+		while (pool_len + n + 1 > max_pool) {
+			max_pool = max_pool ? 2 * max_pool : 65536;
+			pool = realloc(pool, max_pool);
+		}
+		if (!digest || !pool) {
+			fprintf(stderr, "%s: out of memory while reading %s\n",
+			    prog_name, file);
+			exit(1);
+		}
+		d = &digest[num_digests++];
+		d->uri = pool_len;
+		d->uri_len = n;
+		memcpy(pool + pool_len, uri, n + 1);
+		pool_len += n + 1;
+
+		d->length = NO_LENGTH;
+		if (strcmp(len_str, "-") != 0) {
+			d->length = strtoull(len_str, &end, 10);
+			if (*end)
+				bad_line(file, lineno);
+		}
+		d->has_crc = strcmp(crc_str, "-") != 0;
+		if (d->has_crc) {
+			d->crc = strtoul(crc_str, &end, 16);
+			if (*end)
+				bad_line(file, lineno);
+		}
+	}
+	fclose(fp);
+	if (num_digests == 0) {
+		fprintf(stderr, "%s: no digests in %s\n", prog_name, file);
+		exit(1);
+	}
+
+	for (n = 1024; n < 2 * num_digests; n *= 2);
+	hash_mask = n - 1;
+	hash = calloc(n, sizeof(*hash));
+	if (!hash) {
+		fprintf(stderr, "%s: out of memory while reading %s\n",
+		    prog_name, file);
+		exit(1);
+	}
+	for (i = 0; i < num_digests; ++i) {
+		d = &digest[i];
+		if (lookup(pool + d->uri, d->uri_len))
+			continue;	/* the first line for a URI counts */
+		n = hash_uri(pool + d->uri, d->uri_len) & hash_mask;
+		while (hash[n])
+			n = (n + 1) & hash_mask;
+		hash[n] = i + 1;
+	}
+}
+
+static void
+recv_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Call_Private_Data *priv;
+	const struct digest *d;
+
+	assert(et == EV_CALL_RECV_START && object_is_call(c));
+
+	CALL_PRIVATE_DATA(c)->d = NULL;
+	if (c->reply.status != 200)
+		return;
+	if (param.verify.fraction < 1.0
+	    && erand48(xsubi) >= param.verify.fraction)
+		return;
+	d = lookup(c->req.iov[IE_URI].iov_base, c->req.iov[IE_URI].iov_len);
+	if (!d)
+		return;
+
+	priv = CALL_PRIVATE_DATA(c);
+	priv->d = d;
+	priv->crc = ~0u;
+	priv->content_length = NO_LENGTH;
+	c->reply.sampled = 1;
+}
+
+static void
+recv_hdr(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	const struct iovec *line = call_arg.vp;
+	const char     *cp, *end;
+	u_wide          len;
+
+	assert(et == EV_CALL_RECV_HDR && object_is_call(c));
+
+	if (!CALL_PRIVATE_DATA(c)->d || line->iov_len < 15
+	    || strncasecmp(line->iov_base, "content-length:", 15) != 0)
+		return;
+	cp = (const char *) line->iov_base + 15;
+	end = (const char *) line->iov_base + line->iov_len;
+	while (cp < end && (*cp == ' ' || *cp == '\t'))
+		++cp;
+	for (len = 0; cp < end && *cp >= '0' && *cp <= '9'; ++cp)
+		len = 10 * len + (*cp - '0');
+	CALL_PRIVATE_DATA(c)->content_length = len;
+}
+
+static void
+recv_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	const struct iovec *iov = call_arg.vp;
+	Call_Private_Data *priv;
+
+	assert(et == EV_CALL_RECV_SAMPLE && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	if (priv->d)
+		priv->crc = crc_update(priv->crc, iov->iov_base, iov->iov_len);
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+	Call_Private_Data *priv;
+	const struct digest *d;
+	u_wide          len;
+	u_int           crc;
+
+	assert(et == EV_CALL_RECV_STOP && object_is_call(c));
+
+	priv = CALL_PRIVATE_DATA(c);
+	d = priv->d;
+	if (!d || c->basic.epoch != test_epoch)
+		return;		/* sent before the last epoch began */
+	len = c->reply.content_bytes;
+	crc = ~priv->crc;
+
+	++st.num_checked;
+	st.bytes_checked += len;
+	if ((d->length != NO_LENGTH && len != d->length)
+	    || (priv->content_length != NO_LENGTH
+		&& len != priv->content_length)) {
+		++st.num_length;
+		c->reply.corrupt = 1;
+	} else if (d->has_crc && crc != d->crc) {
+		++st.num_crc;
+		c->reply.corrupt = 1;
+	}
+	if (c->reply.corrupt && verbose)
+		printf("%s: %s: %llu bytes with CRC32C %08x (expected %lld "
+		    "bytes with %08x)\n", prog_name, pool + d->uri,
+		    (unsigned long long) len, crc,
+		    d->length == NO_LENGTH ? -1LL : (long long) d->length,
+		    d->crc);
+}
+
+static void
+init(void)
+{
+	Any_Type        arg;
+
+	crc_init();
+	load(param.verify.file);
+	xsubi[0] = 0x5eed ^ param.client.id;
+	xsubi[1] = 0x1d1e ^ (param.client.id << 8);
+	xsubi[2] = 0xc3c3 ^ ~param.client.id;
+
+	call_private_data_offset = object_expand(OBJ_CALL,
+	    sizeof(Call_Private_Data));
+	arg.l = 0;
+	event_register_handler(EV_CALL_RECV_START, recv_start, arg);
+	event_register_handler(EV_CALL_RECV_HDR, recv_hdr, arg);
+	event_register_handler(EV_CALL_RECV_SAMPLE, recv_sample, arg);
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+}
+
+static void
+reset(void)
+{
+	memset(&st, 0, sizeof(st));
+}
+
+static void
+dump(void)
+{
+	printf("\nVerify: checked %lu (%.1f MB) length-mismatch %lu "
+	    "crc-mismatch %lu\n", st.num_checked,
+	    st.bytes_checked / 1048576.0, st.num_length, st.num_crc);
+}
+
+static const void *
+export(size_t *len)
+{
+	*len = sizeof(st);
+	return &st;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const struct verify_stats *o = buf;
+
+	assert(len == sizeof(st));
+	st.num_checked += o->num_checked;
+	st.num_length += o->num_length;
+	st.num_crc += o->num_crc;
+	st.bytes_checked += o->bytes_checked;
+}
+
+Stat_Collector  stats_verify = {
+	"Reply integrity checks",
+	init,
+	no_op,
+	no_op,
+	dump,
+	export,
+	merge,
+	reset
+};
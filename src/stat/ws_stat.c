@@ -0,0 +1,142 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * WebSocket statistics collector (see --websocket).  Counts the messages
+ * sent and the echoes received and keeps a histogram of the echo times,
+ * that is, the time from queueing a message to receiving it back.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <localevent.h>
+#include <stats.h>
+#include <hist.h>
+
+typedef struct WS_Stats {
+	u_long          num_sent;	/* # of messages sent */
+	Time            echo_sum;	/* sum of the echo times */
+	Time            echo_sum2;	/* sum of their squares */
+	Hist            echo_hist;
+} WS_Stats;
+
+static WS_Stats ws;
+
+static void
+echoed(Event_Type et, Object *obj, Any_Type regarg, Any_Type arg)
+{
+	assert(et == EV_WS_ECHO);
+
+	ws.echo_sum += arg.d;
+	ws.echo_sum2 += SQUARE(arg.d);
+	hist_record(&ws.echo_hist, arg.d);
+}
+
+static void
+reset(void)
+{
+	memset(&ws, 0, sizeof(ws));
+	hist_init(&ws.echo_hist);
+}
+
+static void
+init(void)
+{
+	Any_Type        arg;
+
+	reset();
+
+	arg.l = 0;
+	event_register_counter(EV_WS_SEND, &ws.num_sent);
+	event_register_handler(EV_WS_ECHO, echoed, arg);
+}
+
+static void
+dump(void)
+{
+	const Hist     *h = &ws.echo_hist;
+	u_wide          n = h->s.count;
+	Time            delta, avg = 0.0;
+
+	delta = test_time_stop - test_time_start;
+	if (n > 0)
+		avg = ws.echo_sum / n;
+
+	printf("\nWebSocket: messages sent %lu echoed %llu (%.1f msg/s)\n",
+	       ws.num_sent, (unsigned long long) n, delta > 0 ? n / delta : 0.0);
+	printf("WebSocket: echo time [ms]: min %.3f avg %.3f max %.3f "
+	       "median %.3f stddev %.3f\n",
+	       n > 0 ? h->s.min / 1e3 : 0.0, 1e3 * avg,
+	       n > 0 ? h->s.max / 1e3 : 0.0,
+	       1e3 * hist_percentile(h, 0.5),
+	       1e3 * STDDEV(ws.echo_sum, ws.echo_sum2, n));
+	printf("WebSocket: echo time [ms]: p50 %.3f p90 %.3f p99 %.3f "
+	       "p99.9 %.3f max %.3f\n",
+	       1e3 * hist_percentile(h, 0.5), 1e3 * hist_percentile(h, 0.9),
+	       1e3 * hist_percentile(h, 0.99), 1e3 * hist_percentile(h, 0.999),
+	       1e3 * hist_percentile(h, 1.0));
+}
+
+static const void *
+export(size_t *len)
+{
+	*len = sizeof(ws);
+	return &ws;
+}
+
+static void
+merge(const void *buf, size_t len)
+{
+	const WS_Stats *o = buf;
+
+	assert(len == sizeof(ws));
+	ws.num_sent += o->num_sent;
+	ws.echo_sum += o->echo_sum;
+	ws.echo_sum2 += o->echo_sum2;
+	hist_merge(&ws.echo_hist, &o->echo_hist);
+}
+
+Stat_Collector  stats_ws = {
+	"WebSocket statistics",
+	init,
+	no_op,
+	no_op,
+	dump,
+	export,
+	merge,
+	reset
+};
@@ -35,20 +35,56 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <sys/time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
 
 #include <generic_types.h>
-#include <list.h>
 #include <httperf.h>
+#include <timer.h>
+#include <self_stat.h>
 
-#define NUM_TIMERS 25
+/*
+ * Timers are kept in a hierarchical timing wheel: TIMER_LEVELS wheels of
+ * TIMER_SLOTS slots each, where a slot of level 0 covers one tick of
+ * TIMER_RESOLUTION seconds and a slot of level N covers a whole revolution
+ * of level N-1.  Scheduling and cancelling a timer are O(1), and a tick
+ * only looks at the timers that expire in it (plus, once per revolution of
+ * a level, at the timers that cascade down from the next level).  Timers
+ * further out than the last level can reach wait on an overflow list.
+ */
+#define TIMER_RESOLUTION	100e-6
+#define TIMER_SLOT_BITS		8
+#define TIMER_SLOTS		(1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK		(TIMER_SLOTS - 1)
+#define TIMER_LEVELS		4
+
+/*
+ * Timers are allocated this many at a time and recycled through a free
+ * list, so scheduling a timer normally doesn't call malloc().
+ */
+#define TIMER_CHUNK		1024
 
 static Time     now;
 
+struct Timer_Link {
+	struct Timer_Link *next;
+	struct Timer_Link *prev;
+};
+
+enum Timer_State {
+	TIMER_FREE, TIMER_PENDING, TIMER_FIRING
+};
+
 struct Timer {
-	Time            time_started;
-	Time            timeout_delay;
-	bool            has_expired;
+	struct Timer_Link link;	/* must be first */
+	u_wide          expires;	/* tick at which the timer fires */
+	enum Timer_State state;
 
 	/*
 	 * Callback function called when timer expires (timeout) 
@@ -61,31 +97,196 @@ struct Timer {
 	Any_Type        timer_subject;
 };
 
+struct Timer_Chunk {
+	struct Timer_Chunk *next;
+	struct Timer    timers[TIMER_CHUNK];
+};
+
+static struct Timer_Link wheel[TIMER_LEVELS][TIMER_SLOTS];
+static struct Timer_Link overflow;
+
+/*
+ * Precise timers (timer_schedule_precise()) don't go on the wheel, which
+ * rounds their time up to a tick, but on a list sorted by expiration time
+ * that timer_tick() looks at on every call, so they fire within an event
+ * loop iteration of their time.  Their `expires' is in nanoseconds.  They
+ * are meant for the few timers that pace the arrivals of a test.
+ */
+static struct Timer_Link precise;
+static struct Timer_Link free_timers;
+static struct Timer_Chunk *chunks;
+static u_long   num_timers;	/* # of timers in all chunks */
+
+static Time     wheel_base;	/* time of tick 0 */
+static u_wide   wheel_tick;	/* next tick to be processed */
+static u_long   num_pending;
+
+static void
+link_init(struct Timer_Link *l)
+{
+	l->next = l->prev = l;
+}
+
+static bool
+link_is_empty(struct Timer_Link *l)
+{
+	return l->next == l;
+}
+
+static void
+link_insert(struct Timer_Link *head, struct Timer_Link *l)
+{
+	l->next = head->next;
+	l->prev = head;
+	head->next->prev = l;
+	head->next = l;
+}
+
+static void
+link_remove(struct Timer_Link *l)
+{
+	l->prev->next = l->next;
+	l->next->prev = l->prev;
+	l->next = l->prev = l;
+}
+
+/*
+ * Moves all the timers on list FROM to the (empty) list TO.
+ */
+static void
+link_move(struct Timer_Link *from, struct Timer_Link *to)
+{
+	if (link_is_empty(from)) {
+		link_init(to);
+		return;
+	}
+	to->next = from->next;
+	to->prev = from->prev;
+	to->next->prev = to;
+	to->prev->next = to;
+	link_init(from);
+}
+
+static Time
+read_gettimeofday(void)
+{
+	struct timeval  tv;
+
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+#ifdef HAVE_CLOCK_GETTIME
+
+static Time
+read_monotonic(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifdef CLOCK_MONOTONIC_COARSE
+static Time
+read_monotonic_coarse(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+#ifdef HAVE_TSC
 /*
- * inactive timers 
+ * The TSC is converted to CLOCK_MONOTONIC's time scale: tsc_base_time is
+ * the time at which the TSC read tsc_base.
  */
-static struct List *passive_timers = NULL;
+static u_wide   tsc_base;
+static Time     tsc_base_time;
+static double   tsc_period;	/* seconds per TSC tick */
+
+static Time
+read_tsc(void)
+{
+	return tsc_base_time + (Time) (__rdtsc() - tsc_base) * tsc_period;
+}
+
 /*
- * active timers 
+ * Makes sure the TSC ticks at a constant rate that is the same on all
+ * CPUs and measures that rate against CLOCK_MONOTONIC.
  */
-static struct List *active_timers = NULL;
+static bool
+tsc_calibrate(void)
+{
+	struct timespec delay = {0, 50000000};
+	u_int           eax, ebx, ecx, edx;
+	u_wide          tsc_end;
+	Time            end;
+
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)
+	    || !(edx & (1 << 8)))
+		return false;	/* no invariant TSC */
+
+	tsc_base_time = read_monotonic();
+	tsc_base = __rdtsc();
+	nanosleep(&delay, NULL);
+	end = read_monotonic();
+	tsc_end = __rdtsc();
+	if (tsc_end <= tsc_base || end <= tsc_base_time)
+		return false;
+	tsc_period = (end - tsc_base_time) / (tsc_end - tsc_base);
+	return true;
+}
+#endif /* HAVE_TSC */
+
+#endif /* HAVE_CLOCK_GETTIME */
+
+static Time     (*read_clock) (void) = read_gettimeofday;
+
 /*
- * active timeoutless timers 
+ * Selects the clock source.  Returns false if CLOCK is not available on
+ * this system.
  */
-static struct List *persistent_timers = NULL;
+bool
+timer_clock_init(int clock)
+{
+	switch (clock) {
+	case TIMER_CLOCK_GETTIMEOFDAY:
+		read_clock = read_gettimeofday;
+		return true;
+#ifdef HAVE_CLOCK_GETTIME
+	case TIMER_CLOCK_MONOTONIC:
+		read_clock = read_monotonic;
+		return true;
+#ifdef CLOCK_MONOTONIC_COARSE
+	case TIMER_CLOCK_COARSE:
+		read_clock = read_monotonic_coarse;
+		return true;
+#endif
+#ifdef HAVE_TSC
+	case TIMER_CLOCK_TSC:
+		if (!tsc_calibrate())
+			return false;
+		read_clock = read_tsc;
+		return true;
+#endif
+#endif /* HAVE_CLOCK_GETTIME */
+	default:
+		return false;
+	}
+}
 
 /*
- * Returns the time and calls the syscall gettimeofday.  This is an expensive
- * function since it requires a context switch.  Use of the cache is
+ * Reads the clock selected by timer_clock_init().  Depending on the
+ * clock source, this may involve a system call.  Use of the cache is
  * preferable with the timer_now function
  */
 Time
 timer_now_forced(void)
 {
-	struct timeval  tv;
-
-	gettimeofday(&tv, 0);
-	return tv.tv_sec + tv.tv_usec * 1e-6;
+	return (*read_clock) ();
 }
 
 /*
@@ -100,38 +301,49 @@ timer_now(void)
 		return timer_now_forced();
 }
 
+static bool
+timer_grow_pool(void)
+{
+	struct Timer_Chunk *c;
+	int             i;
+
+	c = malloc(sizeof(*c));
+	if (c == NULL)
+		return false;
+	c->next = chunks;
+	chunks = c;
+	num_timers += TIMER_CHUNK;
+	for (i = 0; i < TIMER_CHUNK; i++) {
+		c->timers[i].state = TIMER_FREE;
+		link_insert(&free_timers, &c->timers[i].link);
+	}
+	return true;
+}
+
 /*
- * Initializes a large timer pool cache
- * This is a very expensive function.  Call before beginning measurements.
+ * Initializes the timing wheel and a large timer pool cache
+ * Call before beginning measurements.
  * Returns 0 upon a memory allocation error
  */
 bool
 timer_init(void)
 {
-	passive_timers = list_create();
-	if (passive_timers == NULL)
-		goto init_failure;
+	int             i, j;
 
-	active_timers = list_create();
-	if (active_timers == NULL)
-		goto init_failure;
+	for (i = 0; i < TIMER_LEVELS; i++)
+		for (j = 0; j < TIMER_SLOTS; j++)
+			link_init(&wheel[i][j]);
+	link_init(&overflow);
+	link_init(&precise);
+	link_init(&free_timers);
 
-	persistent_timers = list_create();
-	if (persistent_timers == NULL)
+	if (timer_grow_pool() == false)
 		goto init_failure;
 
-	for (int i = 0; i < NUM_TIMERS; i++) {
-		Any_Type        a;
-		a.vp = malloc(sizeof(struct Timer));
-
-		if (a.vp == NULL)
-			goto init_failure;
-
-		if (list_push(passive_timers, a) == false)
-			goto init_failure;
-	}
-
 	now = timer_now_forced();
+	wheel_base = now;
+	wheel_tick = 0;
+	num_pending = 0;
 
 	return true;
 
@@ -141,117 +353,230 @@ timer_init(void)
 }
 
 /*
- * Frees all allocated timers, and timer queues
+ * Grows the timer pool so that COUNT timers can be pending at the same time
+ * without allocating memory.
+ */
+bool
+timer_prealloc(u_long count)
+{
+	while (num_timers < count)
+		if (timer_grow_pool() == false)
+			return false;
+	return true;
+}
+
+/*
+ * Frees all allocated timers
  */
 void
 timer_free_all(void)
 {
-	while (!is_list_empty(passive_timers)) {
-		Any_Type        a = list_pop(passive_timers);
-		free(a.vp);
-	}
-	list_free(passive_timers);
-	passive_timers = NULL;
+	struct Timer_Chunk *c;
 
-	while (!is_list_empty(active_timers)) {
-		Any_Type        a = list_pop(active_timers);
-		free(a.vp);
+	while ((c = chunks) != NULL) {
+		chunks = c->next;
+		free(c);
 	}
-	list_free(active_timers);
-	active_timers = NULL;
+	num_timers = 0;
+	link_init(&free_timers);
+}
+
+/*
+ * Puts timer T on the wheel slot (or the overflow list) that corresponds to
+ * the distance between its expiration tick and the current tick.
+ */
+static void
+timer_enqueue(struct Timer *t)
+{
+	u_wide          delta;
+	int             level;
+
+	if (t->expires < wheel_tick)
+		t->expires = wheel_tick;
+	delta = t->expires - wheel_tick;
+
+	for (level = 0; level < TIMER_LEVELS; level++)
+		if (delta < ((u_wide) 1 << (TIMER_SLOT_BITS * (level + 1)))) {
+			link_insert(&wheel[level][(t->expires
+			    >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK],
+			    &t->link);
+			return;
+		}
+	link_insert(&overflow, &t->link);
+}
+
+/*
+ * Re-files the timers of slot SLOT of level LEVEL into the lower levels.
+ */
+static void
+timer_cascade(struct Timer_Link *slot)
+{
+	struct Timer_Link list;
+
+	link_move(slot, &list);
+	while (!link_is_empty(&list)) {
+		struct Timer   *t = (struct Timer *) list.next;
 
-	while (!is_list_empty(persistent_timers)) {
-		Any_Type        a = list_pop(persistent_timers);
-		free(a.vp);
+		link_remove(&t->link);
+		timer_enqueue(t);
 	}
-	list_free(persistent_timers);
-	persistent_timers = NULL;
 }
 
 /*
- * Checks whether a timer has expired
+ * Fires the timers that expire in tick wheel_tick and advances the wheel.
  */
-static bool
-timer_has_expired(Any_Type a)
+static void
+timer_run_tick(void)
 {
-	struct Timer   *t = a.vp;
+	struct Timer_Link expired;
+	int             level, idx;
+	Time            lag;
 
 	/*
-	 * Only expire currently processing timers 
+	 * At the start of a revolution of a level, spread the timers of the
+	 * next slot of the level above over it.
 	 */
-	if (t->has_expired == false) {
-		if (t->time_started + t->timeout_delay < timer_now()) {
-			t->has_expired = true;
-			(*t->timeout_callback) (t, t->timer_subject);
-			return true;
-		}
+	for (level = 1; level <= TIMER_LEVELS; level++) {
+		if ((wheel_tick >> (TIMER_SLOT_BITS * (level - 1)))
+		    & TIMER_SLOT_MASK)
+			break;
+		if (level == TIMER_LEVELS)
+			timer_cascade(&overflow);
+		else
+			timer_cascade(&wheel[level][(wheel_tick
+			    >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK]);
 	}
 
-	return false;
+	idx = wheel_tick & TIMER_SLOT_MASK;
+	link_move(&wheel[0][idx], &expired);
+
+	/*
+	 * How late the timers of this tick fire; a client that can't keep
+	 * up shows here first.
+	 */
+	lag = now - (wheel_base + wheel_tick * TIMER_RESOLUTION);
+
+	/*
+	 * Timers scheduled by the callbacks below go to later ticks.
+	 */
+	++wheel_tick;
+
+	while (!link_is_empty(&expired)) {
+		struct Timer   *t = (struct Timer *) expired.next;
+
+		link_remove(&t->link);
+		--num_pending;
+		t->state = TIMER_FIRING;
+		hist_record(&self_stats.timer_lag, lag);
+		(*t->timeout_callback) (t, t->timer_subject);
+		t->state = TIMER_FREE;
+		link_insert(&free_timers, &t->link);
+	}
 }
 
-static bool
-timer_deactivate(Any_Type a)
+/*
+ * Fires the precise timers that have expired.
+ */
+static void
+timer_run_precise(void)
 {
-	struct Timer   *t = a.vp;
+	u_wide          nsec;
+
+	nsec = (u_wide) ((now - wheel_base) * 1e9);
+	while (!link_is_empty(&precise)) {
+		struct Timer   *t = (struct Timer *) precise.next;
+
+		if (t->expires > nsec)
+			break;
+		link_remove(&t->link);
+		--num_pending;
+		t->state = TIMER_FIRING;
+		hist_record(&self_stats.timer_lag,
+		    now - (wheel_base + t->expires * 1e-9));
+		(*t->timeout_callback) (t, t->timer_subject);
+		t->state = TIMER_FREE;
+		link_insert(&free_timers, &t->link);
+	}
+}
 
-	/* TODO: Error check list_push */
-	if (t->has_expired == true)
-		list_push(passive_timers, a);
+void
+timer_tick(void)
+{
+	u_wide          target;
 
-	return t->has_expired;
+	now = timer_now_forced();
+	if (now < wheel_base)
+		return;		/* the clock went backwards */
+	if (!link_is_empty(&precise))
+		timer_run_precise();
+	target = (u_wide) ((now - wheel_base) / TIMER_RESOLUTION);
+
+	if (num_pending == 0) {
+		/*
+		 * Nothing to expire or cascade; just catch up.
+		 */
+		if (target >= wheel_tick)
+			wheel_tick = target + 1;
+		return;
+	}
+	while (wheel_tick <= target)
+		timer_run_tick();
 }
 
 /*
- * Checks for timers which have had their timeout value pass and executes their
- * callback function.  The timer is then removed from the active timer list
- * and then enqueued back into the passive timer queue
+ * Moves the pending timers later by the time that passed since the last
+ * timer_tick(), as if it had not passed.  For waits that are not part of
+ * the test; no lag is recorded for them.
  */
 void
-timer_tick(void)
+timer_rebase(void)
 {
-	now = timer_now_forced();
-	list_for_each(active_timers, &timer_has_expired);
-	list_remove_if_true(active_timers, &timer_deactivate);
+	Time            shift;
+
+	shift = timer_now_forced() - now;
+	if (shift <= 0)
+		return;
+	wheel_base += shift;
+	now += shift;
 }
 
 /*
- * Schedules a timer into the active_timer list.  Usually the timer is 
- * requisitioned from the passive_timer list to avoid making extra calls
- * to malloc, but will allocate memory for a new counter if there are no
- * inactive timers available
+ * Schedules a timer to expire DELAY seconds from now.  The timer comes from
+ * the pool of free timers; memory is allocated only when the pool runs dry.
  */
+static struct Timer *
+timer_get(void (*timeout) (struct Timer * t, Any_Type arg), Any_Type subject)
+{
+	struct Timer   *t;
+
+	if (link_is_empty(&free_timers) && timer_grow_pool() == false)
+		return NULL;
+	t = (struct Timer *) free_timers.next;
+	link_remove(&t->link);
+
+	t->timeout_callback = timeout;
+	t->timer_subject = subject;
+	t->state = TIMER_PENDING;
+	++num_pending;
+	return t;
+}
+
 struct Timer   *
 timer_schedule(void (*timeout) (struct Timer * t, Any_Type arg),
 	       Any_Type subject, Time delay)
 {
 	struct Timer   *t;
+	Time            due;
 
-	if (!is_list_empty(passive_timers)) {
-		Any_Type        a = list_pop(passive_timers);
-		t = (struct Timer *) a.vp;
-	} else if ((t = malloc(sizeof(struct Timer))) == NULL)
+	if ((t = timer_get(timeout, subject)) == NULL)
 		return NULL;
 
-	memset(t, 0, sizeof(struct Timer));
-	t->timeout_callback = timeout;
-	t->has_expired = false;
-	t->timer_subject = subject;
-	t->time_started = timer_now();
-	t->timeout_delay = delay;
-
-	if (delay > 0 || true)
-	{
-		Any_Type temp;
-		temp.vp = (void *)t;
-		list_push(active_timers, temp);
-	}
-	else
-	{
-		Any_Type temp;
-		temp.vp = (void *)t;
-		list_push(persistent_timers, temp);
-	}
+	/*
+	 * Round up so a timer never fires before its time.
+	 */
+	due = timer_now() + delay - wheel_base;
+	t->expires = due > 0 ? (u_wide) (due / TIMER_RESOLUTION) + 1 : 0;
+	timer_enqueue(t);
 
 	if (DBG > 2)
 		fprintf(stderr,
@@ -261,6 +586,40 @@ timer_schedule(void (*timeout) (struct Timer * t, Any_Type arg),
 	return t;
 }
 
+/*
+ * Like timer_schedule(), but the timer fires at the first timer_tick() after
+ * its time rather than on the next tick of the wheel.
+ */
+struct Timer   *
+timer_schedule_precise(void (*timeout) (struct Timer * t, Any_Type arg),
+		       Any_Type subject, Time delay)
+{
+	struct Timer_Link *l;
+	struct Timer   *t;
+	Time            due;
+
+	if ((t = timer_get(timeout, subject)) == NULL)
+		return NULL;
+
+	due = timer_now() + delay - wheel_base;
+	t->expires = due > 0 ? (u_wide) (due * 1e9) + 1 : 0;
+
+	/*
+	 * Timers are mostly scheduled in the order they expire.
+	 */
+	for (l = precise.prev; l != &precise; l = l->prev)
+		if (((struct Timer *) l)->expires <= t->expires)
+			break;
+	link_insert(l, &t->link);
+
+	if (DBG > 2)
+		fprintf(stderr,
+			"timer_schedule_precise: t=%p, delay=%gs, "
+			"subject=%lx\n", t, delay, subject.l);
+
+	return t;
+}
+
 void
 timer_cancel(struct Timer *t)
 {
@@ -269,8 +628,14 @@ timer_cancel(struct Timer *t)
 
 	/*
 	 * A module MUST NOT call timer_cancel() for a timer that is currently 
-	 * being processed (whose timeout has expired).  
+	 * being processed (whose timeout has expired).  Be lenient: it is
+	 * recycled once its callback returns anyway.
 	 */
+	if (t->state != TIMER_PENDING)
+		return;
 
-	t->has_expired = true;
+	link_remove(&t->link);
+	--num_pending;
+	t->state = TIMER_FREE;
+	link_insert(&free_timers, &t->link);
 }
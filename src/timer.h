@@ -35,19 +35,32 @@
 struct Timer;
 typedef void    (*Timer_Callback) (struct Timer * t, Any_Type arg);
 
+/*
+ * Clock sources (see --clock)
+ */
+#define TIMER_CLOCK_GETTIMEOFDAY	0
+#define TIMER_CLOCK_MONOTONIC		1
+#define TIMER_CLOCK_COARSE		2	/* CLOCK_MONOTONIC_COARSE */
+#define TIMER_CLOCK_TSC			3	/* calibrated invariant TSC */
+
+bool     timer_clock_init(int clock);
 Time     timer_now_forced(void);
 Time     timer_now(void);
 
 bool      timer_init(void);
+bool      timer_prealloc(u_long count);
 void     timer_reset_all(void);
 void     timer_free_all(void);
 /*
  * Needs to be called at least once every TIMER_INTERVAL: 
  */
 void     timer_tick(void);
+void     timer_rebase(void);
 
 struct Timer   *timer_schedule(Timer_Callback timeout, Any_Type arg,
 			       Time delay);
+struct Timer   *timer_schedule_precise(Timer_Callback timeout, Any_Type arg,
+			       Time delay);
 void     timer_cancel(struct Timer * t);
 
 #endif /* timer_h */
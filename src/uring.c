@@ -0,0 +1,300 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Minimal io_uring(7) ring management for the core's io_uring engine
+ * (--io-uring).  This talks to the kernel through the raw system calls so
+ * liburing is not needed.  Only what the core uses is provided: a single
+ * ring whose submissions are batched until uring_enter() is called, and one
+ * ring of provided buffers for multishot receives.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <generic_types.h>
+
+#include <httperf.h>
+#include <uring.h>
+
+/*
+ * Each provided buffer has room for the terminating '\0' that the reply
+ * parser relies on.
+ */
+#define	URING_BUF_SIZE		(URING_BUF_LEN + 8)
+
+static int      ring_fd = -1;
+
+static u_int   *sq_head, *sq_tail, *sq_flags, *sq_array;
+static u_int    sq_mask, sq_entries;
+static u_int    sq_local_tail;	/* entries filled in so far */
+static struct io_uring_sqe *sqes;
+
+static u_int   *cq_head, *cq_tail;
+static u_int    cq_mask;
+static struct io_uring_cqe *cqes;
+
+static struct io_uring_buf_ring *buf_ring;
+static u_int    buf_mask;
+static u_short  buf_tail;
+static char    *buf_base;
+
+static int
+sys_io_uring_setup(u_int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(u_int to_submit, u_int min_complete, u_int flags,
+    void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+	    flags, arg, argsz);
+}
+
+static int
+sys_io_uring_register(u_int opcode, void *arg, u_int nr_args)
+{
+	return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static int
+setup_buf_ring(u_int nbufs)
+{
+	struct io_uring_buf_reg reg;
+	size_t          len;
+	u_int           bid;
+
+	len = nbufs * sizeof(struct io_uring_buf);
+	buf_ring = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf_ring == MAP_FAILED)
+		return -1;
+
+	buf_base = mmap(NULL, (size_t) nbufs * URING_BUF_SIZE,
+	    PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf_base == MAP_FAILED)
+		return -1;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (u_long) buf_ring;
+	reg.ring_entries = nbufs;
+	reg.bgid = URING_BGID;
+	if (sys_io_uring_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		return -1;
+
+	buf_mask = nbufs - 1;
+	for (bid = 0; bid < nbufs; ++bid)
+		uring_buf_recycle(bid);
+	return 0;
+}
+
+/*
+ * Set up a ring with ENTRIES submission queue entries and NBUFS provided
+ * receive buffers (NBUFS must be a power of two).  Returns -1 with errno
+ * set if the kernel doesn't support what we need.
+ */
+int
+uring_init(u_int entries, u_int nbufs)
+{
+	struct io_uring_params p;
+	size_t          sq_len, cq_len;
+	char           *ring;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP
+	    | IORING_SETUP_SUBMIT_ALL;
+	/*
+	 * Multishot receives can post many completions per submission.
+	 */
+	p.cq_entries = 4 * entries;
+
+	ring_fd = sys_io_uring_setup(entries, &p);
+	if (ring_fd < 0)
+		return -1;
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP)
+	    || !(p.features & IORING_FEAT_NODROP)) {
+		errno = ENOSYS;
+		goto failure;
+	}
+
+	sq_len = p.sq_off.array + p.sq_entries * sizeof(u_int);
+	cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (cq_len > sq_len)
+		sq_len = cq_len;
+	ring = mmap(NULL, sq_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	if (ring == MAP_FAILED)
+		goto failure;
+	sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+	    IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		goto failure;
+
+	sq_head = (u_int *) (ring + p.sq_off.head);
+	sq_tail = (u_int *) (ring + p.sq_off.tail);
+	sq_flags = (u_int *) (ring + p.sq_off.flags);
+	sq_array = (u_int *) (ring + p.sq_off.array);
+	sq_mask = *(u_int *) (ring + p.sq_off.ring_mask);
+	sq_entries = p.sq_entries;
+	sq_local_tail = *sq_tail;
+
+	cq_head = (u_int *) (ring + p.cq_off.head);
+	cq_tail = (u_int *) (ring + p.cq_off.tail);
+	cq_mask = *(u_int *) (ring + p.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *) (ring + p.cq_off.cqes);
+
+	if (setup_buf_ring(nbufs) < 0)
+		goto failure;
+	return 0;
+
+      failure:
+	close(ring_fd);
+	ring_fd = -1;
+	return -1;
+}
+
+struct io_uring_sqe *
+uring_get_sqe(void)
+{
+	struct io_uring_sqe *sqe;
+	u_int           idx;
+
+	if (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)
+	    >= sq_entries) {
+		/*
+		 * The batch is full; send it off early.
+		 */
+		uring_enter(0, 0.0);
+		if (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)
+		    >= sq_entries) {
+			fprintf(stderr, "%s: io_uring submission queue "
+			    "overflow\n", prog_name);
+			exit(1);
+		}
+	}
+	idx = sq_local_tail & sq_mask;
+	sqe = &sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sq_array[idx] = idx;
+	++sq_local_tail;
+	return sqe;
+}
+
+int
+uring_enter(int wait, Time timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	u_int           to_submit, min_complete = 0, flags = 0;
+	void           *argp = NULL;
+	int             ret;
+
+	__atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+	to_submit = sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+	if (wait && *cq_head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+		ts.tv_sec = (long) timeout;
+		ts.tv_nsec = (long) ((timeout - ts.tv_sec) * 1e9);
+		memset(&arg, 0, sizeof(arg));
+		arg.ts = (u_long) &ts;
+		argp = &arg;
+		min_complete = 1;
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	} else if (__atomic_load_n(sq_flags, __ATOMIC_RELAXED)
+	    & IORING_SQ_CQ_OVERFLOW)
+		/*
+		 * Have the kernel move completions it had to put aside
+		 * into the completion queue.
+		 */
+		flags = IORING_ENTER_GETEVENTS;
+	if (to_submit == 0 && flags == 0)
+		return 0;
+
+	ret = sys_io_uring_enter(to_submit, min_complete, flags, argp,
+	    sizeof(arg));
+	if (ret < 0 && (errno == ETIME || errno == EINTR || errno == EBUSY
+	    || errno == EAGAIN))
+		ret = 0;	/* whatever is left goes out next time */
+	return ret;
+}
+
+struct io_uring_cqe *
+uring_peek_cqe(void)
+{
+	u_int           head = *cq_head;
+
+	if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+	return &cqes[head & cq_mask];
+}
+
+u_int
+uring_cq_ready(void)
+{
+	return __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE) - *cq_head;
+}
+
+void
+uring_cqe_seen(void)
+{
+	__atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
+
+char *
+uring_buf(u_int bid)
+{
+	return buf_base + (size_t) bid * URING_BUF_SIZE;
+}
+
+void
+uring_buf_recycle(u_int bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &buf_ring->bufs[buf_tail & buf_mask];
+	buf->addr = (u_long) uring_buf(bid);
+	buf->len = URING_BUF_LEN;
+	buf->bid = bid;
+	++buf_tail;
+	__atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
+
+#endif /* HAVE_IO_URING */
@@ -0,0 +1,80 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef uring_h
+#define uring_h
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+
+/*
+ * Buffer group of the provided receive buffers.  Each buffer holds up to
+ * URING_BUF_LEN bytes of data plus a terminating '\0'.
+ */
+#define	URING_BGID		0
+#define	URING_BUF_LEN		8192
+
+extern int	uring_init(u_int entries, u_int nbufs);
+
+/*
+ * Returns a cleared submission queue entry.  Entries are batched and only
+ * handed to the kernel by uring_enter() (or when the queue fills up).
+ */
+extern struct io_uring_sqe *uring_get_sqe(void);
+
+/*
+ * Submits all queued entries.  If WAIT is non-zero and no completion is
+ * ready, blocks for at most TIMEOUT seconds waiting for one.
+ */
+extern int	uring_enter(int wait, Time timeout);
+
+/*
+ * Returns the next completed entry or NULL.  Every entry returned must be
+ * released with uring_cqe_seen() before asking for the next one.
+ */
+extern struct io_uring_cqe *uring_peek_cqe(void);
+extern void	uring_cqe_seen(void);
+
+/*
+ * Returns the number of completed entries waiting to be looked at.
+ */
+extern u_int	uring_cq_ready(void);
+
+/*
+ * Provided receive buffers: the data of a completion with
+ * IORING_CQE_F_BUFFER set is in uring_buf(cqe->flags >>
+ * IORING_CQE_BUFFER_SHIFT) and the buffer has to be given back with
+ * uring_buf_recycle() once it has been processed.
+ */
+extern char    *uring_buf(u_int bid);
+extern void	uring_buf_recycle(u_int bid);
+
+#endif /* HAVE_IO_URING */
+
+#endif /* uring_h */
@@ -0,0 +1,249 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The warm-up phase (--warmup).  It ends after a given time, after a
+ * given number of replies or, automatically, once the reply rate and the
+ * mean response time of the last few rate sampling intervals (see
+ * perf_sample() in httperf.c) agree with each other, but no later than a
+ * given time.  Each worker warms up on its own; a number of replies is
+ * shared out among them like the load is.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <generic_types.h>
+#include <sys/resource.h>	/* after sys/types.h for BSD (in generic_types.h) */
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <call.h>
+#include <localevent.h>
+#include <warmup.h>
+
+#define	SETTLE_SAMPLES	3	/* # of intervals that must agree... */
+#define	RATE_TOLERANCE	0.05	/* ...on the reply rate to within 5% */
+#define	TIME_TOLERANCE	0.10	/* ...and on the response time to 10%, */
+#define	TIME_SLACK	1e-3	/* or to 1 ms if that is more */
+
+static Stat_Collector **stat;
+static int      num_stats;
+static int      warming_up;
+static int      settled;	/* did the auto warm-up see a steady state? */
+static Time     start_time, duration;
+static struct Timer *timer;
+static u_long   replies_needed;
+static u_long   num_replies;	/* during the warm-up */
+
+/* the current and the last few sampling intervals (for WARMUP_AUTO): */
+static u_long   interval_replies;
+static u_long   interval_responses;
+static Time     interval_response_sum;
+static u_int    num_samples;
+static struct {
+	double          rate;
+	Time            response_time;
+}               sample[SETTLE_SAMPLES];
+
+static void
+end_warmup(void)
+{
+	warming_up = 0;
+	if (timer) {
+		timer_cancel(timer);
+		timer = NULL;
+	}
+	duration = timer_now() - start_time;
+	if (verbose)
+		printf("%s: warm-up over after %.3f s and %lu replies\n",
+		    prog_name, duration, num_replies);
+	warmup_epoch();
+}
+
+void
+warmup_epoch(void)
+{
+	int             i;
+
+	if (warming_up) {
+		end_warmup();
+		return;
+	}
+	for (i = 0; i < num_stats; ++i)
+		if (stat[i]->reset)
+			(*stat[i]->reset) ();
+	/*
+	 * Calls sent before now are left out of the new statistics even
+	 * when their replies come in later (see call->basic.epoch).
+	 */
+	++test_epoch;
+	test_time_start = timer_now();
+	getrusage(RUSAGE_SELF, &test_rusage_start);
+}
+
+static void
+warmup_timeout(struct Timer *t, Any_Type arg)
+{
+	timer = NULL;
+	if (warming_up)
+		end_warmup();
+}
+
+/*
+ * Do the last SETTLE_SAMPLES intervals agree with their mean?
+ */
+static int
+steady(void)
+{
+	double          rate = 0.0, response_time = 0.0, slack;
+	u_int           i;
+
+	if (num_samples < SETTLE_SAMPLES)
+		return 0;
+	for (i = 0; i < SETTLE_SAMPLES; ++i) {
+		rate += sample[i].rate / SETTLE_SAMPLES;
+		response_time += sample[i].response_time / SETTLE_SAMPLES;
+	}
+	if (rate <= 0.0)
+		return 0;
+	slack = TIME_TOLERANCE * response_time;
+	if (slack < TIME_SLACK)
+		slack = TIME_SLACK;
+	for (i = 0; i < SETTLE_SAMPLES; ++i)
+		if (sample[i].rate < (1.0 - RATE_TOLERANCE) * rate
+		    || sample[i].rate > (1.0 + RATE_TOLERANCE) * rate
+		    || sample[i].response_time < response_time - slack
+		    || sample[i].response_time > response_time + slack)
+			return 0;
+	return 1;
+}
+
+static void
+perf_sample(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	assert(et == EV_PERF_SAMPLE);
+
+	if (!warming_up)
+		return;
+	sample[num_samples % SETTLE_SAMPLES].rate =
+	    call_arg.d * interval_replies;
+	sample[num_samples % SETTLE_SAMPLES].response_time =
+	    interval_responses ? interval_response_sum / interval_responses
+	    : 0.0;
+	++num_samples;
+	interval_replies = interval_responses = 0;
+	interval_response_sum = 0.0;
+
+	if (steady()) {
+		settled = 1;
+		end_warmup();
+	}
+}
+
+static void
+recv_start(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	Call           *c = (Call *) obj;
+
+	assert(et == EV_CALL_RECV_START && object_is_call(c));
+
+	if (!warming_up)
+		return;
+	interval_response_sum += timer_now() - c->basic.time_send_start;
+	++interval_responses;
+}
+
+static void
+recv_stop(Event_Type et, Object * obj, Any_Type reg_arg, Any_Type call_arg)
+{
+	assert(et == EV_CALL_RECV_STOP && object_is_call(obj));
+
+	if (!warming_up)
+		return;
+	++num_replies;
+	++interval_replies;
+	if (replies_needed && num_replies >= replies_needed)
+		end_warmup();
+}
+
+void
+warmup_init(Stat_Collector **collectors, int num_collectors)
+{
+	Any_Type        arg;
+
+	stat = collectors;
+	num_stats = num_collectors;
+	if (!param.warmup.mode)
+		return;
+
+	arg.l = 0;
+	event_register_handler(EV_CALL_RECV_STOP, recv_stop, arg);
+	if (param.warmup.mode == WARMUP_REPLIES)
+		replies_needed = (param.warmup.replies + param.workers - 1)
+		    / param.workers;
+	if (param.warmup.mode == WARMUP_AUTO) {
+		event_register_handler(EV_PERF_SAMPLE, perf_sample, arg);
+		event_register_handler(EV_CALL_RECV_START, recv_start, arg);
+	}
+}
+
+void
+warmup_start(void)
+{
+	Any_Type        arg;
+
+	if (!param.warmup.mode)
+		return;
+	warming_up = 1;
+	start_time = timer_now();
+	if (param.warmup.mode != WARMUP_REPLIES) {
+		arg.l = 0;
+		timer = timer_schedule(warmup_timeout, arg,
+		    param.warmup.time);
+	}
+}
+
+void
+warmup_report(void)
+{
+	if (!param.warmup.mode)
+		return;
+	if (warming_up)
+		printf("\nWarm-up: not over by the end of the test (%.3f s, "
+		    "%lu replies); the results include it\n",
+		    timer_now() - start_time, num_replies);
+	else
+		printf("\nWarm-up: %.3f s, %lu replies%s\n", duration,
+		    num_replies, param.warmup.mode != WARMUP_AUTO ? ""
+		    : settled ? " (steady)" : " (not steady, cut off)");
+}
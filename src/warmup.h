@@ -0,0 +1,54 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef warmup_h
+#define warmup_h
+
+/*
+ * --warmup: results are only collected once the warm-up is over.  Until
+ * then the test runs as usual, but when the warm-up ends, every
+ * statistics collector with a RESET function forgets what it collected
+ * so far, and the test's start time and resource usage are taken anew.
+ * Connections are left alone, so those opened during the warm-up carry
+ * on.
+ *
+ * warmup_init() must be called after the collectors' INIT functions and
+ * warmup_start() right after their START functions.
+ */
+extern void	warmup_init(Stat_Collector **stat, int num_stats);
+extern void	warmup_start(void);
+extern void	warmup_report(void);
+
+/*
+ * Starts a new measurement epoch: ends the warm-up, if it is still on, and
+ * resets the collectors and the test's start time and resource usage as
+ * the end of the warm-up does.
+ */
+extern void	warmup_epoch(void);
+
+#endif /* warmup_h */
@@ -0,0 +1,400 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+
+/*
+ * The WebSocket framing layer.  Messages are sent as single binary frames.
+ * Their payload is the same for every message and only gets masked on the
+ * way out, eight bytes at a time, into an output buffer that is allocated
+ * along with the connection's state and big enough for a full window of
+ * messages; sending a message allocates nothing.  The server's frames are
+ * not looked at beyond their headers, except for the control frames: a
+ * ping is answered with a pong and a close ends the connection.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/uio.h>
+
+#include <generic_types.h>
+
+#include <object.h>
+#include <timer.h>
+#include <httperf.h>
+#include <conn.h>
+#include <localevent.h>
+#include <websocket.h>
+
+#define	MAX_HDR_LEN		14	/* frame header with a mask key */
+#define	MAX_CTL_LEN		125	/* payload of a control frame */
+
+/*
+ * Room kept in the output buffer for pongs and a close frame on top of a
+ * window's worth of messages.
+ */
+#define	CTL_ROOM		(2 * (6 + MAX_CTL_LEN))
+
+#define	F_FIN			0x80
+#define	F_MASK			0x80
+
+enum {
+	OP_CONT = 0x0, OP_TEXT = 0x1, OP_BINARY = 0x2, OP_CLOSE = 0x8,
+	OP_PING = 0x9, OP_PONG = 0xa
+};
+
+struct WS_Conn {
+	Time            sent[WS_WINDOW];	/* when messages were queued */
+	u_int           head;	/* oldest of them */
+	u_int           num_waiting;	/* messages not echoed yet */
+
+	u_char          hdr[MAX_HDR_LEN];	/* frame header being read */
+	u_int           hdr_len;
+	u_int           hdr_need;
+	u_wide          payload_left;	/* of the frame being read */
+	u_char          opcode;	/* of the frame being read */
+	u_char          fin;
+	u_char          in_payload;	/* reading a payload? */
+	u_char          closed;	/* the server sent a close frame */
+	u_char          ctl[MAX_CTL_LEN];	/* payload of a control frame */
+	u_int           ctl_len;
+
+	size_t          out_start;	/* first byte not written yet */
+	size_t          out_len;
+	size_t          out_size;
+	char            out[1];	/* really out_size bytes */
+};
+
+static char    *payload;	/* the payload of every message */
+static size_t   frame_len;	/* a message's frame, header included */
+static u_int    mask_state = 2463534242U;	/* xorshift32 */
+
+static u_int
+next_mask(void)
+{
+	mask_state ^= mask_state << 13;
+	mask_state ^= mask_state >> 17;
+	mask_state ^= mask_state << 5;
+	return mask_state;
+}
+
+/*
+ * Copy the LEN bytes at SRC to DST, masking them with the mask key KEY as it
+ * is stored in the frame header.
+ */
+static void
+mask(char *dst, const char *src, size_t len, u_int key)
+{
+	const u_char   *k = (const u_char *) &key;
+	u_wide          k8, w;
+	size_t          i;
+
+	memcpy(&k8, &key, 4);
+	memcpy((char *) &k8 + 4, &key, 4);
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&w, src + i, 8);
+		w ^= k8;
+		memcpy(dst + i, &w, 8);
+	}
+	for (; i < len; ++i)
+		dst[i] = src[i] ^ k[i & 3];
+}
+
+/*
+ * Append a frame with opcode OP and the LEN byte payload DATA to the output
+ * of W.  Returns -1 if it doesn't fit.
+ */
+static int
+queue_frame(struct WS_Conn *w, int op, const char *data, size_t len)
+{
+	u_char         *p;
+	size_t          hdr_len;
+	u_int           key;
+	int             i;
+
+	hdr_len = 2 + 4 + (len < 126 ? 0 : len < 65536 ? 2 : 8);
+	if (w->out_len + hdr_len + len > w->out_size) {
+		if (w->out_start == 0)
+			return -1;
+		memmove(w->out, w->out + w->out_start,
+		    w->out_len - w->out_start);
+		w->out_len -= w->out_start;
+		w->out_start = 0;
+		if (w->out_len + hdr_len + len > w->out_size)
+			return -1;
+	}
+
+	p = (u_char *) w->out + w->out_len;
+	*p++ = F_FIN | op;
+	if (len < 126)
+		*p++ = F_MASK | len;
+	else if (len < 65536) {
+		*p++ = F_MASK | 126;
+		*p++ = len >> 8;
+		*p++ = len;
+	} else {
+		*p++ = F_MASK | 127;
+		for (i = 7; i >= 0; --i)
+			*p++ = (u_wide) len >> (8 * i);
+	}
+	key = next_mask();
+	memcpy(p, &key, 4);
+	mask((char *) p + 4, data, len, key);
+	w->out_len += hdr_len + len;
+	return 0;
+}
+
+void
+ws_init(Conn * s)
+{
+	struct WS_Conn *w;
+	size_t          size, i;
+
+	if (!payload) {
+		size = param.websocket.msg_size;
+		payload = malloc(size ? size : 1);
+		if (!payload) {
+			fprintf(stderr, "%s.ws_init: out of memory\n",
+			    prog_name);
+			exit(1);
+		}
+		for (i = 0; i < size; ++i)
+			payload[i] = 'a' + i % 26;
+		frame_len = 2 + 4 + (size < 126 ? 0 : size < 65536 ? 2 : 8)
+		    + size;
+	}
+
+	size = WS_WINDOW * frame_len + CTL_ROOM;
+	w = malloc(sizeof(*w) + size);
+	if (!w) {
+		fprintf(stderr, "%s.ws_init: out of memory\n", prog_name);
+		exit(1);
+	}
+	memset(w, 0, sizeof(*w));
+	w->hdr_need = 2;
+	w->out_size = size;
+
+	s->ws = w;
+}
+
+void
+ws_free(Conn * s)
+{
+	free(s->ws);
+	s->ws = NULL;
+}
+
+int
+ws_queue(Conn * s)
+{
+	struct WS_Conn *w = s->ws;
+	Any_Type        arg;
+	Time            now;
+
+	if (w->num_waiting >= WS_WINDOW)
+		return -1;
+	/*
+	 * There is always room for a full window of messages, unless
+	 * pongs took it.
+	 */
+	if (queue_frame(w, OP_BINARY, payload, param.websocket.msg_size) < 0)
+		return -1;
+	now = timer_now();
+	w->sent[(w->head + w->num_waiting++) % WS_WINDOW] = now;
+
+	arg.l = 0;
+	event_signal(EV_WS_SEND, (Object *) s, arg);
+	return 0;
+}
+
+int
+ws_output(Conn * s, struct iovec *iov)
+{
+	struct WS_Conn *w = s->ws;
+
+	iov->iov_base = w->out + w->out_start;
+	iov->iov_len = w->out_len - w->out_start;
+	return iov->iov_len > 0;
+}
+
+void
+ws_sent(Conn * s, size_t len)
+{
+	struct WS_Conn *w = s->ws;
+
+	w->out_start += len;
+	if (w->out_start == w->out_len)
+		w->out_start = w->out_len = 0;
+}
+
+int
+ws_done(Conn * s)
+{
+	return s->ws->closed && s->ws->num_waiting == 0;
+}
+
+Time
+ws_oldest(Conn * s)
+{
+	struct WS_Conn *w = s->ws;
+
+	return w->num_waiting > 0 ? w->sent[w->head] : 0.0;
+}
+
+/*
+ * The header of the frame being read is complete.
+ */
+static int
+frame_start(struct WS_Conn *w)
+{
+	u_char         *p = w->hdr;
+	int             i;
+
+	w->fin = p[0] & F_FIN;
+	w->opcode = p[0] & 0x0f;
+	w->payload_left = p[1] & 0x7f;
+	if (w->payload_left == 126)
+		w->payload_left = (p[2] << 8) | p[3];
+	else if (w->payload_left == 127)
+		for (w->payload_left = 0, i = 2; i < 10; ++i)
+			w->payload_left = (w->payload_left << 8) | p[i];
+
+	if (w->opcode & 0x8) {
+		if (!w->fin || w->payload_left > MAX_CTL_LEN)
+			return EPROTO;
+		w->ctl_len = 0;
+	}
+	w->in_payload = 1;
+	return 0;
+}
+
+/*
+ * The frame being read is complete.
+ */
+static int
+frame_end(Conn * s)
+{
+	struct WS_Conn *w = s->ws;
+	Any_Type        arg;
+
+	w->in_payload = 0;
+	w->hdr_len = 0;
+	w->hdr_need = 2;
+
+	switch (w->opcode) {
+	case OP_CONT:
+	case OP_TEXT:
+	case OP_BINARY:
+		if (!w->fin || w->num_waiting == 0)
+			return 0;
+		arg.d = timer_now() - w->sent[w->head];
+		w->head = (w->head + 1) % WS_WINDOW;
+		--w->num_waiting;
+		event_signal(EV_WS_ECHO, (Object *) s, arg);
+		return 0;
+
+	case OP_PING:
+		/*
+		 * Without room for the pong, the ping goes unanswered; a
+		 * later one will get its pong.
+		 */
+		queue_frame(w, OP_PONG, (char *) w->ctl, w->ctl_len);
+		return 0;
+
+	case OP_PONG:
+		return 0;
+
+	case OP_CLOSE:
+		if (DBG > 0)
+			fprintf(stderr, "%s.ws_input: server closed %p (status "
+			    "%d)\n", prog_name, s, w->ctl_len >= 2
+			    ? (w->ctl[0] << 8) | w->ctl[1] : 0);
+		w->closed = 1;
+		return w->num_waiting > 0 ? ECONNRESET : 0;
+
+	default:
+		return EPROTO;
+	}
+}
+
+int
+ws_input(Conn * s, const char *buf, size_t len)
+{
+	struct WS_Conn *w = s->ws;
+	size_t          n;
+	int             err;
+
+	while (len > 0 || (w->in_payload && w->payload_left == 0)) {
+		if (w->closed)
+			return 0;	/* whatever follows is ignored */
+
+		if (!w->in_payload) {
+			n = w->hdr_need - w->hdr_len;
+			if (n > len)
+				n = len;
+			memcpy(w->hdr + w->hdr_len, buf, n);
+			w->hdr_len += n;
+			buf += n;
+			len -= n;
+			if (w->hdr_len < w->hdr_need)
+				return 0;
+			if (w->hdr_need == 2) {
+				if (w->hdr[1] & F_MASK)
+					return EPROTO;	/* servers don't mask */
+				n = w->hdr[1] & 0x7f;
+				w->hdr_need += n == 126 ? 2 : n == 127 ? 8 : 0;
+				if (w->hdr_len < w->hdr_need)
+					continue;
+			}
+			err = frame_start(w);
+			if (err)
+				return err;
+			continue;
+		}
+
+		n = len < w->payload_left ? len : w->payload_left;
+		if (w->opcode & 0x8) {
+			memcpy(w->ctl + w->ctl_len, buf, n);
+			w->ctl_len += n;
+		}
+		buf += n;
+		len -= n;
+		w->payload_left -= n;
+		if (w->payload_left == 0) {
+			err = frame_end(s);
+			if (err || s->state >= S_CLOSING)
+				return err;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+
+#ifndef websocket_h
+#define websocket_h
+
+/*
+ * WebSocket (RFC 6455) framing for the core.  Once the upgrade request of a
+ * connection has been answered with "101 Switching Protocols", c->ws is set
+ * and the connection carries messages rather than calls.  Every message
+ * sent is expected to come back from the server, in order; the time it
+ * takes is passed on with EV_WS_ECHO.  The core does the reading and
+ * writing, this module the framing.
+ */
+
+/*
+ * Messages that may be waiting for their echo on a connection.
+ */
+#define	WS_WINDOW	8
+
+struct WS_Conn;
+
+/*
+ * Turn connection S into a WebSocket connection.
+ */
+extern void	ws_init(Conn * s);
+extern void	ws_free(Conn * s);
+
+/*
+ * Queue a message of param.websocket.msg_size bytes on S.  Returns -1 if
+ * WS_WINDOW messages are waiting for their echo already.
+ */
+extern int	ws_queue(Conn * s);
+
+/*
+ * Point IOV at the bytes waiting to be written on S.  Returns 0 if there
+ * are none.  Once some of them went out, ws_sent() has to be called with
+ * their number.
+ */
+extern int	ws_output(Conn * s, struct iovec *iov);
+extern void	ws_sent(Conn * s, size_t len);
+
+/*
+ * Process the LEN bytes read from S.  Returns 0 or the errno value the
+ * connection should fail with.
+ */
+extern int	ws_input(Conn * s, const char *buf, size_t len);
+
+/*
+ * Returns non-zero if the server closed S with no message left waiting for
+ * its echo.
+ */
+extern int	ws_done(Conn * s);
+
+/*
+ * Returns when the oldest message still waiting for its echo on S was
+ * queued, or 0 if there is none.
+ */
+extern Time	ws_oldest(Conn * s);
+
+#endif /* websocket_h */
@@ -0,0 +1,523 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Worker processes (--workers=N).
+ *
+ * Rather than running N copies of httperf with --client=i/N and adding up
+ * their output by hand, httperf can fork N-1 copies of itself right after
+ * parsing the command line.  Every worker is pinned to its own CPU (the
+ * ones listed with --cpus, if given) and runs a completely independent
+ * event loop: it owns its connections, timers, rate generator and
+ * statistics, so there is no state shared on the hot path.  Once pinned,
+ * a worker asks for its memory to come from the NUMA node of its CPU,
+ * before the core allocates any objects or buffers.  Each worker gets a
+ * 1/N share of the requested rate and of the number of connections or
+ * sessions.
+ *
+ * When a worker's test is over it ships the state of its statistics
+ * collectors (see the EXPORT and MERGE hooks of Stat_Collector) back to the
+ * first process through a pipe.  That process merges everything into its
+ * own collectors before calling their DUMP functions, so the output looks
+ * exactly as if a single process had generated the whole load.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
+#ifdef HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/wait.h>
+
+#include <generic_types.h>
+#include <sys/resource.h>	/* after sys/types.h for BSD (in generic_types.h) */
+
+#include <httperf.h>
+#include <worker.h>
+
+/*
+ * Sent ahead of the collector states.
+ */
+struct worker_result {
+	Time            time_start;
+	Time            time_stop;
+	struct timeval  utime;	/* CPU time used during the test */
+	struct timeval  stime;
+};
+
+int             worker_id;
+int             worker_cpu = -1;
+
+#define MAX_CPUS	1024
+
+static int      cpu_list[MAX_CPUS];	/* from --cpus */
+static int      num_cpus_listed;
+
+static pid_t   *worker_pid;
+static int     *worker_fd;	/* read end of the result pipe, per worker */
+static int      result_fd = -1;	/* in a forked worker: write end */
+
+int
+write_all(int fd, const void *buf, size_t len)
+{
+	const char     *cp = buf;
+	ssize_t         n;
+
+	while (len > 0) {
+		n = write(fd, cp, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		cp += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int
+read_all(int fd, void *buf, size_t len)
+{
+	char           *cp = buf;
+	ssize_t         n;
+
+	while (len > 0) {
+		n = read(fd, cp, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		cp += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * Returns worker W's share of TOTAL items.
+ */
+static u_long
+share(u_long total, int w, int n)
+{
+	return total / n + ((u_long) w < total % n);
+}
+
+/*
+ * Scale the global parameters down to what the W-th of N processes is
+ * responsible for.  Slicing the slice of an agent (see agent.c) works too.
+ */
+void
+worker_slice(int w, int n)
+{
+	Rate_Info      *r = &param.rate;
+	int             i;
+
+	if (r->rate_param > 0.0) {
+		r->rate_param /= n;
+		r->mean_iat *= n;
+		r->min_iat *= n;
+		r->max_iat *= n;
+		for (i = 0; i < r->numRates; ++i)
+			r->iat[i] *= n;
+		/*
+		 * Interleave the arrivals of the workers instead of having
+		 * all of them fire at the same instant.
+		 */
+		r->phase += w * r->mean_iat / n;
+	}
+
+	param.num_conns = share(param.num_conns, w, n);
+	param.preconnect.num_conns = share(param.preconnect.num_conns, w, n);
+	param.preconnect.rate /= n;
+	param.wsess.num_sessions = share(param.wsess.num_sessions, w, n);
+	param.wsesspage.num_sessions =
+	    share(param.wsesspage.num_sessions, w, n);
+	param.wsesslog.num_sessions = share(param.wsesslog.num_sessions, w, n);
+
+	/*
+	 * Make the workers look like separate clients so they use
+	 * different random number sequences and working set files.
+	 */
+	param.client.id = param.client.id * n + w;
+	param.client.num_clients *= n;
+}
+
+/*
+ * Parse the --cpus argument LIST, CPU numbers and ranges such as 0-3,8,10
+ * separated by commas.  Returns -1 if LIST is malformed or names a CPU
+ * this process may not run on.
+ */
+int
+worker_set_cpus(const char *list)
+{
+	const char     *cp = list;
+	char           *end;
+	long            lo, hi;
+#ifdef HAVE_SCHED_SETAFFINITY
+	cpu_set_t       allowed;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		CPU_ZERO(&allowed);
+#endif
+
+	num_cpus_listed = 0;
+	do {
+		lo = strtol(cp, &end, 10);
+		if (end == cp || lo < 0 || lo >= MAX_CPUS)
+			return -1;
+		hi = lo;
+		cp = end;
+		if (*cp == '-') {
+			hi = strtol(++cp, &end, 10);
+			if (end == cp || hi < lo || hi >= MAX_CPUS)
+				return -1;
+			cp = end;
+		}
+		for (; lo <= hi; ++lo) {
+			if (num_cpus_listed >= MAX_CPUS)
+				return -1;
+#ifdef HAVE_SCHED_SETAFFINITY
+			if (lo >= CPU_SETSIZE || !CPU_ISSET(lo, &allowed))
+				return -1;
+#endif
+			cpu_list[num_cpus_listed++] = lo;
+		}
+	} while (*cp++ == ',');
+	return cp[-1] == '\0' ? 0 : -1;
+}
+
+/*
+ * Make the memory this process allocates from now on come from the NUMA
+ * node of the CPU it runs on, even if it was started under an interleave
+ * or bind policy.  The slabs and buffers touched afterwards (the core and
+ * the collectors are initialized after the workers are pinned) then stay
+ * local to the event loop.
+ */
+static void
+numa_local(void)
+{
+#if defined(HAVE_LINUX_MEMPOLICY_H) && defined(SYS_set_mempolicy)
+	unsigned        cpu, node;
+
+	if (syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0) < 0) {
+		if (verbose > 1)
+			fprintf(stderr, "%s: set_mempolicy: %s\n",
+			    prog_name, strerror(errno));
+		return;
+	}
+#ifdef SYS_getcpu
+	if (verbose > 1 && syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		printf("%s: worker %d allocating from NUMA node %u\n",
+		    prog_name, worker_id, node);
+#endif
+#endif
+}
+
+static void
+pin_cpu(int w)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+	cpu_set_t       allowed, mask;
+	int             cpu, ncpus, i;
+
+	if (num_cpus_listed > 0)
+		cpu = cpu_list[w % num_cpus_listed];
+	else {
+		if (param.workers <= 1
+		    || sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+			return;
+		ncpus = CPU_COUNT(&allowed);
+		if (ncpus <= 1)
+			return;
+
+		/*
+		 * Pick the (w mod ncpus)-th CPU we are allowed to run on.
+		 */
+		w %= ncpus;
+		for (cpu = 0, i = 0; cpu < CPU_SETSIZE; ++cpu)
+			if (CPU_ISSET(cpu, &allowed) && i++ == w)
+				break;
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+		fprintf(stderr, "%s: failed to pin worker %d to CPU %d: %s\n",
+		    prog_name, worker_id, cpu, strerror(errno));
+		if (num_cpus_listed > 0)
+			exit(1);
+		return;
+	}
+	worker_cpu = cpu;
+	if (verbose > 1)
+		printf("%s: worker %d running on CPU %d\n",
+		    prog_name, worker_id, cpu);
+	numa_local();
+#else
+	if (num_cpus_listed > 0) {
+		fprintf(stderr, "%s: --cpus is not supported on this system\n",
+		    prog_name);
+		exit(1);
+	}
+#endif
+}
+
+/*
+ * Fork the additional worker processes.  Must be called before the core,
+ * the statistics collectors and the load generators are initialized.
+ */
+void
+worker_start(void)
+{
+	int             n = param.workers, w, i, fds[2];
+	u_long          total;
+	pid_t           pid;
+
+	if (n <= 1) {
+		pin_cpu(0);
+		return;
+	}
+
+	if (param.wsess.num_sessions)
+		total = param.wsess.num_sessions;
+	else if (param.wsesspage.num_sessions)
+		total = param.wsesspage.num_sessions;
+	else if (param.wsesslog.num_sessions)
+		total = param.wsesslog.num_sessions;
+	else
+		total = param.num_conns;
+	if (total < (u_long) n) {
+		fprintf(stderr, "%s: --workers=%d needs at least as many "
+		    "connections or sessions as workers\n", prog_name, n);
+		exit(1);
+	}
+
+	worker_pid = calloc(n, sizeof(worker_pid[0]));
+	worker_fd = calloc(n, sizeof(worker_fd[0]));
+	if (!worker_pid || !worker_fd) {
+		fprintf(stderr, "%s.worker_start: out of memory\n", prog_name);
+		exit(1);
+	}
+
+	/*
+	 * Don't let the children inherit buffered output.
+	 */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (w = 1; w < n; ++w) {
+		if (pipe(fds) < 0) {
+			fprintf(stderr, "%s.worker_start: pipe: %s\n",
+			    prog_name, strerror(errno));
+			exit(1);
+		}
+		pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "%s.worker_start: fork: %s\n",
+			    prog_name, strerror(errno));
+			exit(1);
+		}
+		if (pid == 0) {
+			close(fds[0]);
+			for (i = 1; i < w; ++i)
+				close(worker_fd[i]);
+			result_fd = fds[1];
+			worker_id = w;
+			break;
+		}
+		close(fds[1]);
+		worker_pid[w] = pid;
+		worker_fd[w] = fds[0];
+	}
+
+	pin_cpu(worker_id);
+	worker_slice(worker_id, n);
+}
+
+static void
+timeval_add(struct timeval *tv, const struct timeval *delta)
+{
+	tv->tv_sec += delta->tv_sec;
+	tv->tv_usec += delta->tv_usec;
+	if (tv->tv_usec >= 1000000) {
+		tv->tv_usec -= 1000000;
+		++tv->tv_sec;
+	}
+}
+
+static void
+timeval_sub(struct timeval *res, const struct timeval *a,
+    const struct timeval *b)
+{
+	res->tv_sec = a->tv_sec - b->tv_sec;
+	res->tv_usec = a->tv_usec - b->tv_usec;
+	if (res->tv_usec < 0) {
+		res->tv_usec += 1000000;
+		--res->tv_sec;
+	}
+}
+
+/*
+ * Writes the test times, the CPU time used and the state of every
+ * collector to FD.
+ */
+int
+worker_send_results(int fd, Stat_Collector **stat, int num_stats)
+{
+	struct worker_result res;
+	const void     *state;
+	size_t          len;
+	int             i;
+
+	res.time_start = test_time_start;
+	res.time_stop = test_time_stop;
+	timeval_sub(&res.utime, &test_rusage_stop.ru_utime,
+	    &test_rusage_start.ru_utime);
+	timeval_sub(&res.stime, &test_rusage_stop.ru_stime,
+	    &test_rusage_start.ru_stime);
+	if (write_all(fd, &res, sizeof(res)) < 0)
+		return -1;
+
+	for (i = 0; i < num_stats; ++i) {
+		len = 0;
+		state = NULL;
+		if (stat[i]->export)
+			state = (*stat[i]->export) (&len);
+		if (write_all(fd, &len, sizeof(len)) < 0
+		    || (len > 0 && write_all(fd, state, len) < 0))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Reads what worker_send_results() wrote and merges it into the local
+ * state.  The clocks of processes on one machine agree, so the test is
+ * taken to have run from the earliest start to the latest stop.  With
+ * REBASE, the sender's clock is unrelated to ours (another machine) and
+ * only the length of its test counts.
+ */
+int
+worker_receive_results(int fd, Stat_Collector **stat, int num_stats,
+    int rebase)
+{
+	struct worker_result res;
+	void           *buf = NULL;
+	size_t          len, buf_size = 0;
+	int             i;
+
+	if (read_all(fd, &res, sizeof(res)) < 0)
+		return -1;
+
+	if (rebase) {
+		if (test_time_start + (res.time_stop - res.time_start)
+		    > test_time_stop)
+			test_time_stop = test_time_start
+			    + (res.time_stop - res.time_start);
+	} else {
+		if (res.time_start < test_time_start)
+			test_time_start = res.time_start;
+		if (res.time_stop > test_time_stop)
+			test_time_stop = res.time_stop;
+	}
+	timeval_add(&test_rusage_stop.ru_utime, &res.utime);
+	timeval_add(&test_rusage_stop.ru_stime, &res.stime);
+
+	for (i = 0; i < num_stats; ++i) {
+		if (read_all(fd, &len, sizeof(len)) < 0)
+			goto failure;
+		if (len == 0)
+			continue;
+		if (len > buf_size) {
+			free(buf);
+			buf_size = len;
+			buf = malloc(buf_size);
+			if (!buf) {
+				fprintf(stderr,
+				    "%s.worker_collect: out of memory\n",
+				    prog_name);
+				exit(1);
+			}
+		}
+		if (read_all(fd, buf, len) < 0)
+			goto failure;
+		if (stat[i]->merge)
+			(*stat[i]->merge) (buf, len);
+	}
+	free(buf);
+	return 0;
+
+      failure:
+	free(buf);
+	return -1;
+}
+
+/*
+ * Called once the test is over and the collectors have been stopped.  A
+ * forked worker sends its results and exits; the first process waits for
+ * all other workers and merges their results into its own.
+ */
+void
+worker_collect(Stat_Collector **stat, int num_stats)
+{
+	int             w, status;
+
+	if (param.workers <= 1 || !worker_pid)
+		return;
+
+	if (worker_id > 0) {
+		if (worker_send_results(result_fd, stat, num_stats) < 0) {
+			fprintf(stderr, "%s: worker %d failed to report "
+			    "results: %s\n", prog_name, worker_id,
+			    strerror(errno));
+			exit(1);
+		}
+		close(result_fd);
+		exit(0);
+	}
+
+	for (w = 1; w < param.workers; ++w) {
+		if (worker_receive_results(worker_fd[w], stat, num_stats,
+		    0) < 0)
+			fprintf(stderr, "%s: lost results of worker %d\n",
+			    prog_name, w);
+		close(worker_fd[w]);
+		while (waitpid(worker_pid[w], &status, 0) < 0
+		    && errno == EINTR);
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of httperf, a web server performance measurment tool.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * In addition, as a special exception, the copyright holders give permission
+ * to link the code of this work with the OpenSSL project's "OpenSSL" library
+ * (or with modified versions of it that use the same license as the "OpenSSL"
+ * library), and distribute linked combinations including the two.  You must
+ * obey the GNU General Public License in all respects for all of the code
+ * used other than "OpenSSL".  If you modify this file, you may extend this
+ * exception to your version of the file, but you are not obligated to do so.
+ * If you do not wish to do so, delete this exception statement from your
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef worker_h
+#define worker_h
+
+/*
+ * Index of this worker process: 0 for the process httperf was started as,
+ * 1..param.workers-1 for the processes forked by worker_start().
+ */
+extern int	worker_id;
+
+/*
+ * The CPU this process is pinned to, or -1 if it may run anywhere.
+ */
+extern int	worker_cpu;
+
+extern int	worker_set_cpus(const char *list);
+extern void	worker_start(void);
+extern void	worker_collect(Stat_Collector **stat, int num_stats);
+extern void	worker_slice(int w, int n);
+
+/*
+ * The results of a test as shipped between processes (also used by the
+ * agents, see agent.c).
+ */
+extern int	worker_send_results(int fd, Stat_Collector **stat,
+		    int num_stats);
+extern int	worker_receive_results(int fd, Stat_Collector **stat,
+		    int num_stats, int rebase);
+
+/*
+ * Like write(2) and read(2) but transfer all LEN bytes (or fail).
+ */
+extern int	write_all(int fd, const void *buf, size_t len);
+extern int	read_all(int fd, void *buf, size_t len);
+
+#endif /* worker_h */